@@ -9,6 +9,7 @@
 #include "NvInfer.h"
 #include "cuda_runtime_api.h"
 #include "logging.h"
+#include "planar_normalize.h"
 
 #define CHECK(status) \
     do\
@@ -400,11 +401,7 @@ int main(int argc, char** argv) {
     delete[] trtModelStream;
 
     cv::Mat img = cv::imread("../joey0.ppm");
-    for (int i = 0; i < INPUT_H * INPUT_W; i++) {
-        data[i] = ((float)img.at<cv::Vec3b>(i)[2] - 127.5) * 0.0078125;
-        data[i + INPUT_H * INPUT_W] = ((float)img.at<cv::Vec3b>(i)[1] - 127.5) * 0.0078125;
-        data[i + 2 * INPUT_H * INPUT_W] = ((float)img.at<cv::Vec3b>(i)[0] - 127.5) * 0.0078125;
-    }
+    planar::normalize<planar::HalfRange, planar::Order::kRgb>(img.data, img.step, INPUT_W, INPUT_H, data, 0);
 
     // Run inference
     auto start = std::chrono::system_clock::now();
@@ -417,11 +414,7 @@ int main(int argc, char** argv) {
     cv::normalize(out, out_norm);
 
     img = cv::imread("../joey1.ppm");
-    for (int i = 0; i < INPUT_H * INPUT_W; i++) {
-        data[i] = ((float)img.at<cv::Vec3b>(i)[2] - 127.5) * 0.0078125;
-        data[i + INPUT_H * INPUT_W] = ((float)img.at<cv::Vec3b>(i)[1] - 127.5) * 0.0078125;
-        data[i + 2 * INPUT_H * INPUT_W] = ((float)img.at<cv::Vec3b>(i)[0] - 127.5) * 0.0078125;
-    }
+    planar::normalize<planar::HalfRange, planar::Order::kRgb>(img.data, img.step, INPUT_W, INPUT_H, data, 0);
 
     // Run inference
     start = std::chrono::system_clock::now();
@@ -0,0 +1,229 @@
+#ifndef TRTX_IMAGE_LOADER_H_
+#define TRTX_IMAGE_LOADER_H_
+
+// Reads and decodes the images of a directory listing on a few threads, in
+// batches, up to `lookahead` batches ahead of the batch being inferred, so
+// disk I/O and JPEG decode overlap inference instead of preceding it.
+//
+// Images are decoded into a fixed set of (lookahead + 1) * batch_size buffers
+// of max_image_bytes each, recycled batch after batch: the batch returned by
+// next() stays valid until the following next(), then its buffers go back to
+// the decode threads. Buffers come from options.alloc, e.g. cudaMallocHost so
+// the pixels can be copied to the GPU without staging. An image larger than a
+// buffer keeps the Mat it was decoded into instead, on the heap. Each thread
+// reuses its file and decode buffers, so once warm a same-size stream does not
+// allocate. Entries that are not regular files, or cannot be read or decoded,
+// are reported on std::cerr and come out empty.
+// With a target size set, JPEGs are decoded at a reduced scale still covering
+// it (jpeg_scale.h); original_sizes then holds the size of the files' images.
+//
+//   ImageLoader::Options options;
+//   options.batch_size = BATCH_SIZE;
+//   ImageLoader loader(dir, file_names, options);
+//   while (const ImageLoader::Batch* batch = loader.next()) {
+//       for (int b = 0; b < batch->size; b++) use(batch->images[b]);  // empty if unreadable
+//   }
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+#include "jpeg_scale.h"
+
+class ImageLoader {
+public:
+    struct Options {
+        int batch_size = 1;
+        // batches decoded ahead of the one in use
+        int lookahead = 2;
+        // decode threads, 0 for hardware_concurrency
+        int threads = 0;
+        // capacity of a buffer; larger images get a heap Mat of their own
+        size_t max_image_bytes = 3840 * 2160 * 3;
+        int imread_flags = cv::IMREAD_COLOR;
+        // network input size: decode JPEGs by 1/2, 1/4 or 1/8 while they still
+        // cover its letterbox (BGR only, imread_flags is ignored); 0 for full size
+        int target_w = 0;
+        int target_h = 0;
+        // allocation of the buffers, new[] / delete[] if not set
+        void* (*alloc)(size_t bytes) = nullptr;
+        void (*release)(void* p) = nullptr;
+    };
+
+    struct Batch {
+        // index in the file list of images[0]
+        int first = 0;
+        int size = 0;
+        // views of the loader's buffers, or heap Mats for images over max_image_bytes;
+        // empty if the file could not be read or decoded
+        std::vector<cv::Mat> images;
+        std::vector<std::string> names;
+        // full size of each image, images[b].size() unless decoded at a reduced scale
+        std::vector<cv::Size> original_sizes;
+    };
+
+    // files are names relative to dir, as read_files_in_dir() lists them.
+    ImageLoader(const std::string& dir, const std::vector<std::string>& files, const Options& options)
+        : dir_(dir), files_(files), options_(options) {
+        options_.batch_size = std::max(1, options_.batch_size);
+        options_.lookahead = std::max(0, options_.lookahead);
+        int threads = options_.threads;
+        if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        slots_.resize(options_.lookahead + 1);
+        for (Slot& slot : slots_) {
+            slot.batch.images.resize(options_.batch_size);
+            slot.batch.names.resize(options_.batch_size);
+            slot.batch.original_sizes.resize(options_.batch_size);
+            for (int b = 0; b < options_.batch_size; b++) {
+                void* p = options_.alloc ? options_.alloc(options_.max_image_bytes) : new uint8_t[options_.max_image_bytes];
+                slot.buffers.push_back(static_cast<uint8_t*>(p));
+            }
+        }
+        for (int t = 0; t < threads; t++) workers_.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~ImageLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : workers_) t.join();
+        for (Slot& slot : slots_) {
+            for (uint8_t* p : slot.buffers) {
+                if (options_.release) {
+                    options_.release(p);
+                } else {
+                    delete[] p;
+                }
+            }
+        }
+    }
+
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    int batches() const { return ((int)files_.size() + options_.batch_size - 1) / options_.batch_size; }
+
+    // The next batch in file order, once all its images are decoded; nullptr
+    // after the last one. Gives the previous batch's buffers back.
+    const Batch* next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (current_ >= 0) {
+            released_ = current_ + 1;
+            wake_.notify_all();
+        }
+        if (current_ + 1 >= batches()) return nullptr;
+        current_++;
+        Slot& slot = slots_[current_ % slots_.size()];
+        const int size = batchSize(current_);
+        ready_.wait(lock, [&]() { return slot.done == size; });
+        slot.done = 0;
+        slot.batch.first = current_ * options_.batch_size;
+        slot.batch.size = size;
+        return &slot.batch;
+    }
+
+private:
+    struct Slot {
+        Batch batch;
+        std::vector<uint8_t*> buffers;
+        // images of the batch decoded so far
+        int done = 0;
+    };
+
+    int batchSize(int k) const { return std::min(options_.batch_size, (int)files_.size() - k * options_.batch_size); }
+
+    void workerLoop() {
+        std::vector<uint8_t> bytes;
+        cv::Mat decoded;
+        for (;;) {
+            int i;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                // the batch of the next file must have a free slot
+                wake_.wait(lock, [&]() {
+                    return stop_ || next_file_ >= (int)files_.size() ||
+                           next_file_ / options_.batch_size < released_ + (int)slots_.size();
+                });
+                if (stop_ || next_file_ >= (int)files_.size()) return;
+                i = next_file_++;
+            }
+            const int k = i / options_.batch_size, b = i % options_.batch_size;
+            Slot& slot = slots_[k % slots_.size()];
+            slot.batch.names[b] = files_[i];
+            const std::string path = dir_ + "/" + files_[i];
+            try {
+                slot.batch.images[b] = decode(path, slot.buffers[b], bytes, decoded, slot.batch.original_sizes[b]);
+            } catch (const std::exception& e) {
+                // cv::Exception from the decoder, bad_alloc for a huge image: skip the file, not the run
+                decoded = cv::Mat();
+                slot.batch.images[b] = skip(path, e.what());
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (++slot.done == batchSize(k)) ready_.notify_all();
+        }
+    }
+
+    // cv::imread, reusing the caller's file and pixel buffers, with the pixels
+    // then copied into buffer when they fit.
+    cv::Mat decode(const std::string& path, uint8_t* buffer, std::vector<uint8_t>& bytes, cv::Mat& decoded, cv::Size& original) const {
+        original = cv::Size();
+        // a directory opens as a stream too, and its tellg() is huge
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return skip(path, "cannot open the file");
+        if (!S_ISREG(st.st_mode)) return skip(path, "not a regular file");
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return skip(path, "cannot open the file");
+        const std::streamoff size = file.tellg();
+        if (size < 0) return skip(path, "cannot read the file");
+        bytes.resize((size_t)size);
+        file.seekg(0);
+        if (bytes.empty()) return skip(path, "the file is empty");
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return skip(path, "cannot read the file");
+        // decoded keeps its previous image when decoding fails, test the result
+        cv::Mat img = options_.target_w > 0 && options_.target_h > 0
+                          ? jpegscale::decode(bytes, options_.target_w, options_.target_h, &decoded, &original)
+                          : cv::imdecode(bytes, options_.imread_flags, &decoded);
+        if (img.empty()) return skip(path, "cannot decode the image");
+        if (original.area() == 0) original = img.size();
+        const size_t row_bytes = decoded.cols * decoded.elemSize();
+        if (row_bytes * decoded.rows > options_.max_image_bytes) {
+            // the batch keeps this decode's Mat, the thread decodes the next image into a new one
+            decoded = cv::Mat();
+            return img;
+        }
+        for (int r = 0; r < decoded.rows; r++) memcpy(buffer + r * row_bytes, decoded.ptr<uint8_t>(r), row_bytes);
+        return cv::Mat(decoded.rows, decoded.cols, decoded.type(), buffer);
+    }
+
+    static cv::Mat skip(const std::string& path, const char* reason) {
+        // one write per line, the decode threads report concurrently
+        std::cerr << "ImageLoader: skipping " + path + ": " + reason + "\n";
+        return cv::Mat();
+    }
+
+    std::string dir_;
+    std::vector<std::string> files_;
+    Options options_;
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable ready_;
+    bool stop_ = false;
+    int next_file_ = 0;
+    // batch handed out by next(), and batches whose slots are free again
+    int current_ = -1;
+    int released_ = 0;
+};
+
+#endif  // TRTX_IMAGE_LOADER_H_
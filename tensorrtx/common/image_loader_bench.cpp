@@ -0,0 +1,130 @@
+// Times the image loop of the samples' -d mode on the CPU, with inference
+// replaced by a sleep: cv::imread of each batch then "inference", as the
+// samples did, against ImageLoader decoding ahead while the batch "runs".
+// Also checks that the loader's images are those of cv::imread, in its buffers
+// and, with buffers too small for them, on the heap. Without an image
+// directory, writes 1080p synthetic JPEGs to image_loader_bench_images/, with
+// a subdirectory, an empty file and a corrupt one that must come out empty.
+//   ./image_loader_bench [image dir] [batch size] [inference ms] [threads] [lookahead]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "image_loader.h"
+
+static std::vector<std::string> list_dir(const std::string& dir) {
+    std::vector<std::string> files;
+    DIR* p_dir = opendir(dir.c_str());
+    if (p_dir == nullptr) return files;
+    struct dirent* p_file = nullptr;
+    while ((p_file = readdir(p_dir)) != nullptr) {
+        if (strcmp(p_file->d_name, ".") != 0 && strcmp(p_file->d_name, "..") != 0) files.push_back(p_file->d_name);
+    }
+    closedir(p_dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static std::string make_images(int count) {
+    const std::string dir = "image_loader_bench_images";
+    mkdir(dir.c_str(), 0755);
+    std::mt19937 rng(0);
+    for (int i = 0; i < count; i++) {
+        // smooth gradients plus noise, so the JPEGs are about the size of photos
+        cv::Mat img(1080, 1920, CV_8UC3);
+        for (int y = 0; y < img.rows; y++) {
+            uint8_t* row = img.ptr<uint8_t>(y);
+            for (int x = 0; x < img.cols * 3; x++) row[x] = (uint8_t)((x / 3 + y + i * 37) / 4 + rng() % 24);
+        }
+        cv::imwrite(dir + "/" + std::to_string(1000 + i) + ".jpg", img);
+    }
+    // entries read_files_in_dir lists too
+    mkdir((dir + "/subdir").c_str(), 0755);
+    std::ofstream(dir + "/empty.jpg");
+    std::ofstream(dir + "/corrupt.jpg") << "not an image";
+    return dir;
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    std::string dir = argc > 1 ? argv[1] : make_images(64);
+    int batch_size = argc > 2 ? atoi(argv[2]) : 1;
+    int infer_ms = argc > 3 ? atoi(argv[3]) : 10;
+    ImageLoader::Options options;
+    options.batch_size = batch_size;
+    options.threads = argc > 4 ? atoi(argv[4]) : 0;
+    options.lookahead = argc > 5 ? atoi(argv[5]) : 2;
+    std::vector<std::string> files = list_dir(dir);
+    if (files.empty()) {
+        std::cerr << "no images in " << dir << std::endl;
+        return -1;
+    }
+    const int batches = ((int)files.size() + batch_size - 1) / batch_size;
+    auto infer = [&]() { std::this_thread::sleep_for(std::chrono::milliseconds(infer_ms)); };
+
+    // the samples' loop: decode the batch, then run it
+    double start = now_ms(), decode_ms = 0;
+    for (int k = 0; k < batches; k++) {
+        double t = now_ms();
+        for (int i = k * batch_size; i < std::min((k + 1) * batch_size, (int)files.size()); i++) {
+            cv::Mat img = cv::imread(dir + "/" + files[i]);
+        }
+        decode_ms += now_ms() - t;
+        infer();
+    }
+    double serial_ms = now_ms() - start;
+
+    // the loader: the next batches decode while this one runs
+    bool same = true;
+    double wait_ms = 0;
+    start = now_ms();
+    {
+        ImageLoader loader(dir, files, options);
+        for (;;) {
+            double t = now_ms();
+            const ImageLoader::Batch* batch = loader.next();
+            wait_ms += now_ms() - t;
+            if (!batch) break;
+            infer();
+        }
+    }
+    double loader_ms = now_ms() - start;
+
+    // every image over max_image_bytes
+    ImageLoader::Options heap = options;
+    heap.max_image_bytes = 1;
+    int skipped = 0;
+    for (const ImageLoader::Options& o : {options, heap}) {
+        ImageLoader loader(dir, files, o);
+        while (const ImageLoader::Batch* batch = loader.next()) {
+            for (int b = 0; b < batch->size; b++) {
+                cv::Mat ref = cv::imread(dir + "/" + files[batch->first + b]);
+                const cv::Mat& img = batch->images[b];
+                bool equal = ref.rows == img.rows && ref.cols == img.cols && batch->names[b] == files[batch->first + b];
+                for (int y = 0; equal && y < ref.rows; y++) equal = memcmp(ref.ptr<uint8_t>(y), img.ptr<uint8_t>(y), ref.cols * ref.elemSize()) == 0;
+                same = same && equal;
+                skipped += img.empty();
+            }
+        }
+    }
+
+    // the subdirectory, the empty and the corrupt file, by both loaders
+    if (argc <= 1) same = same && skipped == 6;
+    std::cout << files.size() << " entries (" << skipped / 2 << " skipped), batch " << batch_size << ", " << infer_ms << "ms inference per batch" << std::endl;
+    std::cout << "imread then infer: " << serial_ms / batches << "ms per batch (" << decode_ms / batches << "ms decoding)" << std::endl;
+    std::cout << "ImageLoader:       " << loader_ms / batches << "ms per batch (" << wait_ms / batches << "ms waiting for images)"
+              << (same ? ", same images as imread" : ", MISMATCH") << std::endl;
+    return same ? 0 : 1;
+}
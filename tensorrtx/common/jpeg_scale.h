@@ -0,0 +1,91 @@
+#ifndef TRTX_JPEG_SCALE_H_
+#define TRTX_JPEG_SCALE_H_
+
+// Decoding of JPEGs at a reduced size for a network input of target_w x
+// target_h: libjpeg can scale by 1/2, 1/4 or 1/8 while decoding (it drops DCT
+// coefficients, so decode time drops about with the pixel count), and the
+// letterbox only needs an image as large as its content, e.g. 960x540 of a
+// 3840x2160 still for 640x640. OpenCV exposes this as IMREAD_REDUCED_COLOR_*,
+// which decode() uses; other formats are decoded at full size.
+//
+// Boxes found in the decoded image are mapped back with
+// scale_to_original (yolov5/postprocess_cpu.h) or get_rect(img, original, bbox).
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace jpegscale {
+
+// Width and height from the SOF marker of a JPEG; false if data is not a JPEG
+// or the marker is not within it.
+inline bool jpegSize(const uint8_t* data, size_t size, int& width, int& height) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return false;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {  // fill byte
+            pos++;
+            continue;
+        }
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {  // no length
+            pos += 2;
+            continue;
+        }
+        size_t length = (size_t)data[pos + 2] << 8 | data[pos + 3];
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > size) return false;
+            height = data[pos + 5] << 8 | data[pos + 6];
+            width = data[pos + 7] << 8 | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        if (marker == 0xDA || length < 2) return false;  // scan before any SOF
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// Largest scale denominator, 8, 4, 2 or 1, whose image still covers the
+// content of the letterbox of a width x height image into target_w x target_h,
+// i.e. scale * denom <= 1 for the letterbox scale min(target_w / width, target_h / height).
+inline int scaleDenom(int width, int height, int target_w, int target_h) {
+    for (int denom = 8; denom > 1; denom /= 2) {
+        if ((long)denom * target_w <= width || (long)denom * target_h <= height) return denom;
+    }
+    return 1;
+}
+
+inline int imreadFlags(int denom) {
+    switch (denom) {
+        case 8: return cv::IMREAD_REDUCED_COLOR_8;
+        case 4: return cv::IMREAD_REDUCED_COLOR_4;
+        case 2: return cv::IMREAD_REDUCED_COLOR_2;
+        default: return cv::IMREAD_COLOR;
+    }
+}
+
+// cv::imdecode of bytes into dst (reused if it has the right size), BGR, if it
+// is a JPEG at the largest reduction whose image still covers target_w x target_h.
+// original gets the full size of the image. Returns the decoded image, empty
+// on failure.
+inline cv::Mat decode(const std::vector<uint8_t>& bytes, int target_w, int target_h, cv::Mat* dst, cv::Size* original) {
+    int width = 0, height = 0, denom = 1;
+    if (jpegSize(bytes.data(), bytes.size(), width, height)) denom = scaleDenom(width, height, target_w, target_h);
+    cv::Mat img = cv::imdecode(bytes, imreadFlags(denom), dst);
+    if (original) {
+        *original = img.size();
+        if (denom > 1 && !img.empty()) {
+            // libjpeg rounds the scaled size up; EXIF orientation may have transposed the image
+            bool transposed = img.cols != (width + denom - 1) / denom;
+            *original = transposed ? cv::Size(height, width) : cv::Size(width, height);
+        }
+    }
+    return img;
+}
+
+}  // namespace jpegscale
+
+#endif  // TRTX_JPEG_SCALE_H_
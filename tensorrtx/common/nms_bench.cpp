@@ -0,0 +1,189 @@
+// Checks boxnms::NmsEngine against the std::map based nms() of the samples and
+// times both, plus the DIoU and soft variants, at 100 / 1000 / 10000 candidate
+// boxes. Also counts heap allocations of the engine once it is warm.
+//   ./nms_bench [iterations]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include "nms_engine.h"
+
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct Detection {
+    float bbox[4];  // center_x center_y w h, or x1 y1 x2 y2 for the corner case
+    float conf;
+    float class_id;
+};
+
+// The per-sample implementation being replaced (yolov5/common.hpp).
+static float iou_center(const float lbox[4], const float rbox[4]) {
+    float interBox[] = {
+        (std::max)(lbox[0] - lbox[2] / 2.f , rbox[0] - rbox[2] / 2.f), //left
+        (std::min)(lbox[0] + lbox[2] / 2.f , rbox[0] + rbox[2] / 2.f), //right
+        (std::max)(lbox[1] - lbox[3] / 2.f , rbox[1] - rbox[3] / 2.f), //top
+        (std::min)(lbox[1] + lbox[3] / 2.f , rbox[1] + rbox[3] / 2.f), //bottom
+    };
+
+    if (interBox[2] > interBox[3] || interBox[0] > interBox[1])
+        return 0.0f;
+
+    float interBoxS = (interBox[1] - interBox[0])*(interBox[3] - interBox[2]);
+    return interBoxS / (lbox[2] * lbox[3] + rbox[2] * rbox[3] - interBoxS);
+}
+
+// retinaface/common.hpp
+static float iou_corner(const float lbox[4], const float rbox[4]) {
+    float interBox[] = {
+        std::max(lbox[0], rbox[0]), //left
+        std::min(lbox[2], rbox[2]), //right
+        std::max(lbox[1], rbox[1]), //top
+        std::min(lbox[3], rbox[3]), //bottom
+    };
+
+    if(interBox[2] > interBox[3] || interBox[0] > interBox[1])
+        return 0.0f;
+
+    float interBoxS = (interBox[1] - interBox[0]) * (interBox[3] - interBox[2]);
+    return interBoxS / ((lbox[2] - lbox[0]) * (lbox[3] - lbox[1]) + (rbox[2] - rbox[0]) * (rbox[3] - rbox[1]) -interBoxS + 0.000001f);
+}
+
+static void nms_reference(std::vector<Detection>& res, const std::vector<Detection>& input, float nms_thresh, bool corner) {
+    std::map<float, std::vector<Detection>> m;
+    for (const Detection& det : input) m[det.class_id].push_back(det);
+    for (auto it = m.begin(); it != m.end(); it++) {
+        auto& dets = it->second;
+        std::sort(dets.begin(), dets.end(), [](const Detection& a, const Detection& b) { return a.conf > b.conf; });
+        for (size_t m = 0; m < dets.size(); ++m) {
+            auto& item = dets[m];
+            res.push_back(item);
+            for (size_t n = m + 1; n < dets.size(); ++n) {
+                float iou = corner ? iou_corner(item.bbox, dets[n].bbox) : iou_center(item.bbox, dets[n].bbox);
+                if (iou > nms_thresh) {
+                    dets.erase(dets.begin() + n);
+                    --n;
+                }
+            }
+        }
+    }
+}
+
+static const std::vector<int>& nms_engine(boxnms::NmsEngine& engine, const std::vector<Detection>& input, const boxnms::Config& config, bool corner) {
+    engine.reset();
+    for (const Detection& det : input) {
+        if (corner) {
+            engine.addCorner(det.bbox, det.conf, (int)det.class_id);
+        } else {
+            engine.addCenter(det.bbox, det.conf, (int)det.class_id);
+        }
+    }
+    return engine.run(config);
+}
+
+// Objects on a 640x640 image, each seen by several jittered candidates, as the
+// YOLO heads produce them.
+static std::vector<Detection> make_candidates(int n, int classes, bool corner, std::mt19937& rng) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<Detection> dets;
+    while ((int)dets.size() < n) {
+        float cx = 640 * u(rng), cy = 640 * u(rng), w = 16 + 200 * u(rng), h = 16 + 200 * u(rng);
+        float cls = (float)(rng() % classes);
+        int copies = 1 + rng() % 12;
+        for (int k = 0; k < copies && (int)dets.size() < n; k++) {
+            Detection d;
+            d.bbox[0] = cx + w * 0.1f * (u(rng) - 0.5f);
+            d.bbox[1] = cy + h * 0.1f * (u(rng) - 0.5f);
+            d.bbox[2] = w * (0.9f + 0.2f * u(rng));
+            d.bbox[3] = h * (0.9f + 0.2f * u(rng));
+            if (corner) {
+                float x = d.bbox[0], y = d.bbox[1];
+                d.bbox[0] = x - d.bbox[2] / 2;
+                d.bbox[1] = y - d.bbox[3] / 2;
+                d.bbox[2] = x + d.bbox[2] / 2;
+                d.bbox[3] = y + d.bbox[3] / 2;
+            }
+            d.conf = 0.1f + 0.9f * u(rng);
+            d.class_id = cls;
+            dets.push_back(d);
+        }
+    }
+    return dets;
+}
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    std::mt19937 rng(0);
+    boxnms::NmsEngine engine;
+    bool ok = true;
+    struct Case { int boxes; int classes; bool corner; const char* name; };
+    const Case cases[] = {
+        {100, 80, false, "yolo"}, {1000, 80, false, "yolo"}, {10000, 80, false, "yolo"},
+        {100, 1, true, "face"}, {1000, 1, true, "face"}, {10000, 1, true, "face"},
+    };
+    for (const Case& c : cases) {
+        std::vector<Detection> input = make_candidates(c.boxes, c.classes, c.corner, rng);
+        boxnms::Config hard;
+        hard.iou_thresh = 0.4f;
+        hard.union_eps = c.corner ? 0.000001f : 0.f;
+
+        std::vector<Detection> expected;
+        nms_reference(expected, input, hard.iou_thresh, c.corner);
+        const std::vector<int>& keep = nms_engine(engine, input, hard, c.corner);
+        bool same = keep.size() == expected.size();
+        for (size_t k = 0; same && k < keep.size(); k++) {
+            same = memcmp(&input[keep[k]], &expected[k], sizeof(Detection)) == 0;
+        }
+        ok = ok && same;
+        size_t kept = keep.size();
+
+        boxnms::Config diou = hard;
+        diou.mode = boxnms::Mode::DIOU;
+        boxnms::Config soft = hard;
+        soft.mode = boxnms::Mode::SOFT_GAUSSIAN;
+        soft.score_thresh = 0.1f;
+        size_t kept_diou = nms_engine(engine, input, diou, c.corner).size();
+        size_t kept_soft = nms_engine(engine, input, soft, c.corner).size();
+
+        std::vector<Detection> res;
+        res.reserve(input.size());
+        double t_ref = time_ms(iterations, [&]() {
+            res.clear();
+            nms_reference(res, input, hard.iou_thresh, c.corner);
+        });
+        size_t allocations = g_allocations;
+        double t_hard = time_ms(iterations, [&]() { nms_engine(engine, input, hard, c.corner); });
+        double t_diou = time_ms(iterations, [&]() { nms_engine(engine, input, diou, c.corner); });
+        double t_soft = time_ms(iterations, [&]() { nms_engine(engine, input, soft, c.corner); });
+        allocations = g_allocations - allocations;
+        ok = ok && allocations == 0;
+
+        std::cout << c.name << " " << c.boxes << " boxes: kept " << kept << (same ? " same as nms()" : " MISMATCH")
+                  << ", diou " << kept_diou << ", soft " << kept_soft
+                  << "  nms() " << t_ref << "ms  hard " << t_hard << "ms  diou " << t_diou << "ms  soft " << t_soft << "ms"
+                  << "  " << allocations << " allocations" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,366 @@
+#ifndef TRTX_NMS_ENGINE_H_
+#define TRTX_NMS_ENGINE_H_
+
+// Non-maximum suppression shared by the tensorrtx samples and the Triton client.
+//
+// Candidates are added one by one, in whatever layout the decode plugin emits
+// (center cx, cy, w, h for the YOLO layers, corners x1, y1, x2, y2 for
+// retinaface), and stored as a structure of arrays with corners, centers and
+// areas precomputed. run() sorts once by (class, score) and each kept box
+// sweeps the rest of its class segment with an 8-wide (AVX2) / 4-wide (NEON)
+// IoU, setting the suppressed boxes in a bitmask. All buffers belong to the
+// engine and keep their capacity across reset(), so a long-lived engine does
+// not allocate once it has seen its largest frame.
+//
+// Modes:
+//   HARD          greedy NMS, suppress while IoU > iou_thresh. Same kept boxes,
+//                 in the same order, as the std::map based nms() it replaces:
+//                 ascending class, descending score within a class.
+//   DIOU          greedy NMS on IoU - d^2 / c^2 (center distance over the
+//                 diagonal of the enclosing box), keeps more of the adjacent,
+//                 overlapping objects than HARD.
+//   SOFT_LINEAR   soft-NMS, score *= 1 - IoU for IoU > iou_thresh.
+//   SOFT_GAUSSIAN soft-NMS, score *= exp(-IoU^2 / sigma).
+// Soft modes keep boxes in decreasing decayed score per class and drop those
+// that fall to score_thresh or below; scores() holds the decayed values.
+//
+//   static thread_local boxnms::NmsEngine engine;
+//   engine.reset();
+//   for (...) engine.addCenter(det.bbox, det.conf, (int)det.class_id);
+//   for (int i : engine.run(config)) res.push_back(dets[i]);
+//
+// nmsDetections() does exactly that for the [count, Detection...] blob of the
+// YOLO layers; yolov3, yolov4, scaled-yolov4 and yolov5 call it for nms().
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NMS_ENGINE_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define NMS_ENGINE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace boxnms {
+
+enum class Mode { HARD, DIOU, SOFT_LINEAR, SOFT_GAUSSIAN };
+
+struct Config {
+    Mode mode = Mode::HARD;
+    float iou_thresh = 0.5f;
+    // Added to the IoU denominator, retinaface uses 1e-6.
+    float union_eps = 0.f;
+    // SOFT_GAUSSIAN decay width.
+    float sigma = 0.5f;
+    // Soft modes: boxes whose decayed score is not above this are dropped.
+    float score_thresh = 0.001f;
+    // Only the best max_candidates boxes of each class take part, 0 for all.
+    int max_candidates = 0;
+};
+
+// Boxes as parallel arrays, sorted by (class, score) in run().
+struct Boxes {
+    std::vector<float> x1, y1, x2, y2, cx, cy, area, score;
+    std::vector<int> cls;
+    std::vector<int> index;  // position in the order of add*()
+
+    void resize(size_t n) {
+        x1.resize(n); y1.resize(n); x2.resize(n); y2.resize(n);
+        cx.resize(n); cy.resize(n); area.resize(n); score.resize(n);
+        cls.resize(n); index.resize(n);
+    }
+};
+
+// IoU, or DIoU, of box i against box j, with the exact arithmetic of the old
+// per-sample iou() functions so HARD gives identical decisions.
+inline float overlapScalar(const Boxes& b, int i, int j, bool diou, float eps) {
+    float left = std::max(b.x1[i], b.x1[j]);
+    float right = std::min(b.x2[i], b.x2[j]);
+    float top = std::max(b.y1[i], b.y1[j]);
+    float bottom = std::min(b.y2[i], b.y2[j]);
+    float inter = 0.f;
+    if (!(top > bottom || left > right)) inter = (right - left) * (bottom - top);
+    float iou = inter / (b.area[i] + b.area[j] - inter + eps);
+    if (!diou) return iou;
+    float dx = b.cx[i] - b.cx[j];
+    float dy = b.cy[i] - b.cy[j];
+    float cw = std::max(b.x2[i], b.x2[j]) - std::min(b.x1[i], b.x1[j]);
+    float ch = std::max(b.y2[i], b.y2[j]) - std::min(b.y1[i], b.y1[j]);
+    return iou - (dx * dx + dy * dy) / (cw * cw + ch * ch + 1e-7f);
+}
+
+#ifdef NMS_ENGINE_AVX2
+__attribute__((target("avx2"))) inline __m256 overlap8Avx2(const Boxes& b, int i, int j, bool diou, float eps) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 ix1 = _mm256_set1_ps(b.x1[i]), iy1 = _mm256_set1_ps(b.y1[i]);
+    __m256 ix2 = _mm256_set1_ps(b.x2[i]), iy2 = _mm256_set1_ps(b.y2[i]);
+    __m256 jx1 = _mm256_loadu_ps(&b.x1[j]), jy1 = _mm256_loadu_ps(&b.y1[j]);
+    __m256 jx2 = _mm256_loadu_ps(&b.x2[j]), jy2 = _mm256_loadu_ps(&b.y2[j]);
+    // max(w, 0) * max(h, 0) is 0 exactly where the scalar code returns 0
+    __m256 w = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(ix2, jx2), _mm256_max_ps(ix1, jx1)), zero);
+    __m256 h = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(iy2, jy2), _mm256_max_ps(iy1, jy1)), zero);
+    __m256 inter = _mm256_mul_ps(w, h);
+    __m256 uni = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(b.area[i]), _mm256_loadu_ps(&b.area[j])), inter);
+    __m256 iou = _mm256_div_ps(inter, _mm256_add_ps(uni, _mm256_set1_ps(eps)));
+    if (!diou) return iou;
+    __m256 dx = _mm256_sub_ps(_mm256_set1_ps(b.cx[i]), _mm256_loadu_ps(&b.cx[j]));
+    __m256 dy = _mm256_sub_ps(_mm256_set1_ps(b.cy[i]), _mm256_loadu_ps(&b.cy[j]));
+    __m256 cw = _mm256_sub_ps(_mm256_max_ps(ix2, jx2), _mm256_min_ps(ix1, jx1));
+    __m256 ch = _mm256_sub_ps(_mm256_max_ps(iy2, jy2), _mm256_min_ps(iy1, jy1));
+    __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    __m256 c2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cw, cw), _mm256_mul_ps(ch, ch)), _mm256_set1_ps(1e-7f));
+    return _mm256_sub_ps(iou, _mm256_div_ps(d2, c2));
+}
+
+// suppress() and overlaps() over whole blocks of 8, returning where the scalar tail starts.
+__attribute__((target("avx2"))) inline int suppressAvx2(const Boxes& b, int i, int j, int j1, bool diou, float eps, float thresh, uint64_t* removed) {
+    const __m256 vthresh = _mm256_set1_ps(thresh);
+    for (; j + 8 <= j1; j += 8) {
+        int word = j >> 6, shift = j & 63;
+        uint64_t done = removed[word] >> shift;
+        if (shift > 56) done |= removed[word + 1] << (64 - shift);
+        if ((done & 0xFF) == 0xFF) continue;  // already suppressed by a better box
+        __m256 v = overlap8Avx2(b, i, j, diou, eps);
+        uint64_t bits = (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(v, vthresh, _CMP_GT_OQ));
+        removed[word] |= bits << shift;
+        if (shift > 56) removed[word + 1] |= bits >> (64 - shift);
+    }
+    return j;
+}
+
+__attribute__((target("avx2"))) inline int overlapsAvx2(const Boxes& b, int i, int j0, int j1, bool diou, float eps, float* out) {
+    int j = j0;
+    for (; j + 8 <= j1; j += 8) _mm256_storeu_ps(out + j - j0, overlap8Avx2(b, i, j, diou, eps));
+    return j;
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif  // NMS_ENGINE_AVX2
+
+#ifdef NMS_ENGINE_NEON
+inline float32x4_t overlap4Neon(const Boxes& b, int i, int j, bool diou, float eps) {
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    float32x4_t ix1 = vdupq_n_f32(b.x1[i]), iy1 = vdupq_n_f32(b.y1[i]);
+    float32x4_t ix2 = vdupq_n_f32(b.x2[i]), iy2 = vdupq_n_f32(b.y2[i]);
+    float32x4_t jx1 = vld1q_f32(&b.x1[j]), jy1 = vld1q_f32(&b.y1[j]);
+    float32x4_t jx2 = vld1q_f32(&b.x2[j]), jy2 = vld1q_f32(&b.y2[j]);
+    float32x4_t w = vmaxq_f32(vsubq_f32(vminq_f32(ix2, jx2), vmaxq_f32(ix1, jx1)), zero);
+    float32x4_t h = vmaxq_f32(vsubq_f32(vminq_f32(iy2, jy2), vmaxq_f32(iy1, jy1)), zero);
+    float32x4_t inter = vmulq_f32(w, h);
+    float32x4_t uni = vsubq_f32(vaddq_f32(vdupq_n_f32(b.area[i]), vld1q_f32(&b.area[j])), inter);
+    float32x4_t iou = vdivq_f32(inter, vaddq_f32(uni, vdupq_n_f32(eps)));
+    if (!diou) return iou;
+    float32x4_t dx = vsubq_f32(vdupq_n_f32(b.cx[i]), vld1q_f32(&b.cx[j]));
+    float32x4_t dy = vsubq_f32(vdupq_n_f32(b.cy[i]), vld1q_f32(&b.cy[j]));
+    float32x4_t cw = vsubq_f32(vmaxq_f32(ix2, jx2), vminq_f32(ix1, jx1));
+    float32x4_t ch = vsubq_f32(vmaxq_f32(iy2, jy2), vminq_f32(iy1, jy1));
+    float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+    float32x4_t c2 = vaddq_f32(vaddq_f32(vmulq_f32(cw, cw), vmulq_f32(ch, ch)), vdupq_n_f32(1e-7f));
+    return vsubq_f32(iou, vdivq_f32(d2, c2));
+}
+#endif  // NMS_ENGINE_NEON
+
+// Sets bit j of removed for every j in [j0, j1) whose overlap with i exceeds thresh.
+inline void suppress(const Boxes& b, int i, int j0, int j1, bool diou, float eps, float thresh, uint64_t* removed) {
+    int j = j0;
+#if defined(NMS_ENGINE_AVX2)
+    if (hasAvx2()) j = suppressAvx2(b, i, j, j1, diou, eps, thresh, removed);
+#elif defined(NMS_ENGINE_NEON)
+    for (; j + 4 <= j1; j += 4) {
+        float out[4];
+        vst1q_f32(out, overlap4Neon(b, i, j, diou, eps));
+        for (int k = 0; k < 4; k++) {
+            if (out[k] > thresh) removed[(j + k) >> 6] |= 1ull << ((j + k) & 63);
+        }
+    }
+#endif
+    for (; j < j1; j++) {
+        if (overlapScalar(b, i, j, diou, eps) > thresh) removed[j >> 6] |= 1ull << (j & 63);
+    }
+}
+
+// Overlap of i with every box in [j0, j1) into out[0, j1 - j0).
+inline void overlaps(const Boxes& b, int i, int j0, int j1, bool diou, float eps, float* out) {
+    int j = j0;
+#if defined(NMS_ENGINE_AVX2)
+    if (hasAvx2()) j = overlapsAvx2(b, i, j0, j1, diou, eps, out);
+#elif defined(NMS_ENGINE_NEON)
+    for (; j + 4 <= j1; j += 4) vst1q_f32(out + j - j0, overlap4Neon(b, i, j, diou, eps));
+#endif
+    for (; j < j1; j++) out[j - j0] = overlapScalar(b, i, j, diou, eps);
+}
+
+class NmsEngine {
+public:
+    void reset() {
+        raw_.x1.clear(); raw_.y1.clear(); raw_.x2.clear(); raw_.y2.clear();
+        raw_.cx.clear(); raw_.cy.clear(); raw_.area.clear(); raw_.score.clear();
+        raw_.cls.clear(); raw_.index.clear();
+    }
+
+    size_t size() const { return raw_.score.size(); }
+
+    // bbox = center x, center y, w, h
+    void addCenter(const float* bbox, float score, int class_id) {
+        add(bbox[0] - bbox[2] / 2.f, bbox[1] - bbox[3] / 2.f, bbox[0] + bbox[2] / 2.f, bbox[1] + bbox[3] / 2.f,
+            bbox[0], bbox[1], bbox[2] * bbox[3], score, class_id);
+    }
+
+    // bbox = x1, y1, x2, y2
+    void addCorner(const float* bbox, float score, int class_id) {
+        add(bbox[0], bbox[1], bbox[2], bbox[3], (bbox[0] + bbox[2]) / 2.f, (bbox[1] + bbox[3]) / 2.f,
+            (bbox[2] - bbox[0]) * (bbox[3] - bbox[1]), score, class_id);
+    }
+
+    // Kept boxes as indices in add order, by ascending class and, within a
+    // class, descending (decayed) score. Valid until the next reset().
+    const std::vector<int>& run(const Config& config) {
+        keep_.clear();
+        scores_.clear();
+        const int n = (int)size();
+        if (n == 0) return keep_;
+        sortByClassAndScore(n);
+        const bool diou = config.mode == Mode::DIOU;
+        for (int begin = 0; begin < n;) {
+            int end = begin + 1;
+            while (end < n && sorted_.cls[end] == sorted_.cls[begin]) end++;
+            int last = config.max_candidates > 0 ? std::min(end, begin + config.max_candidates) : end;
+            if (config.mode == Mode::HARD || diou) {
+                runGreedy(begin, last, diou, config);
+            } else {
+                runSoft(begin, last, config);
+            }
+            begin = end;
+        }
+        return keep_;
+    }
+
+    // Scores of the kept boxes, same order as run().
+    const std::vector<float>& scores() const { return scores_; }
+
+private:
+    void add(float x1, float y1, float x2, float y2, float cx, float cy, float area, float score, int class_id) {
+        raw_.index.push_back((int)raw_.score.size());
+        raw_.x1.push_back(x1); raw_.y1.push_back(y1); raw_.x2.push_back(x2); raw_.y2.push_back(y2);
+        raw_.cx.push_back(cx); raw_.cy.push_back(cy); raw_.area.push_back(area);
+        raw_.score.push_back(score); raw_.cls.push_back(class_id);
+    }
+
+    // Gathers raw_ into sorted_ by (class ascending, score descending, add order).
+    void sortByClassAndScore(int n) {
+        order_.assign(raw_.index.begin(), raw_.index.end());
+        const Boxes& r = raw_;
+        std::sort(order_.begin(), order_.end(), [&r](int a, int b) {
+            if (r.cls[a] != r.cls[b]) return r.cls[a] < r.cls[b];
+            if (r.score[a] != r.score[b]) return r.score[a] > r.score[b];
+            return a < b;
+        });
+        sorted_.resize(n);
+        for (int k = 0; k < n; k++) {
+            int s = order_[k];
+            sorted_.x1[k] = r.x1[s]; sorted_.y1[k] = r.y1[s]; sorted_.x2[k] = r.x2[s]; sorted_.y2[k] = r.y2[s];
+            sorted_.cx[k] = r.cx[s]; sorted_.cy[k] = r.cy[s]; sorted_.area[k] = r.area[s];
+            sorted_.score[k] = r.score[s]; sorted_.cls[k] = r.cls[s]; sorted_.index[k] = s;
+        }
+        // One spare word so suppress() can spill 8 bits past the last full word.
+        removed_.assign(n / 64 + 2, 0);
+    }
+
+    void runGreedy(int begin, int end, bool diou, const Config& config) {
+        uint64_t* removed = removed_.data();
+        for (int i = begin; i < end; i++) {
+            if (removed[i >> 6] >> (i & 63) & 1) continue;
+            keep_.push_back(sorted_.index[i]);
+            scores_.push_back(sorted_.score[i]);
+            suppress(sorted_, i, i + 1, end, diou, config.union_eps, config.iou_thresh, removed);
+        }
+    }
+
+    void runSoft(int begin, int end, const Config& config) {
+        // Alive boxes are compacted to the front of [begin, live) after every pick,
+        // so the overlap sweep stays contiguous for the SIMD kernel.
+        int live = end;
+        overlap_.resize(end - begin);
+        while (live > begin) {
+            int best = begin;
+            for (int k = begin + 1; k < live; k++) {
+                if (sorted_.score[k] > sorted_.score[best]) best = k;
+            }
+            swapBoxes(begin, best);
+            keep_.push_back(sorted_.index[begin]);
+            scores_.push_back(sorted_.score[begin]);
+            overlaps(sorted_, begin, begin + 1, live, false, config.union_eps, overlap_.data());
+            int out = begin;
+            for (int k = begin + 1; k < live; k++) {
+                float iou = overlap_[k - begin - 1];
+                float s = sorted_.score[k];
+                if (config.mode == Mode::SOFT_LINEAR) {
+                    if (iou > config.iou_thresh) s *= 1.f - iou;
+                } else {
+                    s *= std::exp(-(iou * iou) / config.sigma);
+                }
+                if (s <= config.score_thresh) continue;
+                sorted_.score[k] = s;
+                swapBoxes(++out, k);
+            }
+            begin++;
+            live = out + 1;
+        }
+    }
+
+    void swapBoxes(int a, int b) {
+        if (a == b) return;
+        std::swap(sorted_.x1[a], sorted_.x1[b]); std::swap(sorted_.y1[a], sorted_.y1[b]);
+        std::swap(sorted_.x2[a], sorted_.x2[b]); std::swap(sorted_.y2[a], sorted_.y2[b]);
+        std::swap(sorted_.cx[a], sorted_.cx[b]); std::swap(sorted_.cy[a], sorted_.cy[b]);
+        std::swap(sorted_.area[a], sorted_.area[b]); std::swap(sorted_.score[a], sorted_.score[b]);
+        std::swap(sorted_.cls[a], sorted_.cls[b]); std::swap(sorted_.index[a], sorted_.index[b]);
+    }
+
+    Boxes raw_;
+    Boxes sorted_;
+    std::vector<int> order_;
+    std::vector<uint64_t> removed_;
+    std::vector<float> overlap_;
+    std::vector<int> keep_;
+    std::vector<float> scores_;
+};
+
+// nms() of the YOLO samples. output is the [count, Detection...] blob of
+// YoloLayer_TRT, where a Detection is bbox (center x, center y, w, h), conf,
+// class_id as floats. Appends the boxes above conf_thresh that survive HARD
+// NMS to res: the boxes, and the order (class ascending, then conf descending),
+// of the former std::map based nms().
+template <typename Detection>
+void nmsDetections(std::vector<Detection>& res, const float* output, float conf_thresh, float iou_thresh, int max_count) {
+    const int det_size = sizeof(Detection) / sizeof(float);
+    static thread_local NmsEngine engine;
+    static thread_local std::vector<int> rows;  // blob row of each added box
+    engine.reset();
+    rows.clear();
+    for (int i = 0; i < output[0] && i < max_count; i++) {
+        const float* det = &output[1 + det_size * i];
+        if (det[4] <= conf_thresh) continue;
+        engine.addCenter(det, det[4], (int)det[5]);
+        rows.push_back(i);
+    }
+    Config config;
+    config.iou_thresh = iou_thresh;
+    for (int k : engine.run(config)) {
+        Detection det;
+        memcpy(&det, &output[1 + det_size * rows[k]], det_size * sizeof(float));
+        res.push_back(det);
+    }
+}
+
+}  // namespace boxnms
+
+#endif  // TRTX_NMS_ENGINE_H_
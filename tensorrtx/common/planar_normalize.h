@@ -0,0 +1,238 @@
+#ifndef TRTX_PLANAR_NORMALIZE_H_
+#define TRTX_PLANAR_NORMALIZE_H_
+
+// The input loop of the classification, recognition and detection samples:
+// an 8-bit BGR HWC image (OpenCV's) normalized per channel into float CHW
+// planes, written straight into one slot of the batch's input buffer.
+//
+//   planar::normalize<Norm, Order>(src, step, width, height, batch, slot, &pool);
+//
+// Norm gives scale(), mean(c) and stdev(c) as constexpr, c being 0, 1, 2 for
+// R, G, B, and a plane is (x * scale - mean) / stdev; Order the planes' order.
+// Both are template arguments, so each plane is one multiply and one add by
+// constants, x * (scale / stdev) - mean / stdev. Rows are deinterleaved and
+// converted 16 pixels at a time with AVX-512 or AVX2 (chosen at run time) or
+// NEON, and images of more than kParallelPixels are split into blocks of rows
+// over the pool.
+//
+// The values are those of normalizeRef(), the samples' per-pixel loop in
+// float, bit for bit on x86 without -ffp-contract (NEON, and FMA targets
+// contracting the scalar tail, can differ in the last bit). Against the loops
+// the samples had, which divided in double, they differ by a few ulp; for
+// HalfRange, whose constants are powers of two, not at all.
+//
+//   planar::normalize<planar::ImageNet, planar::Order::kRgb>(img.data, img.step, img.cols, img.rows, data, b, &pool);
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "worker_pool.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PLANAR_NORMALIZE_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define PLANAR_NORMALIZE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace planar {
+
+// Images up to this many pixels are done on the calling thread.
+const size_t kParallelPixels = 1 << 17;
+// Pixels per block of rows given to a worker.
+const size_t kBlockPixels = 1 << 15;
+
+// Order of the output planes; the input is always BGR.
+enum class Order { kBgr, kRgb };
+
+// torchvision's ImageNet normalization: DBNet, DETR.
+struct ImageNet {
+    static constexpr float scale() { return 1.f / 255; }
+    static constexpr float mean(int c) { return c == 0 ? 0.485f : c == 1 ? 0.456f : 0.406f; }
+    static constexpr float stdev(int c) { return c == 0 ? 0.229f : c == 1 ? 0.224f : 0.225f; }
+};
+
+// (x - 127.5) / 128: LPRNet, ArcFace.
+struct HalfRange {
+    static constexpr float scale() { return 1.f; }
+    static constexpr float mean(int) { return 127.5f; }
+    static constexpr float stdev(int) { return 128.f; }
+};
+
+// Output plane p: the byte of the BGR pixel it reads and its constants.
+template <typename Norm, Order order>
+struct Planes {
+    static constexpr int color(int p) { return order == Order::kRgb ? p : 2 - p; }
+    static constexpr int channel(int p) { return 2 - color(p); }
+    static constexpr float mul(int p) { return Norm::scale() / Norm::stdev(color(p)); }
+    static constexpr float add(int p) { return -Norm::mean(color(p)) / Norm::stdev(color(p)); }
+};
+
+template <typename Norm, Order order>
+inline void rowScalar(const uint8_t* src, int x, int width, float* const dst[3]) {
+    typedef Planes<Norm, order> P;
+    for (; x < width; x++) {
+        const uint8_t* pixel = src + 3 * x;
+        dst[0][x] = pixel[P::channel(0)] * P::mul(0) + P::add(0);
+        dst[1][x] = pixel[P::channel(1)] * P::mul(1) + P::add(1);
+        dst[2][x] = pixel[P::channel(2)] * P::mul(2) + P::add(2);
+    }
+}
+
+#ifdef PLANAR_NORMALIZE_AVX2
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+inline bool hasAvx512() {
+    static const bool supported = __builtin_cpu_supports("avx512f");
+    return supported;
+}
+
+// 16 BGR pixels into their B, G and R bytes.
+__attribute__((target("avx2")))
+inline void deinterleave16(const uint8_t* src, __m128i bgr[3]) {
+    const __m128i a = _mm_loadu_si128((const __m128i*)src);
+    const __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+    bgr[0] = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    bgr[1] = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    bgr[2] = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+// Returns the pixels done, a multiple of 16.
+template <typename Norm, Order order>
+__attribute__((target("avx2")))
+int rowAvx2(const uint8_t* src, int width, float* const dst[3]) {
+    typedef Planes<Norm, order> P;
+    const __m256 mul[3] = {_mm256_set1_ps(P::mul(0)), _mm256_set1_ps(P::mul(1)), _mm256_set1_ps(P::mul(2))};
+    const __m256 add[3] = {_mm256_set1_ps(P::add(0)), _mm256_set1_ps(P::add(1)), _mm256_set1_ps(P::add(2))};
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i bgr[3];
+        deinterleave16(src + 3 * x, bgr);
+        for (int p = 0; p < 3; p++) {
+            const __m128i v = bgr[P::channel(p)];
+            const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+            const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+            _mm256_storeu_ps(dst[p] + x, _mm256_add_ps(_mm256_mul_ps(lo, mul[p]), add[p]));
+            _mm256_storeu_ps(dst[p] + x + 8, _mm256_add_ps(_mm256_mul_ps(hi, mul[p]), add[p]));
+        }
+    }
+    return x;
+}
+
+// GCC 12 takes the _mm512_undefined operands of the intrinsics for uninitialized.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <typename Norm, Order order>
+__attribute__((target("avx512f,avx2")))
+int rowAvx512(const uint8_t* src, int width, float* const dst[3]) {
+    typedef Planes<Norm, order> P;
+    const __m512 mul[3] = {_mm512_set1_ps(P::mul(0)), _mm512_set1_ps(P::mul(1)), _mm512_set1_ps(P::mul(2))};
+    const __m512 add[3] = {_mm512_set1_ps(P::add(0)), _mm512_set1_ps(P::add(1)), _mm512_set1_ps(P::add(2))};
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i bgr[3];
+        deinterleave16(src + 3 * x, bgr);
+        for (int p = 0; p < 3; p++) {
+            const __m512 v = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bgr[P::channel(p)]));
+            _mm512_storeu_ps(dst[p] + x, _mm512_add_ps(_mm512_mul_ps(v, mul[p]), add[p]));
+        }
+    }
+    return x;
+}
+#pragma GCC diagnostic pop
+#endif  // PLANAR_NORMALIZE_AVX2
+
+#ifdef PLANAR_NORMALIZE_NEON
+template <typename Norm, Order order>
+int rowNeon(const uint8_t* src, int width, float* const dst[3]) {
+    typedef Planes<Norm, order> P;
+    const float32x4_t mul[3] = {vdupq_n_f32(P::mul(0)), vdupq_n_f32(P::mul(1)), vdupq_n_f32(P::mul(2))};
+    const float32x4_t add[3] = {vdupq_n_f32(P::add(0)), vdupq_n_f32(P::add(1)), vdupq_n_f32(P::add(2))};
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x3_t bgr = vld3q_u8(src + 3 * x);
+        for (int p = 0; p < 3; p++) {
+            const uint8x16_t v = bgr.val[P::channel(p)];
+            const uint16x8_t halves[2] = {vmovl_u8(vget_low_u8(v)), vmovl_u8(vget_high_u8(v))};
+            for (int k = 0; k < 4; k++) {
+                const uint16x4_t q = k % 2 ? vget_high_u16(halves[k / 2]) : vget_low_u16(halves[k / 2]);
+                const float32x4_t f = vcvtq_f32_u32(vmovl_u16(q));
+                vst1q_f32(dst[p] + x + 4 * k, vaddq_f32(vmulq_f32(f, mul[p]), add[p]));
+            }
+        }
+    }
+    return x;
+}
+#endif  // PLANAR_NORMALIZE_NEON
+
+template <typename Norm, Order order>
+inline void normalizeRow(const uint8_t* src, int width, float* const dst[3]) {
+    int x = 0;
+#if defined(PLANAR_NORMALIZE_AVX2)
+    if (hasAvx512()) {
+        x = rowAvx512<Norm, order>(src, width, dst);
+    } else if (hasAvx2()) {
+        x = rowAvx2<Norm, order>(src, width, dst);
+    }
+#elif defined(PLANAR_NORMALIZE_NEON)
+    x = rowNeon<Norm, order>(src, width, dst);
+#endif
+    rowScalar<Norm, order>(src, x, width, dst);
+}
+
+// Normalizes the width x height image src, rows step bytes apart, into slot
+// of batch, which holds 3 * width * height floats per slot. pool may be null.
+template <typename Norm, Order order>
+void normalize(const uint8_t* src, size_t step, int width, int height, float* batch, int slot,
+               WorkerPool* pool = nullptr) {
+    const size_t area = (size_t)width * height;
+    float* const planes = batch + slot * 3 * area;
+    auto rows = [=](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            float* const dst[3] = {planes + (size_t)y * width, planes + area + (size_t)y * width,
+                                   planes + 2 * area + (size_t)y * width};
+            normalizeRow<Norm, order>(src + y * step, width, dst);
+        }
+    };
+    if (!pool || pool->size() == 1 || area <= kParallelPixels) {
+        rows(0, height);
+        return;
+    }
+    const int block = std::max(1, (int)(kBlockPixels / width));
+    pool->parallelFor((height + block - 1) / block,
+                      [&](int b) { rows(b * block, std::min(height, (b + 1) * block)); });
+}
+
+// The per-pixel loop, the reference of normalize().
+template <typename Norm, Order order>
+void normalizeRef(const uint8_t* src, size_t step, int width, int height, float* batch, int slot) {
+    typedef Planes<Norm, order> P;
+    const size_t area = (size_t)width * height;
+    float* const planes = batch + slot * 3 * area;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t* pixel = src + y * step + 3 * x;
+            for (int p = 0; p < 3; p++) {
+                planes[p * area + (size_t)y * width + x] = pixel[P::channel(p)] * P::mul(p) + P::add(p);
+            }
+        }
+    }
+}
+
+}  // namespace planar
+
+#endif  // TRTX_PLANAR_NORMALIZE_H_
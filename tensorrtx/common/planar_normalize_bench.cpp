@@ -0,0 +1,174 @@
+// Checks planar::normalize against the input loops dbnet, LPRnet, arcface-r100
+// and detr had, and against normalizeRef, at each model's input size, then
+// times them: the old loop, the row kernels on one thread (scalar, AVX2,
+// AVX-512 or NEON) and normalize() on one thread and on all of them. The
+// images are random bytes with a row padding, as a cv::Mat ROI would have.
+// Build without -ffp-contract for normalizeRef to match bit for bit.
+//   ./planar_normalize_bench [iterations]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "planar_normalize.h"
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+struct Image {
+    int width, height;
+    size_t step;
+    std::vector<uint8_t> bytes;
+    const uint8_t* data() const { return bytes.data(); }
+};
+
+// dbnet.cpp: double division by ImageNet's mean and std, RGB planes
+static void dbnet_loop(const Image& img, float* data) {
+    std::vector<float> mean_value{0.406, 0.456, 0.485};  // BGR
+    std::vector<float> std_value{0.225, 0.224, 0.229};
+    int i = 0;
+    for (int row = 0; row < img.height; ++row) {
+        const uint8_t* uc_pixel = img.data() + row * img.step;
+        for (int col = 0; col < img.width; ++col) {
+            data[i] = (uc_pixel[2] / 255.0 - mean_value[2]) / std_value[2];
+            data[i + img.height * img.width] = (uc_pixel[1] / 255.0 - mean_value[1]) / std_value[1];
+            data[i + 2 * img.height * img.width] = (uc_pixel[0] / 255.0 - mean_value[0]) / std_value[0];
+            uc_pixel += 3;
+            ++i;
+        }
+    }
+}
+
+// LPRnet.cpp: (x - 127.5) / 128, BGR planes
+static void lprnet_loop(const Image& img, float* data) {
+    int i = 0;
+    for (int row = 0; row < img.height; ++row) {
+        const uint8_t* uc_pixel = img.data() + row * img.step;
+        for (int col = 0; col < img.width; ++col) {
+            data[i + 2 * img.height * img.width] = ((float)uc_pixel[2] - 127.5) * 0.0078125;
+            data[i + img.height * img.width] = ((float)uc_pixel[1] - 127.5) * 0.0078125;
+            data[i] = ((float)uc_pixel[0] - 127.5) * 0.0078125;
+            uc_pixel += 3;
+            ++i;
+        }
+    }
+}
+
+// arcface-r100.cpp: the same in RGB, by img.at<cv::Vec3b>(i) on a continuous image
+static void arcface_loop(const Image& img, float* data) {
+    const int area = img.width * img.height;
+    for (int i = 0; i < area; i++) {
+        const uint8_t* pixel = img.data() + (i / img.width) * img.step + 3 * (i % img.width);
+        data[i] = ((float)pixel[2] - 127.5) * 0.0078125;
+        data[i + area] = ((float)pixel[1] - 127.5) * 0.0078125;
+        data[i + 2 * area] = ((float)pixel[0] - 127.5) * 0.0078125;
+    }
+}
+
+// detr: preprocessImg's convertTo, /= 255, -= mean and /= std, each a pass
+// over an RGB float image, then img.at<cv::Vec3f>(h, w)[c] plane by plane
+static void detr_loop(const Image& img, float* data) {
+    const double mean[3] = {0.485, 0.456, 0.406}, stdev[3] = {0.229, 0.224, 0.225};
+    std::vector<float> rgb((size_t)img.width * img.height * 3);
+    for (int h = 0; h < img.height; h++) {
+        for (int w = 0; w < img.width; w++) {
+            for (int c = 0; c < 3; c++) rgb[((size_t)h * img.width + w) * 3 + c] = img.data()[h * img.step + 3 * w + 2 - c];
+        }
+    }
+    for (float& v : rgb) v = (float)(v * (1. / 255));
+    for (size_t i = 0; i < rgb.size(); i++) rgb[i] = (float)(rgb[i] - mean[i % 3]);
+    for (size_t i = 0; i < rgb.size(); i++) rgb[i] = (float)(rgb[i] / stdev[i % 3]);
+    for (int c = 0; c < 3; c++) {
+        for (int h = 0; h < img.height; h++) {
+            for (int w = 0; w < img.width; w++) {
+                data[c * img.height * img.width + h * img.width + w] = rgb[((size_t)h * img.width + w) * 3 + c];
+            }
+        }
+    }
+}
+
+// One row kernel over the whole image on the calling thread.
+template <typename Norm, planar::Order order, typename Kernel>
+static void rows_with(Kernel kernel, const Image& img, float* data) {
+    const size_t area = (size_t)img.width * img.height;
+    for (int y = 0; y < img.height; y++) {
+        float* const dst[3] = {data + (size_t)y * img.width, data + area + (size_t)y * img.width,
+                               data + 2 * area + (size_t)y * img.width};
+        const int x = kernel(img.data() + y * img.step, img.width, dst);
+        planar::rowScalar<Norm, order>(img.data() + y * img.step, x, img.width, dst);
+    }
+}
+
+template <typename Norm, planar::Order order>
+static bool run(const char* model, int width, int height, void (*loop)(const Image&, float*), int iterations,
+                WorkerPool& one, WorkerPool& all, std::mt19937& rng) {
+    Image img{width, height, (size_t)width * 3 + 64, {}};
+    img.bytes.resize(img.step * height);
+    for (auto& b : img.bytes) b = (uint8_t)rng();
+    const size_t floats = (size_t)3 * width * height;
+    // slot 1 of a batch of 2, the rest must stay untouched
+    std::vector<float> old(floats), ref(floats), batch(2 * floats, -1.f);
+    float* const slot = batch.data() + floats;
+
+    loop(img, old.data());
+    planar::normalizeRef<Norm, order>(img.data(), img.step, width, height, ref.data(), 0);
+    planar::normalize<Norm, order>(img.data(), img.step, width, height, batch.data(), 1, &all);
+    bool ok = memcmp(slot, ref.data(), floats * sizeof(float)) == 0;
+    for (size_t i = 0; i < floats; i++) ok = ok && batch[i] == -1.f;
+    double worst = 0;
+    for (size_t i = 0; i < floats; i++) worst = std::max(worst, (double)std::fabs(old[i] - ref[i]));
+
+    std::cout << model << " " << width << "x" << height << ": " << (ok ? "same as normalizeRef" : "MISMATCH")
+              << ", off the old loop by max " << worst << std::endl;
+    const double old_ms = time_ms(iterations, [&]() { loop(img, old.data()); });
+    std::cout << "  old loop " << old_ms << "ms";
+    auto scalar = [](const uint8_t*, int, float* const*) { return 0; };
+    std::cout << ", scalar rows " << time_ms(iterations, [&]() { rows_with<Norm, order>(scalar, img, ref.data()); })
+              << "ms";
+#if defined(PLANAR_NORMALIZE_AVX2)
+    if (planar::hasAvx2()) {
+        std::cout << ", AVX2 rows "
+                  << time_ms(iterations, [&]() { rows_with<Norm, order>(planar::rowAvx2<Norm, order>, img, ref.data()); })
+                  << "ms";
+    }
+    if (planar::hasAvx512()) {
+        std::cout << ", AVX-512 rows "
+                  << time_ms(iterations, [&]() { rows_with<Norm, order>(planar::rowAvx512<Norm, order>, img, ref.data()); })
+                  << "ms";
+    }
+#elif defined(PLANAR_NORMALIZE_NEON)
+    std::cout << ", NEON rows "
+              << time_ms(iterations, [&]() { rows_with<Norm, order>(planar::rowNeon<Norm, order>, img, ref.data()); })
+              << "ms";
+#endif
+    std::cout << std::endl;
+    const double one_ms = time_ms(iterations, [&]() {
+        planar::normalize<Norm, order>(img.data(), img.step, width, height, batch.data(), 1, &one);
+    });
+    const double all_ms = time_ms(iterations, [&]() {
+        planar::normalize<Norm, order>(img.data(), img.step, width, height, batch.data(), 1, &all);
+    });
+    std::cout << "  normalize: 1 thread " << one_ms << "ms (" << old_ms / one_ms << "x), " << all.size()
+              << " threads " << all_ms << "ms (" << old_ms / all_ms << "x)" << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    std::mt19937 rng(0);
+    WorkerPool one(1), all(0);
+    bool ok = true;
+    ok = run<planar::ImageNet, planar::Order::kRgb>("dbnet", 1152, 640, dbnet_loop, iterations, one, all, rng) && ok;
+    ok = run<planar::HalfRange, planar::Order::kBgr>("LPRnet", 94, 24, lprnet_loop, iterations * 100, one, all, rng) && ok;
+    ok = run<planar::HalfRange, planar::Order::kRgb>("arcface-r100", 112, 112, arcface_loop, iterations * 20, one, all, rng) && ok;
+    ok = run<planar::ImageNet, planar::Order::kRgb>("detr", 1066, 800, detr_loop, iterations, one, all, rng) && ok;
+    return ok ? 0 : 1;
+}
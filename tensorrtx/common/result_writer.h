@@ -0,0 +1,307 @@
+#ifndef TRTX_RESULT_WRITER_H_
+#define TRTX_RESULT_WRITER_H_
+
+// Draws, encodes and writes the results of the samples on a few threads of its
+// own, so the inference loop only hands an image and its boxes over instead of
+// drawing and cv::imwrite-ing them itself.
+//
+// Jobs come from a fixed set of `queue` jobs, recycled once written: acquire()
+// blocks while all of them are in flight, which holds the loop back when
+// output cannot keep up rather than queueing frames without bound. A job's
+// image and vectors keep their memory from one use to the next, so copying a
+// same-size loader image into it (copyTo) does not allocate once warm. Each
+// writer thread draws the boxes, runs options.annotate for what else the
+// sample draws (masks, ...), encodes the image as its name's extension says
+// (.jpg or .png) and writes the file. With options.results set, the boxes of
+// every image also go to a JSON lines file, in submission order. With
+// options.draw false no image is drawn or written, only that file.
+//
+//   ResultWriter::Options options;
+//   options.results = "results.jsonl";
+//   ResultWriter writer(options);
+//   ResultWriter::Job& job = writer.acquire();
+//   job.name = "_" + name;
+//   if (writer.drawing()) img.copyTo(job.image);  // the loader reuses img
+//   job.detections.push_back(ResultWriter::Detection{x1, y1, x2, y2, score, class_id});
+//   writer.submit(job);
+//   ...
+//   writer.finish();  // all written, also done by the destructor
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+class ResultWriter {
+public:
+    // a box in pixels of the job's image
+    struct Detection {
+        float x1, y1, x2, y2;
+        float score;
+        int class_id;
+    };
+
+    // How a box's corners become the drawn rectangle, as the samples drew them.
+    enum class BoxRect {
+        kRounded,    // cv::Rect of the rounded corner and size: yolov5's get_rect
+        kTruncated,  // cv::Rect of the truncated corner and size: detr, rcnn
+        kCorners,    // between the truncated corners, both included: dbnet
+    };
+
+    struct Job {
+        // output file, relative to options.dir; its extension picks the encoder
+        std::string name;
+        // the image to draw on, owned by the job (copy images that get reused)
+        cv::Mat image;
+        std::vector<Detection> detections;
+        // whatever options.annotate needs besides the boxes, e.g. rcnn's masks
+        cv::Mat extra;
+
+    private:
+        friend class ResultWriter;
+        std::string line;
+        bool done = false;
+    };
+
+    struct Options {
+        // writer threads, 0 for half of hardware_concurrency
+        int threads = 0;
+        // jobs in flight before acquire() blocks
+        int queue = 8;
+        // false: draw and write no images, only the results file
+        bool draw = true;
+        // directory of the images, which must exist
+        std::string dir = ".";
+        // JSON lines file of the boxes of every image, empty for none
+        std::string results;
+        // box and label colors, BGR; labels are the class ids
+        cv::Scalar box_color = cv::Scalar(0x27, 0xC1, 0x36);
+        cv::Scalar label_color = cv::Scalar(0xFF, 0xFF, 0xFF);
+        int thickness = 2;
+        BoxRect box_rect = BoxRect::kRounded;
+        bool labels = true;
+        int jpeg_quality = 95;
+        // 1 rather than OpenCV's default 3: about twice as fast, files a bit larger
+        int png_compression = 1;
+        // drawing of the sample after the boxes, on the writer threads
+        void (*annotate)(Job& job) = nullptr;
+    };
+
+    explicit ResultWriter(const Options& options) : options_(options) {
+        options_.queue = std::max(1, options_.queue);
+        int threads = options_.threads;
+        if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        if (!options_.results.empty()) {
+            results_.open(options_.results);
+            if (!results_) std::cerr << "could not open " << options_.results << std::endl;
+        }
+        jobs_.resize(options_.queue);
+        for (Job& job : jobs_) free_.push_back(&job);
+        // no images to make, one thread formats the results in order anyway
+        if (!options_.draw) threads = 1;
+        for (int t = 0; t < threads; t++) workers_.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~ResultWriter() {
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    // whether jobs need an image
+    bool drawing() const { return options_.draw; }
+
+    // A free job, cleared but for its memory; waits while all are in flight.
+    Job& acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            space_.wait(lock, [this]() { return !free_.empty(); });
+            blocked_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            waits_++;
+        }
+        Job* job = free_.back();
+        free_.pop_back();
+        job->name.clear();
+        job->detections.clear();
+        job->extra.release();
+        job->done = false;
+        return *job;
+    }
+
+    // Hands an acquired job over to the writer threads.
+    void submit(Job& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            order_.push_back(&job);
+            pending_.push_back(&job);
+        }
+        work_.notify_one();
+    }
+
+    // Waits until every submitted job is written.
+    void finish() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this]() { return order_.empty(); });
+        if (results_.is_open()) results_.flush();
+    }
+
+    // seconds acquire() waited for a free job, and how many times
+    double blockedSeconds() const { return blocked_; }
+    long blockedCount() const { return waits_; }
+
+private:
+    void workerLoop() {
+        std::vector<uchar> bytes;
+        std::vector<int> params;
+        for (;;) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+                if (pending_.empty()) return;
+                job = pending_.front();
+                pending_.pop_front();
+            }
+            if (options_.draw && !job->image.empty()) {
+                draw(*job);
+                write(*job, bytes, params);
+            }
+            if (results_.is_open()) format(*job);
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->done = true;
+            // results lines in submission order; a job is free again once its line is out
+            bool freed = false;
+            while (!order_.empty() && order_.front()->done) {
+                Job* front = order_.front();
+                order_.pop_front();
+                if (results_.is_open()) results_ << front->line;
+                free_.push_back(front);
+                freed = true;
+            }
+            if (freed) space_.notify_all();
+        }
+    }
+
+    void draw(Job& job) const {
+        for (const Detection& d : job.detections) {
+            cv::Point corner;
+            if (options_.box_rect == BoxRect::kCorners) {
+                corner = cv::Point((int)d.x1, (int)d.y1);
+                cv::rectangle(job.image, corner, cv::Point((int)d.x2, (int)d.y2), options_.box_color, options_.thickness);
+            } else {
+                // a cv::Rect ends a pixel before x + width, and is not drawn when empty
+                const cv::Rect r = options_.box_rect == BoxRect::kRounded
+                                       ? cv::Rect(round(d.x1), round(d.y1), round(d.x2 - d.x1), round(d.y2 - d.y1))
+                                       : cv::Rect((int)d.x1, (int)d.y1, (int)(d.x2 - d.x1), (int)(d.y2 - d.y1));
+                corner = r.tl();
+                cv::rectangle(job.image, r, options_.box_color, options_.thickness);
+            }
+            if (options_.labels) {
+                cv::putText(job.image, std::to_string(d.class_id), cv::Point(corner.x, corner.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, options_.label_color, 2);
+            }
+        }
+        if (options_.annotate) options_.annotate(job);
+    }
+
+    void write(const Job& job, std::vector<uchar>& bytes, std::vector<int>& params) const {
+        std::string ext = ".jpg";
+        const size_t dot = job.name.rfind('.');
+        if (dot != std::string::npos) ext = job.name.substr(dot);
+        std::string lower = ext;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        params.clear();
+        if (lower == ".jpg" || lower == ".jpeg") {
+            params.push_back(cv::IMWRITE_JPEG_QUALITY);
+            params.push_back(options_.jpeg_quality);
+        } else if (lower == ".png") {
+            params.push_back(cv::IMWRITE_PNG_COMPRESSION);
+            params.push_back(options_.png_compression);
+        }
+        const std::string path = options_.dir + "/" + job.name + (dot == std::string::npos ? ext : "");
+        if (!cv::imencode(lower, job.image, bytes, params)) {
+            std::cerr << "could not encode " << path << std::endl;
+            return;
+        }
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) std::cerr << "could not write " << path << std::endl;
+    }
+
+    // {"image": name, "detections": [[class, score, x1, y1, x2, y2], ...]}, with
+    // null for a NaN or infinite value, which JSON has no number for
+    static void format(Job& job) {
+        char buffer[128];
+        job.line = "{\"image\": \"";
+        for (char c : job.name) {
+            if ((unsigned char)c < 0x20) {
+                snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)c);
+                job.line += buffer;
+                continue;
+            }
+            if (c == '"' || c == '\\') job.line += '\\';
+            job.line += c;
+        }
+        job.line += "\", \"detections\": [";
+        for (size_t i = 0; i < job.detections.size(); i++) {
+            const Detection& d = job.detections[i];
+            if (std::isfinite(d.score) && std::isfinite(d.x1) && std::isfinite(d.y1) && std::isfinite(d.x2) && std::isfinite(d.y2)) {
+                snprintf(buffer, sizeof(buffer), "%s[%d, %.4f, %.1f, %.1f, %.1f, %.1f]", i ? ", " : "", d.class_id, d.score, d.x1, d.y1, d.x2, d.y2);
+                job.line += buffer;
+                continue;
+            }
+            snprintf(buffer, sizeof(buffer), "%s[%d", i ? ", " : "", d.class_id);
+            job.line += buffer;
+            appendNumber(job.line, d.score, "%.4f");
+            appendNumber(job.line, d.x1, "%.1f");
+            appendNumber(job.line, d.y1, "%.1f");
+            appendNumber(job.line, d.x2, "%.1f");
+            appendNumber(job.line, d.y2, "%.1f");
+            job.line += ']';
+        }
+        job.line += "]}\n";
+    }
+
+    static void appendNumber(std::string& line, float value, const char* fmt) {
+        line += ", ";
+        if (!std::isfinite(value)) {
+            line += "null";
+            return;
+        }
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), fmt, value);
+        line += buffer;
+    }
+
+    Options options_;
+    std::vector<Job> jobs_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable space_;
+    bool stop_ = false;
+    // jobs not acquired, submitted and not yet picked by a thread, submitted and not yet freed
+    std::vector<Job*> free_;
+    std::deque<Job*> pending_;
+    std::deque<Job*> order_;
+    std::ofstream results_;
+    double blocked_ = 0;
+    long waits_ = 0;
+};
+
+#endif  // TRTX_RESULT_WRITER_H_
@@ -0,0 +1,196 @@
+// Times the output end of the samples' -d loop on the CPU, with inference
+// replaced by a sleep: drawing the boxes and cv::imwrite on the loop's thread,
+// as the samples did, against ResultWriter with 1, 2 and 4 threads and in its
+// no-draw mode (results file only). Also checks that the writer's files are
+// byte for byte those of cv::imwrite after the boxes are drawn as yolov5, detr
+// and rcnn, and dbnet drew them before the writer, and the JSON of an odd name
+// and a NaN score. Writes to result_writer_bench_out/ 1080p synthetic frames
+// with 20 boxes each, as JPEG or, with "png", as PNG.
+//   ./result_writer_bench [images] [inference ms] [jpg|png]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "result_writer.h"
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The boxes as the samples drew them before ResultWriter.
+static void draw_yolov5(cv::Mat& img, const ResultWriter::Detection& d) {
+    // get_rect's rounding
+    cv::Rect r(round(d.x1), round(d.y1), round(d.x2 - d.x1), round(d.y2 - d.y1));
+    cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
+    cv::putText(img, std::to_string(d.class_id), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
+}
+
+static void draw_detr(cv::Mat& img, const ResultWriter::Detection& d) {
+    // detr.cpp and rcnn.cpp, the float corners truncated by cv::Rect
+    float x1 = d.x1, y1 = d.y1, x2 = d.x2, y2 = d.y2;
+    cv::Rect r(x1, y1, x2 - x1, y2 - y1);
+    cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
+    cv::putText(img, std::to_string(d.class_id), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
+}
+
+static void draw_dbnet(cv::Mat& img, const ResultWriter::Detection& d) {
+    cv::rectangle(img, cv::Point(d.x1, d.y1), cv::Point(d.x2, d.y2), cv::Scalar(0, 0, 255), 2, 8);
+}
+
+struct Sample {
+    const char* name;
+    void (*draw)(cv::Mat& img, const ResultWriter::Detection& d);
+    ResultWriter::BoxRect box_rect;
+    cv::Scalar box_color;
+    bool labels;
+};
+
+static std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv) {
+    const int count = argc > 1 ? atoi(argv[1]) : 64;
+    const int infer_ms = argc > 2 ? atoi(argv[2]) : 10;
+    const std::string ext = argc > 3 && std::string(argv[3]) == "png" ? ".png" : ".jpg";
+    const std::string dir = "result_writer_bench_out";
+    mkdir(dir.c_str(), 0755);
+
+    // a few frames cycled through, as a loader's recycled buffers would be
+    std::mt19937 rng(0);
+    std::vector<cv::Mat> frames(4);
+    for (size_t i = 0; i < frames.size(); i++) {
+        // smooth gradients plus noise, so the JPEGs are about the size of photos
+        frames[i].create(1080, 1920, CV_8UC3);
+        for (int y = 0; y < frames[i].rows; y++) {
+            uint8_t* row = frames[i].ptr<uint8_t>(y);
+            for (int x = 0; x < frames[i].cols * 3; x++) row[x] = (uint8_t)((x / 3 + y + i * 37) / 4 + rng() % 24);
+        }
+    }
+    std::vector<std::vector<ResultWriter::Detection>> boxes(count);
+    for (auto& b : boxes) {
+        for (int j = 0; j < 20; j++) {
+            // fractional, as the networks' boxes are
+            float x = rng() % 180000 / 100.f, y = rng() % 100000 / 100.f;
+            b.push_back(ResultWriter::Detection{x, y, x + 20 + rng() % 10000 / 100.f, y + 20 + rng() % 8000 / 100.f, 0.5f + (rng() % 50) / 100.f, (int)(rng() % 80)});
+        }
+    }
+    auto name = [&](const char* mode, int i) { return std::string(mode) + "_" + std::to_string(1000 + i) + ext; };
+    auto infer = [&]() { std::this_thread::sleep_for(std::chrono::milliseconds(infer_ms)); };
+
+    // draw as the sample did and cv::imwrite images [0, n)
+    const ResultWriter::Options defaults;
+    auto imwrite_loop = [&](const Sample& sample, int n, bool inference) {
+        for (int i = 0; i < n; i++) {
+            if (inference) infer();
+            cv::Mat img = frames[i % frames.size()].clone();
+            for (const ResultWriter::Detection& d : boxes[i]) sample.draw(img, d);
+            std::vector<int> params;
+            if (ext == ".png") params = {cv::IMWRITE_PNG_COMPRESSION, defaults.png_compression};
+            cv::imwrite(dir + "/" + name((std::string("imwrite_") + sample.name).c_str(), i), img, params);
+        }
+    };
+    const Sample samples[] = {{"yolov5", draw_yolov5, ResultWriter::BoxRect::kRounded, defaults.box_color, true},
+                              {"detr", draw_detr, ResultWriter::BoxRect::kTruncated, defaults.box_color, true},
+                              {"dbnet", draw_dbnet, ResultWriter::BoxRect::kCorners, cv::Scalar(0, 0, 255), false}};
+
+    // the samples' loop: infer, then draw and write on the same thread
+    double start = now_ms();
+    imwrite_loop(samples[0], count, true);
+    const double serial_ms = now_ms() - start;
+    std::cout << count << " 1920x1080 " << ext << " images, 20 boxes each, " << infer_ms << "ms inference per image" << std::endl;
+    std::cout << "draw + imwrite in the loop: " << serial_ms / count << "ms per image" << std::endl;
+
+    struct Run {
+        const char* mode;
+        int threads;
+        bool draw;
+    };
+    const Run runs[] = {{"writer1", 1, true}, {"writer2", 2, true}, {"writer4", 4, true}, {"nodraw", 1, false}};
+    bool same = true;
+    for (const Run& run : runs) {
+        ResultWriter::Options options;
+        options.threads = run.threads;
+        options.draw = run.draw;
+        options.dir = dir;
+        options.results = dir + "/" + run.mode + ".jsonl";
+        double loop_ms;
+        start = now_ms();
+        ResultWriter writer(options);
+        for (int i = 0; i < count; i++) {
+            infer();
+            ResultWriter::Job& job = writer.acquire();
+            job.name = name(run.mode, i);
+            if (writer.drawing()) frames[i % frames.size()].copyTo(job.image);
+            job.detections = boxes[i];
+            writer.submit(job);
+        }
+        loop_ms = now_ms() - start;
+        writer.finish();
+        const double total_ms = now_ms() - start;
+        std::cout << "ResultWriter, " << (run.draw ? std::to_string(run.threads) + " thread" + (run.threads > 1 ? "s" : "") : "no draw")
+                  << ": " << loop_ms / count << "ms per image in the loop, " << total_ms / count << "ms with the writes ("
+                  << writer.blockedSeconds() * 1000 / count << "ms waiting for the writer)" << std::endl;
+        for (int i = 0; run.draw && i < count; i++) {
+            same = same && read_file(dir + "/" + name(run.mode, i)) == read_file(dir + "/" + name("imwrite_yolov5", i));
+        }
+    }
+
+    // the other samples' boxes, on a few images
+    const int few = std::min(count, 8);
+    for (const Sample& sample : samples) {
+        if (sample.draw == draw_yolov5) continue;
+        imwrite_loop(sample, few, false);
+        ResultWriter::Options options;
+        options.dir = dir;
+        options.box_rect = sample.box_rect;
+        options.box_color = sample.box_color;
+        options.labels = sample.labels;
+        {
+            ResultWriter writer(options);
+            for (int i = 0; i < few; i++) {
+                ResultWriter::Job& job = writer.acquire();
+                job.name = name(sample.name, i);
+                frames[i % frames.size()].copyTo(job.image);
+                job.detections = boxes[i];
+                writer.submit(job);
+            }
+        }
+        bool equal = true;
+        for (int i = 0; i < few; i++) {
+            equal = equal && read_file(dir + "/" + name(sample.name, i)) == read_file(dir + "/" + name((std::string("imwrite_") + sample.name).c_str(), i));
+        }
+        std::cout << sample.name << " boxes: " << (equal ? "same" : "MISMATCH") << std::endl;
+        same = same && equal;
+    }
+    std::cout << (same ? "same files as imwrite" : "MISMATCH with imwrite") << std::endl;
+
+    // a name with quotes and control characters, a NaN score, and a recycled job's extra
+    bool valid = true;
+    {
+        ResultWriter::Options options;
+        options.draw = false;
+        options.queue = 1;
+        options.dir = dir;
+        options.results = dir + "/escape.jsonl";
+        ResultWriter writer(options);
+        ResultWriter::Job& job = writer.acquire();
+        job.name = "a\"b\\c\td\n.jpg";
+        job.detections.push_back(ResultWriter::Detection{1, 2, 3, INFINITY, NAN, 7});
+        job.extra = cv::Mat(2, 2, CV_8UC1);
+        writer.submit(job);
+        valid = writer.acquire().extra.empty();
+    }
+    const std::string expected = "{\"image\": \"a\\\"b\\\\c\\u0009d\\u000a.jpg\", \"detections\": [[7, null, 1.0, 2.0, 3.0, null]]}\n";
+    valid = valid && read_file(dir + "/escape.jsonl") == expected;
+    std::cout << (valid ? "results file: escaped names, null for NaN, extra reset" : "results file: MISMATCH") << std::endl;
+    return same && valid ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#ifndef TRTX_WORKER_POOL_H_
+#define TRTX_WORKER_POOL_H_
+
+// Fixed set of worker threads for the per-frame host work of the samples
+// (post-processing a batch, decoding heads on the CPU). Unlike wts::parallelFor,
+// which is run once at load time, the threads are started once and parked on a
+// condition variable between calls, and a call does not allocate.
+//
+//   WorkerPool pool;  // hardware_concurrency threads, the caller included
+//   pool.parallelFor(batch, [&](int b) { ... });
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    // threads counts the calling thread, 0 for hardware_concurrency.
+    explicit WorkerPool(int threads = 0) {
+        if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int t = 1; t < threads; t++) workers_.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int size() const { return (int)workers_.size() + 1; }
+
+    // Runs fn(i) for every i in [0, n) and returns once all have finished. The
+    // calling thread takes indices too. Not reentrant: one call at a time.
+    template <typename Fn>
+    void parallelFor(int n, Fn& fn) {
+        if (n <= 0) return;
+        if (n == 1 || workers_.empty()) {
+            for (int i = 0; i < n; i++) fn(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &fn;
+            call_ = [](void* task, int i) { (*static_cast<Fn*>(task))(i); };
+            n_ = n;
+            next_ = 0;
+            busy_ = (int)workers_.size();
+            generation_++;
+        }
+        wake_.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return busy_ == 0; });
+    }
+
+    template <typename Fn>
+    void parallelFor(int n, const Fn& fn) {
+        Fn copy = fn;
+        parallelFor(n, copy);
+    }
+
+private:
+    void work() {
+        for (int i = next_++; i < n_; i = next_++) call_(task_, i);
+    }
+
+    void workerLoop() {
+        unsigned seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0) done_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool stop_ = false;
+    unsigned generation_ = 0;
+    int busy_ = 0;
+    void* task_ = nullptr;
+    void (*call_)(void*, int) = nullptr;
+    int n_ = 0;
+    std::atomic<int> next_{0};
+};
+
+#endif  // TRTX_WORKER_POOL_H_
@@ -0,0 +1,85 @@
+// Compare load time and peak RSS of the weight file formats and parsers.
+// Each load runs in a forked child so peak RSS is measured per run. Text files
+// are loaded with both the parallel and the old serial parser, and the two
+// weight maps are checked to be bit-exact.
+//   ./wts_bench yolov5s.wts yolov5s.wtsb
+
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "wts_loader.h"
+
+typedef std::map<std::string, nvinfer1::Weights> (*LoadFn)(const std::string&);
+
+static std::map<std::string, nvinfer1::Weights> load_default(const std::string& file) {
+    return loadWeights(file);
+}
+
+static void bench_child(const std::string& file, const char* label, LoadFn load) {
+    auto start = std::chrono::steady_clock::now();
+    std::map<std::string, nvinfer1::Weights> weightMap = load(file);
+    // Touch every value, as the engine builder does, so lazily mapped pages are counted too.
+    double checksum = 0;
+    size_t values = 0;
+    for (auto& kv : weightMap) {
+        const float* v = reinterpret_cast<const float*>(kv.second.values);
+        for (int64_t i = 0; i < kv.second.count; i++) checksum += v[i];
+        values += kv.second.count;
+    }
+    auto end = std::chrono::steady_clock::now();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << file << " [" << label << "]: " << weightMap.size() << " blobs, " << values << " values, "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms, "
+              << "peak RSS " << usage.ru_maxrss / 1024 << "MB, checksum " << checksum << std::endl;
+    freeWeights(weightMap);
+}
+
+static void verify_child(const std::string& file) {
+    std::map<std::string, nvinfer1::Weights> parallel = loadWeights(file);
+    std::map<std::string, nvinfer1::Weights> serial = wts::loadWeightsTextSerial(file);
+    bool same = parallel.size() == serial.size();
+    for (auto& kv : serial) {
+        if (!same) break;
+        auto it = parallel.find(kv.first);
+        same = it != parallel.end() && it->second.count == kv.second.count &&
+               memcmp(it->second.values, kv.second.values, kv.second.count * sizeof(float)) == 0;
+    }
+    std::cout << file << " [verify]: parallel and serial parsers are " << (same ? "bit-exact" : "DIFFERENT") << std::endl;
+    freeWeights(parallel);
+    freeWeights(serial);
+}
+
+template <typename Fn>
+static void run_forked(Fn fn) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        fn();
+        exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: ./wts_bench [weight file] [weight file] ..." << std::endl;
+        return -1;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string file = argv[i];
+        wts::FileView view;
+        if (!wts::openFile(file, view)) {
+            std::cerr << "could not open " << file << std::endl;
+            continue;
+        }
+        bool binary = wts::isBinary(view);
+        wts::closeFile(view);
+
+        run_forked([&]() { bench_child(file, binary ? "binary" : "text, parallel", load_default); });
+        if (binary) continue;
+        run_forked([&]() { bench_child(file, "text, serial", wts::loadWeightsTextSerial); });
+        run_forked([&]() { verify_child(file); });
+    }
+    return 0;
+}
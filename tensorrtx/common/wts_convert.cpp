@@ -0,0 +1,28 @@
+// Convert a text .wts into the binary container read by wts_loader.h.
+//   ./wts_convert yolov5s.wts yolov5s.wtsb
+
+#include <chrono>
+#include "wts_loader.h"
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage: ./wts_convert [input .wts] [output .wtsb]" << std::endl;
+        return -1;
+    }
+    auto start = std::chrono::system_clock::now();
+    std::map<std::string, nvinfer1::Weights> weightMap = loadWeights(argv[1]);
+    if (weightMap.empty()) {
+        std::cerr << "no weights loaded from " << argv[1] << std::endl;
+        return -1;
+    }
+    if (!wts::saveWeightsBinary(argv[2], weightMap)) {
+        std::cerr << "could not write " << argv[2] << std::endl;
+        freeWeights(weightMap);
+        return -1;
+    }
+    auto end = std::chrono::system_clock::now();
+    std::cout << "Wrote " << weightMap.size() << " blobs to " << argv[2] << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+    freeWeights(weightMap);
+    return 0;
+}
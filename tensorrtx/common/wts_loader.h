@@ -0,0 +1,490 @@
+#ifndef TRTX_WTS_LOADER_H_
+#define TRTX_WTS_LOADER_H_
+
+// Shared weight loader for the tensorrtx samples.
+//
+// Two on-disk formats are understood, detected by the first bytes of the file:
+//
+//  * the legacy text .wts:  [count]\n then per blob  [name] [size] <hex x size>
+//    It is mmapped, split into one record per line and decoded on all cores;
+//    files that do not follow that layout go through the old iostream parser.
+//  * the binary container, written by `gen_wts.py --binary` or `wts_convert`:
+//
+//      offset 0   char     magic[4] = "TRTW"
+//             4   uint32   version  = 1
+//             8   uint32   blob count
+//            12   uint32   blob alignment in bytes (64)
+//            16   uint64   byte offset of the name index
+//            24   uint64   total file size
+//      index, one entry per blob:
+//             uint32   name length, followed by the name bytes (no terminator)
+//             uint32   data type (0 = fp32, same values as nvinfer1::DataType)
+//             uint64   value count
+//             uint64   byte offset of the blob, a multiple of the alignment
+//
+//    All fields are little-endian. Blobs are stored raw, so the loader mmaps the
+//    file and points Weights::values straight into the mapping.
+//
+// Memory behind the returned Weights must be released with freeWeights(), which
+// frees malloc'ed blobs (text format, or ones added later by the network code,
+// e.g. addBatchNorm2d) and unmaps the binary files.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NvInfer.h"
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wts {
+
+static constexpr char BINARY_MAGIC[4] = {'T', 'R', 'T', 'W'};
+static constexpr uint32_t BINARY_VERSION = 1;
+static constexpr uint32_t BINARY_ALIGNMENT = 64;
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t alignment;
+    uint64_t index_offset;
+    uint64_t file_size;
+};
+static_assert(sizeof(BinaryHeader) == 32, "BinaryHeader must be packed to 32 bytes");
+
+// A read-only view of a whole weight file, mmapped where the platform allows it.
+struct FileView {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+};
+
+inline bool openFile(const std::string& file, FileView& view) {
+#ifdef _WIN32
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* buf = reinterpret_cast<char*>(malloc(size > 0 ? size : 1));
+    size_t got = size > 0 ? fread(buf, 1, size, fp) : 0;
+    fclose(fp);
+    if (got != (size_t)size) {
+        free(buf);
+        return false;
+    }
+    view.data = buf;
+    view.size = size;
+    view.mapped = false;
+    return true;
+#else
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return false;
+    madvise(addr, st.st_size, MADV_WILLNEED);
+    view.data = reinterpret_cast<const char*>(addr);
+    view.size = st.st_size;
+    view.mapped = true;
+    return true;
+#endif
+}
+
+inline void closeFile(FileView& view) {
+    if (!view.data) return;
+#ifdef _WIN32
+    free(const_cast<char*>(view.data));
+#else
+    if (view.mapped) {
+        munmap(const_cast<char*>(view.data), view.size);
+    } else {
+        free(const_cast<char*>(view.data));
+    }
+#endif
+    view.data = nullptr;
+    view.size = 0;
+}
+
+// Files whose memory is still referenced by Weights handed out by loadWeights().
+inline std::vector<FileView>& openViews() {
+    static std::vector<FileView> views;
+    return views;
+}
+
+inline bool isBinary(const FileView& view) {
+    return view.size >= sizeof(BinaryHeader) && memcmp(view.data, BINARY_MAGIC, 4) == 0;
+}
+
+template <typename T>
+inline T readLE(const char*& p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+inline bool parseBinary(const FileView& view, std::map<std::string, nvinfer1::Weights>& weightMap) {
+    BinaryHeader header;
+    memcpy(&header, view.data, sizeof(header));
+    if (header.version != BINARY_VERSION) {
+        std::cerr << "Unsupported binary weight version " << header.version << std::endl;
+        return false;
+    }
+    if (header.file_size != view.size || header.index_offset >= view.size) {
+        std::cerr << "Truncated binary weight file" << std::endl;
+        return false;
+    }
+    const char* p = view.data + header.index_offset;
+    const char* end = view.data + view.size;
+    for (uint32_t i = 0; i < header.count; i++) {
+        if (p + sizeof(uint32_t) > end) return false;
+        uint32_t name_len = readLE<uint32_t>(p);
+        if (p + name_len + sizeof(uint32_t) + 2 * sizeof(uint64_t) > end) return false;
+        std::string name(p, name_len);
+        p += name_len;
+        uint32_t type = readLE<uint32_t>(p);
+        uint64_t count = readLE<uint64_t>(p);
+        uint64_t offset = readLE<uint64_t>(p);
+        if (type != static_cast<uint32_t>(nvinfer1::DataType::kFLOAT) || offset + count * sizeof(float) > view.size) {
+            std::cerr << "Invalid blob " << name << " in binary weight file" << std::endl;
+            return false;
+        }
+        // Empty blobs get no pointer so freeWeights() never mistakes the end of the mapping for a heap block.
+        nvinfer1::Weights wt{ nvinfer1::DataType::kFLOAT, count ? view.data + offset : nullptr, static_cast<int64_t>(count) };
+        weightMap[name] = wt;
+    }
+    return true;
+}
+
+// Legacy text parser, one hex word at a time through iostream. Kept as the
+// fallback for files the parallel parser does not understand.
+inline std::map<std::string, nvinfer1::Weights> loadWeightsTextSerial(const std::string& file) {
+    std::map<std::string, nvinfer1::Weights> weightMap;
+
+    // Open weights file
+    std::ifstream input(file);
+    assert(input.is_open() && "Unable to load weight file. please check if the .wts file path is right!!!!!!");
+
+    // Read number of weight blobs
+    int32_t count;
+    input >> count;
+    assert(count > 0 && "Invalid weight map file.");
+
+    while (count--)
+    {
+        nvinfer1::Weights wt{ nvinfer1::DataType::kFLOAT, nullptr, 0 };
+        uint32_t size;
+
+        // Read name and type of blob
+        std::string name;
+        input >> name >> std::dec >> size;
+
+        // Load blob
+        uint32_t* val = reinterpret_cast<uint32_t*>(malloc(sizeof(uint32_t) * size));
+        for (uint32_t x = 0, y = size; x < y; ++x)
+        {
+            input >> std::hex >> val[x];
+        }
+        wt.values = val;
+
+        wt.count = size;
+        weightMap[name] = wt;
+    }
+
+    return weightMap;
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Value of a hex digit, or -1.
+inline const int8_t* hexTable() {
+    struct Table {
+        int8_t v[256];
+        Table() {
+            memset(v, -1, sizeof(v));
+            for (int i = 0; i < 10; i++) v['0' + i] = i;
+            for (int i = 0; i < 6; i++) v['a' + i] = v['A' + i] = 10 + i;
+        }
+    };
+    static const Table table;
+    return table.v;
+}
+
+// Decodes exactly 8 validated hex digits at once: the nibbles of all 8 chars are
+// computed in one 64-bit word, then packed pairwise into the 32-bit value.
+inline uint32_t parseHex8(const char* s) {
+    uint64_t x;
+    memcpy(&x, s, sizeof(x));
+    // '0'-'9' keep their low nibble, 'a'-'f' / 'A'-'F' have bit 6 set and need +9.
+    x = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 6) & 0x0101010101010101ULL) * 9;
+    // Chars are in memory order, so byte 0 holds the most significant nibble.
+    x = ((x & 0x000F000F000F000FULL) << 4) | ((x & 0x0F000F000F000F00ULL) >> 8);
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x >> 16)) & 0xFFFFFFFFULL;
+    uint32_t v = static_cast<uint32_t>(x);
+    return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+inline uint32_t parseHex(const char* s, size_t len) {
+    if (len == 8) return parseHex8(s);
+    const int8_t* table = hexTable();
+    uint32_t v = 0;
+    for (size_t i = 0; i < len; i++) v = (v << 4) | static_cast<uint32_t>(table[static_cast<uint8_t>(s[i])]);
+    return v;
+}
+
+// A byte range of one blob's hex words, decoded by a single worker.
+struct TextChunk {
+    size_t blob;
+    const char* begin;
+    const char* end;
+    uint32_t count;   // hex words in the chunk
+    uint32_t offset;  // index of the first word inside the blob
+    bool valid;
+};
+
+// Counts the words of a chunk and checks they are all plain hex that fits in 32 bits.
+inline void countChunk(TextChunk& chunk) {
+    const int8_t* table = hexTable();
+    const char* p = chunk.begin;
+    uint32_t count = 0;
+    chunk.valid = true;
+    while (p < chunk.end) {
+        while (p < chunk.end && isSpace(*p)) p++;
+        const char* word = p;
+        while (p < chunk.end && !isSpace(*p)) {
+            if (table[static_cast<uint8_t>(*p)] < 0) chunk.valid = false;
+            p++;
+        }
+        if (p == word) break;
+        if (p - word > 8) chunk.valid = false;
+        count++;
+    }
+    chunk.count = count;
+}
+
+inline void decodeChunk(const TextChunk& chunk, uint32_t* dst) {
+    const char* p = chunk.begin;
+    dst += chunk.offset;
+    while (p < chunk.end) {
+        while (p < chunk.end && isSpace(*p)) p++;
+        const char* word = p;
+        while (p < chunk.end && !isSpace(*p)) p++;
+        if (p == word) break;
+        *dst++ = parseHex(word, p - word);
+    }
+}
+
+// Runs fn(i) for i in [0, n) on up to hardware_concurrency threads.
+template <typename Fn>
+inline void parallelFor(size_t n, Fn fn) {
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < n; i = next++) fn(i);
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < workers; t++) threads.emplace_back(work);
+    work();
+    for (auto& t : threads) t.join();
+}
+
+// Parallel text parser. One serial pass splits the mapped file into blob records,
+// one per line as gen_wts.py writes them, and cuts large records into chunks at
+// word boundaries; the chunks are then counted and decoded across all cores.
+// Returns false, leaving weightMap empty, if the file does not have that shape.
+inline bool parseText(const FileView& view, std::map<std::string, nvinfer1::Weights>& weightMap) {
+    static const size_t CHUNK_BYTES = 1 << 20;
+    const char* p = view.data;
+    const char* end = view.data + view.size;
+    auto skipSpace = [&]() { while (p < end && isSpace(*p)) p++; };
+    auto readDecimal = [&](uint64_t& v) {
+        const char* start = p;
+        v = 0;
+        while (p < end && *p >= '0' && *p <= '9' && v <= 0xFFFFFFFFULL) v = v * 10 + (*p++ - '0');
+        return p != start && v <= 0xFFFFFFFFULL && (p == end || isSpace(*p));
+    };
+
+    uint64_t count;
+    skipSpace();
+    if (!readDecimal(count) || count == 0) return false;
+
+    std::vector<std::string> names;
+    std::vector<uint32_t> sizes;
+    std::vector<TextChunk> chunks;
+    for (uint64_t i = 0; i < count; i++) {
+        skipSpace();
+        const char* name = p;
+        while (p < end && !isSpace(*p)) p++;
+        if (p == name) return false;
+        names.emplace_back(name, p - name);
+        uint64_t size;
+        skipSpace();
+        if (!readDecimal(size)) return false;
+        sizes.push_back(static_cast<uint32_t>(size));
+        const char* line_end = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+        if (!line_end) line_end = end;
+        while (p < line_end) {
+            const char* chunk_end = std::min(p + CHUNK_BYTES, line_end);
+            while (chunk_end < line_end && !isSpace(*chunk_end)) chunk_end++;
+            chunks.push_back(TextChunk{ names.size() - 1, p, chunk_end, 0, 0, true });
+            p = chunk_end;
+        }
+        p = line_end;
+    }
+
+    parallelFor(chunks.size(), [&](size_t i) { countChunk(chunks[i]); });
+
+    std::vector<uint32_t> filled(names.size(), 0);
+    for (auto& chunk : chunks) {
+        if (!chunk.valid) return false;
+        chunk.offset = filled[chunk.blob];
+        filled[chunk.blob] += chunk.count;
+    }
+    for (size_t b = 0; b < names.size(); b++) {
+        if (filled[b] != sizes[b]) return false;
+    }
+
+    std::vector<uint32_t*> blobs(names.size());
+    for (size_t b = 0; b < names.size(); b++) {
+        blobs[b] = reinterpret_cast<uint32_t*>(malloc(sizeof(uint32_t) * sizes[b]));
+    }
+    parallelFor(chunks.size(), [&](size_t i) { decodeChunk(chunks[i], blobs[chunks[i].blob]); });
+
+    for (size_t b = 0; b < names.size(); b++) {
+        auto it = weightMap.find(names[b]);
+        if (it != weightMap.end()) free(const_cast<void*>(it->second.values));
+        weightMap[names[b]] = nvinfer1::Weights{ nvinfer1::DataType::kFLOAT, blobs[b], sizes[b] };
+    }
+    return true;
+}
+
+// Writes weightMap in the binary container format. Blobs are written in name order.
+inline bool saveWeightsBinary(const std::string& file, const std::map<std::string, nvinfer1::Weights>& weightMap) {
+    std::vector<char> index;
+    auto put = [&index](const void* p, size_t n) {
+        index.insert(index.end(), reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(p) + n);
+    };
+    auto align = [](uint64_t v) { return (v + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT; };
+
+    // The index size does not depend on the offsets, so lay it out once to learn where blobs start.
+    uint64_t index_size = 0;
+    for (auto& kv : weightMap) {
+        index_size += sizeof(uint32_t) + kv.first.size() + sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    }
+    uint64_t offset = align(sizeof(BinaryHeader) + index_size);
+    std::vector<uint64_t> offsets;
+    for (auto& kv : weightMap) {
+        uint32_t name_len = kv.first.size();
+        uint32_t type = static_cast<uint32_t>(nvinfer1::DataType::kFLOAT);
+        uint64_t count = kv.second.count;
+        put(&name_len, sizeof(name_len));
+        put(kv.first.data(), name_len);
+        put(&type, sizeof(type));
+        put(&count, sizeof(count));
+        put(&offset, sizeof(offset));
+        offsets.push_back(offset);
+        offset = align(offset + count * sizeof(float));
+    }
+
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, 4);
+    header.version = BINARY_VERSION;
+    header.count = weightMap.size();
+    header.alignment = BINARY_ALIGNMENT;
+    header.index_offset = sizeof(BinaryHeader);
+    header.file_size = offset;
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(index.data(), index.size());
+    uint64_t pos = sizeof(header) + index.size();
+    static const char zeros[BINARY_ALIGNMENT] = {};
+    size_t i = 0;
+    for (auto& kv : weightMap) {
+        out.write(zeros, offsets[i] - pos);
+        size_t bytes = kv.second.count * sizeof(float);
+        out.write(reinterpret_cast<const char*>(kv.second.values), bytes);
+        pos = offsets[i] + bytes;
+        i++;
+    }
+    out.write(zeros, offset - pos);
+    return out.good();
+}
+
+}  // namespace wts
+
+// Load a text .wts or a binary weight container into a name -> Weights map.
+// Binary blobs are not copied: Weights::values points into the mapped file.
+inline std::map<std::string, nvinfer1::Weights> loadWeights(const std::string file) {
+    std::cout << "Loading weights: " << file << std::endl;
+    std::map<std::string, nvinfer1::Weights> weightMap;
+
+    wts::FileView view;
+    bool opened = wts::openFile(file, view);
+    assert(opened && "Unable to load weight file. please check if the .wts file path is right!!!!!!");
+    (void)opened;
+    if (!wts::isBinary(view)) {
+        bool ok = wts::parseText(view, weightMap);
+        wts::closeFile(view);
+        if (ok) return weightMap;
+        std::cerr << "Falling back to the serial .wts parser for " << file << std::endl;
+        return wts::loadWeightsTextSerial(file);
+    }
+    bool ok = wts::parseBinary(view, weightMap);
+    assert(ok && "Invalid binary weight file.");
+    (void)ok;
+    wts::openViews().push_back(view);
+    return weightMap;
+}
+
+// Release everything loadWeights() handed out, plus blobs the network code malloc'ed into the map.
+inline void freeWeights(std::map<std::string, nvinfer1::Weights>& weightMap) {
+    auto& views = wts::openViews();
+    std::vector<bool> used(views.size(), false);
+    for (auto& mem : weightMap) {
+        const char* p = reinterpret_cast<const char*>(mem.second.values);
+        bool in_view = false;
+        for (size_t i = 0; i < views.size(); i++) {
+            if (p >= views[i].data && p < views[i].data + views[i].size) {
+                used[i] = true;
+                in_view = true;
+                break;
+            }
+        }
+        if (!in_view) free(const_cast<void*>(mem.second.values));
+    }
+    for (size_t i = views.size(); i-- > 0;) {
+        if (!used[i]) continue;
+        wts::closeFile(views[i]);
+        views.erase(views.begin() + i);
+    }
+    weightMap.clear();
+}
+
+#endif  // TRTX_WTS_LOADER_H_
@@ -0,0 +1,454 @@
+#ifndef TRTX_YOLO_DECODE_H_
+#define TRTX_YOLO_DECODE_H_
+
+// Host decode of the YOLO detect heads of yolov3, yolov4, scaled-yolov4 and
+// yolov5, i.e. what each sample's YoloLayer plugin (CalDetection) writes, from
+// one implementation specialized at compile time:
+//
+//   yolodecode::Decoder<Head, Anchors, Classes, NetW, NetH, Strides...>
+//
+// Head is the family's convention (sigmoid precision, xy / wh transform,
+// filtering and Detection layout), Anchors the anchors per cell, Strides the
+// heads in the order of the plugin's inputs. Grid sizes and head offsets are
+// constexpr, the class loops have a fixed trip count, and cells are screened 8
+// at a time (AVX2, NEON) on their raw objectness logits, so the sigmoid is only
+// evaluated near or above the threshold and only for the classes that can be
+// the maximum. Anchors are given at construction: yolov5 reads them from the
+// weights, the others have them as constexpr YoloKernel in yololayer.h.
+//
+// decode() writes, per image, [count, Detection * maxOut] with the boxes in
+// head, cell, anchor order, bit for bit what decodeRef() -- the plugin's
+// per-cell loop run serially -- writes, whatever the thread count. The GPU
+// kernels' expf and fused multiply-adds can change the last bits, compare
+// GPU output within a tolerance. Build without -ffast-math for exactness.
+//
+//   yolodecode::Yolov5Decoder<> decoder(anchors);  // 80 classes, 640x640, P3-P5
+//   decoder.decode(heads, prob, batch, &pool);
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "worker_pool.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define YOLO_DECODE_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define YOLO_DECODE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace yolodecode {
+
+// IGNORE_THRESH of all four yololayer.h.
+const float kIgnoreThresh = 0.1f;
+
+// Objectness logits below this have a sigmoid below kIgnoreThresh, with margin
+// for every family's sigmoid; the others are checked with the sigmoid itself.
+const float kObjLogitMin = std::log(kIgnoreThresh / (1.f - kIgnoreThresh)) - 0.05f;
+
+// ---- conventions ----------------------------------------------------------
+
+// The arguments of write(): tx, ty, tw, th logits spaced plane floats apart.
+struct Cell {
+    const float* box;
+    int plane;
+    int col, row;
+    int grid_w, grid_h;
+    int net_w, net_h;
+    float anchor_w, anchor_h;
+};
+
+// yolov3: float sigmoid, xy = (col + s(tx)) * stride, wh = exp(tw) * anchor.
+// Detection {bbox, det_confidence, class_id, class_confidence}, and the best
+// class must reach the threshold as well.
+struct Yolov3Head {
+    static const int kDetFloats = 7;
+    static const bool kClassGate = true;
+    static float sigmoid(float x) { return 1.0f / (1.0f + expf(-x)); }
+    static void write(const Cell& c, float box_prob, int class_id, float cls_prob, float* det) {
+        det[0] = (c.col + sigmoid(c.box[0])) * c.net_w / c.grid_w;
+        det[1] = (c.row + sigmoid(c.box[c.plane])) * c.net_h / c.grid_h;
+        det[2] = expf(c.box[2 * c.plane]) * c.anchor_w;
+        det[3] = expf(c.box[3 * c.plane]) * c.anchor_h;
+        det[4] = box_prob;
+        det[5] = class_id;
+        det[6] = cls_prob;
+    }
+};
+
+// yolov4: as yolov3 with the sigmoid evaluated in double.
+struct Yolov4Head {
+    static const int kDetFloats = 7;
+    static const bool kClassGate = true;
+    static float sigmoid(float x) { return 1. / (1. + expf(-x)); }
+    static void write(const Cell& c, float box_prob, int class_id, float cls_prob, float* det) {
+        det[0] = (c.col + sigmoid(c.box[0])) * c.net_w / c.grid_w;
+        det[1] = (c.row + sigmoid(c.box[c.plane])) * c.net_h / c.grid_h;
+        det[2] = expf(c.box[2 * c.plane]) * c.anchor_w;
+        det[3] = expf(c.box[3 * c.plane]) * c.anchor_h;
+        det[4] = box_prob;
+        det[5] = class_id;
+        det[6] = cls_prob;
+    }
+};
+
+// scaled-yolov4: yolov4's sigmoid and layout, xy = (col + 2 s(tx) - 0.5) * stride
+// (in double), wh = (2 s(tw))^2 * anchor.
+struct ScaledYolov4Head {
+    static const int kDetFloats = 7;
+    static const bool kClassGate = true;
+    static float sigmoid(float x) { return Yolov4Head::sigmoid(x); }
+    static void write(const Cell& c, float box_prob, int class_id, float cls_prob, float* det) {
+        det[0] = (c.col + (2 * (sigmoid(c.box[0]))) - 0.5) * c.net_w / c.grid_w;
+        det[1] = (c.row + (2 * (sigmoid(c.box[c.plane]))) - 0.5) * c.net_h / c.grid_h;
+        det[2] = (powf(2 * (sigmoid(c.box[2 * c.plane])), 2)) * c.anchor_w;
+        det[3] = (powf(2 * (sigmoid(c.box[3 * c.plane])), 2)) * c.anchor_h;
+        det[4] = box_prob;
+        det[5] = class_id;
+        det[6] = cls_prob;
+    }
+};
+
+// yolov5: float sigmoid, xy = (col - 0.5 + 2 s(tx)) * stride, wh = (2 s(tw))^2 * anchor.
+// Detection {bbox, conf = objectness * class, class_id}, only objectness is gated.
+struct Yolov5Head {
+    static const int kDetFloats = 6;
+    static const bool kClassGate = false;
+    static float sigmoid(float x) { return 1.0f / (1.0f + expf(-x)); }
+    static void write(const Cell& c, float box_prob, int class_id, float cls_prob, float* det) {
+        det[0] = (c.col - 0.5f + 2.0f * sigmoid(c.box[0])) * c.net_w / c.grid_w;
+        det[1] = (c.row - 0.5f + 2.0f * sigmoid(c.box[c.plane])) * c.net_h / c.grid_h;
+        det[2] = 2.0f * sigmoid(c.box[2 * c.plane]);
+        det[2] = det[2] * det[2] * c.anchor_w;
+        det[3] = 2.0f * sigmoid(c.box[3 * c.plane]);
+        det[3] = det[3] * det[3] * c.anchor_h;
+        det[4] = box_prob * cls_prob;
+        det[5] = class_id;
+    }
+};
+
+// ---- SIMD kernels, shared with YoloLayerCpu ----------------------------------
+
+#ifdef YOLO_DECODE_AVX2
+__attribute__((target("avx2"))) inline unsigned screen8Avx2(const float* logits, float min_logit) {
+    __m256 v = _mm256_loadu_ps(logits);
+    return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_set1_ps(min_logit), _CMP_GE_OQ));
+}
+
+template <int Classes>
+__attribute__((target("avx2"))) inline void classMax8Avx2(const float* cls, int plane, int classes, float* out) {
+    const int n = Classes > 0 ? Classes : classes;
+    __m256 m = _mm256_loadu_ps(cls);
+    for (int i = 1; i < n; ++i) m = _mm256_max_ps(m, _mm256_loadu_ps(cls + (size_t)i * plane));
+    _mm256_storeu_ps(out, m);
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif  // YOLO_DECODE_AVX2
+
+#ifdef YOLO_DECODE_NEON
+inline unsigned screen8Neon(const float* logits, float min_logit) {
+    const float32x4_t min = vdupq_n_f32(min_logit);
+    static const uint32_t weights_lo[4] = {1, 2, 4, 8};
+    static const uint32_t weights_hi[4] = {16, 32, 64, 128};
+    uint32x4_t lo = vandq_u32(vcgeq_f32(vld1q_f32(logits), min), vld1q_u32(weights_lo));
+    uint32x4_t hi = vandq_u32(vcgeq_f32(vld1q_f32(logits + 4), min), vld1q_u32(weights_hi));
+    return vaddvq_u32(vorrq_u32(lo, hi));
+}
+
+template <int Classes>
+inline void classMax8Neon(const float* cls, int plane, int classes, float* out) {
+    const int n = Classes > 0 ? Classes : classes;
+    float32x4_t lo = vld1q_f32(cls), hi = vld1q_f32(cls + 4);
+    for (int i = 1; i < n; ++i) {
+        lo = vmaxq_f32(lo, vld1q_f32(cls + (size_t)i * plane));
+        hi = vmaxq_f32(hi, vld1q_f32(cls + (size_t)i * plane + 4));
+    }
+    vst1q_f32(out, lo);
+    vst1q_f32(out + 4, hi);
+}
+#endif  // YOLO_DECODE_NEON
+
+// Bit j set if logits[j] >= min_logit, for the 8 cells from logits.
+inline unsigned screen8(const float* logits, float min_logit) {
+#if defined(YOLO_DECODE_AVX2)
+    if (hasAvx2()) return screen8Avx2(logits, min_logit);
+#elif defined(YOLO_DECODE_NEON)
+    return screen8Neon(logits, min_logit);
+#endif
+    unsigned mask = 0;
+    for (int j = 0; j < 8; j++) mask |= (unsigned)(logits[j] >= min_logit) << j;
+    return mask;
+}
+
+// Largest class logit of the 8 cells from cls, whose class planes are plane
+// floats apart; a lower bound if some logits are NaN, never above the maximum.
+// Classes fixes the count at compile time, 0 takes classes.
+template <int Classes>
+inline void classMax8(const float* cls, int plane, int classes, float* out) {
+#if defined(YOLO_DECODE_AVX2)
+    if (hasAvx2()) {
+        classMax8Avx2<Classes>(cls, plane, classes, out);
+        for (int j = 0; j < 8; j++) {
+            if (out[j] != out[j]) out[j] = -INFINITY;
+        }
+        return;
+    }
+#elif defined(YOLO_DECODE_NEON)
+    classMax8Neon<Classes>(cls, plane, classes, out);
+    for (int j = 0; j < 8; j++) {
+        if (out[j] != out[j]) out[j] = -INFINITY;
+    }
+    return;
+#endif
+    const int n = Classes > 0 ? Classes : classes;
+    for (int j = 0; j < 8; j++) {
+        float m = -INFINITY;
+        for (int i = 0; i < n; ++i) m = std::max(m, cls[(size_t)i * plane + j]);
+        out[j] = m;
+    }
+}
+
+// CalDetection's class loop, max_cls_prob / class_id over the first classes
+// logits spaced plane apart. The sigmoid is monotonic, so a class whose logit
+// is more than 1 below max_logit (or below 14, where float sigmoids saturate
+// towards 1.f) cannot reach, or tie, the best probability and is skipped.
+// max_logit may be any lower bound of the true maximum.
+template <class Head, int Classes>
+inline int bestClass(const float* cls, int plane, int classes, float max_logit, float& max_cls_prob) {
+    const int n = Classes > 0 ? Classes : classes;
+    const float candidate = std::min(max_logit - 1.f, 14.f);
+    int class_id = 0;
+    max_cls_prob = 0.0;
+    for (int i = 0; i < n; ++i) {
+        float x = cls[(size_t)i * plane];
+        if (!(x >= candidate)) continue;
+        float p = Head::sigmoid(x);
+        if (p > max_cls_prob) {
+            max_cls_prob = p;
+            class_id = i;
+        }
+    }
+    return class_id;
+}
+
+// ---- decoder --------------------------------------------------------------
+
+inline constexpr int nth(int) { return 0; }
+template <typename... Rest>
+inline constexpr int nth(int i, int first, Rest... rest) { return i == 0 ? first : nth(i - 1, rest...); }
+
+inline constexpr bool divides(int) { return true; }
+template <typename... Rest>
+inline constexpr bool divides(int n, int first, Rest... rest) { return n % first == 0 && divides(n, rest...); }
+
+template <class Head, int Anchors, int Classes, int NetW, int NetH, int... Strides>
+class Decoder {
+public:
+    static constexpr int kHeads = sizeof...(Strides);
+    static constexpr int kAnchors = Anchors;
+    static constexpr int kClasses = Classes;
+    static constexpr int kInfoLen = 5 + Classes;
+    static constexpr int kDetFloats = Head::kDetFloats;
+    static_assert(kHeads > 0 && divides(NetW, Strides...) && divides(NetH, Strides...),
+                  "the input size must be a multiple of every stride");
+
+    static constexpr int stride(int h) { return nth(h, Strides...); }
+    static constexpr int gridWidth(int h) { return NetW / stride(h); }
+    static constexpr int gridHeight(int h) { return NetH / stride(h); }
+    static constexpr int gridCells(int h) { return gridWidth(h) * gridHeight(h); }
+    // Floats of head h for one image, CHW with Anchors * (5 + Classes) channels.
+    static constexpr int headSize(int h) { return Anchors * kInfoLen * gridCells(h); }
+    // Cells of the heads before h, e.g. to lay the heads out in one buffer.
+    static constexpr int cellOffset(int h) { return h == 0 ? 0 : cellOffset(h - 1) + gridCells(h - 1); }
+
+    // anchors: w, h per anchor, per head, in Strides order.
+    explicit Decoder(const float* anchors, int maxOut = 1000) : mMaxOut(maxOut) {
+        std::copy(anchors, anchors + kHeads * Anchors * 2, &mAnchors[0][0]);
+    }
+
+    // Floats of one image's output, 1 + maxOut * kDetFloats.
+    int outputSize() const { return 1 + mMaxOut * kDetFloats; }
+
+    // inputs[h] is head h for the whole batch, output holds batch * outputSize() floats.
+    // Bands of rows of all heads and images run on pool, if given. Scratch is
+    // kept across calls; one call at a time per object.
+    void decode(const float* const* inputs, float* output, int batch, WorkerPool* pool = nullptr) {
+        mBands.clear();
+        for (int b = 0; b < batch; ++b) {
+            for (int h = 0; h < kHeads; ++h) {
+                int rows = std::max(1, kBandCells / gridWidth(h));
+                for (int r = 0; r < gridHeight(h); r += rows) mBands.push_back({b, h, r, std::min(r + rows, gridHeight(h))});
+            }
+        }
+        const int bands = (int)mBands.size();
+        const int bandsPerImage = batch > 0 ? bands / batch : 0;
+        if ((int)mFound.size() < bands) mFound.resize(bands);
+        auto decodeOne = [&](int band) { decodeBand(inputs, mBands[band], mFound[band]); };
+        auto merge = [&](int b) {
+            float* out = output + (size_t)b * outputSize();
+            int count = 0;
+            for (int band = b * bandsPerImage; band < (b + 1) * bandsPerImage; ++band) emit(mFound[band], out, count);
+            out[0] = (float)count;
+        };
+        if (pool) {
+            pool->parallelFor(bands, decodeOne);
+            pool->parallelFor(batch, merge);
+        } else {
+            for (int band = 0; band < bands; ++band) decodeOne(band);
+            for (int b = 0; b < batch; ++b) merge(b);
+        }
+    }
+
+    // The plugin's loop, one cell after another on one thread. Slow; the reference for decode().
+    void decodeRef(const float* const* inputs, float* output, int batch) const {
+        for (int b = 0; b < batch; ++b) output[(size_t)b * outputSize()] = 0;
+        for (int h = 0; h < kHeads; ++h) {
+            const int total_grid = gridCells(h);
+            for (int b = 0; b < batch; ++b) {
+                const float* in = inputs[h] + (size_t)b * headSize(h);
+                float* res_count = output + (size_t)b * outputSize();
+                for (int idx = 0; idx < total_grid; ++idx) {
+                    for (int k = 0; k < Anchors; ++k) {
+                        const float* box = in + k * kInfoLen * total_grid + idx;
+                        int class_id = 0;
+                        float max_cls_prob = 0.0;
+                        for (int i = 5; i < kInfoLen; ++i) {
+                            float p = Head::sigmoid(box[i * total_grid]);
+                            if (p > max_cls_prob) {
+                                max_cls_prob = p;
+                                class_id = i - 5;
+                            }
+                        }
+                        float box_prob = Head::sigmoid(box[4 * total_grid]);
+                        if (box_prob < kIgnoreThresh || (Head::kClassGate && max_cls_prob < kIgnoreThresh)) continue;
+                        int count = (int)(*res_count)++;
+                        if (count >= mMaxOut) break;
+                        Head::write(cell(box, h, idx, k), box_prob, class_id, max_cls_prob, res_count + 1 + count * kDetFloats);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr int kBandCells = 512;
+
+    struct Band {
+        int batch, head, row0, row1;
+    };
+    struct Found {
+        int cell;
+        float det[kDetFloats];
+    };
+
+    Cell cell(const float* box, int h, int idx, int k) const {
+        Cell c;
+        c.box = box;
+        c.plane = gridCells(h);
+        c.col = idx % gridWidth(h);
+        c.row = idx / gridWidth(h);
+        c.grid_w = gridWidth(h);
+        c.grid_h = gridHeight(h);
+        c.net_w = NetW;
+        c.net_h = NetH;
+        c.anchor_w = mAnchors[h][2 * k];
+        c.anchor_h = mAnchors[h][2 * k + 1];
+        return c;
+    }
+
+    void decodeBand(const float* const* inputs, const Band& band, std::vector<Found>& found) const {
+        const int h = band.head;
+        const int total_grid = gridCells(h);
+        const float* in = inputs[h] + (size_t)band.batch * headSize(h);
+        const int cell1 = band.row1 * gridWidth(h);
+        found.clear();
+        for (int cell0 = band.row0 * gridWidth(h); cell0 < cell1; cell0 += 8) {
+            const int n = std::min(8, cell1 - cell0);
+            unsigned masks[Anchors];
+            unsigned any = 0;
+            for (int k = 0; k < Anchors; ++k) {
+                const float* obj = in + (k * kInfoLen + 4) * total_grid + cell0;
+                if (n == 8) {
+                    masks[k] = screen8(obj, kObjLogitMin);
+                } else {
+                    masks[k] = 0;
+                    for (int j = 0; j < n; j++) masks[k] |= (unsigned)(obj[j] >= kObjLogitMin) << j;
+                }
+                any |= masks[k];
+            }
+            float max_logits[Anchors][8];
+            bool have_max[Anchors] = {};
+            while (any) {
+                int j = __builtin_ctz(any);
+                any &= any - 1;
+                int idx = cell0 + j;
+                for (int k = 0; k < Anchors; ++k) {
+                    if (!(masks[k] >> j & 1)) continue;
+                    const float* box = in + k * kInfoLen * total_grid + idx;
+                    float box_prob = Head::sigmoid(box[4 * total_grid]);
+                    if (box_prob < kIgnoreThresh) continue;
+                    if (!have_max[k]) {
+                        // 8 contiguous logits per class plane rather than one cache line per class and cell
+                        const float* cls = in + (k * kInfoLen + 5) * total_grid + cell0;
+                        if (n == 8) {
+                            classMax8<Classes>(cls, total_grid, Classes, max_logits[k]);
+                        } else {
+                            std::fill(max_logits[k], max_logits[k] + 8, -INFINITY);
+                        }
+                        have_max[k] = true;
+                    }
+                    float max_cls_prob;
+                    int class_id = bestClass<Head, Classes>(box + 5 * total_grid, total_grid, Classes, max_logits[k][j], max_cls_prob);
+                    if (Head::kClassGate && max_cls_prob < kIgnoreThresh) continue;
+                    found.emplace_back();
+                    found.back().cell = idx;
+                    Head::write(cell(box, h, idx, k), box_prob, class_id, max_cls_prob, found.back().det);
+                }
+            }
+        }
+    }
+
+    // Appends a band's boxes as the plugin counts them: every box counts, the
+    // first mMaxOut are written, and a cell is left once it overflows.
+    void emit(const std::vector<Found>& found, float* out, int& count) const {
+        int overflowed = -1;
+        for (const Found& f : found) {
+            if (f.cell == overflowed) continue;
+            int slot = count++;
+            if (slot >= mMaxOut) {
+                overflowed = f.cell;
+                continue;
+            }
+            memcpy(out + 1 + slot * kDetFloats, f.det, sizeof(f.det));
+        }
+    }
+
+    int mMaxOut;
+    float mAnchors[kHeads][Anchors * 2];
+    std::vector<Band> mBands;
+    std::vector<std::vector<Found>> mFound;
+};
+
+// The four families with their yololayer.h defaults.
+template <int Classes = 80, int NetW = 608, int NetH = 608>
+using Yolov3Decoder = Decoder<Yolov3Head, 3, Classes, NetW, NetH, 32, 16, 8>;
+template <int Classes = 80, int NetW = 608, int NetH = 608>
+using Yolov4Decoder = Decoder<Yolov4Head, 3, Classes, NetW, NetH, 8, 16, 32>;
+template <int Classes = 80, int NetW = 512, int NetH = 512>
+using ScaledYolov4Decoder = Decoder<ScaledYolov4Head, 3, Classes, NetW, NetH, 8, 16, 32>;
+template <int Classes = 80, int NetW = 640, int NetH = 640>
+using Yolov5Decoder = Decoder<Yolov5Head, 3, Classes, NetW, NetH, 8, 16, 32>;
+// yolov5 n6 .. x6, P3-P6
+template <int Classes = 80, int NetW = 1280, int NetH = 1280>
+using Yolov5P6Decoder = Decoder<Yolov5Head, 3, Classes, NetW, NetH, 8, 16, 32, 64>;
+
+}  // namespace yolodecode
+
+#endif  // TRTX_YOLO_DECODE_H_
@@ -0,0 +1,98 @@
+// Checks yolodecode::Decoder against its per-cell reference loop and times
+// both, for the heads of yolov3, yolov4, scaled-yolov4, yolov5 and yolov5 P6
+// at their default input sizes. The heads are filled with synthetic logits:
+// mostly background, a share of object cells, and some saturated class logits
+// so ties between classes are exercised too. Needs no GPU.
+//   ./yolo_decode_bench [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "yolo_decode.h"
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// One head for the whole batch, CHW per batch item. objects is the share of
+// cells whose objectness is above the threshold.
+static std::vector<float> make_head(int anchors, int classes, int cells, int batch, float objects, std::mt19937& rng) {
+    std::normal_distribution<float> background(-7.f, 2.f), logit(-3.f, 3.f);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const int info_len = 5 + classes;
+    std::vector<float> head((size_t)batch * anchors * info_len * cells);
+    for (int b = 0; b < batch; b++) {
+        for (int k = 0; k < anchors; k++) {
+            float* in = &head[((size_t)b * anchors + k) * info_len * cells];
+            for (int c = 0; c < info_len * cells; c++) in[c] = logit(rng);
+            for (int cell = 0; cell < cells; cell++) {
+                in[4 * cells + cell] = u(rng) < objects ? 2.f * u(rng) - 2.1f : background(rng);
+                if (u(rng) < 0.05f) {
+                    // saturated classes, their sigmoids are all 1.f
+                    for (int n = 0; n < 3; n++) in[(5 + rng() % classes) * cells + cell] = 17.f + 10.f * u(rng);
+                }
+            }
+        }
+    }
+    return head;
+}
+
+template <class Decoder>
+static bool run(const char* name, const float* anchors, int iterations, WorkerPool& pool, std::mt19937& rng) {
+    bool ok = true;
+    struct Case { int batch; float objects; int max_out; };
+    const Case cases[] = {{1, 0.01f, 1000}, {1, 0.05f, 1000}, {4, 0.01f, 1000}, {1, 0.2f, 300}};
+    for (const Case& c : cases) {
+        Decoder decoder(anchors, c.max_out);
+        std::vector<std::vector<float>> heads;
+        std::vector<const float*> inputs;
+        for (int h = 0; h < Decoder::kHeads; h++) {
+            heads.push_back(make_head(Decoder::kAnchors, Decoder::kClasses, Decoder::gridCells(h), c.batch, c.objects, rng));
+        }
+        for (auto& head : heads) inputs.push_back(head.data());
+        const size_t output_size = (size_t)c.batch * decoder.outputSize();
+        std::vector<float> ref(output_size, 0.f), out(output_size, 0.f);
+
+        decoder.decodeRef(inputs.data(), ref.data(), c.batch);
+        decoder.decode(inputs.data(), out.data(), c.batch, &pool);
+        bool same = memcmp(ref.data(), out.data(), output_size * sizeof(float)) == 0;
+        decoder.decode(inputs.data(), out.data(), c.batch);
+        same = same && memcmp(ref.data(), out.data(), output_size * sizeof(float)) == 0;
+        ok = ok && same;
+
+        double t_ref = time_ms(iterations, [&]() { decoder.decodeRef(inputs.data(), ref.data(), c.batch); });
+        double t_one = time_ms(iterations, [&]() { decoder.decode(inputs.data(), out.data(), c.batch); });
+        double t_pool = time_ms(iterations, [&]() { decoder.decode(inputs.data(), out.data(), c.batch, &pool); });
+        std::cout << name << " batch " << c.batch << ", " << c.objects * 100 << "% object cells: count " << ref[0]
+                  << (same ? " same as per-cell loop" : " MISMATCH") << "  per-cell " << t_ref << "ms  1 thread " << t_one
+                  << "ms  " << pool.size() << " threads " << t_pool << "ms" << std::endl;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    std::mt19937 rng(0);
+    WorkerPool pool;
+    // anchors of the yololayer.h, in the order of each decoder's strides
+    const float v3[] = {116, 90, 156, 198, 373, 326, 30, 61, 62, 45, 59, 119, 10, 13, 16, 30, 33, 23};
+    const float v4[] = {12, 16, 19, 36, 40, 28, 36, 75, 76, 55, 72, 146, 142, 110, 192, 243, 459, 401};
+    const float v5[] = {10, 13, 16, 30, 33, 23, 30, 61, 62, 45, 59, 119, 116, 90, 156, 198, 373, 326};
+    const float p6[] = {19, 27, 44, 40, 38, 94, 96, 68, 86, 152, 180, 137, 140, 301, 303, 264, 238, 542, 436, 615, 739, 380, 925, 792};
+    bool ok = true;
+    ok = run<yolodecode::Yolov3Decoder<>>("yolov3", v3, iterations, pool, rng) && ok;
+    ok = run<yolodecode::Yolov4Decoder<>>("yolov4", v4, iterations, pool, rng) && ok;
+    ok = run<yolodecode::ScaledYolov4Decoder<>>("scaled-yolov4", v4, iterations, pool, rng) && ok;
+    ok = run<yolodecode::Yolov5Decoder<>>("yolov5", v5, iterations, pool, rng) && ok;
+    ok = run<yolodecode::Yolov5P6Decoder<>>("yolov5 P6", p6, iterations, pool, rng) && ok;
+    // a custom yolov5 with 1 class, where the class loop is trivial
+    ok = run<yolodecode::Yolov5Decoder<1>>("yolov5 1 class", v5, iterations, pool, rng) && ok;
+    return ok ? 0 : 1;
+}
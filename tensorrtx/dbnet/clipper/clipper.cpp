@@ -47,6 +47,7 @@
 #include <cstdlib>
 #include <ostream>
 #include <functional>
+#include <new>
 
 namespace ClipperLib {
 
@@ -145,6 +146,98 @@ inline cInt Abs(cInt val)
   return val < 0 ? -val : val;
 }
 
+//------------------------------------------------------------------------------
+// Arena methods ...
+//------------------------------------------------------------------------------
+
+static ArenaAllocFunc arenaAlloc = std::malloc;
+static ArenaFreeFunc arenaFree = std::free;
+
+//every allocation, and the block headers, are rounded up to this
+static size_t const ArenaAlign = 16;
+static size_t const ArenaFirstBlock = 4096;
+
+void SetArenaAllocator(ArenaAllocFunc allocFunc, ArenaFreeFunc freeFunc)
+{
+  arenaAlloc = allocFunc;
+  arenaFree = freeFunc;
+}
+//------------------------------------------------------------------------------
+
+Arena::Arena(): m_alloc(arenaAlloc), m_free(arenaFree),
+  m_blocks(0), m_current(0), m_pos(0), m_end(0)
+{
+}
+//------------------------------------------------------------------------------
+
+Arena::~Arena()
+{
+  while (m_blocks)
+  {
+    Block* next = m_blocks->Next;
+    m_free(m_blocks);
+    m_blocks = next;
+  }
+}
+//------------------------------------------------------------------------------
+
+void* Arena::Alloc(size_t size)
+{
+  size = (size + ArenaAlign - 1) & ~(ArenaAlign - 1);
+  if (size > (size_t)(m_end - m_pos)) NextBlock(size);
+  void* result = m_pos;
+  m_pos += size;
+  return result;
+}
+//------------------------------------------------------------------------------
+
+void Arena::Free(void* ptr, size_t size)
+{
+  size = (size + ArenaAlign - 1) & ~(ArenaAlign - 1);
+  if ((char*)ptr + size == m_pos) m_pos = (char*)ptr;
+}
+//------------------------------------------------------------------------------
+
+void Arena::NextBlock(size_t size)
+{
+  //move on to the next kept block, or if that is too small insert a new one
+  //twice the size of the current ...
+  size_t const header = (sizeof(Block) + ArenaAlign - 1) & ~(ArenaAlign - 1);
+  Block* next = m_current ? m_current->Next : m_blocks;
+  if (!next || next->Size < size)
+  {
+    size_t bytes = m_current ? m_current->Size * 2 : ArenaFirstBlock;
+    while (bytes < size) bytes *= 2;
+    Block* block = static_cast<Block*>(m_alloc(header + bytes));
+    if (!block) throw std::bad_alloc();
+    block->Size = bytes;
+    block->Next = next;
+    if (m_current) m_current->Next = block;
+    else m_blocks = block;
+    next = block;
+  }
+  m_current = next;
+  m_pos = (char*)next + header;
+  m_end = m_pos + next->Size;
+}
+//------------------------------------------------------------------------------
+
+void Arena::Reset()
+{
+  m_current = 0;
+  m_pos = m_end = 0;
+}
+//------------------------------------------------------------------------------
+
+//records made in an arena are never destroyed, just forgotten when it is reset ...
+template <typename T>
+inline T* ArenaNew(Arena& arena, size_t count = 1)
+{
+  T* result = static_cast<T*>(arena.Alloc(sizeof(T) * count));
+  for (size_t i = 0; i < count; ++i) new (result + i) T;
+  return result;
+}
+
 //------------------------------------------------------------------------------
 // PolyTree methods ...
 //------------------------------------------------------------------------------
@@ -705,14 +798,8 @@ void ReversePolyPtLinks(OutPt *pp)
 
 void DisposeOutPts(OutPt*& pp)
 {
-  if (pp == 0) return;
-    pp->Prev->Next = 0;
-  while( pp )
-  {
-    OutPt *tmpPp = pp;
-    pp = pp->Next;
-    delete tmpPp;
-  }
+  //the points are in the Clipper's arena, which Execute resets ...
+  pp = 0;
 }
 //------------------------------------------------------------------------------
 
@@ -1058,7 +1145,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   if ((Closed && highI < 2) || (!Closed && highI < 1)) return false;
 
   //create a new edge array ...
-  TEdge *edges = new TEdge [highI +1];
+  TEdge *edges = ArenaNew<TEdge>(m_EdgeArena, highI + 1);
 
   bool IsFlat = true;
   //1. Basic (first) edge initialization ...
@@ -1077,7 +1164,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   }
   catch(...)
   {
-    delete [] edges;
+    m_EdgeArena.Free(edges, sizeof(TEdge) * (highI + 1));
     throw; //range test fails
   }
   TEdge *eStart = &edges[0];
@@ -1118,7 +1205,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
 
   if ((!Closed && (E == E->Next)) || (Closed && (E->Prev == E->Next)))
   {
-    delete [] edges;
+    m_EdgeArena.Free(edges, sizeof(TEdge) * (highI + 1));
     return false;
   }
 
@@ -1146,7 +1233,7 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   {
     if (Closed) 
     {
-      delete [] edges;
+      m_EdgeArena.Free(edges, sizeof(TEdge) * (highI + 1));
       return false;
     }
     E->Prev->OutIdx = Skip;
@@ -1233,12 +1320,8 @@ bool ClipperBase::AddPaths(const Paths &ppg, PolyType PolyTyp, bool Closed)
 void ClipperBase::Clear()
 {
   DisposeLocalMinimaList();
-  for (EdgeList::size_type i = 0; i < m_edges.size(); ++i)
-  {
-    TEdge* edges = m_edges[i];
-    delete [] edges;
-  }
   m_edges.clear();
+  m_EdgeArena.Reset();
   m_UseFullRange = false;
   m_HasOpenPaths = false;
 }
@@ -1250,7 +1333,7 @@ void ClipperBase::Reset()
   if (m_CurrentLM == m_MinimaList.end()) return; //ie nothing to process
   std::sort(m_MinimaList.begin(), m_MinimaList.end(), LocMinSorter());
 
-  m_Scanbeam = ScanbeamList(); //clears/resets priority_queue
+  m_Scanbeam.clear();
   //reset all edges ...
   for (MinimaList::iterator lm = m_MinimaList.begin(); lm != m_MinimaList.end(); ++lm)
   {
@@ -1334,32 +1417,32 @@ IntRect ClipperBase::GetBounds()
 
 void ClipperBase::InsertScanbeam(const cInt Y)
 {
-  m_Scanbeam.push(Y);
+  m_Scanbeam.push_back(Y);
+  std::push_heap(m_Scanbeam.begin(), m_Scanbeam.end());
 }
 //------------------------------------------------------------------------------
 
 bool ClipperBase::PopScanbeam(cInt &Y)
 {
   if (m_Scanbeam.empty()) return false;
-  Y = m_Scanbeam.top();
-  m_Scanbeam.pop();
-  while (!m_Scanbeam.empty() && Y == m_Scanbeam.top()) { m_Scanbeam.pop(); } // Pop duplicates.
+  Y = m_Scanbeam.front();
+  do // Pop duplicates.
+  {
+    std::pop_heap(m_Scanbeam.begin(), m_Scanbeam.end());
+    m_Scanbeam.pop_back();
+  } while (!m_Scanbeam.empty() && Y == m_Scanbeam.front());
   return true;
 }
 //------------------------------------------------------------------------------
 
 void ClipperBase::DisposeAllOutRecs(){
-  for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
-    DisposeOutRec(i);
   m_PolyOuts.clear();
+  m_OutArena.Reset();
 }
 //------------------------------------------------------------------------------
 
 void ClipperBase::DisposeOutRec(PolyOutList::size_type index)
 {
-  OutRec *outRec = m_PolyOuts[index];
-  if (outRec->Pts) DisposeOutPts(outRec->Pts);
-  delete outRec;
   m_PolyOuts[index] = 0;
 }
 //------------------------------------------------------------------------------
@@ -1379,7 +1462,7 @@ void ClipperBase::DeleteFromAEL(TEdge *e)
 
 OutRec* ClipperBase::CreateOutRec()
 {
-  OutRec* result = new OutRec;
+  OutRec* result = ArenaNew<OutRec>(m_OutArena);
   result->IsHole = false;
   result->IsOpen = false;
   result->FirstLeft = 0;
@@ -1512,13 +1595,13 @@ bool Clipper::Execute(ClipType clipType, Paths &solution,
   if (m_HasOpenPaths)
     throw clipperException("Error: PolyTree struct is needed for open path clipping.");
   m_ExecuteLocked = true;
-  solution.resize(0);
   m_SubjFillType = subjFillType;
   m_ClipFillType = clipFillType;
   m_ClipType = clipType;
   m_UsingPolyTree = false;
   bool succeeded = ExecuteInternal();
   if (succeeded) BuildResult(solution);
+  else solution.resize(0);
   DisposeAllOutRecs();
   m_ExecuteLocked = false;
   return succeeded;
@@ -1562,7 +1645,7 @@ bool Clipper::ExecuteInternal()
   bool succeeded = true;
   try {
     Reset();
-    m_Maxima = MaximaList();
+    m_Maxima.clear();
     m_SortedEdges = 0;
 
     succeeded = true;
@@ -1941,7 +2024,7 @@ void Clipper::CopyAELToSEL()
 
 void Clipper::AddJoin(OutPt *op1, OutPt *op2, const IntPoint OffPt)
 {
-  Join* j = new Join;
+  Join* j = ArenaNew<Join>(m_OutArena);
   j->OutPt1 = op1;
   j->OutPt2 = op2;
   j->OffPt = OffPt;
@@ -1951,23 +2034,19 @@ void Clipper::AddJoin(OutPt *op1, OutPt *op2, const IntPoint OffPt)
 
 void Clipper::ClearJoins()
 {
-  for (JoinList::size_type i = 0; i < m_Joins.size(); i++)
-    delete m_Joins[i];
   m_Joins.resize(0);
 }
 //------------------------------------------------------------------------------
 
 void Clipper::ClearGhostJoins()
 {
-  for (JoinList::size_type i = 0; i < m_GhostJoins.size(); i++)
-    delete m_GhostJoins[i];
   m_GhostJoins.resize(0);
 }
 //------------------------------------------------------------------------------
 
 void Clipper::AddGhostJoin(OutPt *op, const IntPoint OffPt)
 {
-  Join* j = new Join;
+  Join* j = ArenaNew<Join>(m_OutArena);
   j->OutPt1 = op;
   j->OutPt2 = 0;
   j->OffPt = OffPt;
@@ -2466,7 +2545,7 @@ OutPt* Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
   {
     OutRec *outRec = CreateOutRec();
     outRec->IsOpen = (e->WindDelta == 0);
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = ArenaNew<OutPt>(m_OutArena);
     outRec->Pts = newOp;
     newOp->Idx = outRec->Idx;
     newOp->Pt = pt;
@@ -2486,7 +2565,7 @@ OutPt* Clipper::AddOutPt(TEdge *e, const IntPoint &pt)
 	if (ToFront && (pt == op->Pt)) return op;
     else if (!ToFront && (pt == op->Prev->Pt)) return op->Prev;
 
-    OutPt* newOp = new OutPt;
+    OutPt* newOp = ArenaNew<OutPt>(m_OutArena);
     newOp->Idx = outRec->Idx;
     newOp->Pt = pt;
     newOp->Next = op;
@@ -2847,8 +2926,6 @@ bool Clipper::ProcessIntersections(const cInt topY)
 
 void Clipper::DisposeIntersectNodes()
 {
-  for (size_t i = 0; i < m_IntersectList.size(); ++i )
-    delete m_IntersectList[i];
   m_IntersectList.clear();
 }
 //------------------------------------------------------------------------------
@@ -2882,7 +2959,7 @@ void Clipper::BuildIntersectList(const cInt topY)
       {
         IntersectPoint(*e, *eNext, Pt);
         if (Pt.Y < topY) Pt = IntPoint(TopX(*e, topY), topY);
-        IntersectNode * newNode = new IntersectNode;
+        IntersectNode * newNode = ArenaNew<IntersectNode>(m_OutArena);
         newNode->Edge1 = e;
         newNode->Edge2 = eNext;
         newNode->Pt = Pt;
@@ -2912,7 +2989,6 @@ void Clipper::ProcessIntersectList()
       IntersectEdges( iNode->Edge1, iNode->Edge2, iNode->Pt);
       SwapPositionsInAEL( iNode->Edge1 , iNode->Edge2 );
     }
-    delete iNode;
   }
   m_IntersectList.clear();
 }
@@ -3071,7 +3147,7 @@ void Clipper::ProcessEdgesAtTopOfScanbeam(const cInt topY)
   }
 
   //3. Process horizontals at the Top of the scanbeam ...
-  m_Maxima.sort();
+  std::sort(m_Maxima.begin(), m_Maxima.end());
   ProcessHorizontals();
   m_Maxima.clear();
 
@@ -3126,7 +3202,6 @@ void Clipper::FixupOutPolyline(OutRec &outrec)
       OutPt *tmpPP = pp->Prev;
       tmpPP->Next = pp->Next;
       pp->Next->Prev = tmpPP;
-      delete pp;
       pp = tmpPP;
     }
   }
@@ -3164,11 +3239,9 @@ void Clipper::FixupOutPolygon(OutRec &outrec)
             (!preserveCol || !Pt2IsBetweenPt1AndPt3(pp->Prev->Pt, pp->Pt, pp->Next->Pt))))
         {
             lastOK = 0;
-            OutPt *tmp = pp;
             pp->Prev->Next = pp->Next;
             pp->Next->Prev = pp->Prev;
             pp = pp->Prev;
-            delete tmp;
         }
         else if (pp == lastOK) break;
         else
@@ -3198,22 +3271,27 @@ int PointCount(OutPt *Pts)
 
 void Clipper::BuildResult(Paths &polys)
 {
+  //the paths already in polys are overwritten rather than freed, so that a
+  //solution reused across executions keeps their buffers ...
+  Paths::size_type k = 0;
   polys.reserve(m_PolyOuts.size());
   for (PolyOutList::size_type i = 0; i < m_PolyOuts.size(); ++i)
   {
     if (!m_PolyOuts[i]->Pts) continue;
-    Path pg;
     OutPt* p = m_PolyOuts[i]->Pts->Prev;
     int cnt = PointCount(p);
     if (cnt < 2) continue;
+    if (k == polys.size()) polys.push_back(Path());
+    Path& pg = polys[k++];
+    pg.clear();
     pg.reserve(cnt);
     for (int i = 0; i < cnt; ++i)
     {
       pg.push_back(p->Pt);
       p = p->Prev;
     }
-    polys.push_back(pg);
   }
+  polys.resize(k);
 }
 //------------------------------------------------------------------------------
 
@@ -3345,9 +3423,9 @@ void Clipper::InsertEdgeIntoAEL(TEdge *edge, TEdge* startEdge)
 }
 //----------------------------------------------------------------------
 
-OutPt* DupOutPt(OutPt* outPt, bool InsertAfter)
+OutPt* DupOutPt(OutPt* outPt, bool InsertAfter, Arena& arena)
 {
-  OutPt* result = new OutPt;
+  OutPt* result = ArenaNew<OutPt>(arena);
   result->Pt = outPt->Pt;
   result->Idx = outPt->Idx;
   if (InsertAfter)
@@ -3369,7 +3447,7 @@ OutPt* DupOutPt(OutPt* outPt, bool InsertAfter)
 //------------------------------------------------------------------------------
 
 bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
-  const IntPoint Pt, bool DiscardLeft)
+  const IntPoint Pt, bool DiscardLeft, Arena& arena)
 {
   Direction Dir1 = (op1->Pt.X > op1b->Pt.X ? dRightToLeft : dLeftToRight);
   Direction Dir2 = (op2->Pt.X > op2b->Pt.X ? dRightToLeft : dLeftToRight);
@@ -3386,12 +3464,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op1->Next->Pt.X >= op1->Pt.X && op1->Next->Pt.Y == Pt.Y)  
         op1 = op1->Next;
     if (DiscardLeft && (op1->Pt.X != Pt.X)) op1 = op1->Next;
-    op1b = DupOutPt(op1, !DiscardLeft);
+    op1b = DupOutPt(op1, !DiscardLeft, arena);
     if (op1b->Pt != Pt) 
     {
       op1 = op1b;
       op1->Pt = Pt;
-      op1b = DupOutPt(op1, !DiscardLeft);
+      op1b = DupOutPt(op1, !DiscardLeft, arena);
     }
   } 
   else
@@ -3400,12 +3478,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op1->Next->Pt.X <= op1->Pt.X && op1->Next->Pt.Y == Pt.Y) 
         op1 = op1->Next;
     if (!DiscardLeft && (op1->Pt.X != Pt.X)) op1 = op1->Next;
-    op1b = DupOutPt(op1, DiscardLeft);
+    op1b = DupOutPt(op1, DiscardLeft, arena);
     if (op1b->Pt != Pt)
     {
       op1 = op1b;
       op1->Pt = Pt;
-      op1b = DupOutPt(op1, DiscardLeft);
+      op1b = DupOutPt(op1, DiscardLeft, arena);
     }
   }
 
@@ -3415,12 +3493,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op2->Next->Pt.X >= op2->Pt.X && op2->Next->Pt.Y == Pt.Y)
         op2 = op2->Next;
     if (DiscardLeft && (op2->Pt.X != Pt.X)) op2 = op2->Next;
-    op2b = DupOutPt(op2, !DiscardLeft);
+    op2b = DupOutPt(op2, !DiscardLeft, arena);
     if (op2b->Pt != Pt)
     {
       op2 = op2b;
       op2->Pt = Pt;
-      op2b = DupOutPt(op2, !DiscardLeft);
+      op2b = DupOutPt(op2, !DiscardLeft, arena);
     };
   } else
   {
@@ -3428,12 +3506,12 @@ bool JoinHorz(OutPt* op1, OutPt* op1b, OutPt* op2, OutPt* op2b,
       op2->Next->Pt.X <= op2->Pt.X && op2->Next->Pt.Y == Pt.Y) 
         op2 = op2->Next;
     if (!DiscardLeft && (op2->Pt.X != Pt.X)) op2 = op2->Next;
-    op2b = DupOutPt(op2, DiscardLeft);
+    op2b = DupOutPt(op2, DiscardLeft, arena);
     if (op2b->Pt != Pt)
     {
       op2 = op2b;
       op2->Pt = Pt;
-      op2b = DupOutPt(op2, DiscardLeft);
+      op2b = DupOutPt(op2, DiscardLeft, arena);
     };
   };
 
@@ -3485,8 +3563,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
     if (reverse1 == reverse2) return false;
     if (reverse1)
     {
-      op1b = DupOutPt(op1, false);
-      op2b = DupOutPt(op2, true);
+      op1b = DupOutPt(op1, false, m_OutArena);
+      op2b = DupOutPt(op2, true, m_OutArena);
       op1->Prev = op2;
       op2->Next = op1;
       op1b->Next = op2b;
@@ -3496,8 +3574,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       return true;
     } else
     {
-      op1b = DupOutPt(op1, true);
-      op2b = DupOutPt(op2, false);
+      op1b = DupOutPt(op1, true, m_OutArena);
+      op2b = DupOutPt(op2, false, m_OutArena);
       op1->Next = op2;
       op2->Prev = op1;
       op1b->Prev = op2b;
@@ -3553,7 +3631,7 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       Pt = op2b->Pt; DiscardLeftSide = (op2b->Pt.X > op2->Pt.X);
     }
     j->OutPt1 = op1; j->OutPt2 = op2;
-    return JoinHorz(op1, op1b, op2, op2b, Pt, DiscardLeftSide);
+    return JoinHorz(op1, op1b, op2, op2b, Pt, DiscardLeftSide, m_OutArena);
   } else
   {
     //nb: For non-horizontal joins ...
@@ -3589,8 +3667,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
 
     if (Reverse1)
     {
-      op1b = DupOutPt(op1, false);
-      op2b = DupOutPt(op2, true);
+      op1b = DupOutPt(op1, false, m_OutArena);
+      op2b = DupOutPt(op2, true, m_OutArena);
       op1->Prev = op2;
       op2->Next = op1;
       op1b->Next = op2b;
@@ -3600,8 +3678,8 @@ bool Clipper::JoinPoints(Join *j, OutRec* outRec1, OutRec* outRec2)
       return true;
     } else
     {
-      op1b = DupOutPt(op1, true);
-      op2b = DupOutPt(op2, false);
+      op1b = DupOutPt(op1, true, m_OutArena);
+      op2b = DupOutPt(op2, false, m_OutArena);
       op1->Next = op2;
       op2->Prev = op1;
       op1b->Prev = op2b;
@@ -3788,19 +3866,23 @@ ClipperOffset::ClipperOffset(double miterLimit, double arcTolerance)
   this->MiterLimit = miterLimit;
   this->ArcTolerance = arcTolerance;
   m_lowest.X = -1;
+  m_destCount = 0;
 }
 //------------------------------------------------------------------------------
 
 ClipperOffset::~ClipperOffset()
 {
   Clear();
+  for (PolyNodes::size_type i = 0; i < m_freeNodes.size(); ++i)
+    delete m_freeNodes[i];
 }
 //------------------------------------------------------------------------------
 
 void ClipperOffset::Clear()
 {
+  //keep the nodes, and their contours' buffers, for the next AddPath ...
   for (int i = 0; i < m_polyNodes.ChildCount(); ++i)
-    delete m_polyNodes.Childs[i];
+    m_freeNodes.push_back(m_polyNodes.Childs[i]);
   m_polyNodes.Childs.clear();
   m_lowest.X = -1;
 }
@@ -3810,7 +3892,14 @@ void ClipperOffset::AddPath(const Path& path, JoinType joinType, EndType endType
 {
   int highI = (int)path.size() - 1;
   if (highI < 0) return;
-  PolyNode* newNode = new PolyNode();
+  PolyNode* newNode;
+  if (m_freeNodes.empty()) newNode = new PolyNode();
+  else
+  {
+    newNode = m_freeNodes.back();
+    m_freeNodes.pop_back();
+    newNode->Contour.clear();
+  }
   newNode->m_jointype = joinType;
   newNode->m_endtype = endType;
 
@@ -3831,7 +3920,7 @@ void ClipperOffset::AddPath(const Path& path, JoinType joinType, EndType endType
     }
   if (endType == etClosedPolygon && j < 2)
   {
-    delete newNode;
+    m_freeNodes.push_back(newNode);
     return;
   }
   m_polyNodes.AddChild(*newNode);
@@ -3886,13 +3975,15 @@ void ClipperOffset::FixOrientations()
 
 void ClipperOffset::Execute(Paths& solution, double delta)
 {
-  solution.clear();
   FixOrientations();
   DoOffset(delta);
   
   //now clean up 'corners' ...
-  Clipper clpr;
-  clpr.AddPaths(m_destPolys, ptSubject, true);
+  Clipper& clpr = m_clipper;
+  clpr.Clear();
+  clpr.ReverseSolution(false);
+  for (size_t i = 0; i < m_destCount; ++i)
+    clpr.AddPath(m_destPolys[i], ptSubject, true);
   if (delta > 0)
   {
     clpr.Execute(ctUnion, solution, pftPositive, pftPositive);
@@ -3921,8 +4012,11 @@ void ClipperOffset::Execute(PolyTree& solution, double delta)
   DoOffset(delta);
 
   //now clean up 'corners' ...
-  Clipper clpr;
-  clpr.AddPaths(m_destPolys, ptSubject, true);
+  Clipper& clpr = m_clipper;
+  clpr.Clear();
+  clpr.ReverseSolution(false);
+  for (size_t i = 0; i < m_destCount; ++i)
+    clpr.AddPath(m_destPolys[i], ptSubject, true);
   if (delta > 0)
   {
     clpr.Execute(ctUnion, solution, pftPositive, pftPositive);
@@ -3955,20 +4049,32 @@ void ClipperOffset::Execute(PolyTree& solution, double delta)
 }
 //------------------------------------------------------------------------------
 
+void ClipperOffset::AddDestPoly()
+{
+  //swap m_destPoly into the next kept path, taking that path's buffer in
+  //exchange, so that no points are copied or allocated ...
+  if (m_destCount == m_destPolys.size()) m_destPolys.push_back(Path());
+  m_destPolys[m_destCount++].swap(m_destPoly);
+  m_destPoly.clear();
+}
+//------------------------------------------------------------------------------
+
 void ClipperOffset::DoOffset(double delta)
 {
-  m_destPolys.clear();
+  m_destCount = 0;
   m_delta = delta;
 
   //if Zero offset, just copy any CLOSED polygons to m_p and return ...
   if (NEAR_ZERO(delta)) 
   {
-    m_destPolys.reserve(m_polyNodes.ChildCount());
     for (int i = 0; i < m_polyNodes.ChildCount(); i++)
     {
       PolyNode& node = *m_polyNodes.Childs[i];
       if (node.m_endtype == etClosedPolygon)
-        m_destPolys.push_back(node.Contour);
+      {
+        m_destPoly = node.Contour;
+        AddDestPoly();
+      }
     }
     return;
   }
@@ -3991,7 +4097,6 @@ void ClipperOffset::DoOffset(double delta)
   m_StepsPerRad = steps / two_pi;
   if (delta < 0.0) m_sin = -m_sin;
 
-  m_destPolys.reserve(m_polyNodes.ChildCount() * 2);
   for (int i = 0; i < m_polyNodes.ChildCount(); i++)
   {
     PolyNode& node = *m_polyNodes.Childs[i];
@@ -4030,7 +4135,7 @@ void ClipperOffset::DoOffset(double delta)
           else X = -1;
         }
       }
-      m_destPolys.push_back(m_destPoly);
+      AddDestPoly();
       continue;
     }
     //build m_normals ...
@@ -4048,14 +4153,14 @@ void ClipperOffset::DoOffset(double delta)
       int k = len - 1;
       for (int j = 0; j < len; ++j)
         OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
+      AddDestPoly();
     }
     else if (node.m_endtype == etClosedLine)
     {
       int k = len - 1;
       for (int j = 0; j < len; ++j)
         OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
+      AddDestPoly();
       m_destPoly.clear();
       //re-build m_normals ...
       DoublePoint n = m_normals[len -1];
@@ -4065,7 +4170,7 @@ void ClipperOffset::DoOffset(double delta)
       k = 0;
       for (int j = len - 1; j >= 0; j--)
         OffsetPoint(j, k, node.m_jointype);
-      m_destPolys.push_back(m_destPoly);
+      AddDestPoly();
     }
     else
     {
@@ -4122,7 +4227,7 @@ void ClipperOffset::DoOffset(double delta)
         else
           DoRound(0, 1);
       }
-      m_destPolys.push_back(m_destPoly);
+      AddDestPoly();
     }
   }
 }
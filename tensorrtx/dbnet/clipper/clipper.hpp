@@ -207,6 +207,38 @@ struct OutPt;
 struct OutRec;
 struct Join;
 
+//Arena: the bump allocator that holds a Clipper's internal records (edges,
+//output records and points, joins, intersections). Execute resets it rather
+//than deleting the records one by one, and its blocks are kept, so a Clipper
+//or ClipperOffset reused for many polygons stops allocating once it has seen
+//the largest of them. Blocks are taken from, and given back to, the functions
+//set with SetArenaAllocator (malloc and free by default) when the arena is
+//made; set them before making the Clipper objects that are to use them.
+typedef void* (*ArenaAllocFunc)(size_t size);
+typedef void (*ArenaFreeFunc)(void* ptr);
+void SetArenaAllocator(ArenaAllocFunc allocFunc, ArenaFreeFunc freeFunc);
+
+class Arena
+{
+public:
+  Arena();
+  ~Arena();
+  void* Alloc(size_t size);
+  void Free(void* ptr, size_t size); //only undoes the last Alloc
+  void Reset();
+private:
+  struct Block { Block* Next; size_t Size; };
+  Arena(const Arena&);
+  Arena& operator =(const Arena&);
+  void NextBlock(size_t size);
+  ArenaAllocFunc m_alloc;
+  ArenaFreeFunc  m_free;
+  Block*         m_blocks;
+  Block*         m_current;
+  char*          m_pos;
+  char*          m_end;
+};
+
 typedef std::vector < OutRec* > PolyOutList;
 typedef std::vector < TEdge* > EdgeList;
 typedef std::vector < Join* > JoinList;
@@ -255,8 +287,11 @@ protected:
   PolyOutList       m_PolyOuts;
   TEdge           *m_ActiveEdges;
 
-  typedef std::priority_queue<cInt> ScanbeamList;
+  typedef std::vector<cInt> ScanbeamList; //a max-heap, kept between executions
   ScanbeamList     m_Scanbeam;
+
+  Arena            m_EdgeArena; //edges, from AddPath to Clear
+  Arena            m_OutArena;  //output records, points, joins and intersections, for one Execute
 };
 //------------------------------------------------------------------------------
 
@@ -293,7 +328,7 @@ private:
   JoinList         m_GhostJoins;
   IntersectList    m_IntersectList;
   ClipType         m_ClipType;
-  typedef std::list<cInt> MaximaList;
+  typedef std::vector<cInt> MaximaList;
   MaximaList       m_Maxima;
   TEdge           *m_SortedEdges;
   bool             m_ExecuteLocked;
@@ -370,7 +405,8 @@ public:
   double MiterLimit;
   double ArcTolerance;
 private:
-  Paths m_destPolys;
+  Paths m_destPolys; //the first m_destCount are this execution's, the rest kept for reuse
+  size_t m_destCount;
   Path m_srcPoly;
   Path m_destPoly;
   std::vector<DoublePoint> m_normals;
@@ -378,7 +414,10 @@ private:
   double m_miterLim, m_StepsPerRad;
   IntPoint m_lowest;
   PolyNode m_polyNodes;
+  PolyNodes m_freeNodes; //cleared nodes, reused by AddPath
+  Clipper m_clipper; //cleans up the offset paths, reused by every Execute
 
+  void AddDestPoly();
   void FixOrientations();
   void DoOffset(double delta);
   void OffsetPoint(int j, int& k, JoinType jointype);
@@ -0,0 +1,183 @@
+// Times ClipperLib on two workloads, building a Clipper or ClipperOffset for
+// every polygon as the samples did, against one object reused (Cleared) for
+// all of them, and checks both give the same paths:
+//  - DBNet's unclip: every text box of a page offset with round joins, the
+//    boxes rotated rectangles or perturbed into general quads;
+//  - a polygon union: sets of random star-shaped polygons merged by ctUnion.
+// Counts the heap allocations per polygon, and the arena blocks taken through
+// SetArenaAllocator.
+//   ./clipper_bench [boxes per page] [pages] [unions]
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include "clipper.hpp"
+
+static std::atomic<size_t> g_allocations(0);
+static std::atomic<size_t> g_blocks(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static void* block_alloc(size_t size) {
+    g_blocks++;
+    return malloc(size);
+}
+
+static const double EXPANDRATIO = 1.5;
+
+// the distance of unclip.h: area * ratio / perimeter
+static double unclip_distance(const ClipperLib::Path& path) {
+    double length = 0;
+    for (size_t i = 0; i < path.size(); i++) {
+        const ClipperLib::IntPoint &a = path[i], &b = path[(i + 1) % path.size()];
+        length += std::hypot((double)(a.X - b.X), (double)(a.Y - b.Y));
+    }
+    return std::fabs(ClipperLib::Area(path)) * EXPANDRATIO / length;
+}
+
+static ClipperLib::Paths text_boxes(int count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> u(0., 1.);
+    ClipperLib::Paths boxes(count);
+    for (int i = 0; i < count; i++) {
+        const double cx = 50 + 1900 * u(rng), cy = 50 + 2600 * u(rng);
+        const double w = 12 + 300 * u(rng) * u(rng), h = 8 + 24 * u(rng), a = (-5 + 10 * u(rng)) * M_PI / 180;
+        for (int k = 0; k < 4; k++) {
+            const double x = (k == 1 || k == 2 ? 0.5 : -0.5) * w, y = (k < 2 ? -0.5 : 0.5) * h;
+            // every other box a general quad, its corners moved by up to 3px
+            const double dx = i % 2 ? (u(rng) - 0.5) * 6 : 0, dy = i % 2 ? (u(rng) - 0.5) * 6 : 0;
+            boxes[i].push_back(ClipperLib::IntPoint((ClipperLib::cInt)(cx + x * std::cos(a) - y * std::sin(a) + dx),
+                                                    (ClipperLib::cInt)(cy + x * std::sin(a) + y * std::cos(a) + dy)));
+        }
+    }
+    return boxes;
+}
+
+static ClipperLib::Paths stars(int count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> u(0., 1.);
+    ClipperLib::Paths polys(count);
+    for (int i = 0; i < count; i++) {
+        const double cx = 1000 * u(rng), cy = 1000 * u(rng), r = 50 + 150 * u(rng);
+        const int n = 5 + rng() % 20;
+        for (int k = 0; k < n; k++) {
+            const double a = 2 * M_PI * k / n, rk = r * (k % 2 ? 0.4 + 0.5 * u(rng) : 1);
+            polys[i].push_back(ClipperLib::IntPoint((ClipperLib::cInt)(cx + rk * std::cos(a)),
+                                                    (ClipperLib::cInt)(cy + rk * std::sin(a))));
+        }
+    }
+    return polys;
+}
+
+struct Timing {
+    double ms;
+    size_t allocations;
+};
+
+template <typename F>
+static Timing measure(F run) {
+    const size_t before = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+    run();
+    return Timing{std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                  g_allocations - before};
+}
+
+int main(int argc, char** argv) {
+    const int boxes = argc > 1 ? atoi(argv[1]) : 4000;
+    const int pages = argc > 2 ? atoi(argv[2]) : 10;
+    const int unions = argc > 3 ? atoi(argv[3]) : 200;
+    ClipperLib::SetArenaAllocator(block_alloc, free);
+    std::mt19937 rng(0);
+    bool same = true;
+
+    // DBNet's unclip, one ClipperOffset per box against one for the page
+    std::vector<ClipperLib::Paths> page_boxes(pages);
+    for (auto& p : page_boxes) p = text_boxes(boxes, rng);
+    std::vector<ClipperLib::Paths> fresh(boxes), reused(boxes);
+    double fresh_ms = 0, reused_ms = 0;
+    size_t fresh_allocations = 0, reused_allocations = 0, reused_blocks = 0;
+    for (int p = 0; p < pages; p++) {
+        const ClipperLib::Paths& page = page_boxes[p];
+        Timing t = measure([&]() {
+            for (int i = 0; i < boxes; i++) {
+                ClipperLib::ClipperOffset offset;
+                offset.AddPath(page[i], ClipperLib::jtRound, ClipperLib::etClosedPolygon);
+                ClipperLib::Paths out;
+                offset.Execute(out, unclip_distance(page[i]));
+                fresh[i] = out;
+            }
+        });
+        fresh_ms += t.ms;
+        fresh_allocations += t.allocations;
+        const size_t blocks = g_blocks;
+        t = measure([&]() {
+            static ClipperLib::ClipperOffset offset;
+            static ClipperLib::Paths out;
+            for (int i = 0; i < boxes; i++) {
+                offset.Clear();
+                offset.AddPath(page[i], ClipperLib::jtRound, ClipperLib::etClosedPolygon);
+                offset.Execute(out, unclip_distance(page[i]));
+                if (out != fresh[i]) same = false;
+            }
+        });
+        reused_ms += t.ms;
+        // the first page fills the buffers, the rest show the steady state
+        if (p > 0 || pages == 1) {
+            reused_allocations += t.allocations;
+            reused_blocks += g_blocks - blocks;
+        }
+    }
+    const int steady = pages > 1 ? pages - 1 : 1;
+    std::cout << pages << " pages of " << boxes << " text boxes, ClipperOffset per box: " << fresh_ms / pages
+              << "ms per page, " << (double)fresh_allocations / pages / boxes << " allocations per box" << std::endl;
+    std::cout << "  one ClipperOffset reused: " << reused_ms / pages << "ms per page ("
+              << fresh_ms / reused_ms << "x), " << (double)reused_allocations / steady / boxes
+              << " allocations per box, " << reused_blocks << " arena blocks after the first page" << std::endl;
+
+    // polygon union, one Clipper per set against one for all of them
+    std::vector<ClipperLib::Paths> sets(unions);
+    for (auto& s : sets) s = stars(50, rng);
+    std::vector<ClipperLib::Paths> merged(unions);
+    Timing fresh_union = measure([&]() {
+        for (int i = 0; i < unions; i++) {
+            ClipperLib::Clipper clipper;
+            clipper.AddPaths(sets[i], ClipperLib::ptSubject, true);
+            clipper.Execute(ClipperLib::ctUnion, merged[i], ClipperLib::pftNonZero);
+        }
+    });
+    ClipperLib::Clipper clipper;
+    ClipperLib::Paths out;
+    Timing warm = measure([&]() {
+        clipper.AddPaths(sets[0], ClipperLib::ptSubject, true);
+        clipper.Execute(ClipperLib::ctUnion, out, ClipperLib::pftNonZero);
+        clipper.Clear();
+    });
+    const size_t blocks = g_blocks;
+    Timing reused_union = measure([&]() {
+        for (int i = 0; i < unions; i++) {
+            clipper.Clear();
+            clipper.AddPaths(sets[i], ClipperLib::ptSubject, true);
+            clipper.Execute(ClipperLib::ctUnion, out, ClipperLib::pftNonZero);
+            if (out != merged[i]) same = false;
+        }
+    });
+    std::cout << unions << " unions of 50 star polygons, Clipper per union: " << fresh_union.ms / unions << "ms, "
+              << (double)fresh_union.allocations / unions << " allocations per union" << std::endl;
+    std::cout << "  one Clipper reused: " << reused_union.ms / unions << "ms (" << fresh_union.ms / reused_union.ms
+              << "x), " << (double)reused_union.allocations / unions << " allocations per union after "
+              << warm.allocations << " for the first, " << g_blocks - blocks << " arena blocks" << std::endl;
+
+    std::cout << (same ? "same paths" : "MISMATCH between fresh and reused objects") << std::endl;
+    return same ? 0 : 1;
+}
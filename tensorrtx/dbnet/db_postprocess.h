@@ -0,0 +1,403 @@
+#ifndef TRTX_DBNET_DB_POSTPROCESS_H_
+#define TRTX_DBNET_DB_POSTPROCESS_H_
+
+// Text boxes from DBNet's probability map. dbnet.cpp found them one contour at
+// a time: the binary map prob > 0.3, cv::findContours on it, then for every
+// contour its minimum area rectangle, dropped if a side is under min_size; its
+// score, the mean of the probabilities above score_threshold in the
+// rectangle's axis-aligned bounds, rescanned pixel by pixel and dropped under
+// box_threshold; unclip (unclip.h), dropped if a side is under min_size + 2.
+//
+// PostProcessor finds the same boxes, in the same order, with the work spread
+// over a WorkerPool. The map is thresholded 32 pixels at a time (AVX2, NEON),
+// in row blocks in parallel. The contours are processed in parallel, each into
+// its own slot of a vector kept between maps, in two passes: their rectangles
+// first, then their scores and unclip; the boxes kept are gathered in contour
+// order. In between, if the rectangles' bounds add up to more pixels than
+// kTableScans scans of the map, summed-area tables of the probabilities above
+// score_threshold and of their count are built, rows then columns in parallel,
+// and a box's score is four lookups whatever its size: large tilted boxes,
+// whose bounds are mostly background, or dense pages. Otherwise the boxes are
+// scanned, as get_box_score does. The tables sum in double where get_box_score
+// sums in float, so their scores differ from its in the last bits.
+//
+// dbnet.cpp did not clamp a box's bounds to the map: for a box over its edge,
+// which a tilted text line at the edge gives, it read the next row, the
+// threshold map, or outside the buffer. The bounds are now clamped.
+//
+//   dbpost::PostProcessor post(options, &pool);
+//   const std::vector<dbpost::TextBox>& boxes = post.run(prob, width, height);
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "unclip.h"
+#include "worker_pool.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DB_POSTPROCESS_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define DB_POSTPROCESS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace dbpost {
+
+// When PostProcessor scores boxes from summed-area tables.
+enum class Tables { kAuto, kAlways, kNever };
+
+// Building the tables costs about this many scans of the map.
+const double kTableScans = 2.0;
+
+struct Options {
+    double binary_threshold = 0.3;  // the binary map is prob > binary_threshold
+    float score_threshold = 0.3f;   // the probabilities averaged into a box's score
+    float box_threshold = 0.7f;     // boxes scoring under it are dropped
+    float expand_ratio = 1.5f;      // unclip
+    int min_size = 5;               // shortest side before unclip, min_size + 2 after
+    Tables tables = Tables::kAuto;
+};
+
+struct TextBox {
+    cv::Point2f corners[4];  // in get_mini_boxes' order, map pixels
+    float score;
+};
+
+// The corners of rotated_rect from the left top, clockwise; false if a side
+// is under min_size.
+inline bool get_mini_boxes(cv::RotatedRect& rotated_rect, cv::Point2f rect[],
+                           int min_size)
+{
+
+    cv::Point2f temp_rect[4];
+    rotated_rect.points(temp_rect);
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            if (temp_rect[i].x > temp_rect[j].x) {
+                cv::Point2f temp;
+                temp = temp_rect[i];
+                temp_rect[i] = temp_rect[j];
+                temp_rect[j] = temp;
+            }
+        }
+    }
+    int index0 = 0;
+    int index1 = 1;
+    int index2 = 2;
+    int index3 = 3;
+    if (temp_rect[1].y > temp_rect[0].y) {
+        index0 = 0;
+        index3 = 1;
+    } else {
+        index0 = 1;
+        index3 = 0;
+    }
+    if (temp_rect[3].y > temp_rect[2].y) {
+        index1 = 2;
+        index2 = 3;
+    } else {
+        index1 = 3;
+        index2 = 2;
+    }
+
+    rect[0] = temp_rect[index0];  // Left top coordinate
+    rect[1] = temp_rect[index1];  // Left bottom coordinate
+    rect[2] = temp_rect[index2];  // Right bottom coordinate
+    rect[3] = temp_rect[index3];  // Right top coordinate
+
+    if (rotated_rect.size.width < min_size ||
+        rotated_rect.size.height < min_size) {
+        return false;
+    } else {
+        return true;
+    }
+}
+
+// The bounds get_box_score scans: the corners truncated, clamped to the map.
+inline void box_bounds(const cv::Point2f rect[], int width, int height, int& xmin, int& ymin, int& xmax, int& ymax)
+{
+    xmin = width - 1;
+    ymin = height - 1;
+    xmax = 0;
+    ymax = 0;
+
+    for (int j = 0; j < 4; j++) {
+        if (rect[j].x < xmin) {
+            xmin = rect[j].x;
+        }
+        if (rect[j].y < ymin) {
+            ymin = rect[j].y;
+        }
+        if (rect[j].x > xmax) {
+            xmax = rect[j].x;
+        }
+        if (rect[j].y > ymax) {
+            ymax = rect[j].y;
+        }
+    }
+    xmin = std::max(xmin, 0);
+    ymin = std::max(ymin, 0);
+    xmax = std::min(xmax, width - 1);
+    ymax = std::min(ymax, height - 1);
+}
+
+// Mean of the probabilities above threshold in the bounds of rect, by scanning.
+inline float get_box_score(const float* map, const cv::Point2f rect[], int width, int height,
+                           float threshold)
+{
+    int xmin, ymin, xmax, ymax;
+    box_bounds(rect, width, height, xmin, ymin, xmax, ymax);
+    float sum = 0;
+    int num = 0;
+    for (int i = ymin; i <= ymax; i++) {
+        for (int j = xmin; j <= xmax; j++) {
+            if (map[i * width + j] > threshold) {
+                sum = sum + map[i * width + j];
+                num++;
+            }
+        }
+    }
+
+    return sum / num;
+}
+
+// prob > t compared in double, as dbnet.cpp's `prob[i] > 0.3` did, is prob >=
+// the float this returns.
+inline float float_above(double t) {
+    float f = (float)t;
+    if ((double)f <= t) f = std::nextafter(f, INFINITY);
+    return f;
+}
+
+#ifdef DB_POSTPROCESS_AVX2
+__attribute__((target("avx2"))) inline void binarize32Avx2(const float* src, uint8_t* dst, float t) {
+    const __m256 v = _mm256_set1_ps(t);
+    // all-ones lanes, packed down to 0xFF bytes; the packs work per 128-bit
+    // lane, the permute puts the four groups of 8 back in order
+    __m256i a = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(src), v, _CMP_GE_OQ));
+    __m256i b = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(src + 8), v, _CMP_GE_OQ));
+    __m256i c = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(src + 16), v, _CMP_GE_OQ));
+    __m256i d = _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(src + 24), v, _CMP_GE_OQ));
+    __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+    bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), bytes);
+}
+
+inline bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif  // DB_POSTPROCESS_AVX2
+
+#ifdef DB_POSTPROCESS_NEON
+inline void binarize32Neon(const float* src, uint8_t* dst, float t) {
+    const float32x4_t v = vdupq_n_f32(t);
+    for (int i = 0; i < 32; i += 16) {
+        uint16x8_t lo = vcombine_u16(vmovn_u32(vcgeq_f32(vld1q_f32(src + i), v)),
+                                     vmovn_u32(vcgeq_f32(vld1q_f32(src + i + 4), v)));
+        uint16x8_t hi = vcombine_u16(vmovn_u32(vcgeq_f32(vld1q_f32(src + i + 8), v)),
+                                     vmovn_u32(vcgeq_f32(vld1q_f32(src + i + 12), v)));
+        vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+}
+#endif  // DB_POSTPROCESS_NEON
+
+// dst[i] = src[i] >= t ? 255 : 0 for n pixels; NaN is 0.
+inline void binarize(const float* src, uint8_t* dst, int n, float t) {
+    int i = 0;
+#if defined(DB_POSTPROCESS_AVX2)
+    if (hasAvx2()) {
+        for (; i + 32 <= n; i += 32) binarize32Avx2(src + i, dst + i, t);
+    }
+#elif defined(DB_POSTPROCESS_NEON)
+    for (; i + 32 <= n; i += 32) binarize32Neon(src + i, dst + i, t);
+#endif
+    for (; i < n; i++) dst[i] = src[i] >= t ? 255 : 0;
+}
+
+class PostProcessor {
+public:
+    // pool may be null: everything then runs on the calling thread.
+    PostProcessor(const Options& options, WorkerPool* pool) : options_(options), pool_(pool) {}
+
+    // The boxes of the width x height probability map prob, in contour order;
+    // valid until the next call.
+    const std::vector<TextBox>& run(const float* prob, int width, int height) {
+        prob_ = prob;
+        width_ = width;
+        height_ = height;
+        binarizeMap();
+        cv::findContours(map_, contours_, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+        const int n = (int)contours_.size();
+        if (slots_.size() < (size_t)n) slots_.resize(n);
+        forEach(n, [this](int i) { findRect(contours_[i], slots_[i]); });
+        double scanned = 0;
+        for (int i = 0; i < n; i++) scanned += slots_[i].status == kPending ? slots_[i].area : 0;
+        use_tables_ = options_.tables == Tables::kAlways ||
+                      (options_.tables == Tables::kAuto && scanned > kTableScans * width * height);
+        if (use_tables_) buildTables();
+        forEach(n, [this](int i) {
+            if (slots_[i].status == kPending) slots_[i].status = scoreAndUnclip(slots_[i]);
+        });
+        boxes_.clear();
+        too_small_ = low_score_ = 0;
+        for (int i = 0; i < n; i++) {
+            if (slots_[i].status == kKept) boxes_.push_back(slots_[i].box);
+            too_small_ += slots_[i].status == kTooSmall;
+            low_score_ += slots_[i].status == kLowScore;
+        }
+        return boxes_;
+    }
+
+    // Of the last run: the binary map, whether the boxes were scored from
+    // tables, and the contours dropped for a side under min_size and for a
+    // score under box_threshold.
+    const cv::Mat& binary() const { return map_; }
+    bool usedTables() const { return use_tables_; }
+    int tooSmall() const { return too_small_; }
+    int lowScore() const { return low_score_; }
+
+    // get_box_score of the last run's map, from the tables if it built them.
+    float boxScore(const cv::Point2f rect[]) const {
+        int xmin, ymin, xmax, ymax;
+        box_bounds(rect, width_, height_, xmin, ymin, xmax, ymax);
+        if (!use_tables_) {
+            return get_box_score(prob_, rect, width_, height_, options_.score_threshold);
+        }
+        double sum = 0;
+        int num = 0;
+        if (xmin <= xmax && ymin <= ymax) {
+            const size_t stride = width_ + 1;
+            const size_t a = ymin * stride + xmin, b = ymin * stride + xmax + 1;
+            const size_t c = (ymax + 1) * stride + xmin, d = (ymax + 1) * stride + xmax + 1;
+            sum = sum_[d] - sum_[b] - sum_[c] + sum_[a];
+            num = count_[d] - count_[b] - count_[c] + count_[a];
+        }
+        return (float)sum / num;
+    }
+
+private:
+    enum Status { kPending, kKept, kTooSmall, kLowScore, kDropped };
+
+    struct Slot {
+        TextBox box;  // the rectangle's corners until it is unclipped
+        double area;  // of the rectangle's bounds
+        int status;
+    };
+
+    template <typename Fn>
+    void forEach(int n, const Fn& fn) {
+        if (pool_) {
+            pool_->parallelFor(n, fn);
+        } else {
+            for (int i = 0; i < n; i++) fn(i);
+        }
+    }
+
+    static const int kRowBlock = 16;
+
+    void binarizeMap() {
+        const int w = width_, h = height_;
+        map_.create(h, w, CV_8UC1);
+        const float t = float_above(options_.binary_threshold);
+        forEach((h + kRowBlock - 1) / kRowBlock, [&](int block) {
+            for (int y = block * kRowBlock; y < std::min(h, (block + 1) * kRowBlock); y++) {
+                binarize(prob_ + (size_t)y * w, map_.ptr<uchar>(y), w, t);
+            }
+        });
+    }
+
+    // The summed-area tables: entry (y + 1, x + 1) holds the sum and the count
+    // of the probabilities above score_threshold in rows 0..y, columns 0..x.
+    void buildTables() {
+        const int w = width_, h = height_;
+        const size_t stride = w + 1;
+        sum_.resize(stride * (h + 1));
+        count_.resize(stride * (h + 1));
+        std::fill(sum_.begin(), sum_.begin() + stride, 0.0);
+        std::fill(count_.begin(), count_.begin() + stride, 0);
+
+        const float t = options_.score_threshold;
+        forEach((h + kRowBlock - 1) / kRowBlock, [&](int block) {
+            for (int y = block * kRowBlock; y < std::min(h, (block + 1) * kRowBlock); y++) {
+                const float* p = prob_ + (size_t)y * w;
+                double* s = &sum_[(y + 1) * stride];
+                int* c = &count_[(y + 1) * stride];
+                double row_sum = 0;
+                int row_count = 0;
+                s[0] = 0;
+                c[0] = 0;
+                for (int x = 0; x < w; x++) {
+                    if (p[x] > t) {
+                        row_sum += p[x];
+                        row_count++;
+                    }
+                    s[x + 1] = row_sum;
+                    c[x + 1] = row_count;
+                }
+            }
+        });
+        const int col_block = 256;
+        forEach((int)((stride + col_block - 1) / col_block), [&](int block) {
+            const size_t x0 = (size_t)block * col_block, x1 = std::min(stride, x0 + col_block);
+            for (int y = 2; y <= h; y++) {
+                double* s = &sum_[y * stride];
+                int* c = &count_[y * stride];
+                const double* s_up = s - stride;
+                const int* c_up = c - stride;
+                for (size_t x = x0; x < x1; x++) {
+                    s[x] += s_up[x];
+                    c[x] += c_up[x];
+                }
+            }
+        });
+    }
+
+    // What dbnet.cpp's loop did with one contour, up to the score.
+    void findRect(const std::vector<cv::Point>& contour, Slot& slot) const {
+        cv::RotatedRect rotated_rect = cv::minAreaRect(contour);
+        if (!get_mini_boxes(rotated_rect, slot.box.corners, options_.min_size)) {
+            slot.status = kTooSmall;
+            return;
+        }
+        int xmin, ymin, xmax, ymax;
+        box_bounds(slot.box.corners, width_, height_, xmin, ymin, xmax, ymax);
+        slot.area = xmin <= xmax && ymin <= ymax ? (double)(xmax - xmin + 1) * (ymax - ymin + 1) : 0;
+        slot.status = kPending;
+    }
+
+    // And the rest.
+    int scoreAndUnclip(Slot& slot) const {
+        cv::Point2f rect[4];
+        TextBox& box = slot.box;
+        box.score = boxScore(box.corners);
+        if (box.score < options_.box_threshold) return kLowScore;
+
+        cv::RotatedRect expandbox = unclip::expand_box(box.corners, options_.expand_ratio);
+        expandbox.points(rect);
+        if (!get_mini_boxes(expandbox, rect, options_.min_size + 2)) return kDropped;
+        for (int k = 0; k < 4; k++) box.corners[k] = rect[k];
+        return kKept;
+    }
+
+    Options options_;
+    WorkerPool* pool_;
+    const float* prob_ = nullptr;
+    int width_ = 0, height_ = 0;
+    bool use_tables_ = false;
+    cv::Mat map_;
+    std::vector<double> sum_;
+    std::vector<int> count_;
+    std::vector<std::vector<cv::Point>> contours_;
+    std::vector<Slot> slots_;
+    std::vector<TextBox> boxes_;
+    int too_small_ = 0, low_score_ = 0;
+};
+
+}  // namespace dbpost
+
+#endif  // TRTX_DBNET_DB_POSTPROCESS_H_
@@ -0,0 +1,211 @@
+// Checks dbpost::PostProcessor against the post-processing loop dbnet.cpp ran
+// before it, on synthetic probability maps of three kinds: scenes, a few
+// dozen lines of text tilted up to 45 degrees; pages, rows of words over the
+// whole map; and pages photographed at 20 to 30 degrees, whose boxes' bounds
+// overlap many times over. All have faint blobs that score under
+// BOX_THRESHOLD, specks under BOX_MINI_SIZE, and boxes over the map's edges.
+// The binary maps and the boxes must be the same in every mode, the scores
+// within 1e-4. Then times both, the post-processor scanning boxes, with tables
+// and choosing, on one thread and on all of them, the best of three runs.
+// cv::findContours, the same in both, is timed apart.
+//   ./db_postprocess_bench [maps]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "db_postprocess.h"
+
+static const float SCORE_THRESHOLD = 0.3f;
+static const float BOX_THRESHOLD = 0.7f;
+static const float EXPANDRATIO = 1.5f;
+static const int BOX_MINI_SIZE = 5;
+
+// dbnet.cpp's loop, but for its prints and the scaling to the input image, with
+// get_box_score now clamping the bounds to the map
+static void reference(float* prob, int width, int height, cv::Mat& map, std::vector<dbpost::TextBox>& boxes) {
+    map = cv::Mat(height, width, CV_8UC1);
+    for (int h = 0; h < height; ++h) {
+        uchar* ptr = map.ptr<uchar>(h);
+        for (int w = 0; w < width; ++w) {
+            ptr[w] = (prob[h * width + w] > 0.3) ? 255 : 0;
+        }
+    }
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(map, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+    cv::Point2f rect[4];
+    boxes.clear();
+    for (int i = 0; i < (int)contours.size(); i++) {
+        cv::RotatedRect rotated_rect = cv::minAreaRect(contours[i]);
+        if (!dbpost::get_mini_boxes(rotated_rect, rect, BOX_MINI_SIZE)) continue;
+        float score = dbpost::get_box_score(prob, rect, width, height, SCORE_THRESHOLD);
+        if (score < BOX_THRESHOLD) continue;
+        cv::RotatedRect expandbox = unclip::expand_box(rect, EXPANDRATIO);
+        expandbox.points(rect);
+        if (!dbpost::get_mini_boxes(expandbox, rect, BOX_MINI_SIZE + 2)) continue;
+        dbpost::TextBox box;
+        for (int k = 0; k < 4; k++) box.corners[k] = rect[k];
+        box.score = score;
+        boxes.push_back(box);
+    }
+}
+
+// Both maps of the network's output, the probability map first.
+struct Map {
+    int width, height;
+    std::vector<float> prob;
+};
+
+// A bar of text: level inside, falling off over two pixels like the network's
+// soft edges.
+static void bar(Map& map, std::mt19937& rng, float cx, float cy, float len, float thick, float angle, float level) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const float c = std::cos(angle), s = std::sin(angle), r = len / 2 + thick;
+    for (int y = std::max(0, (int)(cy - r)); y < std::min(map.height, (int)(cy + r) + 1); y++) {
+        for (int x = std::max(0, (int)(cx - r)); x < std::min(map.width, (int)(cx + r) + 1); x++) {
+            const float along = std::abs((x - cx) * c + (y - cy) * s), across = std::abs((y - cy) * c - (x - cx) * s);
+            const float edge = std::min(len / 2 - along, thick / 2 - across);
+            float& p = map.prob[(size_t)y * map.width + x];
+            if (edge > -2) p = std::max(p, level * std::min(1.f, (edge + 2) / 3) + 0.05f * u(rng));
+        }
+    }
+}
+
+static Map background(int width, int height, std::mt19937& rng) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Map map{width, height, std::vector<float>((size_t)width * height * 2)};
+    for (size_t i = 0; i < map.prob.size(); i++) map.prob[i] = 0.2f * u(rng) * u(rng);
+    return map;
+}
+
+static Map scene(std::mt19937& rng) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Map map = background(1152, 640, rng);
+    for (int i = 0; i < 40; i++) {
+        const float x = 1152 * u(rng), y = 640 * u(rng), angle = (u(rng) - 0.5f) * 1.6f;
+        if (i % 8 == 0) {
+            bar(map, rng, x, y, 2 + 3 * u(rng), 2 + 2 * u(rng), angle, 0.9f);
+        } else if (i % 8 == 1) {
+            bar(map, rng, x, y, 40 + 150 * u(rng), 10 + 20 * u(rng), angle, 0.4f + 0.2f * u(rng));
+        } else {
+            bar(map, rng, x, y, 60 + 400 * u(rng), 16 + 30 * u(rng), angle, 0.8f + 0.15f * u(rng));
+        }
+    }
+    return map;
+}
+
+static Map page(std::mt19937& rng, bool tilted) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Map map = background(1024, 1440, rng);
+    const float skew = tilted ? 0.35f + 0.17f * u(rng) : (u(rng) - 0.5f) * 0.06f;
+    for (float y = tilted ? -600 : 10; y < 1440; y += 26) {
+        for (float x = 20 * u(rng) - 10; x < 1024;) {
+            const float len = tilted ? 60 + 400 * u(rng) : 15 + 120 * u(rng) * u(rng);
+            const int kind = rng() % 20;
+            const float cy = y + (x + len / 2) * skew;
+            if (kind == 0) {
+                bar(map, rng, x + len / 2, cy, 3, 3, skew, 0.9f);
+            } else {
+                bar(map, rng, x + len / 2, cy, len, 12, skew, kind == 1 ? 0.5f : 0.85f + 0.1f * u(rng));
+            }
+            x += len + 10 + 8 * u(rng);
+        }
+    }
+    return map;
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool same_boxes(const std::vector<dbpost::TextBox>& a, const std::vector<dbpost::TextBox>& b, double& worst_score) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (int k = 0; k < 4; k++) {
+            if (a[i].corners[k].x != b[i].corners[k].x || a[i].corners[k].y != b[i].corners[k].y) return false;
+        }
+        worst_score = std::max(worst_score, (double)std::abs(a[i].score - b[i].score));
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const int count = argc > 1 ? atoi(argv[1]) : 10;
+    std::mt19937 rng(0);
+    WorkerPool one(1), all(0);
+    bool ok = true;
+
+    const char* kinds[] = {"scenes", "pages", "tilted pages"};
+    for (int kind = 0; kind < 3; kind++) {
+        std::vector<Map> maps(count);
+        for (auto& m : maps) m = kind == 0 ? scene(rng) : page(rng, kind == 2);
+
+        const dbpost::Tables modes[] = {dbpost::Tables::kNever, dbpost::Tables::kAlways, dbpost::Tables::kAuto};
+        const char* names[] = {"scanning", "tables", "auto"};
+        double ref_ms = 0, contours_ms = 0, ms[3][2] = {};
+        double worst_score = 0;
+        size_t boxes = 0, small = 0, low = 0, tables = 0;
+        bool same = true;
+        cv::Mat ref_map;
+        std::vector<dbpost::TextBox> ref_boxes;
+        std::vector<std::vector<cv::Point>> contours;
+        for (Map& map : maps) {
+            float* prob = map.prob.data();
+            double best = HUGE_VAL, best_contours = HUGE_VAL;
+            for (int r = 0; r < 3; r++) {
+                double start = now_ms();
+                reference(prob, map.width, map.height, ref_map, ref_boxes);
+                best = std::min(best, now_ms() - start);
+                start = now_ms();
+                cv::findContours(ref_map, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+                best_contours = std::min(best_contours, now_ms() - start);
+            }
+            ref_ms += best;
+            contours_ms += best_contours;
+            for (int m = 0; m < 3; m++) {
+                dbpost::Options options;
+                options.score_threshold = SCORE_THRESHOLD;
+                options.box_threshold = BOX_THRESHOLD;
+                options.expand_ratio = EXPANDRATIO;
+                options.min_size = BOX_MINI_SIZE;
+                options.tables = modes[m];
+                for (int t = 0; t < 2; t++) {
+                    dbpost::PostProcessor post(options, t ? &all : &one);
+                    best = HUGE_VAL;
+                    for (int r = 0; r < 3; r++) {
+                        const double start = now_ms();
+                        post.run(prob, map.width, map.height);
+                        best = std::min(best, now_ms() - start);
+                    }
+                    ms[m][t] += best;
+                    const std::vector<dbpost::TextBox>& found = post.run(prob, map.width, map.height);
+                    for (int y = 0; y < map.height; y++) {
+                        same = same && memcmp(ref_map.ptr<uchar>(y), post.binary().ptr<uchar>(y), map.width) == 0;
+                    }
+                    same = same && same_boxes(found, ref_boxes, worst_score);
+                    if (m == 2 && t == 1) {
+                        boxes += found.size();
+                        small += post.tooSmall();
+                        low += post.lowScore();
+                        tables += post.usedTables();
+                    }
+                }
+            }
+        }
+        same = same && worst_score < 1e-4;
+        ok = ok && same;
+        std::cout << count << " " << kinds[kind] << " of " << maps[0].width << "x" << maps[0].height
+                  << ": " << (double)boxes / count << " boxes per map, " << (double)small / count << " too small, "
+                  << (double)low / count << " low score, tables chosen for " << tables << ", scores off by max "
+                  << worst_score << (same ? "" : "  MISMATCH") << std::endl;
+        std::cout << "  findContours " << contours_ms / count << "ms per map, the rest of the serial loop "
+                  << (ref_ms - contours_ms) / count << "ms" << std::endl;
+        for (int m = 0; m < 3; m++) {
+            std::cout << "  PostProcessor " << names[m] << ": 1 thread " << (ms[m][0] - contours_ms) / count << "ms, "
+                      << all.size() << " threads " << (ms[m][1] - contours_ms) / count << "ms" << std::endl;
+        }
+    }
+    std::cout << (ok ? "same boxes" : "MISMATCH with the serial loop") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -4,7 +4,10 @@
 #include "logging.h"
 #include "common.hpp"
 #include <math.h>
-#include "clipper.hpp"
+#include "db_postprocess.h"
+#include "planar_normalize.h"
+#include "result_writer.h"
+#include "worker_pool.h"
 
 #define USE_FP16  // comment out this if want to use FP32
 #define DEVICE 0  // GPU id
@@ -12,6 +15,10 @@
 #define BOX_MINI_SIZE 5
 #define SCORE_THRESHOLD 0.3
 #define BOX_THRESHOLD 0.7
+#define HOST_THREADS 0  // threads normalizing the input and scoring and unclipping the boxes, 0 for all the cores
+#define WRITER_THREADS 2  // threads drawing, encoding and writing the output images, 0 for half the cores
+#define DRAW_RESULTS true  // false: write no images, only RESULTS_FILE
+#define RESULTS_FILE ""  // JSON lines file of the boxes of every image, "" for none
 
 static const int SHORT_INPUT = 640;
 static const int MAX_INPUT_SIZE = 1440; // 32x
@@ -22,37 +29,6 @@ const char* INPUT_BLOB_NAME = "data";
 const char* OUTPUT_BLOB_NAME = "out";
 static Logger gLogger;
 
-cv::RotatedRect expandBox(cv::Point2f temp[], float ratio)
-{
-    ClipperLib::Path path = {
-        {ClipperLib::cInt(temp[0].x), ClipperLib::cInt(temp[0].y)},
-        {ClipperLib::cInt(temp[1].x), ClipperLib::cInt(temp[1].y)},
-        {ClipperLib::cInt(temp[2].x), ClipperLib::cInt(temp[2].y)},
-        {ClipperLib::cInt(temp[3].x), ClipperLib::cInt(temp[3].y)}};
-    double area = ClipperLib::Area(path);
-    double distance;
-    double length = 0.0;
-    for (int i = 0; i < 4; i++) {
-        length = length + sqrtf(powf((temp[i].x - temp[(i + 1) % 4].x), 2) +
-                                powf((temp[i].y - temp[(i + 1) % 4].y), 2));
-    }
-
-    distance = area * ratio / length;
-
-    ClipperLib::ClipperOffset offset;
-    offset.AddPath(path, ClipperLib::JoinType::jtRound,
-                   ClipperLib::EndType::etClosedPolygon);
-    ClipperLib::Paths paths;
-    offset.Execute(paths, distance);
-    
-    std::vector<cv::Point> contour;
-    for (int i = 0; i < paths[0].size(); i++) {
-        contour.emplace_back(paths[0][i].X, paths[0][i].Y);
-    }
-    offset.Clear();
-    return cv::minAreaRect(contour);
-}
-
 float paddimg(cv::Mat& In_Out_img, int shortsize = 960) {
     int w = In_Out_img.cols;
     int h = In_Out_img.rows;
@@ -312,91 +288,6 @@ void doInference(IExecutionContext& context, float* input, float* output, int h_
     CHECK(cudaFree(buffers[outputIndex]));
 }
 
-bool get_mini_boxes(cv::RotatedRect& rotated_rect, cv::Point2f rect[],
-                    int min_size)
-{
-
-    cv::Point2f temp_rect[4];
-    rotated_rect.points(temp_rect);
-    for (int i = 0; i < 4; i++) {
-        for (int j = i + 1; j < 4; j++) {
-            if (temp_rect[i].x > temp_rect[j].x) {
-                cv::Point2f temp;
-                temp = temp_rect[i];
-                temp_rect[i] = temp_rect[j];
-                temp_rect[j] = temp;
-            }
-        }
-    }
-    int index0 = 0;
-    int index1 = 1;
-    int index2 = 2;
-    int index3 = 3;
-    if (temp_rect[1].y > temp_rect[0].y) {
-        index0 = 0;
-        index3 = 1;
-    } else {
-        index0 = 1;
-        index3 = 0;
-    }
-    if (temp_rect[3].y > temp_rect[2].y) {
-        index1 = 2;
-        index2 = 3;
-    } else {
-        index1 = 3;
-        index2 = 2;
-    }   
-
-    rect[0] = temp_rect[index0];  // Left top coordinate
-    rect[1] = temp_rect[index1];  // Left bottom coordinate
-    rect[2] = temp_rect[index2];  // Right bottom coordinate
-    rect[3] = temp_rect[index3];  // Right top coordinate
-
-    if (rotated_rect.size.width < min_size ||
-        rotated_rect.size.height < min_size) {
-        return false;
-    } else {
-        return true;
-    }
-}
-
-float get_box_score(float* map, cv::Point2f rect[], int width, int height,
-                    float threshold)
-{
-
-    int xmin = width - 1;
-    int ymin = height - 1;
-    int xmax = 0;
-    int ymax = 0;
-
-    for (int j = 0; j < 4; j++) {
-        if (rect[j].x < xmin) {
-            xmin = rect[j].x;
-        }
-        if (rect[j].y < ymin) {
-            ymin = rect[j].y;
-        }
-        if (rect[j].x > xmax) {
-            xmax = rect[j].x;
-        }
-        if (rect[j].y > ymax) {
-            ymax = rect[j].y;
-        }
-    }
-    float sum = 0;
-    int num = 0;
-    for (int i = ymin; i <= ymax; i++) {
-        for (int j = xmin; j <= xmax; j++) {
-            if (map[i * width + j] > threshold) {
-                sum = sum + map[i * width + j];
-                num++;
-            }
-        }
-    }
-
-    return sum / num;
-}
-
 int main(int argc, char** argv) {
     cudaSetDevice(DEVICE);
     // create a model using the API directly and serialize it to a stream
@@ -450,9 +341,25 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    // icdar2015.yaml Hyperparameter
-    std::vector<float> mean_value{ 0.406, 0.456, 0.485 };  // BGR
-    std::vector<float> std_value{ 0.225, 0.224, 0.229 };
+    // the boxes are drawn and the images written on the writer's threads
+    ResultWriter::Options writer_options;
+    writer_options.threads = WRITER_THREADS;
+    writer_options.draw = DRAW_RESULTS;
+    writer_options.results = RESULTS_FILE;
+    writer_options.box_color = cv::Scalar(0, 0, 255);
+    writer_options.labels = false;
+    writer_options.box_rect = ResultWriter::BoxRect::kCorners;
+    ResultWriter writer(writer_options);
+
+    // normalize, then binarize, score and unclip, see planar_normalize.h and db_postprocess.h
+    WorkerPool host_pool(HOST_THREADS);
+    dbpost::Options post_options;
+    post_options.binary_threshold = SCORE_THRESHOLD;
+    post_options.score_threshold = SCORE_THRESHOLD;
+    post_options.box_threshold = BOX_THRESHOLD;
+    post_options.expand_ratio = EXPANDRATIO;
+    post_options.min_size = BOX_MINI_SIZE;
+    dbpost::PostProcessor post(post_options, &host_pool);
 
     int fcount = 0;
 
@@ -460,25 +367,22 @@ int main(int argc, char** argv) {
         fcount++;
         std::cout << fcount << "  " << f << std::endl;
         cv::Mat pr_img = cv::imread(std::string(argv[2]) + "/" + f);
-        cv::Mat src_img = pr_img.clone();
         if (pr_img.empty()) continue;
+        // paddimg resizes pr_img in place, the job draws on the image as read
+        cv::Mat src_img = writer.drawing() ? pr_img.clone() : cv::Mat();
+        const cv::Size src_size = pr_img.size();
         float scale = paddimg(pr_img, SHORT_INPUT); // resize the image
         std::cout << "letterbox shape: " << pr_img.cols << ", " << pr_img.rows << std::endl;
         if (pr_img.cols < MIN_INPUT_SIZE || pr_img.rows < MIN_INPUT_SIZE) continue;
+        ResultWriter::Job& job = writer.acquire();
+        job.name = "_" + f;
+        job.image = src_img;
         float* data = new float[3 * pr_img.rows * pr_img.cols];
 
         auto start = std::chrono::system_clock::now();
-        int i = 0;
-        for (int row = 0; row < pr_img.rows; ++row) {
-            uchar* uc_pixel = pr_img.data + row * pr_img.step;
-            for (int col = 0; col < pr_img.cols; ++col) {
-                data[i] = (uc_pixel[2] / 255.0 - mean_value[2]) / std_value[2];
-                data[i + pr_img.rows * pr_img.cols] = (uc_pixel[1] / 255.0 - mean_value[1]) / std_value[1];
-                data[i + 2 * pr_img.rows * pr_img.cols] = (uc_pixel[0] / 255.0 - mean_value[0]) / std_value[0];
-                uc_pixel += 3;
-                ++i;
-            }
-        }
+        // icdar2015.yaml Hyperparameter: ImageNet's mean and std, RGB planes
+        planar::normalize<planar::ImageNet, planar::Order::kRgb>(pr_img.data, pr_img.step, pr_img.cols, pr_img.rows,
+                                                                 data, 0, &host_pool);
         auto end = std::chrono::system_clock::now();
         std::cout << "pre time:"<< std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
 
@@ -490,59 +394,25 @@ int main(int argc, char** argv) {
         std::cout << "detect time:"<< std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
 
         // prob shape is 2*640*640, get the first one
-        cv::Mat map = cv::Mat::zeros(cv::Size(pr_img.cols, pr_img.rows), CV_8UC1);
-        for (int h = 0; h < pr_img.rows; ++h) {
-            uchar *ptr = map.ptr(h);
-            for (int w = 0; w < pr_img.cols; ++w) {
-                ptr[w] = (prob[h * pr_img.cols + w] > 0.3) ? 255 : 0;
-            }
-        }
-
-        // Extracting minimum circumscribed rectangle
-        std::vector<std::vector<cv::Point>> contours;
-        std::vector<cv::Vec4i> hierarcy;
-        cv::findContours(map, contours, hierarcy, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
-
-        std::vector<cv::Rect> boundRect(contours.size());
-        std::vector<cv::RotatedRect> box(contours.size());
-        cv::Point2f rect[4];
-        cv::Point2f order_rect[4];
-
-        for (int i = 0; i < contours.size(); i++) {
-            cv::RotatedRect rotated_rect = cv::minAreaRect(cv::Mat(contours[i]));
-            if (!get_mini_boxes(rotated_rect, rect, BOX_MINI_SIZE)) {
-                std::cout << "box too small" <<  std::endl;
-                continue;
-            }
-
-            // drop low score boxes
-            float score = get_box_score(prob, rect, pr_img.cols, pr_img.rows,
-                                        SCORE_THRESHOLD);
-            if (score < BOX_THRESHOLD) {
-                std::cout << "score too low =  " << score << ", threshold = " << BOX_THRESHOLD <<  std::endl;
-                continue;
-            }
-
-            // Scaling the predict boxes depend on EXPANDRATIO
-            cv::RotatedRect expandbox = expandBox(rect, EXPANDRATIO);
-            expandbox.points(rect);
-            if (!get_mini_boxes(expandbox, rect, BOX_MINI_SIZE + 2)) {  
-                continue;
-            }
+        start = std::chrono::system_clock::now();
+        const std::vector<dbpost::TextBox>& boxes = post.run(prob, pr_img.cols, pr_img.rows);
+        end = std::chrono::system_clock::now();
+        std::cout << "post time:"<< std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms, "
+                  << boxes.size() << " boxes, " << post.tooSmall() << " too small, " << post.lowScore()
+                  << " scored under " << BOX_THRESHOLD << std::endl;
 
+        for (const dbpost::TextBox& box : boxes) {
             // Restore the coordinates to the original image
+            cv::Point2f order_rect[4];
             for (int k = 0; k < 4; k++) {
-                order_rect[k] = rect[k];
-                order_rect[k].x = int(order_rect[k].x / pr_img.cols * src_img.cols);
-                order_rect[k].y = int(order_rect[k].y / pr_img.rows * src_img.rows);
+                order_rect[k].x = int(box.corners[k].x / pr_img.cols * src_size.width);
+                order_rect[k].y = int(box.corners[k].y / pr_img.rows * src_size.height);
             }
-            
-            cv::rectangle(src_img, cv::Point(order_rect[0].x,order_rect[0].y), cv::Point(order_rect[2].x,order_rect[2].y), cv::Scalar(0, 0, 255), 2, 8);
-            //std::cout << "After LT =  " << order_rect[0] << ", After RD = " << order_rect[2] <<  std::endl;            
+
+            job.detections.push_back(ResultWriter::Detection{order_rect[0].x, order_rect[0].y, order_rect[2].x, order_rect[2].y, box.score, 0});
         }
 
-        cv::imwrite("_" + f, src_img);
-        std::cout << "write image done." << std::endl;
+        writer.submit(job);
         //cv::waitKey(0);
 
         delete prob;
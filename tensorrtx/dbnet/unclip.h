@@ -0,0 +1,121 @@
+#ifndef TRTX_DBNET_UNCLIP_H_
+#define TRTX_DBNET_UNCLIP_H_
+
+#include <cmath>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "clipper.hpp"
+
+// Unclip of the DBNet text boxes: the shrunk box found on the probability map
+// is offset outwards by area * ratio / perimeter, with round joins, and the
+// minimum area rectangle of the result is the text box.
+//
+// The box is always the four corners of a rotated rectangle, so rather than
+// building a ClipperLib::Path and running a general ClipperOffset (edges, joins
+// and output records on the heap, a union to clean the result up), a convex
+// quad is offset analytically. A convex polygon offset by d with round joins
+// is the polygon grown by a disk of radius d: its width in every direction is
+// the polygon's plus 2d, and its minimum area rectangle lies along one of the
+// polygon's edges, like the polygon's own. The rectangle is then the polygon's
+// bounding rectangle along its best edge, grown by d on every side. Clipper's
+// result differs only by its arcs being polygons with integer vertices, less
+// than a pixel. Quads that are not convex, or turn the other way (the offset
+// then shrinks), go through ClipperOffset as before.
+//
+//   cv::RotatedRect box = unclip::expand_box(corners, ratio);
+
+namespace unclip {
+
+// The offset distance, as the samples computed it: the area of the corners
+// truncated to integers (ClipperLib::Area), the perimeter of the float corners.
+inline double distance(const cv::Point2f pts[4], float ratio, double& area) {
+    double a = 0;
+    for (int i = 0, j = 3; i < 4; j = i++) {
+        const double xi = (double)ClipperLib::cInt(pts[i].x), yi = (double)ClipperLib::cInt(pts[i].y);
+        const double xj = (double)ClipperLib::cInt(pts[j].x), yj = (double)ClipperLib::cInt(pts[j].y);
+        a += (xj + xi) * (yj - yi);
+    }
+    area = -a * 0.5;
+    double length = 0.0;
+    for (int i = 0; i < 4; i++) {
+        length = length + sqrtf(powf((pts[i].x - pts[(i + 1) % 4].x), 2) +
+                                powf((pts[i].y - pts[(i + 1) % 4].y), 2));
+    }
+    return area * ratio / length;
+}
+
+// The general path: ClipperOffset with round joins, for any quad. Each thread
+// keeps its ClipperOffset and paths, which keep their buffers between boxes.
+inline cv::RotatedRect expand_box_clipper(const cv::Point2f pts[4], float ratio) {
+    thread_local ClipperLib::ClipperOffset offset;
+    thread_local ClipperLib::Path path(4);
+    thread_local ClipperLib::Paths paths;
+    thread_local std::vector<cv::Point> contour;
+    for (int i = 0; i < 4; i++) {
+        path[i] = ClipperLib::IntPoint(ClipperLib::cInt(pts[i].x), ClipperLib::cInt(pts[i].y));
+    }
+    double area;
+    const double d = distance(pts, ratio, area);
+
+    offset.Clear();
+    offset.AddPath(path, ClipperLib::JoinType::jtRound,
+                   ClipperLib::EndType::etClosedPolygon);
+    offset.Execute(paths, d);
+
+    contour.clear();
+    for (size_t i = 0; !paths.empty() && i < paths[0].size(); i++) {
+        contour.emplace_back(paths[0][i].X, paths[0][i].Y);
+    }
+    return cv::minAreaRect(contour);
+}
+
+// The fast path: false, leaving box as is, unless the integer quad is strictly
+// convex and turns the way that grows it.
+inline bool expand_box_convex(const cv::Point2f pts[4], float ratio, cv::RotatedRect& box) {
+    double area;
+    const double d = distance(pts, ratio, area);
+    if (!(area > 0) || !(d > 0)) return false;
+    double x[4], y[4];
+    for (int i = 0; i < 4; i++) {
+        x[i] = (double)ClipperLib::cInt(pts[i].x);
+        y[i] = (double)ClipperLib::cInt(pts[i].y);
+    }
+    // every corner turns the same way as the area, no two corners coincide
+    for (int i = 0; i < 4; i++) {
+        const int j = (i + 1) % 4, k = (i + 2) % 4;
+        if ((x[j] - x[i]) * (y[k] - y[j]) - (y[j] - y[i]) * (x[k] - x[j]) <= 0) return false;
+    }
+    double best = -1;
+    for (int i = 0; i < 4; i++) {
+        const int j = (i + 1) % 4;
+        const double len = std::sqrt((x[j] - x[i]) * (x[j] - x[i]) + (y[j] - y[i]) * (y[j] - y[i]));
+        const double ux = (x[j] - x[i]) / len, uy = (y[j] - y[i]) / len;
+        // extent along the edge (s) and across it (t)
+        double s0 = HUGE_VAL, s1 = -HUGE_VAL, t0 = HUGE_VAL, t1 = -HUGE_VAL;
+        for (int k = 0; k < 4; k++) {
+            const double s = x[k] * ux + y[k] * uy, t = y[k] * ux - x[k] * uy;
+            s0 = std::min(s0, s);
+            s1 = std::max(s1, s);
+            t0 = std::min(t0, t);
+            t1 = std::max(t1, t);
+        }
+        const double w = s1 - s0 + 2 * d, h = t1 - t0 + 2 * d;
+        if (best >= 0 && w * h >= best) continue;
+        best = w * h;
+        const double sc = (s0 + s1) / 2, tc = (t0 + t1) / 2;
+        box = cv::RotatedRect(cv::Point2f((float)(sc * ux - tc * uy), (float)(sc * uy + tc * ux)),
+                              cv::Size2f((float)w, (float)h), (float)(std::atan2(uy, ux) * 180 / CV_PI));
+    }
+    return true;
+}
+
+// The unclipped box of a quad, analytically when it is convex.
+inline cv::RotatedRect expand_box(const cv::Point2f pts[4], float ratio) {
+    cv::RotatedRect box;
+    if (expand_box_convex(pts, ratio, box)) return box;
+    return expand_box_clipper(pts, ratio);
+}
+
+}  // namespace unclip
+
+#endif  // TRTX_DBNET_UNCLIP_H_
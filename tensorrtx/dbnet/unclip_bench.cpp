@@ -0,0 +1,154 @@
+// Checks the analytic unclip of unclip.h against ClipperOffset + minAreaRect
+// on random quads: the corners of rotated rectangles, ordered as
+// get_mini_boxes orders them, then the same perturbed into general convex
+// quads, then non-convex ones, which must take the Clipper path. Then times
+// both on synthetic document pages of a few thousand text boxes, and counts
+// the heap allocations of the fast path.
+//   ./unclip_bench [boxes per page] [pages]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include "unclip.h"
+
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const float EXPANDRATIO = 1.5f;
+
+// get_mini_boxes of dbnet.cpp: left top, right top, right bottom, left bottom
+static void order_corners(const cv::RotatedRect& r, cv::Point2f rect[4]) {
+    cv::Point2f t[4];
+    r.points(t);
+    for (int i = 0; i < 4; i++) {
+        for (int j = i + 1; j < 4; j++) {
+            if (t[i].x > t[j].x) std::swap(t[i], t[j]);
+        }
+    }
+    const int i0 = t[1].y > t[0].y ? 0 : 1, i3 = 1 - i0;
+    const int i1 = t[3].y > t[2].y ? 2 : 3, i2 = 5 - i1;
+    rect[0] = t[i0];
+    rect[1] = t[i1];
+    rect[2] = t[i2];
+    rect[3] = t[i3];
+}
+
+// Largest distance from a corner of one box to the nearest corner of the other.
+static float corner_distance(const cv::RotatedRect& a, const cv::RotatedRect& b) {
+    cv::Point2f pa[4], pb[4];
+    a.points(pa);
+    b.points(pb);
+    float worst = 0;
+    for (int i = 0; i < 4; i++) {
+        float nearest = HUGE_VALF;
+        for (int j = 0; j < 4; j++) nearest = std::min(nearest, std::hypot(pa[i].x - pb[j].x, pa[i].y - pb[j].y));
+        worst = std::max(worst, nearest);
+    }
+    return worst;
+}
+
+static cv::RotatedRect random_box(std::mt19937& rng, float max_w, float max_h) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    return cv::RotatedRect(cv::Point2f(50 + 1900 * u(rng), 50 + 1900 * u(rng)),
+                           cv::Size2f(5 + max_w * u(rng), 5 + max_h * u(rng)), -90 + 180 * u(rng));
+}
+
+static bool check(int count) {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const char* kinds[] = {"rotated rectangles", "convex quads", "non-convex quads"};
+    bool ok = true;
+    for (int kind = 0; kind < 3; kind++) {
+        int fast = 0;
+        double sum = 0, worst_area = 0;
+        float worst = 0;
+        for (int n = 0; n < count; n++) {
+            cv::Point2f q[4];
+            const cv::RotatedRect r = random_box(rng, 400, 120);
+            order_corners(r, q);
+            const float w = std::min(r.size.width, r.size.height);
+            if (kind == 1) {
+                // each corner moved by up to a tenth of the short side
+                for (int k = 0; k < 4; k++) {
+                    q[k].x += (u(rng) - 0.5f) * 0.2f * w;
+                    q[k].y += (u(rng) - 0.5f) * 0.2f * w;
+                }
+            } else if (kind == 2) {
+                // a corner pulled in past the diagonal of its neighbours
+                const int k = rng() % 4;
+                const cv::Point2f& a = q[(k + 1) % 4];
+                const cv::Point2f& b = q[(k + 3) % 4];
+                q[k] = cv::Point2f(0.5f * (a.x + b.x) + 0.4f * ((a.x + b.x) / 2 - q[k].x),
+                                   0.5f * (a.y + b.y) + 0.4f * ((a.y + b.y) / 2 - q[k].y));
+            }
+            cv::RotatedRect analytic;
+            if (!unclip::expand_box_convex(q, EXPANDRATIO, analytic)) continue;
+            fast++;
+            const cv::RotatedRect reference = unclip::expand_box_clipper(q, EXPANDRATIO);
+            const float d = corner_distance(analytic, reference);
+            sum += d;
+            worst = std::max(worst, d);
+            const double area = (double)analytic.size.width * analytic.size.height;
+            const double ref_area = (double)reference.size.width * reference.size.height;
+            // area difference over the half perimeter: how far the sides are apart on average
+            worst_area = std::max(worst_area, std::abs(area - ref_area) / (reference.size.width + reference.size.height));
+        }
+        // Clipper's arcs are polygons with integer vertices, a little inside the
+        // true arcs, which can tilt its rectangle a bit. For general quads two
+        // edges can give rectangles of about the same area, and the two ways
+        // may then pick different ones: only their sides are compared.
+        bool pass = fast == 0;
+        if (kind == 0) pass = fast == count && worst < 3.f;
+        if (kind == 1) pass = fast > count * 9 / 10 && worst_area < 2;
+        ok = ok && pass;
+        std::cout << kinds[kind] << ": " << fast << " of " << count << " analytic";
+        if (fast) {
+            std::cout << ", corners off Clipper's by mean " << sum / fast << "px, max " << worst
+                      << "px, sides by max " << worst_area << "px";
+        }
+        std::cout << (pass ? "" : "  FAIL") << std::endl;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const int boxes = argc > 1 ? atoi(argv[1]) : 4000;
+    const int pages = argc > 2 ? atoi(argv[2]) : 10;
+    if (!check(100000)) return 1;
+
+    // pages of text lines: mostly short words and lines, a little skew
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<cv::Point2f> corners((size_t)boxes * pages * 4);
+    for (int i = 0; i < boxes * pages; i++) {
+        const cv::RotatedRect r(cv::Point2f(50 + 1900 * u(rng), 50 + 2600 * u(rng)),
+                                cv::Size2f(12 + 300 * u(rng) * u(rng), 8 + 24 * u(rng)), -5 + 10 * u(rng));
+        order_corners(r, &corners[(size_t)i * 4]);
+    }
+    float sink = 0;
+    auto time = [&](cv::RotatedRect (*expand)(const cv::Point2f*, float)) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < boxes * pages; i++) sink += expand(&corners[(size_t)i * 4], EXPANDRATIO).size.width;
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / pages;
+    };
+    const double clipper_ms = time(unclip::expand_box_clipper);
+    const size_t before = g_allocations;
+    const double fast_ms = time(unclip::expand_box);
+    const size_t allocations = g_allocations - before;
+    std::cout << pages << " pages of " << boxes << " text boxes: ClipperOffset " << clipper_ms << "ms per page, analytic "
+              << fast_ms << "ms per page (" << clipper_ms / fast_ms << "x), " << allocations << " allocations"
+              << (sink == 0 ? " " : "") << std::endl;
+    return allocations == 0 ? 0 : 1;
+}
@@ -79,15 +79,7 @@ bool Int8EntropyCalibrator2::getBatch(void* bindings[], const char* names[], int
             std::cerr << "Fatal error: image cannot open!" << std::endl;
             return false;
         }
-        preprocessImg(temp, input_w_, input_h_);
-        for (int c = 0; c < 3; c++) {
-            for (int h = 0; h < input_h_; h++) {
-                for (int w = 0; w < input_w_; w++) {
-                    input_imgs_[(i-img_idx_)*input_w_*input_h_*3 +
-                        c * input_h_ * input_w_ + h * input_w_ + w] = temp.at<cv::Vec3f>(h, w)[c];
-                }
-            }
-        }
+        preprocessImg(temp, input_h_, input_w_, input_imgs_.data(), i - img_idx_);
     }
     img_idx_ += batchsize_;
 
@@ -11,6 +11,7 @@
 #include "./logging.h"
 #include <NvInfer.h>
 #include <opencv2/opencv.hpp>
+#include "planar_normalize.h"
 
 static Logger gLogger;
 
@@ -78,14 +79,12 @@ static inline int read_files_in_dir(const char *p_dir_name, std::vector<std::str
     return 0;
 }
 
-void preprocessImg(cv::Mat& img, int newh, int neww) {
-    // convert to rgb
-    cv::cvtColor(img, img, cv::COLOR_BGR2RGB);
-    cv::resize(img, img, cv::Size(neww, newh));
-    img.convertTo(img, CV_32FC3);
-    img /= 255;
-    img -= cv::Scalar(0.485, 0.456, 0.406);
-    img /= cv::Scalar(0.229, 0.224, 0.225);
+// Resizes the BGR image img to neww x newh and writes it normalized with
+// ImageNet's mean and std, as RGB planes, into slot of batch.
+void preprocessImg(const cv::Mat& img, int newh, int neww, float* batch, int slot, WorkerPool* pool = nullptr) {
+    cv::Mat resized;
+    cv::resize(img, resized, cv::Size(neww, newh));
+    planar::normalize<planar::ImageNet, planar::Order::kRgb>(resized.data, resized.step, neww, newh, batch, slot, pool);
 }
 
 #ifndef CUDA_CHECK
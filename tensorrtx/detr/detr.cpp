@@ -4,9 +4,15 @@
 #include "./logging.h"
 #include "backbone.hpp"
 #include "calibrator.hpp"
+#include "image_loader.h"
+#include "result_writer.h"
 
 #define DEVICE 0
 #define BATCH_SIZE 1
+#define NORMALIZE_THREADS 0  // threads normalizing the input images, 0 for all the cores
+#define WRITER_THREADS 2  // threads drawing, encoding and writing the output images, 0 for half the cores
+#define DRAW_RESULTS true  // false: write no images, only RESULTS_FILE
+#define RESULTS_FILE ""  // JSON lines file of the boxes of every image, "" for none
 
 // 1 / math.sqrt(head_dim) https://github.com/pytorch/pytorch/blob/master/torch/csrc/api/include/torch/nn/functional/activation.h#623
 static const float SCALING = 0.17677669529663687;
@@ -739,25 +745,25 @@ int main(int argc, char** argv) {
     std::vector<void*> buffers = { data_d, scores_d, boxes_d };
     std::vector<float*> outputs = {scores_h.data(), boxes_h.data()};
 
-    int fcount = 0;
-    int fileLen = fileList.size();
-    for (int f = 0; f < fileLen; f++) {
-        fcount++;
-        if (fcount < BATCH_SIZE && f + 1 != fileLen) continue;
+    // the next batches are read and decoded while this one runs
+    ImageLoader::Options loaderOptions;
+    loaderOptions.batch_size = BATCH_SIZE;
+    ImageLoader loader(imgDir, fileList, loaderOptions);
+    ResultWriter::Options writerOptions;
+    writerOptions.threads = WRITER_THREADS;
+    writerOptions.draw = DRAW_RESULTS;
+    writerOptions.results = RESULTS_FILE;
+    writerOptions.box_rect = ResultWriter::BoxRect::kTruncated;
+    ResultWriter writer(writerOptions);
+    WorkerPool normalizePool(NORMALIZE_THREADS);
+    assert(INPUT_H * INPUT_W * 3 == input_size);
+    while (const ImageLoader::Batch* batch = loader.next()) {
+        const int fcount = batch->size;
 
         for (int b = 0; b < fcount; b++) {
-            cv::Mat img = cv::imread(imgDir + "/" + fileList[f - fcount + 1 + b]);
-            if (img.empty()) continue;
-            preprocessImg(img, INPUT_H, INPUT_W);
-            assert(img.cols * img.rows * 3 == input_size);
-            for (int c = 0; c < 3; c++) {
-                for (int h = 0; h < img.rows; h++) {
-                    for (int w = 0; w < img.cols; w++) {
-                        data[b * input_size +
-                        c * img.rows * img.cols + h * img.cols + w] = img.at<cv::Vec3f>(h, w)[c];
-                    }
-                }
-            }
+            if (batch->images[b].empty()) continue;
+            // resized and normalized straight into slot b, the loader's image is kept for drawing
+            preprocessImg(batch->images[b], INPUT_H, INPUT_W, data.data(), b, &normalizePool);
         }
 
         // Run inference
@@ -769,8 +775,15 @@ int main(int argc, char** argv) {
         std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
 
         for (int b = 0; b < fcount; b++) {
-            cv::Mat img = cv::imread(imgDir + "/" + fileList[f - fcount + 1 + b]);
-            for (int i = 0; i < scores_h.size(); i += NUM_CLASS) {
+            const cv::Mat& img = batch->images[b];
+            if (img.empty()) continue;
+            // drawn and written on the writer's threads, the loader's image copied as it gets reused
+            ResultWriter::Job& job = writer.acquire();
+            job.name = "_" + batch->names[b];
+            if (writer.drawing()) img.copyTo(job.image);
+            // the queries of image b
+            const int first = b * NUM_QUERIES * NUM_CLASS;
+            for (int i = first; i < first + NUM_QUERIES * NUM_CLASS; i += NUM_CLASS) {
                 int label = -1;
                 float score = -1;
                 for (int j = i; j < i + NUM_CLASS; j++) {
@@ -790,16 +803,13 @@ int main(int argc, char** argv) {
                     float y1 = (cy - h / 2.0) * img.rows;
                     float x2 = (cx + w / 2.0) * img.cols;
                     float y2 = (cy + h / 2.0) * img.rows;
-                    cv::Rect r(x1, y1, x2 - x1, y2 - y1);
-                    cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
-                    cv::putText(img, std::to_string(label), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2,
-                    cv::Scalar(0xFF, 0xFF, 0xFF), 2);
+                    job.detections.push_back(ResultWriter::Detection{x1, y1, x2, y2, score, label});
                 }
             }
-            cv::imwrite("_" + fileList[f - fcount + 1 + b], img);
+            writer.submit(job);
         }
-        fcount = 0;
     }
+    writer.finish();
 
     cudaStreamDestroy(stream);
     CUDA_CHECK(cudaFree(data_d));
@@ -6,11 +6,13 @@
 #include <chrono>
 #include "common.hpp"
 #include "logging.h"
+#include "result_writer.h"
 
 static Logger gLogger;
 #define USE_FP32
 #define DEVICE 0 // GPU id
 #define BATCH_SIZE 1
+#define WRITER_THREADS 2 // threads coloring, encoding and writing the output images, 0 for half the cores
 
 const char *INPUT_BLOB_NAME = "data";
 const char *OUTPUT_BLOB_NAME = "output";
@@ -423,6 +425,26 @@ void doInference(IExecutionContext &context, cudaStream_t &stream, void **buffer
     cudaDeviceSynchronize();
 }
 
+// False colors of the class map in job.extra, on the writer's threads: the map
+// itself when job.image is that class map, else blended into job.image.
+static void colorize(ResultWriter::Job &job)
+{
+    cv::Mat im_color;
+    cv::cvtColor(job.extra, im_color, cv::COLOR_GRAY2RGB);
+    cv::Mat lut = createLTU(NUM_CLASSES);
+    cv::LUT(im_color, lut, im_color);
+    // false color
+    cv::cvtColor(im_color, im_color, cv::COLOR_RGB2GRAY);
+    cv::applyColorMap(im_color, im_color, cv::COLORMAP_HOT);
+    if (job.image.type() == CV_8UC1)
+    {
+        job.image = im_color;
+        return;
+    }
+    //fusion
+    cv::addWeighted(job.image, 1, im_color, 0.8, 1, job.image);
+}
+
 int main(int argc, char **argv)
 {
     cudaSetDevice(DEVICE);
@@ -504,6 +526,12 @@ int main(int argc, char **argv)
     cudaStream_t stream;
     CHECK(cudaStreamCreate(&stream));
 
+    // both images of a frame are colored and written as PNG on the writer's threads
+    ResultWriter::Options writer_options;
+    writer_options.threads = WRITER_THREADS;
+    writer_options.annotate = colorize;
+    ResultWriter writer(writer_options);
+
     for (int f = 0; f < (int)file_names.size(); f++)
     {
         std::cout << file_names[f] << std::endl;
@@ -540,22 +568,19 @@ int main(int argc, char **argv)
                 uc_pixel[col] = (uchar)prob[row * INPUT_W + col];
             }
         }
-        cv::Mat im_color;
-        cv::cvtColor(outimg, im_color, cv::COLOR_GRAY2RGB);
-        cv::Mat lut = createLTU(NUM_CLASSES);
-        cv::LUT(im_color, lut, im_color);
-        // false color
-        cv::cvtColor(im_color, im_color, cv::COLOR_RGB2GRAY);
-        cv::applyColorMap(im_color, im_color, cv::COLORMAP_HOT);
-        // cv::imshow("False Color Map", im_color);
-        cv::imwrite(std::to_string(f) + "_false_color_map.png", im_color);
-        //fusion
-        cv::Mat fusionImg;
-        cv::addWeighted(img, 1, im_color, 0.8, 1, fusionImg);
-        // cv::imshow("Fusion Img", fusionImg);
-        // cv::waitKey(0);
-        cv::imwrite(std::to_string(f) + "_fusion_img.png", fusionImg);
+        // outimg and img are made anew for every image, the jobs can keep them
+        ResultWriter::Job &color_job = writer.acquire();
+        color_job.name = std::to_string(f) + "_false_color_map.png";
+        color_job.image = outimg;
+        color_job.extra = outimg;
+        writer.submit(color_job);
+        ResultWriter::Job &fusion_job = writer.acquire();
+        fusion_job.name = std::to_string(f) + "_fusion_img.png";
+        fusion_job.image = img;
+        fusion_job.extra = outimg;
+        writer.submit(fusion_job);
     }
+    writer.finish();
 
     // Release stream and buffers
     cudaStreamDestroy(stream);
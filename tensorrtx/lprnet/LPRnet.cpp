@@ -5,6 +5,8 @@
 #include "NvInfer.h"
 #include "cuda_runtime_api.h"
 #include "logging.h"
+#include "planar_normalize.h"
+#include "wts_loader.h"
 #include <fstream>
 #include <map>
 #include <sstream>
@@ -42,45 +44,6 @@ const std::string alphabet[] = {"京", "沪", "津", "渝", "冀", "晋", "蒙",
                                 "W", "X", "Y", "Z", "I", "O", "-"
 };
 
-
-// TensorRT weight files have a simple space delimited format:
-// [type] [size] <data x size in hex>
-std::map<std::string, Weights> loadWeights(const std::string file) {
-    std::cout << "Loading weights: " << file << std::endl;
-    std::map<std::string, Weights> weightMap;
-
-    // Open weights file
-    std::ifstream input(file);
-    assert(input.is_open() && "Unable to load weight file. please check if the .wts file path is right!!!!!!");
-
-    // Read number of weight blobs
-    int32_t count;
-    input >> count;
-    assert(count > 0 && "Invalid weight map file.");
-
-    while (count--) {
-        Weights wt{DataType::kFLOAT, nullptr, 0};
-        uint32_t size;
-
-        // Read name and type of blob
-        std::string name;
-        input >> name >> std::dec >> size;
-        wt.type = DataType::kFLOAT;
-
-        // Load blob
-        uint32_t *val = reinterpret_cast<uint32_t *>(malloc(sizeof(val) * size));
-        for (uint32_t x = 0, y = size; x < y; ++x) {
-            input >> std::hex >> val[x];
-        }
-        wt.values = val;
-
-        wt.count = size;
-        weightMap[name] = wt;
-    }
-
-    return weightMap;
-}
-
 IScaleLayer *addBatchNorm2d(INetworkDefinition *network, std::map<std::string, Weights> &weightMap, ITensor &input,
                             std::string lname, float eps) {
     float *gamma = (float *) weightMap[lname + ".weight"].values;
@@ -295,9 +258,7 @@ ICudaEngine *createEngine(unsigned int maxBatchSize, IBuilder *builder, IBuilder
     network->destroy();
 
     // Release host memory
-    for (auto &mem : weightMap) {
-        free((void *) (mem.second.values));
-    }
+    freeWeights(weightMap);
 
     return engine;
 }
@@ -401,17 +362,8 @@ int main(int argc, char **argv) {
     // If you want to process different images in a batch, you need adapt it.
    //cv::Mat blob = cv::dnn::blobFromImage(pr_img, 0.0078125, pr_img.size(), cv::Scalar(127.5, 127.5, 127.5), true,
                                           //false);
-    int i = 0;
-    for (int row = 0; row < INPUT_H; ++row) {
-        uchar* uc_pixel = pr_img.data + row * pr_img.step;
-        for (int col = 0; col < INPUT_W; ++col) {
-            data[i + 2 * INPUT_H * INPUT_W] = ((float)uc_pixel[2] - 127.5)*0.0078125;
-            data[i + INPUT_H * INPUT_W] = ((float)uc_pixel[1]-127.5)*0.0078125;
-            data[i] = ((float)uc_pixel[0]-127.5)*0.0078125;
-            uc_pixel += 3;
-            ++i;
-        }
-    }
+    // (x - 127.5) * 0.0078125, BGR planes, into the first slot
+    planar::normalize<planar::HalfRange, planar::Order::kBgr>(pr_img.data, pr_img.step, INPUT_W, INPUT_H, data, 0);
 
     IRuntime *runtime = createInferRuntime(gLogger);
     assert(runtime != nullptr);
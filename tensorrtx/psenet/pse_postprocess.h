@@ -0,0 +1,286 @@
+#ifndef TENSORRTX_PSE_POSTPROCESS_H
+#define TENSORRTX_PSE_POSTPROCESS_H
+
+// Progressive scale expansion of PSENet's kernels into text instances, and
+// their boxes.
+//
+// The output has num_kernels maps of h x w, the smallest kernel first. The
+// connected components (4-neighbour) of the smallest kernel are the instances.
+// Each larger kernel in turn grows them breadth first: pixels are popped in
+// queue order and claim their unlabelled 4-neighbours that are in the kernel.
+// A pixel that claims nothing is queued for the next kernel. The queue starts
+// with the seeds in raster order, so where instances meet, the first to reach
+// a pixel keeps it.
+//
+// Expander gives the instances and boxes of PSENet::postProcess as it was.
+// The differences are all in how it gets there:
+//  - one pass over the maps sets one bit per kernel in a byte per pixel;
+//  - label and kernel images are padded by one pixel, the label border set to
+//    -1, so neighbours need no bounds checks;
+//  - the queues are two flat arrays of pixel offsets, a slice of each per
+//    region, reused between calls. The label is read from the label image,
+//    and a pixel that has no unlabelled neighbour left is not queued again, as
+//    it can never claim anything;
+//  - instances only meet within a connected component of the union of the
+//    kernels, so these regions are expanded in parallel, each with its seeds
+//    in raster order. No pixel is shared between two regions, so the result
+//    does not depend on the thread count;
+//  - the points of every instance are gathered in one pass, bucketed by label,
+//    where the old code built a mask per label with findNonZero.
+// Labels are int, so there is no limit on the number of instances. The old
+// 8-bit label image merged every label from 255 on into 255, and those
+// instances got empty boxes.
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "worker_pool.h"
+
+namespace pse
+{
+
+class Expander
+{
+public:
+    // Pixels above threshold are in a kernel. pool may be null.
+    Expander(float threshold, int num_kernels, WorkerPool* pool)
+        : threshold_(threshold), num_kernels_(num_kernels), pool_(pool)
+    {
+        assert(num_kernels >= 1 && num_kernels <= 8);
+    }
+
+    // The minimum area rectangles of the instances of output, in label order;
+    // valid until the next call.
+    const std::vector<cv::RotatedRect>& run(const float* output, int h, int w)
+    {
+        h_ = h;
+        w_ = w;
+        stride_ = w + 2;
+        threshold(output);
+        label();
+        expand();
+        gather();
+        return boxes_;
+    }
+
+    int instances() const { return (int)boxes_.size(); }
+
+    // Label of pixel (y, x), 0 for none.
+    int label(int y, int x) const { return labels_[(y + 1) * stride_ + x + 1]; }
+
+private:
+    // A region of the union of the kernels and its seeds.
+    struct Region
+    {
+        int seeds;   // first seed in seeds_
+        int count;   // seeds
+        int pixels;  // in the union of the kernels
+        int queue;   // first entry of its slice of the queues
+    };
+
+    template <typename Fn>
+    void forEach(int n, const Fn& fn)
+    {
+        if (pool_)
+        {
+            pool_->parallelFor(n, fn);
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+                fn(i);
+        }
+    }
+
+    // Bit k of kernels_ for map k, and the masks of the smallest kernel and of
+    // the union of all of them for the connected components.
+    void threshold(const float* output)
+    {
+        const int h = h_, w = w_;
+        const size_t length = (size_t)h * w;
+        kernels_.assign((size_t)stride_ * (h + 2), 0);
+        seed_mask_.create(h, w, CV_8UC1);
+        any_mask_.create(h, w, CV_8UC1);
+        // all by value: the byte stores could alias anything behind a reference
+        const float t = threshold_;
+        const int block = 16;
+        forEach((h + block - 1) / block, [=](int b)
+        {
+            for (int y = b * block; y < std::min(h, (b + 1) * block); y++)
+            {
+                uint8_t* k = &kernels_[(y + 1) * stride_ + 1];
+                for (int i = 0; i < num_kernels_; i++)
+                {
+                    const float* map = output + i * length + (size_t)y * w;
+                    const uint8_t bit = (uint8_t)(1 << i);
+                    for (int x = 0; x < w; x++)
+                        k[x] |= map[x] > t ? bit : 0;
+                }
+                uint8_t* seed = seed_mask_.ptr<uint8_t>(y);
+                uint8_t* any = any_mask_.ptr<uint8_t>(y);
+                for (int x = 0; x < w; x++)
+                {
+                    seed[x] = k[x] & 1;
+                    any[x] = k[x] != 0;
+                }
+            }
+        });
+    }
+
+    // Seeds labelled as connectedComponents numbers them, bucketed by region.
+    void label()
+    {
+        const int h = h_, w = w_;
+        label_num_ = cv::connectedComponents(seed_mask_, seed_labels_, 4, CV_32S);
+        const int region_num = cv::connectedComponents(any_mask_, region_labels_, 4, CV_32S);
+
+        labels_.assign((size_t)stride_ * (h + 2), -1);
+        regions_.assign(region_num, Region{ 0, 0, 0, 0 });
+        for (int y = 0; y < h; y++)
+        {
+            const int* seed = seed_labels_.ptr<int>(y);
+            const int* region = region_labels_.ptr<int>(y);
+            int* l = &labels_[(y + 1) * stride_ + 1];
+            for (int x = 0; x < w; x++)
+            {
+                l[x] = seed[x];
+                regions_[region[x]].pixels++;
+                regions_[region[x]].count += seed[x] > 0;
+            }
+        }
+        int seeds = 0, queue = 0;
+        jobs_.clear();
+        for (int r = 1; r < region_num; r++)
+        {
+            if (!regions_[r].count)
+                continue;
+            regions_[r].seeds = seeds;
+            regions_[r].queue = queue;
+            seeds += regions_[r].count;
+            queue += regions_[r].pixels;
+            jobs_.push_back(r);
+        }
+        seeds_.resize(seeds);
+        queue_a_.resize(queue);
+        queue_b_.resize(queue);
+        fill_.assign(region_num, 0);
+        for (int y = 0; y < h; y++)
+        {
+            const int* seed = seed_labels_.ptr<int>(y);
+            const int* region = region_labels_.ptr<int>(y);
+            for (int x = 0; x < w; x++)
+            {
+                if (seed[x] > 0)
+                {
+                    const int r = region[x];
+                    seeds_[regions_[r].seeds + fill_[r]++] = (y + 1) * stride_ + x + 1;
+                }
+            }
+        }
+        // the largest regions first, for the balance between the threads
+        std::sort(jobs_.begin(), jobs_.end(), [&](int a, int b) { return regions_[a].pixels > regions_[b].pixels; });
+    }
+
+    void expand()
+    {
+        forEach((int)jobs_.size(), [&](int j) { expandRegion(regions_[jobs_[j]]); });
+    }
+
+    // The breadth first search of the old postProcess over one region. A queue
+    // never holds a pixel twice, so region.pixels entries do.
+    void expandRegion(const Region& region)
+    {
+        int* labels = labels_.data();
+        const uint8_t* kernels = kernels_.data();
+        const int offsets[4] = { -1, 1, -stride_, stride_ };  // x - 1, x + 1, y - 1, y + 1
+        int* in = &queue_a_[region.queue];
+        int* out = &queue_b_[region.queue];
+        int n = region.count;
+        std::copy(seeds_.begin() + region.seeds, seeds_.begin() + region.seeds + n, in);
+        for (int i = 1; i < num_kernels_ && n > 0; i++)
+        {
+            const uint8_t bit = (uint8_t)(1 << i);
+            int tail = n, kept = 0;
+            for (int head = 0; head < tail; head++)
+            {
+                const int p = in[head];
+                const int l = labels[p];
+                bool claimed = false, open = false;
+                for (int k = 0; k < 4; k++)
+                {
+                    const int nb = p + offsets[k];
+                    if (labels[nb] != 0)
+                        continue;
+                    if (kernels[nb] & bit)
+                    {
+                        labels[nb] = l;
+                        in[tail++] = nb;
+                        claimed = true;
+                    }
+                    else
+                    {
+                        open = true;
+                    }
+                }
+                if (!claimed && open)
+                    out[kept++] = p;
+            }
+            std::swap(in, out);
+            n = kept;
+        }
+    }
+
+    // Points of every label in raster order, then their rectangles.
+    void gather()
+    {
+        const int h = h_, w = w_;
+        const int labels = std::max(label_num_ - 1, 0);
+        // label l's points are [starts_[l], starts_[l + 1])
+        starts_.assign(labels + 2, 0);
+        for (int y = 0; y < h; y++)
+        {
+            const int* l = &labels_[(y + 1) * stride_ + 1];
+            for (int x = 0; x < w; x++)
+                starts_[l[x] + 1] += l[x] > 0;
+        }
+        for (int l = 2; l <= labels + 1; l++)
+            starts_[l] += starts_[l - 1];
+        points_.resize(starts_[labels + 1]);
+        fill_.assign(starts_.begin(), starts_.end());
+        for (int y = 0; y < h; y++)
+        {
+            const int* l = &labels_[(y + 1) * stride_ + 1];
+            for (int x = 0; x < w; x++)
+            {
+                if (l[x] > 0)
+                    points_[fill_[l[x]]++] = cv::Point(x, y);
+            }
+        }
+        boxes_.resize(labels);
+        forEach(labels, [&](int i)
+        {
+            const int start = starts_[i + 1], count = starts_[i + 2] - start;
+            boxes_[i] = cv::minAreaRect(cv::Mat(count, 1, CV_32SC2, &points_[start]));
+        });
+    }
+
+    float threshold_;
+    int num_kernels_;
+    WorkerPool* pool_;
+    int h_ = 0, w_ = 0, stride_ = 0;
+    int label_num_ = 0;
+    std::vector<uint8_t> kernels_;
+    cv::Mat seed_mask_, any_mask_, seed_labels_, region_labels_;
+    std::vector<int> labels_;
+    std::vector<Region> regions_;
+    std::vector<int> jobs_, seeds_, fill_, starts_;
+    std::vector<int> queue_a_, queue_b_;
+    std::vector<cv::Point> points_;
+    std::vector<cv::RotatedRect> boxes_;
+};
+
+}  // namespace pse
+
+#endif  // TENSORRTX_PSE_POSTPROCESS_H
@@ -0,0 +1,271 @@
+// Checks pse::Expander against PSENet::postProcess as it was, on synthetic
+// kernel maps at the 1024 max side of PSENet's input (maps a quarter of it):
+// square scenes of tilted lines, and portrait pages of close lines of words
+// whose larger kernels run into each other. Every kernel is the text shrunk by
+// a step more than the next, with ragged edges, and there are blobs that are
+// only in the larger kernels. The label images and the boxes must be the
+// same. Crowds, grids of over 255 short words, go past the old 8-bit labels:
+// there every instance must get a box of its own, and the two must agree up to
+// label 254. Then times both, Expander on one thread and on all of them.
+//   ./pse_postprocess_bench [maps]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <tuple>
+#include "pse_postprocess.h"
+
+static const int NUM_KERNELS = 6;
+static const float THRESHOLD = 0.9f;
+
+// PSENet::postProcess before pse::Expander, but for taking the map size and
+// giving out the label image. It thresholds output in place.
+static std::vector<cv::RotatedRect> reference(float* origin_output, int h, int w, cv::Mat& out)
+{
+    const int num_kernels_ = NUM_KERNELS;
+    const float post_threshold_ = THRESHOLD;
+    const int length = h * w;
+    // get kernels, sequence: 0->n, max -> min
+    std::vector<cv::Mat> kernels(num_kernels_);
+    for (auto i = num_kernels_ - 1; i >= 0; --i)
+    {
+        cv::Mat tmp_kernel(h, w, CV_32FC1, (void*)(origin_output + i * length), 0);
+        cv::threshold(tmp_kernel, tmp_kernel, post_threshold_, 255, cv::THRESH_BINARY);
+        tmp_kernel.convertTo(tmp_kernel, CV_8UC1);
+        assert(tmp_kernel.rows == h && tmp_kernel.cols == w);
+        kernels[num_kernels_ - 1 - i] = tmp_kernel;
+    }
+    cv::Mat stats, centroids, label_image;
+    int label_num = cv::connectedComponents(kernels[num_kernels_ - 1], label_image, 4);
+
+    label_image.convertTo(label_image, CV_8U);
+    assert(label_image.rows == h && label_image.cols == w);
+
+    out = cv::Mat::zeros(h, w, CV_8UC1);
+    std::queue<std::tuple<int, int, int>> q;
+    std::queue<std::tuple<int, int, int>> next_q;
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            auto label = *label_image.ptr(i, j);
+            if (label > 0)
+            {
+                q.push(std::make_tuple(i, j, label));
+                *out.ptr(i, j) = label;
+            }
+        }
+    }
+
+    int dx[4] = { -1, 1, 0, 0 };
+    int dy[4] = { 0, 0, -1, 1 };
+    for (int i = num_kernels_ - 2; i >= 0; i--)
+    {
+        //get each kernels
+        auto kernel = kernels[i];
+        while (!q.empty())
+        {
+            //get each queue menber in q
+            auto q_n = q.front();
+            q.pop();
+            int y = std::get<0>(q_n); //i
+            int x = std::get<1>(q_n); //j
+            int l = std::get<2>(q_n); //label
+            //store the edge pixel after one expansion
+            bool is_edge = true;
+            for (int idx = 0; idx < 4; idx++)
+            {
+                int index_y = y + dy[idx];
+                int index_x = x + dx[idx];
+                if (index_y < 0 || index_y >= h || index_x < 0 || index_x >= w)
+                    continue;
+                if (!*kernel.ptr(index_y, index_x) || *out.ptr(index_y, index_x) > 0)
+                    continue;
+                q.push(std::make_tuple(index_y, index_x, l));
+                *out.ptr(index_y, index_x) = l;
+                is_edge = false;
+            }
+            if (is_edge)
+            {
+                next_q.push(std::make_tuple(y, x, l));
+            }
+        }
+        std::swap(q, next_q);
+    }
+    std::vector<cv::RotatedRect> boxes;
+    for (auto n = 1; n < label_num; ++n)
+    {
+        std::vector<cv::Point> points;
+        cv::findNonZero(out == n, points);
+        cv::RotatedRect rect = cv::minAreaRect(points);
+        boxes.emplace_back(rect);
+    }
+    return boxes;
+}
+
+struct Maps
+{
+    int h, w;
+    std::vector<float> output;
+};
+
+// A line of text into every kernel: kernel i is the line shrunk by step pixels
+// per kernel above it, with edges made ragged by noise of ragged pixels.
+static void line(Maps& maps, std::mt19937& rng, float cx, float cy, float len, float thick, float angle, float step,
+                 float ragged = 1.2f)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const float c = std::cos(angle), s = std::sin(angle), r = len / 2 + thick;
+    for (int y = std::max(0, (int)(cy - r)); y < std::min(maps.h, (int)(cy + r) + 1); y++)
+    {
+        for (int x = std::max(0, (int)(cx - r)); x < std::min(maps.w, (int)(cx + r) + 1); x++)
+        {
+            const float along = std::abs((x - cx) * c + (y - cy) * s), across = std::abs((y - cy) * c - (x - cx) * s);
+            const float inside = std::min(len / 2 - along, thick / 2 - across);
+            for (int i = 0; i < NUM_KERNELS; i++)
+            {
+                const float d = inside - (NUM_KERNELS - 1 - i) * step + (u(rng) - 0.5f) * ragged;
+                float& p = maps.output[(size_t)i * maps.h * maps.w + y * maps.w + x];
+                p = std::max(p, std::min(1.f, 0.9f + 0.05f * d));
+            }
+        }
+    }
+}
+
+static Maps background(int h, int w, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Maps maps{ h, w, std::vector<float>((size_t)NUM_KERNELS * h * w) };
+    for (auto& p : maps.output)
+        p = 0.3f * u(rng) * u(rng);
+    return maps;
+}
+
+static Maps scene(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Maps maps = background(256, 256, rng);
+    for (int i = 0; i < 40; i++)
+    {
+        const float x = 256 * u(rng), y = 256 * u(rng), angle = (u(rng) - 0.5f) * 1.6f;
+        // every fifth a blob the smallest kernels miss
+        const float thick = i % 5 ? 6 + 10 * u(rng) : 4;
+        line(maps, rng, x, y, 15 + 90 * u(rng), thick, angle, 1.f);
+    }
+    return maps;
+}
+
+static Maps page(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Maps maps = background(256, 192, rng);
+    const float skew = (u(rng) - 0.5f) * 0.06f;
+    for (float y = 7; y < 256; y += 14)
+    {
+        for (float x = 4 + 6 * u(rng); x < 192;)
+        {
+            const float len = 12 + 50 * u(rng);
+            line(maps, rng, x + len / 2, y + (x + len / 2) * skew, len, 12 + 2 * u(rng), skew, 0.8f);
+            x += len + 3 + 4 * u(rng);
+        }
+    }
+    return maps;
+}
+
+// 18 x 18 short words with smooth edges, so each is one seed and not a few
+// pixels split off by the noise: more instances than 8 bits hold.
+static Maps crowd(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Maps maps = background(256, 256, rng);
+    for (int row = 0; row < 18; row++)
+    {
+        for (int col = 0; col < 18; col++)
+            line(maps, rng, 9 + 14 * col, 9 + 14 * row, 11 + u(rng), 11 + u(rng), (u(rng) - 0.5f) * 0.2f, 0.5f, 0.f);
+    }
+    return maps;
+}
+
+static double now_ms()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool same_box(const cv::RotatedRect& a, const cv::RotatedRect& b)
+{
+    return a.center.x == b.center.x && a.center.y == b.center.y && a.size.width == b.size.width &&
+           a.size.height == b.size.height && a.angle == b.angle;
+}
+
+int main(int argc, char** argv)
+{
+    const int count = argc > 1 ? atoi(argv[1]) : 20;
+    std::mt19937 rng(0);
+    WorkerPool one(1), all(0);
+    pse::Expander serial(THRESHOLD, NUM_KERNELS, &one), parallel(THRESHOLD, NUM_KERNELS, &all);
+    bool ok = true;
+
+    const char* kinds[] = { "scenes", "pages", "crowds" };
+    for (int kind = 0; kind < 3; kind++)
+    {
+        std::vector<Maps> maps(count);
+        for (auto& m : maps)
+            m = kind == 0 ? scene(rng) : kind == 1 ? page(rng) : crowd(rng);
+        double ref_ms = 0, one_ms = 0, all_ms = 0;
+        size_t instances = 0;
+        bool same = true;
+        for (const Maps& m : maps)
+        {
+            std::vector<float> copy = m.output;
+            cv::Mat out;
+            double start = now_ms();
+            const std::vector<cv::RotatedRect> boxes = reference(copy.data(), m.h, m.w, out);
+            ref_ms += now_ms() - start;
+            // the old label image is 8-bit: labels from 255 on all became 255,
+            // so only those below are compared, and only crowds go past it
+            const bool crowded = kind == 2;
+            same = same && (boxes.size() > 255) == crowded;
+            const size_t compared = crowded ? 254 : boxes.size();
+            for (pse::Expander* e : { &serial, &parallel })
+            {
+                double best = HUGE_VAL;
+                for (int r = 0; r < 3; r++)
+                {
+                    start = now_ms();
+                    e->run(m.output.data(), m.h, m.w);
+                    best = std::min(best, now_ms() - start);
+                }
+                (e == &serial ? one_ms : all_ms) += best;
+                const std::vector<cv::RotatedRect>& found = e->run(m.output.data(), m.h, m.w);
+                same = same && found.size() == boxes.size();
+                for (size_t i = 0; same && i < compared; i++)
+                    same = same_box(found[i], boxes[i]);
+                std::vector<int> pixels(found.size() + 1, 0);
+                for (int y = 0; y < m.h; y++)
+                {
+                    for (int x = 0; x < m.w; x++)
+                    {
+                        const int l = e->label(y, x), old = *out.ptr(y, x);
+                        same = same && (old < 255 ? l == old : l >= 255) && l <= (int)found.size();
+                        if (same)
+                            pixels[l]++;
+                    }
+                }
+                // every instance has pixels and a box that is not empty
+                for (size_t i = 0; crowded && same && i < found.size(); i++)
+                    same = pixels[i + 1] > 0 && found[i].size.width > 0 && found[i].size.height > 0;
+            }
+            instances += boxes.size();
+        }
+        ok = ok && same;
+        std::cout << count << " " << kinds[kind] << " of " << maps[0].w << "x" << maps[0].h << " maps: "
+                  << (double)instances / count << " instances per map" << (same ? "" : "  MISMATCH") << std::endl;
+        std::cout << "  postProcess " << ref_ms / count << "ms, Expander: 1 thread " << one_ms / count << "ms ("
+                  << ref_ms / one_ms << "x), " << all.size() << " threads " << all_ms / count << "ms ("
+                  << ref_ms / all_ms << "x)" << std::endl;
+    }
+    std::cout << (ok ? "same instances and boxes" : "MISMATCH with postProcess") << std::endl;
+    return ok ? 0 : 1;
+}
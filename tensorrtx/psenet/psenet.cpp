@@ -1,15 +1,17 @@
 #include "psenet.h"
 #include <string>
-#include <queue>
 #define MAX_INPUT_SIZE 1200
 #define MIN_INPUT_SIZE 128
 #define OPT_INPUT_W 640
 #define OPT_INPUT_H 640
+#define POST_THREADS 0  // threads expanding the kernels, 0 for all the cores
 
 PSENet::PSENet(int max_side_len, int min_side_len, float threshold, int num_kernel, int stride) : max_side_len_(max_side_len), min_side_len_(min_side_len),
 post_threshold_(threshold),
 num_kernels_(num_kernel),
-stride_(stride)
+stride_(stride),
+pool_(POST_THREADS),
+expander_(threshold, num_kernel, &pool_)
 {
 }
 
@@ -184,10 +186,7 @@ ICudaEngine* PSENet::createEngine(IBuilder* builder, IBuilderConfig* config)
     network->destroy();
 
     // Release host memory
-    for (auto& mem : weightMap)
-    {
-        free((void*)(mem.second.values));
-    }
+    freeWeights(weightMap);
     return engine;
 }
 
@@ -361,85 +360,8 @@ float* PSENet::preProcess(cv::Mat image, int& resize_h, int& resize_w, float& ra
 
 std::vector<cv::RotatedRect> PSENet::postProcess(float* origin_output, int resize_h, int resize_w)
 {
-    // BxCxHxW  S0 ===> S5  small ===> large
+    // BxCxHxW  S0 ===> S5  small ===> large, expanded as in pse_postprocess.h
     const int h = resize_h / stride_;
     const int w = resize_w / stride_;
-    const int length = h * w;
-    // get kernels, sequence: 0->n, max -> min
-    std::vector<cv::Mat> kernels(num_kernels_);
-    for (auto i = num_kernels_ - 1; i >= 0; --i)
-    {
-        cv::Mat tmp_kernel(h, w, CV_32FC1, (void*)(origin_output + i * length), 0);
-        cv::threshold(tmp_kernel, tmp_kernel, post_threshold_, 255, cv::THRESH_BINARY);
-        tmp_kernel.convertTo(tmp_kernel, CV_8UC1);
-        assert(tmp_kernel.rows == h && tmp_kernel.cols == w);
-        kernels[num_kernels_ - 1 - i] = tmp_kernel;
-    }
-    cv::Mat stats, centroids, label_image;
-    int label_num = cv::connectedComponents(kernels[num_kernels_ - 1], label_image, 4);
-
-    label_image.convertTo(label_image, CV_8U);
-    assert(label_image.rows == h && label_image.cols == w);
-
-    cv::Mat out = cv::Mat::zeros(h, w, CV_8UC1);
-    std::queue<std::tuple<int, int, int>> q;
-    std::queue<std::tuple<int, int, int>> next_q;
-    for (int i = 0; i < h; i++)
-    {
-        for (int j = 0; j < w; j++)
-        {
-            auto label = *label_image.ptr(i, j);
-            if (label > 0)
-            {
-                q.push(std::make_tuple(i, j, label));
-                *out.ptr(i, j) = label;
-            }
-        }
-    }
-
-    int dx[4] = { -1, 1, 0, 0 };
-    int dy[4] = { 0, 0, -1, 1 };
-    for (int i = num_kernels_ - 2; i >= 0; i--)
-    {
-        //get each kernels
-        auto kernel = kernels[i];
-        while (!q.empty())
-        {
-            //get each queue menber in q
-            auto q_n = q.front();
-            q.pop();
-            int y = std::get<0>(q_n); //i
-            int x = std::get<1>(q_n); //j
-            int l = std::get<2>(q_n); //label
-            //store the edge pixel after one expansion
-            bool is_edge = true;
-            for (int idx = 0; idx < 4; idx++)
-            {
-                int index_y = y + dy[idx];
-                int index_x = x + dx[idx];
-                if (index_y < 0 || index_y >= h || index_x < 0 || index_x >= w)
-                    continue;
-                if (!*kernel.ptr(index_y, index_x) || *out.ptr(index_y, index_x) > 0)
-                    continue;
-                q.push(std::make_tuple(index_y, index_x, l));
-                *out.ptr(index_y, index_x) = l;
-                is_edge = false;
-            }
-            if (is_edge)
-            {
-                next_q.push(std::make_tuple(y, x, l));
-            }
-        }
-        std::swap(q, next_q);
-    }
-    std::vector<cv::RotatedRect> boxes;
-    for (auto n = 1; n < label_num; ++n)
-    {
-        std::vector<cv::Point> points;
-        cv::findNonZero(out == n, points);
-        cv::Mat fuck = out == n;
-        cv::RotatedRect rect = cv::minAreaRect(points);
-        boxes.emplace_back(rect);
-    }
-    return boxes;
+    return expander_.run(origin_output, h, w);
 }
@@ -6,6 +6,8 @@
 #include <opencv2/opencv.hpp>
 #include "utils.h"
 #include "layers.h"
+#include "pse_postprocess.h"
+#include "worker_pool.h"
 class PSENet
 {
 public:
@@ -34,6 +36,8 @@ private:
 	float post_threshold_ = 0.9;
 	int num_kernels_ = 6;
 	int stride_ = 4;
+	WorkerPool pool_;
+	pse::Expander expander_;
 };
 
 #endif // TENSORRTX_PSENET_H
@@ -7,11 +7,10 @@
 #include "cuda_runtime_api.h"
 #include "assert.h"
 #include <fstream>
+#include "wts_loader.h"
 
 using namespace nvinfer1;
 
-std::map<std::string, Weights> loadWeights(const std::string file);
-
 cv::RotatedRect expandBox(const cv::RotatedRect& inBox, float ratio = 1.0);
 
 void drawRects(cv::Mat& image, std::vector<cv::RotatedRect> boxes, float stride, float ratio_h, float ratio_w, float expand_ratio);
@@ -8,10 +8,15 @@
 #include "BatchedNmsPlugin.h"
 #include "MaskRcnnInferencePlugin.h"
 #include "calibrator.hpp"
+#include "image_loader.h"
+#include "result_writer.h"
 
 #define DEVICE 0
 #define BATCH_SIZE 1
 #define BACKBONE_RESNETTYPE R50
+#define WRITER_THREADS 2  // threads drawing, encoding and writing the output images, 0 for half the cores
+#define DRAW_RESULTS true  // false: write no images, only RESULTS_FILE
+#define RESULTS_FILE ""  // JSON lines file of the boxes of every image, "" for none
 // data
 static const std::vector<float> PIXEL_MEAN = { 103.53, 116.28, 123.675 };
 static const std::vector<float> PIXEL_STD = {1.0, 1.0, 1.0};
@@ -396,6 +401,27 @@ bool parse_args(int argc, char** argv, std::string& wtsFile, std::string& engine
     return true;
 }
 
+// Outlines the mask of each box, row j of job.extra for detection j, on the writer's threads.
+static void drawMasks(ResultWriter::Job& job) {
+    for (int j = 0; j < (int)job.detections.size(); j++) {
+        const ResultWriter::Detection& d = job.detections[j];
+        cv::Mat maskPart(POOLER_RESOLUTION, POOLER_RESOLUTION, CV_32FC1, job.extra.ptr<float>(j));
+        cv::Rect r(cv::Point(floor(d.x1) - 1 < 0 ? 0 : floor(d.x1) - 1,
+                             floor(d.y1) - 1 < 0 ? 0 : floor(d.y1) - 1),
+                   cv::Point(ceil(d.x2) + 1 > INPUT_W ? INPUT_W : ceil(d.x2) + 1,
+                             ceil(d.y2) + 1 > INPUT_H ? INPUT_H : ceil(d.y2) + 1));
+        cv::Mat resized;
+        cv::resize(maskPart, resized, cv::Size(r.width, r.height));
+        cv::Mat curMask = cv::Mat::zeros(cv::Size(INPUT_W, INPUT_H), CV_8UC1);
+        cv::threshold(resized, resized, 0.5, 255, cv::THRESH_BINARY);
+        curMask(r) += resized;
+        std::vector<std::vector<cv::Point>> contours;
+        cv::findContours(curMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
+        for (int c = 0; c < contours.size(); c++)
+            cv::drawContours(job.image, contours, c, cv::Scalar(0, 0, 255));
+    }
+}
+
 int main(int argc, char** argv) {
     cudaSetDevice(DEVICE);
 
@@ -488,15 +514,26 @@ int main(int argc, char** argv) {
         outputs.push_back(masks_h.data());
     }
 
-    int fcount = 0;
-    int fileLen = fileList.size();
-    for (int f = 0; f < fileLen; f++) {
-        fcount++;
-        if (fcount < BATCH_SIZE && f + 1 != fileLen) continue;
+    // the next batches are read and decoded while this one runs
+    ImageLoader::Options loaderOptions;
+    loaderOptions.batch_size = BATCH_SIZE;
+    ImageLoader loader(imgDir, fileList, loaderOptions);
+    ResultWriter::Options writerOptions;
+    writerOptions.threads = WRITER_THREADS;
+    writerOptions.draw = DRAW_RESULTS;
+    writerOptions.results = RESULTS_FILE;
+    writerOptions.box_rect = ResultWriter::BoxRect::kTruncated;
+    if (MASK_ON) writerOptions.annotate = drawMasks;
+    ResultWriter writer(writerOptions);
+    // the letterboxed images of the batch, drawn on once it has run
+    std::vector<cv::Mat> inputs(BATCH_SIZE);
+    while (const ImageLoader::Batch* batch = loader.next()) {
+        const int fcount = batch->size;
 
         for (int b = 0; b < fcount; b++) {
-            cv::Mat img = cv::imread(imgDir + "/" + fileList[f - fcount + 1 + b]);
-            img = preprocessImg(img, INPUT_W, INPUT_H);
+            cv::Mat src = batch->images[b];
+            inputs[b] = src.empty() ? cv::Mat() : preprocessImg(src, INPUT_W, INPUT_H);
+            const cv::Mat& img = inputs[b];
             if (img.empty()) continue;
             for (int i = 0; i < INPUT_H * INPUT_W * 3; i++)
                 data[b*INPUT_H * INPUT_W * 3 + i] = static_cast<float>(*(img.data + i));
@@ -514,8 +551,16 @@ int main(int argc, char** argv) {
         float w_ratio = static_cast<float>(INPUT_W) / IMAGE_WIDTH;
 
         for (int b = 0; b < fcount; b++) {
-            cv::Mat img = cv::imread(imgDir + "/" + fileList[f - fcount + 1 + b]);
-            img = preprocessImg(img, INPUT_W, INPUT_H);
+            if (inputs[b].empty()) continue;
+            // drawn and written on the writer's threads; the letterboxed image is
+            // made anew for every batch, the job can keep it
+            ResultWriter::Job& job = writer.acquire();
+            job.name = "_" + batch->names[b];
+            job.image = inputs[b];
+            const int kept = std::count_if(&scores_h[b * DETECTIONS_PER_IMAGE], &scores_h[(b + 1) * DETECTIONS_PER_IMAGE],
+                                           [](float score) { return score > SCORE_THRESH; });
+            // the masks of the detections kept, one per row
+            if (MASK_ON) job.extra.create(kept, POOLER_RESOLUTION * POOLER_RESOLUTION, CV_32FC1);
             for (int i = 0; i < DETECTIONS_PER_IMAGE; i++) {
                 if (scores_h[b * DETECTIONS_PER_IMAGE + i] > SCORE_THRESH) {
                     float x1 = boxes_h[b * DETECTIONS_PER_IMAGE * 4 + i * 4 + 0] * w_ratio;
@@ -525,37 +570,19 @@ int main(int argc, char** argv) {
                     int label = classes_h[b * DETECTIONS_PER_IMAGE + i];
                     float score = scores_h[b * DETECTIONS_PER_IMAGE + i];
                     printf("boxes:[%.6f, %.6f, %.6f, %.6f] scores: %.4f label: %d \n", x1, y1, x2, y2, score, label);
-                    cv::Rect r(x1, y1, x2 - x1, y2 - y1);
-                    cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
-                    cv::putText(img, std::to_string(label), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2,
-                    cv::Scalar(0xFF, 0xFF, 0xFF), 2);
-
                     if (MASK_ON) {
-                        cv::Mat maskPart = cv::Mat::zeros(cv::Size(POOLER_RESOLUTION, POOLER_RESOLUTION), CV_32FC1);
-                        memcpy(maskPart.data,
+                        memcpy(job.extra.ptr<float>((int)job.detections.size()),
                           &masks_h[b * DETECTIONS_PER_IMAGE * POOLER_RESOLUTION * POOLER_RESOLUTION +
                           i * POOLER_RESOLUTION * POOLER_RESOLUTION],
                           POOLER_RESOLUTION * POOLER_RESOLUTION * sizeof(float));
-
-                        cv::Rect r(cv::Point(floor(x1) - 1 < 0 ? 0 : floor(x1) - 1,
-                                             floor(y1) - 1 < 0 ? 0 : floor(y1) - 1),
-                                   cv::Point(ceil(x2) + 1 > INPUT_W ? INPUT_W : ceil(x2) + 1,
-                                             ceil(y2) + 1 > INPUT_H ? INPUT_H : ceil(y2) + 1));
-                        cv::resize(maskPart, maskPart, cv::Size(r.width, r.height));
-                        cv::Mat curMask = cv::Mat::zeros(cv::Size(INPUT_W, INPUT_H), CV_8UC1);
-                        cv::threshold(maskPart, maskPart, 0.5, 255, cv::THRESH_BINARY);
-                        curMask(r) += maskPart;
-                        std::vector<std::vector<cv::Point>> contours;
-                        cv::findContours(curMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
-                        for (int c = 0; c < contours.size(); c++)
-                            cv::drawContours(img, contours, c, cv::Scalar(0, 0, 255));
                     }
+                    job.detections.push_back(ResultWriter::Detection{x1, y1, x2, y2, score, label});
                 }
             }
-            cv::imwrite("_" + fileList[f - fcount + 1 + b], img);
+            writer.submit(job);
         }
-        fcount = 0;
     }
+    writer.finish();
 
     cudaStreamDestroy(stream);
     CUDA_CHECK(cudaFree(data_d));
@@ -4,6 +4,7 @@
 #include <dirent.h>
 #include "NvInfer.h"
 #include "decode.h"
+#include "nms_engine.h"
 
 using namespace nvinfer1;
 
@@ -88,44 +89,24 @@ static inline cv::Rect get_rect_adapt_landmark(cv::Mat& img, int input_w, int in
     return cv::Rect(l, t, r-l, b-t);
 }
 
-static float iou(float lbox[4], float rbox[4]) {
-    float interBox[] = {
-        std::max(lbox[0], rbox[0]), //left
-        std::min(lbox[2], rbox[2]), //right
-        std::max(lbox[1], rbox[1]), //top
-        std::min(lbox[3], rbox[3]), //bottom
-    };
-
-    if(interBox[2] > interBox[3] || interBox[0] > interBox[1])
-        return 0.0f;
-
-    float interBoxS = (interBox[1] - interBox[0]) * (interBox[3] - interBox[2]);
-    return interBoxS / ((lbox[2] - lbox[0]) * (lbox[3] - lbox[1]) + (rbox[2] - rbox[0]) * (rbox[3] - rbox[1]) -interBoxS + 0.000001f);
-}
-
-static bool cmp(const decodeplugin::Detection& a, const decodeplugin::Detection& b) {
-    return a.class_confidence > b.class_confidence;
-}
-
 static inline void nms(std::vector<decodeplugin::Detection>& res, float *output, float nms_thresh = 0.4) {
-    std::vector<decodeplugin::Detection> dets;
+    static thread_local boxnms::NmsEngine engine;
+    static thread_local std::vector<int> rows;
+    engine.reset();
+    rows.clear();
     for (int i = 0; i < output[0]; i++) {
-        if (output[15 * i + 1 + 4] <= 0.1) continue;
-        decodeplugin::Detection det;
-        memcpy(&det, &output[15 * i + 1], sizeof(decodeplugin::Detection));
-        dets.push_back(det);
+        const float* det = &output[15 * i + 1];
+        if (det[4] <= 0.1) continue;
+        engine.addCorner(det, det[4], 0);
+        rows.push_back(i);
     }
-    std::sort(dets.begin(), dets.end(), cmp);
-    for (size_t m = 0; m < dets.size(); ++m) {
-        auto& item = dets[m];
-        res.push_back(item);
-        //std::cout << item.class_confidence << " bbox " << item.bbox[0] << ", " << item.bbox[1] << ", " << item.bbox[2] << ", " << item.bbox[3] << std::endl;
-        for (size_t n = m + 1; n < dets.size(); ++n) {
-            if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
-                dets.erase(dets.begin()+n);
-                --n;
-            }
-        }
+    boxnms::Config config;
+    config.iou_thresh = nms_thresh;
+    config.union_eps = 0.000001f;
+    for (int k : engine.run(config)) {
+        decodeplugin::Detection det;
+        memcpy(&det, &output[15 * rows[k] + 1], sizeof(decodeplugin::Detection));
+        res.push_back(det);
     }
 }
 
@@ -9,6 +9,8 @@
 #include "NvInfer.h"
 #include "cuda_runtime_api.h"
 #include "logging.h"
+#include "wts_loader.h"
+#include "nms_engine.h"
 #include "decode.h"
 
 #define CHECK(status) \
@@ -86,86 +88,26 @@ cv::Rect get_rect_adapt_landmark(cv::Mat& img, float bbox[4], float lmk[10]) {
     return cv::Rect(l, t, r-l, b-t);
 }
 
-float iou(float lbox[4], float rbox[4]) {
-    float interBox[] = {
-        std::max(lbox[0], rbox[0]), //left
-        std::min(lbox[2], rbox[2]), //right
-        std::max(lbox[1], rbox[1]), //top
-        std::min(lbox[3], rbox[3]), //bottom
-    };
-
-    if(interBox[2] > interBox[3] || interBox[0] > interBox[1])
-        return 0.0f;
-
-    float interBoxS = (interBox[1] - interBox[0]) * (interBox[3] - interBox[2]);
-    return interBoxS / ((lbox[2] - lbox[0]) * (lbox[3] - lbox[1]) + (rbox[2] - rbox[0]) * (rbox[3] - rbox[1]) -interBoxS + 0.000001f);
-}
-
-bool cmp(decodeplugin::Detection& a, decodeplugin::Detection& b) {
-    return a.class_confidence > b.class_confidence;
-}
-
 void nms(std::vector<decodeplugin::Detection>& res, float *output, float nms_thresh = 0.4) {
-    std::vector<decodeplugin::Detection> dets;
+    static thread_local boxnms::NmsEngine engine;
+    static thread_local std::vector<int> rows;
+    engine.reset();
+    rows.clear();
     for (int i = 0; i < output[0]; i++) {
-        if (output[DETECTION_SIZE * i + 1 + 4] <= 0.1) continue;
-        decodeplugin::Detection det;
-        memcpy(&det, &output[DETECTION_SIZE * i + 1], sizeof(decodeplugin::Detection));
-        dets.push_back(det);
+        const float* det = &output[DETECTION_SIZE * i + 1];
+        if (det[4] <= 0.1) continue;
+        engine.addCorner(det, det[4], 0);
+        rows.push_back(i);
     }
-    std::sort(dets.begin(), dets.end(), cmp);
-    if (dets.size() > 5000) dets.erase(dets.begin() + 5000, dets.end());
-    for (size_t m = 0; m < dets.size(); ++m) {
-        auto& item = dets[m];
-        res.push_back(item);
-        //std::cout << item.class_confidence << " bbox " << item.bbox[0] << ", " << item.bbox[1] << ", " << item.bbox[2] << ", " << item.bbox[3] << std::endl;
-        for (size_t n = m + 1; n < dets.size(); ++n) {
-            if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
-                dets.erase(dets.begin()+n);
-                --n;
-            }
-        }
-    }
-}
-
-// TensorRT weight files have a simple space delimited format:
-// [type] [size] <data x size in hex>
-std::map<std::string, Weights> loadWeights(const std::string file) {
-    std::cout << "Loading weights: " << file << std::endl;
-    std::map<std::string, Weights> weightMap;
-
-    // Open weights file
-    std::ifstream input(file);
-    assert(input.is_open() && "Unable to load weight file.");
-
-    // Read number of weight blobs
-    int32_t count;
-    input >> count;
-    assert(count > 0 && "Invalid weight map file.");
-
-    while (count--)
-    {
-        Weights wt{DataType::kFLOAT, nullptr, 0};
-        uint32_t size;
-
-        // Read name and type of blob
-        std::string name;
-        input >> name >> std::dec >> size;
-        wt.type = DataType::kFLOAT;
-
-        // Load blob
-        uint32_t* val = reinterpret_cast<uint32_t*>(malloc(sizeof(val) * size));
-        for (uint32_t x = 0, y = size; x < y; ++x)
-        {
-            input >> std::hex >> val[x];
-        }
-        wt.values = val;
-        
-        wt.count = size;
-        weightMap[name] = wt;
+    boxnms::Config config;
+    config.iou_thresh = nms_thresh;
+    config.union_eps = 0.000001f;
+    config.max_candidates = 5000;
+    for (int k : engine.run(config)) {
+        decodeplugin::Detection det;
+        memcpy(&det, &output[DETECTION_SIZE * rows[k] + 1], sizeof(decodeplugin::Detection));
+        res.push_back(det);
     }
-
-    return weightMap;
 }
 
 IScaleLayer* addBatchNorm2d(INetworkDefinition *network, std::map<std::string, Weights>& weightMap, ITensor& input, std::string lname, float eps) {
@@ -394,10 +336,7 @@ ICudaEngine* createEngine(unsigned int maxBatchSize, IBuilder* builder, IBuilder
     network->destroy();
 
     // Release host memory
-    for (auto& mem : weightMap)
-    {
-        free((void*) (mem.second.values));
-    }
+    freeWeights(weightMap);
 
     return engine;
 }
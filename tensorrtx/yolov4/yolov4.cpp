@@ -10,6 +10,7 @@
 #include "utils.h"
 #include "cuda_runtime_api.h"
 #include "logging.h"
+#include "nms_engine.h"
 #include "yololayer.h"
 #include "mish.h"
 
@@ -78,51 +79,6 @@ cv::Rect get_rect(cv::Mat& img, float bbox[4]) {
     return cv::Rect(l, t, r-l, b-t);
 }
 
-float iou(float lbox[4], float rbox[4]) {
-    float interBox[] = {
-        std::max(lbox[0] - lbox[2]/2.f , rbox[0] - rbox[2]/2.f), //left
-        std::min(lbox[0] + lbox[2]/2.f , rbox[0] + rbox[2]/2.f), //right
-        std::max(lbox[1] - lbox[3]/2.f , rbox[1] - rbox[3]/2.f), //top
-        std::min(lbox[1] + lbox[3]/2.f , rbox[1] + rbox[3]/2.f), //bottom
-    };
-
-    if(interBox[2] > interBox[3] || interBox[0] > interBox[1])
-        return 0.0f;
-
-    float interBoxS =(interBox[1]-interBox[0])*(interBox[3]-interBox[2]);
-    return interBoxS/(lbox[2]*lbox[3] + rbox[2]*rbox[3] -interBoxS);
-}
-
-bool cmp(const Yolo::Detection& a, const Yolo::Detection& b) {
-    return a.det_confidence > b.det_confidence;
-}
-
-void nms(std::vector<Yolo::Detection>& res, float *output, float nms_thresh = NMS_THRESH) {
-    std::map<float, std::vector<Yolo::Detection>> m;
-    for (int i = 0; i < output[0] && i < Yolo::MAX_OUTPUT_BBOX_COUNT; i++) {
-        if (output[1 + DETECTION_SIZE * i + 4] <= BBOX_CONF_THRESH) continue;
-        Yolo::Detection det;
-        memcpy(&det, &output[1 + DETECTION_SIZE * i], DETECTION_SIZE * sizeof(float));
-        if (m.count(det.class_id) == 0) m.emplace(det.class_id, std::vector<Yolo::Detection>());
-        m[det.class_id].push_back(det);
-    }
-    for (auto it = m.begin(); it != m.end(); it++) {
-        //std::cout << it->second[0].class_id << " --- " << std::endl;
-        auto& dets = it->second;
-        std::sort(dets.begin(), dets.end(), cmp);
-        for (size_t m = 0; m < dets.size(); ++m) {
-            auto& item = dets[m];
-            res.push_back(item);
-            for (size_t n = m + 1; n < dets.size(); ++n) {
-                if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
-                    dets.erase(dets.begin()+n);
-                    --n;
-                }
-            }
-        }
-    }
-}
-
 // TensorRT weight files have a simple space delimited format:
 // [type] [size] <data x size in hex>
 std::map<std::string, Weights> loadWeights(const std::string file) {
@@ -650,7 +606,7 @@ int main(int argc, char** argv) {
         std::vector<std::vector<Yolo::Detection>> batch_res(fcount);
         for (int b = 0; b < fcount; b++) {
             auto& res = batch_res[b];
-            nms(res, &prob[b * OUTPUT_SIZE]);
+            boxnms::nmsDetections(res, &prob[b * OUTPUT_SIZE], BBOX_CONF_THRESH, NMS_THRESH, Yolo::MAX_OUTPUT_BBOX_COUNT);
         }
         for (int b = 0; b < fcount; b++) {
             auto& res = batch_res[b];
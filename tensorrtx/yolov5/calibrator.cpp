@@ -1,22 +1,24 @@
 #include <iostream>
 #include <iterator>
 #include <fstream>
-#include <opencv2/dnn/dnn.hpp>
+#include <opencv2/opencv.hpp>
 #include "calibrator.h"
 #include "cuda_utils.h"
+#include "image_loader.h"
+#include "preprocess_cpu.h"
 #include "utils.h"
 
 Int8EntropyCalibrator2::Int8EntropyCalibrator2(int batchsize, int input_w, int input_h, const char* img_dir, const char* calib_table_name, const char* input_blob_name, bool read_cache)
     : batchsize_(batchsize)
     , input_w_(input_w)
     , input_h_(input_h)
-    , img_idx_(0)
     , img_dir_(img_dir)
     , calib_table_name_(calib_table_name)
     , input_blob_name_(input_blob_name)
     , read_cache_(read_cache)
 {
     input_count_ = 3 * input_w * input_h * batchsize;
+    host_input_.resize(input_count_);
     CUDA_CHECK(cudaMalloc(&device_input_, input_count_ * sizeof(float)));
     read_files_in_dir(img_dir, img_files_);
 }
@@ -33,25 +35,32 @@ int Int8EntropyCalibrator2::getBatchSize() const TRT_NOEXCEPT
 
 bool Int8EntropyCalibrator2::getBatch(void* bindings[], const char* names[], int nbBindings) TRT_NOEXCEPT
 {
-    if (img_idx_ + batchsize_ > (int)img_files_.size()) {
+    // the decode threads start with the first batch, none is asked for when the calibration cache is read
+    if (!loader_) {
+        ImageLoader::Options options;
+        options.batch_size = batchsize_;
+        loader_.reset(new ImageLoader(img_dir_, img_files_, options));
+    }
+    // only full batches
+    const ImageLoader::Batch* batch = loader_->next();
+    if (!batch || batch->size < batchsize_) {
         return false;
     }
 
-    std::vector<cv::Mat> input_imgs_;
-    for (int i = img_idx_; i < img_idx_ + batchsize_; i++) {
-        std::cout << img_files_[i] << "  " << i << std::endl;
-        cv::Mat temp = cv::imread(img_dir_ + img_files_[i]);
+    // Same letterbox as preprocess_kernel_img at inference time, written straight into the batch slots
+    float* slot = host_input_.data();
+    for (int b = 0; b < batch->size; b++) {
+        std::cout << batch->names[b] << "  " << batch->first + b << std::endl;
+        const cv::Mat& temp = batch->images[b];
         if (temp.empty()){
             std::cerr << "Fatal error: image cannot open!" << std::endl;
             return false;
         }
-        cv::Mat pr_img = preprocess_img(temp, input_w_, input_h_);
-        input_imgs_.push_back(pr_img);
+        preprocess_img_cpu(temp.data, temp.cols, temp.rows, temp.step, slot, input_w_, input_h_);
+        slot += 3 * input_w_ * input_h_;
     }
-    img_idx_ += batchsize_;
-    cv::Mat blob = cv::dnn::blobFromImages(input_imgs_, 1.0 / 255.0, cv::Size(input_w_, input_h_), cv::Scalar(0, 0, 0), true, false);
 
-    CUDA_CHECK(cudaMemcpy(device_input_, blob.ptr<float>(0), input_count_ * sizeof(float), cudaMemcpyHostToDevice));
+    CUDA_CHECK(cudaMemcpy(device_input_, host_input_.data(), input_count_ * sizeof(float), cudaMemcpyHostToDevice));
     assert(!strcmp(names[0], input_blob_name_));
     bindings[0] = device_input_;
     return true;
@@ -2,10 +2,13 @@
 #define ENTROPY_CALIBRATOR_H
 
 #include <NvInfer.h>
+#include <memory>
 #include <string>
 #include <vector>
 #include "macros.h"
 
+class ImageLoader;
+
 //! \class Int8EntropyCalibrator2
 //!
 //! \brief Implements Entropy calibrator 2.
@@ -26,14 +29,16 @@ private:
     int batchsize_;
     int input_w_;
     int input_h_;
-    int img_idx_;
     std::string img_dir_;
     std::vector<std::string> img_files_;
+    // decodes the next batches while TensorRT runs this one, made by the first getBatch
+    std::unique_ptr<ImageLoader> loader_;
     size_t input_count_;
     std::string calib_table_name_;
     const char* input_blob_name_;
     bool read_cache_;
     void* device_input_;
+    std::vector<float> host_input_;
     std::vector<char> calib_cache_;
 };
 
@@ -7,120 +7,30 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "NvInfer.h"
+#include "wts_loader.h"
+#include "nms_engine.h"
 #include "yololayer.h"
+#include "inputlayer.h"
+#include "postprocess_cpu.h"
 
 using namespace nvinfer1;
 
 cv::Rect get_rect(cv::Mat& img, float bbox[4]) {
-    float l, r, t, b;
-    float r_w = Yolo::INPUT_W / (img.cols * 1.0);
-    float r_h = Yolo::INPUT_H / (img.rows * 1.0);
-    if (r_h > r_w) {
-        l = bbox[0] - bbox[2] / 2.f;
-        r = bbox[0] + bbox[2] / 2.f;
-        t = bbox[1] - bbox[3] / 2.f - (Yolo::INPUT_H - r_w * img.rows) / 2;
-        b = bbox[1] + bbox[3] / 2.f - (Yolo::INPUT_H - r_w * img.rows) / 2;
-        l = l / r_w;
-        r = r / r_w;
-        t = t / r_w;
-        b = b / r_w;
-    } else {
-        l = bbox[0] - bbox[2] / 2.f - (Yolo::INPUT_W - r_h * img.cols) / 2;
-        r = bbox[0] + bbox[2] / 2.f - (Yolo::INPUT_W - r_h * img.cols) / 2;
-        t = bbox[1] - bbox[3] / 2.f;
-        b = bbox[1] + bbox[3] / 2.f;
-        l = l / r_h;
-        r = r / r_h;
-        t = t / r_h;
-        b = b / r_h;
-    }
-    return cv::Rect(round(l), round(t), round(r - l), round(b - t));
-}
-
-float iou(float lbox[4], float rbox[4]) {
-    float interBox[] = {
-        (std::max)(lbox[0] - lbox[2] / 2.f , rbox[0] - rbox[2] / 2.f), //left
-        (std::min)(lbox[0] + lbox[2] / 2.f , rbox[0] + rbox[2] / 2.f), //right
-        (std::max)(lbox[1] - lbox[3] / 2.f , rbox[1] - rbox[3] / 2.f), //top
-        (std::min)(lbox[1] + lbox[3] / 2.f , rbox[1] + rbox[3] / 2.f), //bottom
-    };
-
-    if (interBox[2] > interBox[3] || interBox[0] > interBox[1])
-        return 0.0f;
-
-    float interBoxS = (interBox[1] - interBox[0])*(interBox[3] - interBox[2]);
-    return interBoxS / (lbox[2] * lbox[3] + rbox[2] * rbox[3] - interBoxS);
+    float xyxy[4];
+    letterbox_to_image(bbox, img.cols, img.rows, Yolo::INPUT_W, Yolo::INPUT_H, xyxy);
+    return cv::Rect(round(xyxy[0]), round(xyxy[1]), round(xyxy[2] - xyxy[0]), round(xyxy[3] - xyxy[1]));
 }
 
-bool cmp(const Yolo::Detection& a, const Yolo::Detection& b) {
-    return a.conf > b.conf;
+// get_rect for img decoded at a reduced scale (jpeg_scale.h), in pixels of the original image.
+cv::Rect get_rect(cv::Mat& img, const cv::Size& original, float bbox[4]) {
+    float xyxy[4];
+    letterbox_to_image(bbox, img.cols, img.rows, Yolo::INPUT_W, Yolo::INPUT_H, xyxy);
+    scale_to_original(xyxy, img.cols, img.rows, original.width, original.height);
+    return cv::Rect(round(xyxy[0]), round(xyxy[1]), round(xyxy[2] - xyxy[0]), round(xyxy[3] - xyxy[1]));
 }
 
 void nms(std::vector<Yolo::Detection>& res, float *output, float conf_thresh, float nms_thresh = 0.5) {
-    int det_size = sizeof(Yolo::Detection) / sizeof(float);
-    std::map<float, std::vector<Yolo::Detection>> m;
-    for (int i = 0; i < output[0] && i < Yolo::MAX_OUTPUT_BBOX_COUNT; i++) {
-        if (output[1 + det_size * i + 4] <= conf_thresh) continue;
-        Yolo::Detection det;
-        memcpy(&det, &output[1 + det_size * i], det_size * sizeof(float));
-        if (m.count(det.class_id) == 0) m.emplace(det.class_id, std::vector<Yolo::Detection>());
-        m[det.class_id].push_back(det);
-    }
-    for (auto it = m.begin(); it != m.end(); it++) {
-        //std::cout << it->second[0].class_id << " --- " << std::endl;
-        auto& dets = it->second;
-        std::sort(dets.begin(), dets.end(), cmp);
-        for (size_t m = 0; m < dets.size(); ++m) {
-            auto& item = dets[m];
-            res.push_back(item);
-            for (size_t n = m + 1; n < dets.size(); ++n) {
-                if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
-                    dets.erase(dets.begin() + n);
-                    --n;
-                }
-            }
-        }
-    }
-}
-
-// TensorRT weight files have a simple space delimited format:
-// [type] [size] <data x size in hex>
-std::map<std::string, Weights> loadWeights(const std::string file) {
-    std::cout << "Loading weights: " << file << std::endl;
-    std::map<std::string, Weights> weightMap;
-
-    // Open weights file
-    std::ifstream input(file);
-    assert(input.is_open() && "Unable to load weight file. please check if the .wts file path is right!!!!!!");
-
-    // Read number of weight blobs
-    int32_t count;
-    input >> count;
-    assert(count > 0 && "Invalid weight map file.");
-
-    while (count--)
-    {
-        Weights wt{ DataType::kFLOAT, nullptr, 0 };
-        uint32_t size;
-
-        // Read name and type of blob
-        std::string name;
-        input >> name >> std::dec >> size;
-        wt.type = DataType::kFLOAT;
-
-        // Load blob
-        uint32_t* val = reinterpret_cast<uint32_t*>(malloc(sizeof(val) * size));
-        for (uint32_t x = 0, y = size; x < y; ++x)
-        {
-            input >> std::hex >> val[x];
-        }
-        wt.values = val;
-
-        wt.count = size;
-        weightMap[name] = wt;
-    }
-
-    return weightMap;
+    boxnms::nmsDetections(res, output, conf_thresh, nms_thresh, Yolo::MAX_OUTPUT_BBOX_COUNT);
 }
 
 IScaleLayer* addBatchNorm2d(INetworkDefinition *network, std::map<std::string, Weights>& weightMap, ITensor& input, std::string lname, float eps) {
@@ -289,6 +199,37 @@ std::vector<std::vector<float>> getAnchors(std::map<std::string, Weights>& weigh
     return anchors;
 }
 
+// The network input named name in the given wire format. FP32 is the 3 x H x W
+// tensor the backbone consumes directly; UINT8 / FP16 add an InputLayer_TRT that
+// normalizes and planarizes the packed BGR HWC binding on the GPU.
+ITensor* addNetworkInput(INetworkDefinition *network, const char* name, InputFormat format, int input_w, int input_h) {
+    if (format == INPUT_FORMAT_FP32) {
+        return network->addInput(name, DataType::kFLOAT, Dims3{ 3, input_h, input_w });
+    }
+    ITensor* packed;
+    if (format == INPUT_FORMAT_UINT8) {
+        // four uint8 channels per INT32 element
+        assert(input_w * 3 % 4 == 0);
+        packed = network->addInput(name, DataType::kINT32, Dims2{ input_h, input_w * 3 / 4 });
+    } else {
+        packed = network->addInput(name, DataType::kHALF, Dims3{ input_h, input_w, 3 });
+    }
+    assert(packed);
+    auto creator = getPluginRegistry()->getPluginCreator("InputLayer_TRT", "1");
+    PluginField plugin_fields[1];
+    int netinfo[3] = {format, input_w, input_h};
+    plugin_fields[0].data = netinfo;
+    plugin_fields[0].length = 3;
+    plugin_fields[0].name = "netinfo";
+    plugin_fields[0].type = PluginFieldType::kINT32;
+    PluginFieldCollection plugin_data;
+    plugin_data.nbFields = 1;
+    plugin_data.fields = plugin_fields;
+    IPluginV2 *plugin_obj = creator->createPlugin("inputlayer", &plugin_data);
+    auto input = network->addPluginV2(&packed, 1, *plugin_obj);
+    return input->getOutput(0);
+}
+
 IPluginV2Layer* addYoLoLayer(INetworkDefinition *network, std::map<std::string, Weights>& weightMap, std::string lname, std::vector<IConvolutionLayer*> dets) {
     auto creator = getPluginRegistry()->getPluginCreator("YoloLayer_TRT", "1");
     auto anchors = getAnchors(weightMap, lname);
@@ -10,19 +10,45 @@ def parse_args():
     parser = argparse.ArgumentParser(description='Convert .pt file to .wts')
     parser.add_argument('-w', '--weights', required=True, help='Input weights (.pt) file path (required)')
     parser.add_argument('-o', '--output', help='Output (.wts) file path (optional)')
+    parser.add_argument('-b', '--binary', action='store_true',
+                        help='Write the mmap-able binary container (.wtsb) instead of hex text')
     args = parser.parse_args()
     if not os.path.isfile(args.weights):
         raise SystemExit('Invalid input file')
+    ext = '.wtsb' if args.binary else '.wts'
     if not args.output:
-        args.output = os.path.splitext(args.weights)[0] + '.wts'
+        args.output = os.path.splitext(args.weights)[0] + ext
     elif os.path.isdir(args.output):
         args.output = os.path.join(
             args.output,
-            os.path.splitext(os.path.basename(args.weights))[0] + '.wts')
-    return args.weights, args.output
+            os.path.splitext(os.path.basename(args.weights))[0] + ext)
+    return args.weights, args.output, args.binary
 
 
-pt_file, wts_file = parse_args()
+def write_binary(path, state_dict, alignment=64):
+    # Layout documented in tensorrtx/common/wts_loader.h: 32-byte header, name index,
+    # then little-endian fp32 blobs each starting on an `alignment` boundary.
+    blobs = [(k, v.reshape(-1).cpu().numpy().astype('<f4')) for k, v in sorted(state_dict.items())]
+    align = lambda x: (x + alignment - 1) // alignment * alignment
+    index_size = sum(4 + len(k.encode()) + 4 + 8 + 8 for k, _ in blobs)
+    offset = align(32 + index_size)
+    index = b''
+    offsets = []
+    for k, vr in blobs:
+        name = k.encode()
+        index += struct.pack('<I', len(name)) + name + struct.pack('<IQQ', 0, vr.size, offset)
+        offsets.append(offset)
+        offset = align(offset + vr.nbytes)
+    with open(path, 'wb') as f:
+        f.write(b'TRTW' + struct.pack('<IIIQQ', 1, len(blobs), alignment, 32, offset))
+        f.write(index)
+        for (k, vr), off in zip(blobs, offsets):
+            f.write(b'\0' * (off - f.tell()))
+            f.write(vr.tobytes())
+        f.write(b'\0' * (offset - f.tell()))
+
+
+pt_file, wts_file, binary = parse_args()
 
 # Initialize
 device = select_device('cpu')
@@ -37,6 +63,10 @@ model.model[-1].register_buffer("anchor_grid",anchor_grid) #The parameters are s
 
 model.to(device).eval()
 
+if binary:
+    write_binary(wts_file, model.state_dict())
+    sys.exit(0)
+
 with open(wts_file, 'w') as f:
     f.write('{}\n'.format(len(model.state_dict().keys())))
     for k, v in model.state_dict().items():
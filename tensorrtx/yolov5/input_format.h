@@ -0,0 +1,120 @@
+#ifndef TRTX_YOLOV5_INPUT_FORMAT_H_
+#define TRTX_YOLOV5_INPUT_FORMAT_H_
+
+#include <cstdint>
+#include <cstring>
+
+// Wire formats of the "data" binding. FP32 is the original contract: RGB CHW
+// float / 255, filled by preprocess_kernel_img or preprocess_img_cpu. The other
+// two carry the letterboxed image as it comes out of OpenCV, BGR HWC and not
+// normalized, and the engine's first layer (InputLayerPlugin) turns that into
+// the FP32 CHW tensor:
+//   UINT8 - 1 byte per channel. TensorRT has no uint8 bindings, so the bytes
+//           are declared as an INT32 tensor of shape {H, W * 3 / 4}; the memory
+//           layout is exactly the uint8 HWC image.
+//   FP16  - 2 bytes per channel, shape {H, W, 3}, keeps the fractional part of
+//           the bilinear sample.
+// The functions below are that first layer's math, shared by the CUDA kernel in
+// inputlayer.cu and the CPU reference, the same way warpaffine.h is.
+
+#ifdef __CUDACC__
+#define INPUT_FORMAT_HD __host__ __device__
+#else
+#define INPUT_FORMAT_HD
+#endif
+
+enum InputFormat {
+    INPUT_FORMAT_FP32 = 0,
+    INPUT_FORMAT_UINT8 = 1,
+    INPUT_FORMAT_FP16 = 2,
+};
+
+// Bytes per image of the "data" binding.
+inline int input_format_bytes(InputFormat format, int width, int height) {
+    switch (format) {
+        case INPUT_FORMAT_UINT8: return 3 * width * height;
+        case INPUT_FORMAT_FP16: return 3 * width * height * 2;
+        default: return 3 * width * height * 4;
+    }
+}
+
+INPUT_FORMAT_HD inline float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0x1F) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // subnormal, renormalize
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Round to nearest even. Only used on the host, for values in [0, 255].
+inline uint16_t float_to_half(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exp = ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = bits & 0x7FFFFF;
+    if (exp >= 0x1F) return sign | 0x7C00;
+    if (exp <= 0) {
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        uint32_t rest = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rest > mid || (rest == mid && (half & 1))) half++;
+        return sign | half;
+    }
+    // Branchless round to nearest even on the 13 dropped mantissa bits, a carry
+    // into the exponent is the correct result.
+    uint32_t rounded = (bits & 0x7FFFFFFF) + 0x0FFF + ((bits >> 13) & 1);
+    uint32_t half = (rounded >> 13) - ((127 - 15) << 10);
+    return sign | (half > 0x7C00 ? 0x7C00 : half);
+}
+
+// Pixel i of a BGR HWC image into planes R, G, B of dst, / 255.
+INPUT_FORMAT_HD inline void normalize_pixel_uint8(const uint8_t* src, float* dst, int area, int i) {
+    const uint8_t* p = src + 3 * i;
+    dst[i] = p[2] / 255.0f;
+    dst[area + i] = p[1] / 255.0f;
+    dst[2 * area + i] = p[0] / 255.0f;
+}
+
+INPUT_FORMAT_HD inline void normalize_pixel_fp16(const uint16_t* src, float* dst, int area, int i) {
+    const uint16_t* p = src + 3 * i;
+    dst[i] = half_to_float(p[2]) / 255.0f;
+    dst[area + i] = half_to_float(p[1]) / 255.0f;
+    dst[2 * area + i] = half_to_float(p[0]) / 255.0f;
+}
+
+// CPU reference of InputLayerPlugin for one image: src in the given wire format,
+// dst the 3 * width * height FP32 network input.
+inline void normalize_input_cpu(InputFormat format, const void* src, float* dst, int width, int height) {
+    int area = width * height;
+    for (int i = 0; i < area; i++) {
+        if (format == INPUT_FORMAT_UINT8) {
+            normalize_pixel_uint8(static_cast<const uint8_t*>(src), dst, area, i);
+        } else if (format == INPUT_FORMAT_FP16) {
+            normalize_pixel_fp16(static_cast<const uint16_t*>(src), dst, area, i);
+        }
+    }
+    if (format == INPUT_FORMAT_FP32) memcpy(dst, src, 3 * area * sizeof(float));
+}
+
+#endif  // TRTX_YOLOV5_INPUT_FORMAT_H_
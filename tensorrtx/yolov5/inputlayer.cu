@@ -0,0 +1,195 @@
+#include <assert.h>
+#include <string.h>
+#include "inputlayer.h"
+#include "cuda_utils.h"
+
+namespace nvinfer1
+{
+    InputLayerPlugin::InputLayerPlugin(InputFormat format, int netWidth, int netHeight)
+    {
+        mFormat = format;
+        mNetWidth = netWidth;
+        mNetHeight = netHeight;
+    }
+
+    // create the plugin at runtime from a byte stream
+    InputLayerPlugin::InputLayerPlugin(const void* data, size_t length)
+    {
+        const char *d = reinterpret_cast<const char *>(data), *a = d;
+        memcpy(&mFormat, d, sizeof(mFormat));
+        d += sizeof(mFormat);
+        memcpy(&mNetWidth, d, sizeof(mNetWidth));
+        d += sizeof(mNetWidth);
+        memcpy(&mNetHeight, d, sizeof(mNetHeight));
+        d += sizeof(mNetHeight);
+        assert(d == a + length);
+    }
+
+    void InputLayerPlugin::serialize(void* buffer) const TRT_NOEXCEPT
+    {
+        char* d = static_cast<char*>(buffer), *a = d;
+        memcpy(d, &mFormat, sizeof(mFormat));
+        d += sizeof(mFormat);
+        memcpy(d, &mNetWidth, sizeof(mNetWidth));
+        d += sizeof(mNetWidth);
+        memcpy(d, &mNetHeight, sizeof(mNetHeight));
+        d += sizeof(mNetHeight);
+        assert(d == a + getSerializationSize());
+    }
+
+    size_t InputLayerPlugin::getSerializationSize() const TRT_NOEXCEPT
+    {
+        return sizeof(mFormat) + sizeof(mNetWidth) + sizeof(mNetHeight);
+    }
+
+    int InputLayerPlugin::initialize() TRT_NOEXCEPT
+    {
+        return 0;
+    }
+
+    Dims InputLayerPlugin::getOutputDimensions(int index, const Dims* inputs, int nbInputDims) TRT_NOEXCEPT
+    {
+        return Dims3(3, mNetHeight, mNetWidth);
+    }
+
+    bool InputLayerPlugin::supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) const TRT_NOEXCEPT
+    {
+        if (inOut[pos].format != TensorFormat::kLINEAR) return false;
+        if (pos == 1) return inOut[pos].type == DataType::kFLOAT;
+        // uint8 bytes travel as INT32, TensorRT has no 8-bit unsigned bindings
+        return inOut[pos].type == (mFormat == INPUT_FORMAT_FP16 ? DataType::kHALF : DataType::kINT32);
+    }
+
+    // Set plugin namespace
+    void InputLayerPlugin::setPluginNamespace(const char* pluginNamespace) TRT_NOEXCEPT
+    {
+        mPluginNamespace = pluginNamespace;
+    }
+
+    const char* InputLayerPlugin::getPluginNamespace() const TRT_NOEXCEPT
+    {
+        return mPluginNamespace;
+    }
+
+    DataType InputLayerPlugin::getOutputDataType(int index, const nvinfer1::DataType* inputTypes, int nbInputs) const TRT_NOEXCEPT
+    {
+        return DataType::kFLOAT;
+    }
+
+    bool InputLayerPlugin::isOutputBroadcastAcrossBatch(int outputIndex, const bool* inputIsBroadcasted, int nbInputs) const TRT_NOEXCEPT
+    {
+        return false;
+    }
+
+    bool InputLayerPlugin::canBroadcastInputAcrossBatch(int inputIndex) const TRT_NOEXCEPT
+    {
+        return false;
+    }
+
+    void InputLayerPlugin::configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput) TRT_NOEXCEPT
+    {
+    }
+
+    void InputLayerPlugin::attachToContext(cudnnContext* cudnnContext, cublasContext* cublasContext, IGpuAllocator* gpuAllocator) TRT_NOEXCEPT
+    {
+    }
+
+    void InputLayerPlugin::detachFromContext() TRT_NOEXCEPT {}
+
+    const char* InputLayerPlugin::getPluginType() const TRT_NOEXCEPT
+    {
+        return "InputLayer_TRT";
+    }
+
+    const char* InputLayerPlugin::getPluginVersion() const TRT_NOEXCEPT
+    {
+        return "1";
+    }
+
+    void InputLayerPlugin::destroy() TRT_NOEXCEPT
+    {
+        delete this;
+    }
+
+    IPluginV2IOExt* InputLayerPlugin::clone() const TRT_NOEXCEPT
+    {
+        InputLayerPlugin* p = new InputLayerPlugin((InputFormat)mFormat, mNetWidth, mNetHeight);
+        p->setPluginNamespace(mPluginNamespace);
+        return p;
+    }
+
+    // One thread per pixel, all images of the batch.
+    __global__ void normalize_uint8_kernel(const uint8_t* input, float* output, int area, int total)
+    {
+        int idx = threadIdx.x + blockDim.x * blockIdx.x;
+        if (idx >= total) return;
+        int b = idx / area;
+        normalize_pixel_uint8(input + (size_t)b * area * 3, output + (size_t)b * area * 3, area, idx - b * area);
+    }
+
+    __global__ void normalize_fp16_kernel(const uint16_t* input, float* output, int area, int total)
+    {
+        int idx = threadIdx.x + blockDim.x * blockIdx.x;
+        if (idx >= total) return;
+        int b = idx / area;
+        normalize_pixel_fp16(input + (size_t)b * area * 3, output + (size_t)b * area * 3, area, idx - b * area);
+    }
+
+    int InputLayerPlugin::enqueue(int batchSize, const void* const* inputs, void* TRT_CONST_ENQUEUE* outputs, void* workspace, cudaStream_t stream) TRT_NOEXCEPT
+    {
+        int area = mNetWidth * mNetHeight;
+        int total = area * batchSize;
+        int blocks = (total + mThreadCount - 1) / mThreadCount;
+        if (mFormat == INPUT_FORMAT_FP16) {
+            normalize_fp16_kernel << <blocks, mThreadCount, 0, stream >> > ((const uint16_t*)inputs[0], (float*)outputs[0], area, total);
+        } else {
+            normalize_uint8_kernel << <blocks, mThreadCount, 0, stream >> > ((const uint8_t*)inputs[0], (float*)outputs[0], area, total);
+        }
+        return cudaGetLastError() == cudaSuccess ? 0 : -1;
+    }
+
+    PluginFieldCollection InputLayerPluginCreator::mFC{};
+    std::vector<PluginField> InputLayerPluginCreator::mPluginAttributes;
+
+    InputLayerPluginCreator::InputLayerPluginCreator()
+    {
+        mPluginAttributes.clear();
+
+        mFC.nbFields = mPluginAttributes.size();
+        mFC.fields = mPluginAttributes.data();
+    }
+
+    const char* InputLayerPluginCreator::getPluginName() const TRT_NOEXCEPT
+    {
+        return "InputLayer_TRT";
+    }
+
+    const char* InputLayerPluginCreator::getPluginVersion() const TRT_NOEXCEPT
+    {
+        return "1";
+    }
+
+    const PluginFieldCollection* InputLayerPluginCreator::getFieldNames() TRT_NOEXCEPT
+    {
+        return &mFC;
+    }
+
+    IPluginV2IOExt* InputLayerPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc) TRT_NOEXCEPT
+    {
+        assert(fc->nbFields == 1);
+        assert(strcmp(fc->fields[0].name, "netinfo") == 0);
+        int *p_netinfo = (int*)(fc->fields[0].data);
+        InputLayerPlugin* obj = new InputLayerPlugin((InputFormat)p_netinfo[0], p_netinfo[1], p_netinfo[2]);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    IPluginV2IOExt* InputLayerPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength) TRT_NOEXCEPT
+    {
+        // This object will be deleted when the network is destroyed, which will
+        // call InputLayerPlugin::destroy()
+        InputLayerPlugin* obj = new InputLayerPlugin(serialData, serialLength);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+}
@@ -0,0 +1,182 @@
+// Checks postprocess_image against nms() + get_rect, the per-image path it
+// replaces in yolov5.cpp, and times both, then times postprocess_batch over a
+// 32 image batch on one thread and on a WorkerPool. Runs on recorded yolo layer
+// outputs, e.g. from ./yolov5 -d yolov5s.engine ../samples prob.bin, or on
+// synthetic ones without a dump. Needs no GPU.
+//   ./postprocess_bench [prob.bin] [iterations]
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "postprocess_cpu.h"
+
+static const int DET_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+static const int OUTPUT_SIZE = Yolo::MAX_OUTPUT_BBOX_COUNT * DET_SIZE + 1;
+static const int IMG_W = 1920;
+static const int IMG_H = 1080;
+static const int BATCH = 32;
+
+// nms() and the get_rect loop of yolov5.cpp before postprocess_image.
+static float iou(float lbox[4], float rbox[4]) {
+    float interBox[] = {
+        (std::max)(lbox[0] - lbox[2] / 2.f , rbox[0] - rbox[2] / 2.f), //left
+        (std::min)(lbox[0] + lbox[2] / 2.f , rbox[0] + rbox[2] / 2.f), //right
+        (std::max)(lbox[1] - lbox[3] / 2.f , rbox[1] - rbox[3] / 2.f), //top
+        (std::min)(lbox[1] + lbox[3] / 2.f , rbox[1] + rbox[3] / 2.f), //bottom
+    };
+
+    if (interBox[2] > interBox[3] || interBox[0] > interBox[1])
+        return 0.0f;
+
+    float interBoxS = (interBox[1] - interBox[0])*(interBox[3] - interBox[2]);
+    return interBoxS / (lbox[2] * lbox[3] + rbox[2] * rbox[3] - interBoxS);
+}
+
+static void nms_reference(std::vector<Yolo::Detection>& res, const float* output, float conf_thresh, float nms_thresh) {
+    std::map<float, std::vector<Yolo::Detection>> m;
+    for (int i = 0; i < output[0] && i < Yolo::MAX_OUTPUT_BBOX_COUNT; i++) {
+        if (output[1 + DET_SIZE * i + 4] <= conf_thresh) continue;
+        Yolo::Detection det;
+        memcpy(&det, &output[1 + DET_SIZE * i], DET_SIZE * sizeof(float));
+        m[det.class_id].push_back(det);
+    }
+    for (auto it = m.begin(); it != m.end(); it++) {
+        auto& dets = it->second;
+        std::stable_sort(dets.begin(), dets.end(), [](const Yolo::Detection& a, const Yolo::Detection& b) { return a.conf > b.conf; });
+        for (size_t m = 0; m < dets.size(); ++m) {
+            auto& item = dets[m];
+            res.push_back(item);
+            for (size_t n = m + 1; n < dets.size(); ++n) {
+                if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
+                    dets.erase(dets.begin() + n);
+                    --n;
+                }
+            }
+        }
+    }
+}
+
+static void reference(std::vector<ImageDetection>& out, const float* prob, const PostprocessParams& params) {
+    std::vector<Yolo::Detection> res;
+    nms_reference(res, prob, params.conf_thresh, params.nms_thresh);
+    out.clear();
+    for (auto& det : res) {
+        ImageDetection d;
+        float xyxy[4];
+        letterbox_to_image(det.bbox, IMG_W, IMG_H, params.input_w, params.input_h, xyxy);
+        d.x1 = xyxy[0];
+        d.y1 = xyxy[1];
+        d.x2 = xyxy[2];
+        d.y2 = xyxy[3];
+        d.conf = det.conf;
+        d.class_id = det.class_id;
+        out.push_back(d);
+    }
+}
+
+// The yolo layer writes every box with conf >= IGNORE_THRESH, mostly low
+// confidence ones around a few objects.
+static std::vector<float> synthetic_frame(int boxes, std::mt19937& rng) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<float> prob(OUTPUT_SIZE, 0.f);
+    prob[0] = boxes;
+    for (int i = 0; i < boxes; i++) {
+        float* det = &prob[1 + DET_SIZE * i];
+        det[0] = 640 * u(rng);
+        det[1] = 80 + 480 * u(rng);
+        det[2] = 16 + 200 * u(rng);
+        det[3] = 16 + 200 * u(rng);
+        float c = u(rng);
+        det[4] = Yolo::IGNORE_THRESH + (1 - Yolo::IGNORE_THRESH) * c * c * c;
+        det[5] = (float)(rng() % 8);
+    }
+    return prob;
+}
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+static bool same(const std::vector<ImageDetection>& a, const ImageDetection* b, int n) {
+    return (int)a.size() == n && memcmp(a.data(), b, n * sizeof(ImageDetection)) == 0;
+}
+
+int main(int argc, char** argv) {
+    const char* dump = nullptr;
+    int iterations = 20;
+    for (int i = 1; i < argc; i++) {
+        if (atoi(argv[i]) > 0) iterations = atoi(argv[i]);
+        else dump = argv[i];
+    }
+
+    std::vector<std::vector<float>> frames;
+    if (dump) {
+        std::ifstream in(dump, std::ios::binary);
+        std::vector<float> prob(OUTPUT_SIZE);
+        while (in.read(reinterpret_cast<char*>(prob.data()), OUTPUT_SIZE * sizeof(float))) frames.push_back(prob);
+        if (frames.empty()) {
+            std::cerr << dump << ": no whole prob tensor (" << OUTPUT_SIZE << " floats)" << std::endl;
+            return 1;
+        }
+    } else {
+        std::mt19937 rng(0);
+        for (int boxes : {20, 100, 300, 1000}) frames.push_back(synthetic_frame(boxes, rng));
+    }
+
+    PostprocessParams params;
+    PostprocessParams top300 = params;
+    top300.top_k = 300;
+    DetectionArena arena(BATCH, Yolo::MAX_OUTPUT_BBOX_COUNT);
+    std::vector<ImageDetection> expected;
+    bool ok = true;
+    double t_ref = 0, t_all = 0, t_top = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        const float* prob = frames[f].data();
+        reference(expected, prob, params);
+        int n = postprocess_image(prob, IMG_W, IMG_H, params, arena.image(0), arena.maxPerImage());
+        bool match = same(expected, arena.image(0), n);
+        ok = ok && match;
+        int n_top = postprocess_image(prob, IMG_W, IMG_H, top300, arena.image(0), arena.maxPerImage());
+
+        double ref_ms = time_ms(iterations, [&]() { reference(expected, prob, params); });
+        double all_ms = time_ms(iterations, [&]() { postprocess_image(prob, IMG_W, IMG_H, params, arena.image(0), arena.maxPerImage()); });
+        double top_ms = time_ms(iterations, [&]() { postprocess_image(prob, IMG_W, IMG_H, top300, arena.image(0), arena.maxPerImage()); });
+        t_ref += ref_ms;
+        t_all += all_ms;
+        t_top += top_ms;
+        if (frames.size() <= 16) {
+            std::cout << "frame " << f << ": " << (int)prob[0] << " boxes, kept " << n << (match ? " same as nms() + get_rect" : " MISMATCH")
+                      << ", " << n_top << " with top-300  nms() + get_rect " << ref_ms << "ms  postprocess_image " << all_ms
+                      << "ms  top-300 " << top_ms << "ms" << std::endl;
+        }
+    }
+    std::cout << frames.size() << " frames, per frame: nms() + get_rect " << t_ref / frames.size() << "ms  postprocess_image "
+              << t_all / frames.size() << "ms  top-300 " << t_top / frames.size() << "ms" << (ok ? "" : "  MISMATCH") << std::endl;
+
+    // One batch of BATCH frames, cycling through the recorded ones.
+    std::vector<float> batch((size_t)BATCH * OUTPUT_SIZE);
+    std::vector<int> img_sizes(2 * BATCH);
+    for (int b = 0; b < BATCH; b++) {
+        memcpy(&batch[(size_t)b * OUTPUT_SIZE], frames[b % frames.size()].data(), OUTPUT_SIZE * sizeof(float));
+        img_sizes[2 * b] = IMG_W;
+        img_sizes[2 * b + 1] = IMG_H;
+    }
+    WorkerPool pool;
+    double serial = time_ms(iterations, [&]() { postprocess_batch(batch.data(), BATCH, OUTPUT_SIZE, img_sizes.data(), top300, arena); });
+    double pooled = time_ms(iterations, [&]() { postprocess_batch(batch.data(), BATCH, OUTPUT_SIZE, img_sizes.data(), top300, arena, &pool); });
+    for (int b = 0; b < BATCH; b++) {
+        int n = postprocess_image(&batch[(size_t)b * OUTPUT_SIZE], IMG_W, IMG_H, top300, arena.image(0), arena.maxPerImage());
+        ok = ok && n == arena.count(b);
+    }
+    std::cout << "batch " << BATCH << ", top-300: 1 thread " << serial << "ms  " << pool.size() << " threads " << pooled << "ms" << std::endl;
+    return ok ? 0 : 1;
+}
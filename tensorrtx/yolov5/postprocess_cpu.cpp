@@ -0,0 +1,104 @@
+#include "postprocess_cpu.h"
+#include <algorithm>
+#include <utility>
+#include "nms_engine.h"
+
+namespace {
+
+const int DET_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+
+// Heap order: the top is the candidate to drop first, lowest conf and, among
+// equal conf, the latest slot.
+struct DropFirst {
+    bool operator()(const std::pair<float, int>& a, const std::pair<float, int>& b) const {
+        if (a.first != b.first) return a.first > b.first;
+        return a.second < b.second;
+    }
+};
+
+}  // namespace
+
+int postprocess_image(const float* prob, int img_width, int img_height, const PostprocessParams& params,
+                      ImageDetection* out, int capacity) {
+    return postprocess_image(prob, img_width, img_height, img_width, img_height, params, out, capacity);
+}
+
+int postprocess_image(const float* prob, int img_width, int img_height, int original_width, int original_height,
+                      const PostprocessParams& params, ImageDetection* out, int capacity) {
+    static thread_local std::vector<std::pair<float, int>> heap;
+    static thread_local boxnms::NmsEngine engine;
+    const int count = std::min((int)prob[0], Yolo::MAX_OUTPUT_BBOX_COUNT);
+    const int top_k = std::max(params.top_k, 0);
+    const float* dets = prob + 1;
+    // Candidates are appended in slot order until there are top_k of them; only
+    // then do they become a heap, so the common sparse frame skips heap upkeep.
+    heap.clear();
+    heap.reserve(std::min(count, top_k));
+    bool full = false;
+    for (int i = 0; i < count; i++) {
+        float conf = dets[DET_SIZE * i + 4];
+        if (conf <= params.conf_thresh) continue;
+        if (!full) {
+            if ((int)heap.size() < top_k) {
+                heap.emplace_back(conf, i);
+                continue;
+            }
+            if (top_k == 0) break;
+            std::make_heap(heap.begin(), heap.end(), DropFirst());
+            full = true;
+        }
+        if (conf > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), DropFirst());
+            heap.back() = std::make_pair(conf, i);
+            std::push_heap(heap.begin(), heap.end(), DropFirst());
+        }
+    }
+    // Back to slot order, which nms() uses to break ties between equal scores.
+    if (full) {
+        std::sort(heap.begin(), heap.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+            return a.second < b.second;
+        });
+    }
+    engine.reset();
+    for (const auto& h : heap) {
+        const float* det = &dets[DET_SIZE * h.second];
+        engine.addCenter(det, det[4], (int)det[5]);
+    }
+    boxnms::Config config;
+    config.iou_thresh = params.nms_thresh;
+    int n = 0;
+    for (int k : engine.run(config)) {
+        if (n == capacity) break;
+        const float* det = &dets[DET_SIZE * heap[k].second];
+        ImageDetection& d = out[n++];
+        float xyxy[4];
+        letterbox_to_image(det, img_width, img_height, params.input_w, params.input_h, xyxy);
+        scale_to_original(xyxy, img_width, img_height, original_width, original_height);
+        d.x1 = xyxy[0];
+        d.y1 = xyxy[1];
+        d.x2 = xyxy[2];
+        d.y2 = xyxy[3];
+        d.conf = det[4];
+        d.class_id = det[5];
+    }
+    return n;
+}
+
+void postprocess_batch(const float* prob, int batch, int output_size, const int* img_sizes,
+                       const PostprocessParams& params, DetectionArena& arena, WorkerPool* pool) {
+    postprocess_batch(prob, batch, output_size, img_sizes, img_sizes, params, arena, pool);
+}
+
+void postprocess_batch(const float* prob, int batch, int output_size, const int* img_sizes, const int* original_sizes,
+                       const PostprocessParams& params, DetectionArena& arena, WorkerPool* pool) {
+    auto run = [&](int b) {
+        int n = postprocess_image(prob + (size_t)b * output_size, img_sizes[2 * b], img_sizes[2 * b + 1],
+                                  original_sizes[2 * b], original_sizes[2 * b + 1], params, arena.image(b), arena.maxPerImage());
+        arena.setCount(b, n);
+    };
+    if (pool) {
+        pool->parallelFor(batch, run);
+    } else {
+        for (int b = 0; b < batch; b++) run(b);
+    }
+}
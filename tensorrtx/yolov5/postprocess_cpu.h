@@ -0,0 +1,114 @@
+#ifndef TRTX_YOLOV5_POSTPROCESS_CPU_H_
+#define TRTX_YOLOV5_POSTPROCESS_CPU_H_
+
+#include <vector>
+#include "yololayer.h"
+#include "worker_pool.h"
+
+// A kept detection in pixels of the original image, corners as get_rect
+// computes them before rounding to a cv::Rect.
+struct ImageDetection {
+    float x1, y1, x2, y2;
+    float conf;
+    float class_id;
+};
+
+// Caller-owned results of a batch, max_per_image slots per image allocated once.
+class DetectionArena {
+public:
+    DetectionArena(int max_batch, int max_per_image)
+        : max_per_image_(max_per_image), slots_((size_t)max_batch * max_per_image), counts_(max_batch, 0) {}
+
+    int maxBatch() const { return (int)counts_.size(); }
+    int maxPerImage() const { return max_per_image_; }
+    int count(int b) const { return counts_[b]; }
+    const ImageDetection* image(int b) const { return &slots_[(size_t)b * max_per_image_]; }
+    ImageDetection* image(int b) { return &slots_[(size_t)b * max_per_image_]; }
+    void setCount(int b, int n) { counts_[b] = n; }
+
+private:
+    int max_per_image_;
+    std::vector<ImageDetection> slots_;
+    std::vector<int> counts_;
+};
+
+struct PostprocessParams {
+    float conf_thresh = 0.5f;
+    float nms_thresh = 0.4f;
+    // Only the top_k most confident boxes above conf_thresh go to NMS.
+    int top_k = Yolo::MAX_OUTPUT_BBOX_COUNT;
+    int input_w = Yolo::INPUT_W;
+    int input_h = Yolo::INPUT_H;
+};
+
+// Maps a center x, y, w, h box of the letterboxed network input back to x1, y1,
+// x2, y2 in the img_width x img_height image, with get_rect's arithmetic.
+inline void letterbox_to_image(const float bbox[4], int img_width, int img_height, int input_w, int input_h, float xyxy[4]) {
+    float l, r, t, b;
+    float r_w = input_w / (img_width * 1.0);
+    float r_h = input_h / (img_height * 1.0);
+    if (r_h > r_w) {
+        l = bbox[0] - bbox[2] / 2.f;
+        r = bbox[0] + bbox[2] / 2.f;
+        t = bbox[1] - bbox[3] / 2.f - (input_h - r_w * img_height) / 2;
+        b = bbox[1] + bbox[3] / 2.f - (input_h - r_w * img_height) / 2;
+        l = l / r_w;
+        r = r / r_w;
+        t = t / r_w;
+        b = b / r_w;
+    } else {
+        l = bbox[0] - bbox[2] / 2.f - (input_w - r_h * img_width) / 2;
+        r = bbox[0] + bbox[2] / 2.f - (input_w - r_h * img_width) / 2;
+        t = bbox[1] - bbox[3] / 2.f;
+        b = bbox[1] + bbox[3] / 2.f;
+        l = l / r_h;
+        r = r / r_h;
+        t = t / r_h;
+        b = b / r_h;
+    }
+    xyxy[0] = l;
+    xyxy[1] = t;
+    xyxy[2] = r;
+    xyxy[3] = b;
+}
+
+// Scales x1, y1, x2, y2 of a decoded_width x decoded_height image to the
+// original_width x original_height image it was decoded from at a reduced
+// scale (jpeg_scale.h). Leaves them as they are when the sizes are equal.
+inline void scale_to_original(float xyxy[4], int decoded_width, int decoded_height, int original_width, int original_height) {
+    if (decoded_width == original_width && decoded_height == original_height) return;
+    float sx = (float)original_width / decoded_width;
+    float sy = (float)original_height / decoded_height;
+    xyxy[0] *= sx;
+    xyxy[1] *= sy;
+    xyxy[2] *= sx;
+    xyxy[3] *= sy;
+}
+
+// Post-processes one image's slice of the yolo layer output ([count, Detection...]).
+// A single pass over the filled slots keeps the top_k boxes above conf_thresh
+// in a bounded heap, without copying the others; those go through NMS and the
+// kept ones are written to out as ImageDetection, in the order of nms().
+// Returns the number written, at most capacity. With top_k covering every box
+// above the threshold the result is nms() followed by get_rect.
+// Scratch is thread_local, so a thread does not allocate once warm.
+int postprocess_image(const float* prob, int img_width, int img_height, const PostprocessParams& params,
+                      ImageDetection* out, int capacity);
+
+// Same for an img_width x img_height image decoded at a reduced scale, with
+// the boxes written in pixels of the original_width x original_height image.
+int postprocess_image(const float* prob, int img_width, int img_height, int original_width, int original_height,
+                      const PostprocessParams& params, ImageDetection* out, int capacity);
+
+// postprocess_image for each image b of a batch, whose output starts at
+// prob + b * output_size and whose size is img_sizes[2 * b], img_sizes[2 * b + 1].
+// Images are spread over pool, or run on the calling thread if it is null.
+void postprocess_batch(const float* prob, int batch, int output_size, const int* img_sizes,
+                       const PostprocessParams& params, DetectionArena& arena, WorkerPool* pool = nullptr);
+
+// Same for images decoded at a reduced scale, original_sizes (width, height
+// per image as img_sizes) being the sizes the boxes are written for.
+void postprocess_batch(const float* prob, int batch, int output_size, const int* img_sizes, const int* original_sizes,
+                       const PostprocessParams& params, DetectionArena& arena, WorkerPool* pool = nullptr);
+
+#endif  // TRTX_YOLOV5_POSTPROCESS_CPU_H_
@@ -3,14 +3,22 @@
 
 #include <cuda_runtime.h>
 #include <cstdint>
+#include "warpaffine.h"
 
 
-struct AffineMatrix{
-    float value[6];
-};
+void preprocess_kernel_img(uint8_t* src, int src_width, int src_height,
+                           float* dst, int dst_width, int dst_height,
+                           cudaStream_t stream);
 
+// Same letterbox of a src_width x src_height region whose rows are
+// src_line_size bytes apart, e.g. a tile of a larger frame.
+void preprocess_kernel_img(uint8_t* src, int src_width, int src_height, int src_line_size,
+                           float* dst, int dst_width, int dst_height,
+                           cudaStream_t stream);
 
-void preprocess_kernel_img(uint8_t* src, int src_width, int src_height,
+// Same letterbox from the planes of an NV12 / I420 frame in device memory,
+// converting only the pixels it samples (warpaffine_pixel_yuv).
+void preprocess_kernel_img(const YuvImage& src, int src_width, int src_height,
                            float* dst, int dst_width, int dst_height,
                            cudaStream_t stream);
 #endif  // __PREPROCESS_H
@@ -0,0 +1,133 @@
+// Checks preprocess_img_cpu against the per-pixel math of the CUDA letterbox
+// kernel and times both. The packed UINT8 / FP16 wire formats are run through
+// normalize_input_cpu, the CPU reference of the engine's input layer, and must
+// land within their quantization step of the same result. NV12 / I420 frames
+// letterboxed from their planes are checked against cv::cvtColor followed by the
+// BGR letterbox, and timed against it. Needs neither a GPU nor sample images.
+//   ./preprocess_bench [iterations]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "preprocess_cpu.h"
+
+static const float TOLERANCE = 1e-4f;  // well below one gray level, 1 / 255
+// Half a gray level for rounding to uint8; half an fp16 ulp at 255 (0.125 / 2) for FP16.
+static const float TOLERANCE_UINT8 = 0.5f / 255 + TOLERANCE;
+static const float TOLERANCE_FP16 = 0.0625f / 255 + TOLERANCE;
+// The YUV letterbox converts with cv::cvtColor's fixed point math and should
+// match it exactly; one gray level leaves room for a SIMD build of cvtColor
+// rounding a pixel the other way.
+static const float TOLERANCE_YUV = 1.0f / 255 + TOLERANCE;
+
+static float max_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    float max_diff = 0;
+    for (size_t i = 0; i < a.size(); i++) max_diff = std::max(max_diff, std::fabs(a[i] - b[i]));
+    return max_diff;
+}
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// A random src_w x src_h frame as NV12 or I420, converted with cvtColor and
+// letterboxed as BGR, against the letterbox of its planes.
+static bool check_yuv(int src_w, int src_h, int dst_w, int dst_h, bool nv12, int iterations, std::mt19937& rng) {
+    cv::Mat frame(src_h * 3 / 2, src_w, CV_8UC1);
+    for (int i = 0; i < frame.rows * frame.cols; i++) frame.data[i] = rng() & 0xFF;
+    YuvImage yuv = nv12 ? yuv_nv12_frame(frame.data, src_w, src_h) : yuv_i420_frame(frame.data, src_w, src_h);
+    const int code = nv12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420;
+    std::vector<float> bgr_path(3 * dst_w * dst_h), ref(3 * dst_w * dst_h), out(3 * dst_w * dst_h);
+    cv::Mat bgr;
+
+    cv::cvtColor(frame, bgr, code);
+    preprocess_img_cpu(bgr.data, bgr.cols, bgr.rows, bgr.step, bgr_path.data(), dst_w, dst_h);
+    preprocess_yuv_cpu_ref(yuv, src_w, src_h, ref.data(), dst_w, dst_h);
+    preprocess_yuv_cpu(yuv, src_w, src_h, out.data(), dst_w, dst_h);
+    float diff_ref = max_abs_diff(ref, out);
+    float diff_bgr = max_abs_diff(bgr_path, out);
+
+    std::vector<uint8_t> packed(input_format_bytes(INPUT_FORMAT_UINT8, dst_w, dst_h));
+    preprocess_yuv_cpu_packed(yuv, src_w, src_h, INPUT_FORMAT_UINT8, packed.data(), dst_w, dst_h);
+    normalize_input_cpu(INPUT_FORMAT_UINT8, packed.data(), out.data(), dst_w, dst_h);
+    float diff_u8 = max_abs_diff(bgr_path, out);
+    bool ok = diff_ref <= TOLERANCE && diff_bgr <= TOLERANCE_YUV && diff_u8 <= TOLERANCE_YUV + TOLERANCE_UINT8;
+
+    double t_bgr = time_ms(iterations, [&]() {
+        cv::cvtColor(frame, bgr, code);
+        preprocess_img_cpu(bgr.data, bgr.cols, bgr.rows, bgr.step, bgr_path.data(), dst_w, dst_h);
+    });
+    double t_yuv = time_ms(iterations, [&]() {
+        preprocess_yuv_cpu(yuv, src_w, src_h, out.data(), dst_w, dst_h);
+    });
+    std::cout << src_w << "x" << src_h << (nv12 ? " NV12" : " I420") << " -> " << dst_w << "x" << dst_h
+              << "  vs kernel math " << diff_ref << (diff_ref <= TOLERANCE ? "" : " FAIL")
+              << " vs cvtColor + BGR " << diff_bgr << (diff_bgr <= TOLERANCE_YUV ? "" : " FAIL")
+              << " uint8 " << diff_u8 << (diff_u8 <= TOLERANCE_YUV + TOLERANCE_UINT8 ? "" : " FAIL")
+              << "  cvtColor + BGR " << t_bgr << "ms  fused " << t_yuv << "ms" << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    struct Case { int src_w, src_h, dst_w, dst_h; };
+    const Case cases[] = {
+        {1920, 1080, 640, 640}, {1920, 1080, 1280, 1280},
+        {3840, 2160, 640, 640}, {3840, 2160, 1280, 1280},
+        {1080, 1920, 640, 640}, {1001, 753, 640, 640}, {320, 240, 640, 640},
+    };
+    std::mt19937 rng(0);
+    bool ok = true;
+    for (const Case& c : cases) {
+        std::vector<uint8_t> img(c.src_w * c.src_h * 3);
+        for (auto& v : img) v = rng() & 0xFF;
+        std::vector<float> ref(3 * c.dst_w * c.dst_h), out(3 * c.dst_w * c.dst_h);
+
+        preprocess_img_cpu_ref(img.data(), c.src_w, c.src_h, c.src_w * 3, ref.data(), c.dst_w, c.dst_h);
+        preprocess_img_cpu(img.data(), c.src_w, c.src_h, c.src_w * 3, out.data(), c.dst_w, c.dst_h);
+        float max_diff = max_abs_diff(ref, out);
+        ok = ok && max_diff <= TOLERANCE;
+
+        std::vector<uint8_t> packed(input_format_bytes(INPUT_FORMAT_FP16, c.dst_w, c.dst_h));
+        preprocess_img_cpu_packed(img.data(), c.src_w, c.src_h, c.src_w * 3, INPUT_FORMAT_UINT8, packed.data(), c.dst_w, c.dst_h);
+        normalize_input_cpu(INPUT_FORMAT_UINT8, packed.data(), out.data(), c.dst_w, c.dst_h);
+        float diff_u8 = max_abs_diff(ref, out);
+        preprocess_img_cpu_packed(img.data(), c.src_w, c.src_h, c.src_w * 3, INPUT_FORMAT_FP16, packed.data(), c.dst_w, c.dst_h);
+        normalize_input_cpu(INPUT_FORMAT_FP16, packed.data(), out.data(), c.dst_w, c.dst_h);
+        float diff_f16 = max_abs_diff(ref, out);
+        ok = ok && diff_u8 <= TOLERANCE_UINT8 && diff_f16 <= TOLERANCE_FP16;
+
+        double t_ref = time_ms(iterations, [&]() {
+            preprocess_img_cpu_ref(img.data(), c.src_w, c.src_h, c.src_w * 3, ref.data(), c.dst_w, c.dst_h);
+        });
+        double t_cpu = time_ms(iterations, [&]() {
+            preprocess_img_cpu(img.data(), c.src_w, c.src_h, c.src_w * 3, out.data(), c.dst_w, c.dst_h);
+        });
+        double t_u8 = time_ms(iterations, [&]() {
+            preprocess_img_cpu_packed(img.data(), c.src_w, c.src_h, c.src_w * 3, INPUT_FORMAT_UINT8, packed.data(), c.dst_w, c.dst_h);
+        });
+        double t_f16 = time_ms(iterations, [&]() {
+            preprocess_img_cpu_packed(img.data(), c.src_w, c.src_h, c.src_w * 3, INPUT_FORMAT_FP16, packed.data(), c.dst_w, c.dst_h);
+        });
+        std::cout << c.src_w << "x" << c.src_h << " -> " << c.dst_w << "x" << c.dst_h
+                  << "  max diff " << max_diff << (max_diff <= TOLERANCE ? "" : " FAIL")
+                  << " uint8 " << diff_u8 << (diff_u8 <= TOLERANCE_UINT8 ? "" : " FAIL")
+                  << " fp16 " << diff_f16 << (diff_f16 <= TOLERANCE_FP16 ? "" : " FAIL")
+                  << "  per-pixel " << t_ref << "ms  fused " << t_cpu << "ms"
+                  << "  uint8 " << t_u8 << "ms  fp16 " << t_f16 << "ms" << std::endl;
+    }
+    for (const Case& c : cases) {
+        if (c.src_w % 2 || c.src_h % 2) continue;  // 4:2:0 frames have even sizes
+        ok = check_yuv(c.src_w, c.src_h, c.dst_w, c.dst_h, true, iterations, rng) && ok;
+        ok = check_yuv(c.src_w, c.src_h, c.dst_w, c.dst_h, false, iterations, rng) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,404 @@
+#include "preprocess_cpu.h"
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PREPROCESS_CPU_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define PREPROCESS_CPU_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const uint8_t kFillValue = 128;
+
+// Scratch memory kept between calls, one set per thread.
+struct Scratch {
+    // Per output column: byte offset of the left tap in a padded source row and its weights.
+    std::vector<int32_t> xofs;
+    std::vector<float> hx;
+    std::vector<float> lx;
+    // Source row with one fill pixel on each side, plus slack for 4-byte gathers.
+    std::vector<uint8_t> row_pad;
+    // Two horizontally interpolated rows, planar RGB, and the source row each one holds.
+    std::vector<float> rows[2];
+    int row_y[2];
+};
+
+thread_local Scratch scratch;
+
+// The image being letterboxed: interleaved BGR rows, or the planes of a YUV
+// frame, converted row by row as rows are needed.
+struct Source {
+    const uint8_t* bgr;
+    int line_size;
+    const YuvImage* yuv;
+    int width;
+    int height;
+};
+
+// Columns whose sample lies inside the image form one range [cx0, cx1),
+// everything left and right of it is fill.
+struct Columns {
+    int cx0;
+    int cx1;
+};
+
+Columns build_columns(const AffineMatrix& d2s, int src_width, int dst_width) {
+    scratch.xofs.resize(dst_width);
+    scratch.hx.resize(dst_width);
+    scratch.lx.resize(dst_width);
+    Columns cols{dst_width, dst_width};
+    bool found = false;
+    for (int dx = 0; dx < dst_width; dx++) {
+        float src_x = d2s.value[0] * dx + d2s.value[2] + 0.5f;
+        if (src_x <= -1 || src_x >= src_width) {
+            scratch.xofs[dx] = 0;
+            scratch.hx[dx] = 1.f;
+            scratch.lx[dx] = 0.f;
+            if (found && cols.cx1 == dst_width) cols.cx1 = dx;
+            continue;
+        }
+        if (!found) {
+            cols.cx0 = dx;
+            found = true;
+        }
+        int x_low = floorf(src_x);
+        float lx = src_x - x_low;
+        scratch.xofs[dx] = (x_low + 1) * 3;
+        scratch.hx[dx] = 1 - lx;
+        scratch.lx[dx] = lx;
+    }
+    if (!found) cols.cx0 = cols.cx1 = dst_width;
+    return cols;
+}
+
+// Horizontal pass of one padded source row into planar RGB floats.
+void hpass_scalar(const uint8_t* row, float* out, int dst_width, const Columns& cols) {
+    const int32_t* xofs = scratch.xofs.data();
+    const float* hx = scratch.hx.data();
+    const float* lx = scratch.lx.data();
+    for (int c = 0; c < 3; c++) {
+        const uint8_t* p = row + (2 - c);  // BGR -> RGB
+        float* o = out + c * dst_width;
+        for (int dx = cols.cx0; dx < cols.cx1; dx++) {
+            o[dx] = hx[dx] * p[xofs[dx]] + lx[dx] * p[xofs[dx] + 3];
+        }
+    }
+}
+
+// Vertical blend of two interpolated rows, / 255 and store into the planar output row.
+void vpass_scalar(const float* a, const float* b, float hy, float ly, float* dst, int dst_width, int area, const Columns& cols) {
+    for (int c = 0; c < 3; c++) {
+        const float* pa = a + c * dst_width;
+        const float* pb = b + c * dst_width;
+        float* o = dst + c * area;
+        for (int dx = cols.cx0; dx < cols.cx1; dx++) {
+            o[dx] = (hy * pa[dx] + ly * pb[dx]) / 255.0f;
+        }
+    }
+}
+
+#ifdef PREPROCESS_CPU_AVX2
+__attribute__((target("avx2")))
+void hpass_avx2(const uint8_t* row, float* out, int dst_width, const Columns& cols) {
+    const int32_t* xofs = scratch.xofs.data();
+    const float* hx = scratch.hx.data();
+    const float* lx = scratch.lx.data();
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    int dx = cols.cx0;
+    for (; dx + 8 <= cols.cx1; dx += 8) {
+        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xofs + dx));
+        __m256 whx = _mm256_loadu_ps(hx + dx);
+        __m256 wlx = _mm256_loadu_ps(lx + dx);
+        for (int c = 0; c < 3; c++) {
+            const int* p = reinterpret_cast<const int*>(row + (2 - c));
+            __m256i v0 = _mm256_and_si256(_mm256_i32gather_epi32(p, idx, 1), mask);
+            __m256i v1 = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(row + (2 - c) + 3), idx, 1), mask);
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(whx, _mm256_cvtepi32_ps(v0)), _mm256_mul_ps(wlx, _mm256_cvtepi32_ps(v1)));
+            _mm256_storeu_ps(out + c * dst_width + dx, r);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        const uint8_t* p = row + (2 - c);
+        float* o = out + c * dst_width;
+        for (int x = dx; x < cols.cx1; x++) {
+            o[x] = hx[x] * p[xofs[x]] + lx[x] * p[xofs[x] + 3];
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void vpass_avx2(const float* a, const float* b, float hy, float ly, float* dst, int dst_width, int area, const Columns& cols) {
+    const __m256 vhy = _mm256_set1_ps(hy);
+    const __m256 vly = _mm256_set1_ps(ly);
+    const __m256 v255 = _mm256_set1_ps(255.0f);
+    for (int c = 0; c < 3; c++) {
+        const float* pa = a + c * dst_width;
+        const float* pb = b + c * dst_width;
+        float* o = dst + c * area;
+        int dx = cols.cx0;
+        for (; dx + 8 <= cols.cx1; dx += 8) {
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(vhy, _mm256_loadu_ps(pa + dx)), _mm256_mul_ps(vly, _mm256_loadu_ps(pb + dx)));
+            _mm256_storeu_ps(o + dx, _mm256_div_ps(r, v255));
+        }
+        for (; dx < cols.cx1; dx++) {
+            o[dx] = (hy * pa[dx] + ly * pb[dx]) / 255.0f;
+        }
+    }
+}
+
+bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif  // PREPROCESS_CPU_AVX2
+
+#ifdef PREPROCESS_CPU_NEON
+void vpass_neon(const float* a, const float* b, float hy, float ly, float* dst, int dst_width, int area, const Columns& cols) {
+    const float32x4_t vhy = vdupq_n_f32(hy);
+    const float32x4_t vly = vdupq_n_f32(ly);
+    const float inv255 = 1.0f / 255.0f;
+    for (int c = 0; c < 3; c++) {
+        const float* pa = a + c * dst_width;
+        const float* pb = b + c * dst_width;
+        float* o = dst + c * area;
+        int dx = cols.cx0;
+        for (; dx + 4 <= cols.cx1; dx += 4) {
+            float32x4_t r = vaddq_f32(vmulq_f32(vhy, vld1q_f32(pa + dx)), vmulq_f32(vly, vld1q_f32(pb + dx)));
+            vst1q_f32(o + dx, vmulq_n_f32(r, inv255));
+        }
+        for (; dx < cols.cx1; dx++) {
+            o[dx] = (hy * pa[dx] + ly * pb[dx]) / 255.0f;
+        }
+    }
+}
+#endif  // PREPROCESS_CPU_NEON
+
+void hpass(const uint8_t* row, float* out, int dst_width, const Columns& cols) {
+#ifdef PREPROCESS_CPU_AVX2
+    if (has_avx2()) {
+        hpass_avx2(row, out, dst_width, cols);
+        return;
+    }
+#endif
+    hpass_scalar(row, out, dst_width, cols);
+}
+
+void vpass(const float* a, const float* b, float hy, float ly, float* dst, int dst_width, int area, const Columns& cols) {
+#if defined(PREPROCESS_CPU_AVX2)
+    if (has_avx2()) {
+        vpass_avx2(a, b, hy, ly, dst, dst_width, area, cols);
+        return;
+    }
+#elif defined(PREPROCESS_CPU_NEON)
+    vpass_neon(a, b, hy, ly, dst, dst_width, area, cols);
+    return;
+#endif
+    vpass_scalar(a, b, hy, ly, dst, dst_width, area, cols);
+}
+
+inline uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+// Converts row y of a YUV frame to BGR with the math of yuv_to_bgr, each
+// chroma sample's terms computed once for the two pixels sharing it.
+void yuv_row(const YuvImage& src, int width, int y, uint8_t* bgr) {
+    const uint8_t* py = src.y + (size_t)y * src.y_line_size;
+    const uint8_t* pu = src.u + (size_t)(y >> 1) * src.uv_line_size;
+    const uint8_t* pv = src.v + (size_t)(y >> 1) * src.uv_line_size;
+    const int half = 1 << 19;
+    for (int x = 0; x < width; x += 2) {
+        const int u = pu[(x >> 1) * src.uv_step] - 128;
+        const int v = pv[(x >> 1) * src.uv_step] - 128;
+        const int bu = half + 2116026 * u, guv = half - 852492 * v - 409993 * u, rv = half + 1673527 * v;
+        for (int i = x; i < x + 2 && i < width; i++) {
+            int yy = py[i] - 16;
+            yy = (yy > 0 ? yy : 0) * 1220542;
+            bgr[3 * i] = clamp_u8((yy + bu) >> 20);
+            bgr[3 * i + 1] = clamp_u8((yy + guv) >> 20);
+            bgr[3 * i + 2] = clamp_u8((yy + rv) >> 20);
+        }
+    }
+}
+
+// Interpolates source row y (fill value if outside the image) into slot.
+void load_row(const Source& src, int y, int slot, int dst_width, const Columns& cols) {
+    float* out = scratch.rows[slot].data();
+    scratch.row_y[slot] = y;
+    if (y < 0 || y >= src.height) {
+        for (int i = 0; i < 3 * dst_width; i++) out[i] = kFillValue;
+        return;
+    }
+    uint8_t* pad = scratch.row_pad.data();
+    if (src.yuv) {
+        yuv_row(*src.yuv, src.width, y, pad + 3);
+    } else {
+        memcpy(pad + 3, src.bgr + (size_t)y * src.line_size, src.width * 3);
+    }
+    hpass(pad, out, dst_width, cols);
+}
+
+// Prepares the scratch rows for a letterbox of src into dst_width x dst_height.
+void begin_letterbox(int src_width, int dst_width) {
+    scratch.row_pad.resize((src_width + 2) * 3 + 4);
+    memset(scratch.row_pad.data(), kFillValue, 3);
+    memset(scratch.row_pad.data() + (src_width + 1) * 3, kFillValue, 3);
+    for (int s = 0; s < 2; s++) {
+        scratch.rows[s].resize(3 * dst_width);
+        scratch.row_y[s] = -2;  // -1 is a valid (fill) source row
+    }
+}
+
+// Horizontally interpolated source rows around output row dy and their vertical
+// weights, loading whichever of them is not cached yet. False if the whole
+// output row is fill.
+bool source_rows(const Source& src, const AffineMatrix& d2s, const Columns& cols, int dst_width, int dy,
+                 const float** a, const float** b, float* hy, float* ly) {
+    float src_y = d2s.value[4] * dy + d2s.value[5] + 0.5f;
+    if (src_y <= -1 || src_y >= src.height || cols.cx0 == cols.cx1) return false;
+    int y_low = floorf(src_y);
+    *ly = src_y - y_low;
+    *hy = 1 - *ly;
+
+    int sa = scratch.row_y[0] == y_low ? 0 : scratch.row_y[1] == y_low ? 1 : -1;
+    int sb = scratch.row_y[0] == y_low + 1 ? 0 : scratch.row_y[1] == y_low + 1 ? 1 : -1;
+    if (sa < 0) {
+        sa = sb == 0 ? 1 : 0;
+        load_row(src, y_low, sa, dst_width, cols);
+    }
+    if (sb < 0) {
+        sb = 1 - sa;
+        load_row(src, y_low + 1, sb, dst_width, cols);
+    }
+    *a = scratch.rows[sa].data();
+    *b = scratch.rows[sb].data();
+    return true;
+}
+
+// Vertical blend into one interleaved BGR row of the packed formats, not
+// normalized. UINT8 rounds to nearest.
+template <typename T, typename Convert>
+void vpass_packed(const float* a, const float* b, float hy, float ly, T* dst, int dst_width,
+                  const Columns& cols, T fill, Convert convert) {
+    for (int dx = 0; dx < cols.cx0; dx++) dst[3 * dx] = dst[3 * dx + 1] = dst[3 * dx + 2] = fill;
+    for (int dx = cols.cx0; dx < cols.cx1; dx++) {
+        for (int c = 0; c < 3; c++) {
+            dst[3 * dx + 2 - c] = convert(hy * a[c * dst_width + dx] + ly * b[c * dst_width + dx]);
+        }
+    }
+    for (int dx = cols.cx1; dx < dst_width; dx++) dst[3 * dx] = dst[3 * dx + 1] = dst[3 * dx + 2] = fill;
+}
+
+template <typename T, typename Convert>
+void letterbox_packed(const Source& src, T* dst, int dst_width, int dst_height, Convert convert) {
+    AffineMatrix d2s = letterbox_d2s(src.width, src.height, dst_width, dst_height);
+    Columns cols = build_columns(d2s, src.width, dst_width);
+    begin_letterbox(src.width, dst_width);
+    const T fill = convert(kFillValue);
+    for (int dy = 0; dy < dst_height; dy++) {
+        T* out = dst + (size_t)dy * dst_width * 3;
+        const float *a, *b;
+        float hy, ly;
+        if (!source_rows(src, d2s, cols, dst_width, dy, &a, &b, &hy, &ly)) {
+            for (int i = 0; i < 3 * dst_width; i++) out[i] = fill;
+            continue;
+        }
+        vpass_packed(a, b, hy, ly, out, dst_width, cols, fill, convert);
+    }
+}
+
+void letterbox_planar(const Source& src, float* dst, int dst_width, int dst_height) {
+    AffineMatrix d2s = letterbox_d2s(src.width, src.height, dst_width, dst_height);
+    Columns cols = build_columns(d2s, src.width, dst_width);
+    begin_letterbox(src.width, dst_width);
+
+    const int area = dst_width * dst_height;
+    const float fill = kFillValue / 255.0f;
+    for (int dy = 0; dy < dst_height; dy++) {
+        float* out = dst + dy * dst_width;
+        const float *a, *b;
+        float hy, ly;
+        if (!source_rows(src, d2s, cols, dst_width, dy, &a, &b, &hy, &ly)) {
+            for (int c = 0; c < 3; c++) {
+                float* o = out + c * area;
+                for (int dx = 0; dx < dst_width; dx++) o[dx] = fill;
+            }
+            continue;
+        }
+        vpass(a, b, hy, ly, out, dst_width, area, cols);
+        for (int c = 0; c < 3; c++) {
+            float* o = out + c * area;
+            for (int dx = 0; dx < cols.cx0; dx++) o[dx] = fill;
+            for (int dx = cols.cx1; dx < dst_width; dx++) o[dx] = fill;
+        }
+    }
+}
+
+void letterbox_format(const Source& src, InputFormat format, void* dst, int dst_width, int dst_height) {
+    if (format == INPUT_FORMAT_UINT8) {
+        letterbox_packed(src, static_cast<uint8_t*>(dst), dst_width, dst_height,
+                         [](float v) { return (uint8_t)(v + 0.5f); });
+    } else if (format == INPUT_FORMAT_FP16) {
+        letterbox_packed(src, static_cast<uint16_t*>(dst), dst_width, dst_height,
+                         [](float v) { return float_to_half(v); });
+    } else {
+        letterbox_planar(src, static_cast<float*>(dst), dst_width, dst_height);
+    }
+}
+
+Source bgr_source(const uint8_t* src, int src_width, int src_height, int src_line_size) {
+    Source s = {src, src_line_size, nullptr, src_width, src_height};
+    return s;
+}
+
+Source yuv_source(const YuvImage& src, int src_width, int src_height) {
+    Source s = {nullptr, 0, &src, src_width, src_height};
+    return s;
+}
+
+}  // namespace
+
+void preprocess_img_cpu(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                        float* dst, int dst_width, int dst_height) {
+    letterbox_planar(bgr_source(src, src_width, src_height, src_line_size), dst, dst_width, dst_height);
+}
+
+void preprocess_img_cpu_packed(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                               InputFormat format, void* dst, int dst_width, int dst_height) {
+    letterbox_format(bgr_source(src, src_width, src_height, src_line_size), format, dst, dst_width, dst_height);
+}
+
+void preprocess_yuv_cpu(const YuvImage& src, int src_width, int src_height,
+                        float* dst, int dst_width, int dst_height) {
+    letterbox_planar(yuv_source(src, src_width, src_height), dst, dst_width, dst_height);
+}
+
+void preprocess_yuv_cpu_packed(const YuvImage& src, int src_width, int src_height,
+                               InputFormat format, void* dst, int dst_width, int dst_height) {
+    letterbox_format(yuv_source(src, src_width, src_height), format, dst, dst_width, dst_height);
+}
+
+void preprocess_img_cpu_ref(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                            float* dst, int dst_width, int dst_height) {
+    AffineMatrix d2s = letterbox_d2s(src_width, src_height, dst_width, dst_height);
+    for (int dy = 0; dy < dst_height; dy++) {
+        for (int dx = 0; dx < dst_width; dx++) {
+            warpaffine_pixel(src, src_line_size, src_width, src_height,
+                             dst, dst_width, dst_height, kFillValue, d2s, dx, dy);
+        }
+    }
+}
+
+void preprocess_yuv_cpu_ref(const YuvImage& src, int src_width, int src_height,
+                            float* dst, int dst_width, int dst_height) {
+    AffineMatrix d2s = letterbox_d2s(src_width, src_height, dst_width, dst_height);
+    for (int dy = 0; dy < dst_height; dy++) {
+        for (int dx = 0; dx < dst_width; dx++) {
+            warpaffine_pixel_yuv(src, src_width, src_height, dst, dst_width, dst_height, kFillValue, d2s, dx, dy);
+        }
+    }
+}
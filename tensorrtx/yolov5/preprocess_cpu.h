@@ -0,0 +1,44 @@
+#ifndef TRTX_YOLOV5_PREPROCESS_CPU_H_
+#define TRTX_YOLOV5_PREPROCESS_CPU_H_
+
+#include <cstdint>
+#include "input_format.h"
+#include "warpaffine.h"
+
+// CPU equivalent of preprocess_kernel_img: letterbox a BGR HWC uint8 image into
+// dst as RGB CHW float / 255, with the same affine sampling and fill value 128.
+// The bilinear sample is done separably, horizontal taps of each source row are
+// cached and reused by consecutive output rows, and the inner loops use
+// AVX2 / NEON when available with a scalar fallback.
+// dst must hold 3 * dst_width * dst_height floats, e.g. one batch slot.
+void preprocess_img_cpu(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                        float* dst, int dst_width, int dst_height);
+
+// Same letterbox into one of the packed wire formats of input_format.h: BGR HWC,
+// not normalized, rounded to uint8 for INPUT_FORMAT_UINT8 and kept fractional for
+// INPUT_FORMAT_FP16. dst must hold input_format_bytes(format, dst_width, dst_height)
+// bytes. INPUT_FORMAT_FP32 is preprocess_img_cpu.
+void preprocess_img_cpu_packed(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                               InputFormat format, void* dst, int dst_width, int dst_height);
+
+// Per-pixel loop over warpaffine_pixel, i.e. exactly the math of the CUDA kernel.
+// Slow; used as the reference for preprocess_img_cpu.
+void preprocess_img_cpu_ref(const uint8_t* src, int src_width, int src_height, int src_line_size,
+                            float* dst, int dst_width, int dst_height);
+
+// The same letterboxes straight from the planes of an NV12 / I420 frame
+// (warpaffine.h), without a full size BGR copy of it: each source row the
+// letterbox samples is converted to BGR as cv::cvtColor would, into the row
+// buffer of the horizontal pass. The results are those of converting the frame
+// with cv::cvtColor and letterboxing the BGR image. src_width and src_height are even.
+void preprocess_yuv_cpu(const YuvImage& src, int src_width, int src_height,
+                        float* dst, int dst_width, int dst_height);
+
+void preprocess_yuv_cpu_packed(const YuvImage& src, int src_width, int src_height,
+                               InputFormat format, void* dst, int dst_width, int dst_height);
+
+// Per-pixel loop over warpaffine_pixel_yuv, the math of the CUDA kernel's YUV variant.
+void preprocess_yuv_cpu_ref(const YuvImage& src, int src_width, int src_height,
+                            float* dst, int dst_width, int dst_height);
+
+#endif  // TRTX_YOLOV5_PREPROCESS_CPU_H_
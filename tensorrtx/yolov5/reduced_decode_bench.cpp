@@ -0,0 +1,167 @@
+// Times JPEG decode + letterbox at full size against decode at the reduced
+// scale jpegscale picks for INPUT_W x INPUT_H, for the images of a folder and
+// for 3840x2160 re-encodes of them, and reports how far apart the two network
+// inputs are and how far the boxes mapped back to the original image move.
+// Given the prob dumps of two `yolov5 -d [.engine] [folder] [prob.bin]` runs
+// over the same folder, without and with REDUCED_DECODE, it also matches their
+// detections image by image.
+//   ./reduced_decode_bench [image folder] [full_prob.bin reduced_prob.bin]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "jpeg_scale.h"
+#include "postprocess_cpu.h"
+#include "preprocess_cpu.h"
+#include "utils.h"
+
+using namespace Yolo;
+
+static const int DET_SIZE = sizeof(Detection) / sizeof(float);
+static const int OUTPUT_SIZE = MAX_OUTPUT_BBOX_COUNT * DET_SIZE + 1;
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+static float iou(const ImageDetection& a, const ImageDetection& b) {
+    float w = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+    float h = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+    if (w <= 0 || h <= 0) return 0.f;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+// Decode + letterbox of one encoded image, both ways.
+static void bench_image(const std::string& name, const std::vector<uint8_t>& bytes, int iterations) {
+    std::vector<float> full_input(3 * INPUT_W * INPUT_H), reduced_input(3 * INPUT_W * INPUT_H);
+    cv::Mat full, reduced;
+    cv::Size original;
+    double t_full = time_ms(iterations, [&]() {
+        full = cv::imdecode(bytes, cv::IMREAD_COLOR);
+        preprocess_img_cpu(full.data, full.cols, full.rows, full.step, full_input.data(), INPUT_W, INPUT_H);
+    });
+    double t_reduced = time_ms(iterations, [&]() {
+        reduced = jpegscale::decode(bytes, INPUT_W, INPUT_H, nullptr, &original);
+        preprocess_img_cpu(reduced.data, reduced.cols, reduced.rows, reduced.step, reduced_input.data(), INPUT_W, INPUT_H);
+    });
+    if (full.empty() || reduced.empty()) {
+        std::cout << name << ": not decodable" << std::endl;
+        return;
+    }
+
+    double sum = 0, max_diff = 0;
+    for (size_t i = 0; i < full_input.size(); i++) {
+        double d = std::fabs(full_input[i] - reduced_input[i]) * 255;
+        sum += d;
+        max_diff = std::max(max_diff, d);
+    }
+
+    // boxes over the letterbox content, mapped back both ways
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    float max_shift = 0;
+    for (int i = 0; i < 1000; i++) {
+        float bbox[4] = {INPUT_W * u(rng), INPUT_H * u(rng), 8 + 200 * u(rng), 8 + 200 * u(rng)};
+        float a[4], b[4];
+        letterbox_to_image(bbox, full.cols, full.rows, INPUT_W, INPUT_H, a);
+        letterbox_to_image(bbox, reduced.cols, reduced.rows, INPUT_W, INPUT_H, b);
+        scale_to_original(b, reduced.cols, reduced.rows, original.width, original.height);
+        for (int k = 0; k < 4; k++) max_shift = std::max(max_shift, std::fabs(a[k] - b[k]));
+    }
+
+    std::cout << name << " " << full.cols << "x" << full.rows << " -> " << reduced.cols << "x" << reduced.rows
+              << (original == full.size() ? "" : " ORIGINAL SIZE MISMATCH") << ": full " << t_full << "ms  reduced "
+              << t_reduced << "ms  input diff mean " << sum / full_input.size() << " max " << max_diff
+              << " (of 255)  box shift max " << max_shift << "px" << std::endl;
+}
+
+// Detections of the two dumps of the same folder, matched by class and IoU.
+static bool compare_dumps(const std::string& dir, const std::vector<std::string>& files, const std::string& full_dump,
+                          const std::string& reduced_dump) {
+    std::ifstream full_in(full_dump, std::ios::binary), reduced_in(reduced_dump, std::ios::binary);
+    if (!full_in || !reduced_in) {
+        std::cerr << "could not open " << full_dump << " / " << reduced_dump << std::endl;
+        return false;
+    }
+    PostprocessParams params;
+    params.conf_thresh = 0.5f;
+    params.nms_thresh = 0.4f;
+    std::vector<float> full_prob(OUTPUT_SIZE), reduced_prob(OUTPUT_SIZE);
+    std::vector<ImageDetection> full_dets(MAX_OUTPUT_BBOX_COUNT), reduced_dets(MAX_OUTPUT_BBOX_COUNT);
+    int total = 0, matched = 0;
+    double iou_sum = 0;
+    for (const std::string& file : files) {
+        if (!full_in.read(reinterpret_cast<char*>(full_prob.data()), OUTPUT_SIZE * sizeof(float)) ||
+            !reduced_in.read(reinterpret_cast<char*>(reduced_prob.data()), OUTPUT_SIZE * sizeof(float))) {
+            std::cerr << "the dumps hold fewer images than " << dir << std::endl;
+            return false;
+        }
+        std::ifstream in(dir + "/" + file, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        cv::Size original;
+        cv::Mat reduced = jpegscale::decode(bytes, INPUT_W, INPUT_H, nullptr, &original);
+        if (reduced.empty()) continue;
+        int nf = postprocess_image(full_prob.data(), original.width, original.height, params, full_dets.data(), MAX_OUTPUT_BBOX_COUNT);
+        int nr = postprocess_image(reduced_prob.data(), reduced.cols, reduced.rows, original.width, original.height, params,
+                                   reduced_dets.data(), MAX_OUTPUT_BBOX_COUNT);
+        int image_matched = 0;
+        std::vector<bool> used(nr, false);
+        for (int i = 0; i < nf; i++) {
+            int best = -1;
+            float best_iou = 0.5f;
+            for (int j = 0; j < nr; j++) {
+                float o = iou(full_dets[i], reduced_dets[j]);
+                if (!used[j] && full_dets[i].class_id == reduced_dets[j].class_id && o >= best_iou) {
+                    best = j;
+                    best_iou = o;
+                }
+            }
+            if (best < 0) continue;
+            used[best] = true;
+            image_matched++;
+            iou_sum += best_iou;
+        }
+        std::cout << file << ": " << nf << " detections at full size, " << nr << " reduced, " << image_matched
+                  << " matched (same class, IoU >= 0.5)" << std::endl;
+        total += std::max(nf, nr);
+        matched += image_matched;
+    }
+    std::cout << "matched " << matched << " of " << total << " detections, mean IoU "
+              << (matched ? iou_sum / matched : 0.0) << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string dir = argc > 1 ? argv[1] : "../samples";
+    std::vector<std::string> files;
+    if (read_files_in_dir(dir.c_str(), files) < 0) {
+        std::cerr << "read_files_in_dir " << dir << " failed" << std::endl;
+        return -1;
+    }
+    const int iterations = 10;
+    for (const std::string& file : files) {
+        std::ifstream in(dir + "/" + file, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        int w, h;
+        if (!jpegscale::jpegSize(bytes.data(), bytes.size(), w, h)) continue;
+        bench_image(file, bytes, iterations);
+        // the same picture as a 4K still
+        cv::Mat img = cv::imdecode(bytes, cv::IMREAD_COLOR), still;
+        cv::resize(img, still, cv::Size(3840, 2160), 0, 0, cv::INTER_CUBIC);
+        std::vector<uint8_t> still_bytes;
+        cv::imencode(".jpg", still, still_bytes);
+        bench_image(file + " (4K)", still_bytes, iterations);
+    }
+    if (argc > 3 && !compare_dumps(dir, files, argv[2], argv[3])) return -1;
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include "tiling.h"
+#include <algorithm>
+#include <cmath>
+#include "nms_engine.h"
+
+namespace {
+
+// Starts of the tiles along one axis: the first at 0, the last flush with the
+// far edge, and as few as keep neighbours overlapping by at least overlap_px.
+void axis_starts(int frame, int tile, int overlap_px, int* count, int starts[], int max_count) {
+    if (frame <= tile) {
+        starts[0] = 0;
+        *count = 1;
+        return;
+    }
+    const int step = std::max(1, tile - overlap_px);
+    int n = 1 + (frame - tile + step - 1) / step;
+    n = std::min(n, max_count);
+    for (int i = 0; i < n; i++) starts[i] = (int)((long long)i * (frame - tile) / (n - 1));
+    *count = n;
+}
+
+float iou(const ImageDetection& a, const ImageDetection& b) {
+    float w = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+    float h = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+    if (w <= 0 || h <= 0) return 0.f;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+// Pixels from an inner tile edge within which a box counts as cut by it.
+const float CUT_EDGE = 2.f;
+
+// Whether det, in frame pixels, ends at an edge of tile that is not an edge of
+// the frame_width x frame_height frame.
+bool cut_by_tile(const ImageDetection& det, const Tile& tile, int frame_width, int frame_height) {
+    return (tile.x > 0 && det.x1 <= tile.x + CUT_EDGE) || (tile.y > 0 && det.y1 <= tile.y + CUT_EDGE) ||
+           (tile.x + tile.w < frame_width && det.x2 >= tile.x + tile.w - CUT_EDGE) ||
+           (tile.y + tile.h < frame_height && det.y2 >= tile.y + tile.h - CUT_EDGE);
+}
+
+float area(const ImageDetection& d) {
+    return (d.x2 - d.x1) * (d.y2 - d.y1);
+}
+
+// A weighted box fusion cluster: score-weighted sums of the corners of its
+// boxes, the fused box, and the best score, which the fused box keeps.
+struct Cluster {
+    float sx1, sy1, sx2, sy2, weight;
+    ImageDetection fused;
+};
+
+}  // namespace
+
+void tile_frame(int frame_width, int frame_height, const TilingParams& params, std::vector<Tile>& tiles) {
+    tiles.clear();
+    if (frame_width <= 0 || frame_height <= 0) return;
+    const int tile_w = std::max(1, params.tile_w), tile_h = std::max(1, params.tile_h);
+    const int max_count = 256;
+    int xs[max_count], ys[max_count], nx, ny;
+    axis_starts(frame_width, tile_w, (int)std::lround(params.overlap * tile_w), &nx, xs, max_count);
+    axis_starts(frame_height, tile_h, (int)std::lround(params.overlap * tile_h), &ny, ys, max_count);
+    const int w = std::min(tile_w, frame_width), h = std::min(tile_h, frame_height);
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) tiles.push_back(Tile{xs[i], ys[j], w, h});
+    }
+    if (params.full_frame && (frame_width > tile_w || frame_height > tile_h)) {
+        tiles.push_back(Tile{0, 0, frame_width, frame_height});
+    }
+}
+
+void plan_tiles(const int* frame_sizes, int frames, const TilingParams& params, std::vector<TileRef>& tiles) {
+    static thread_local std::vector<Tile> frame_tiles;
+    tiles.clear();
+    for (int f = 0; f < frames; f++) {
+        tile_frame(frame_sizes[2 * f], frame_sizes[2 * f + 1], params, frame_tiles);
+        for (const Tile& t : frame_tiles) tiles.push_back(TileRef{f, t});
+    }
+}
+
+TileMerger::TileMerger(const TilingParams& tiling, const PostprocessParams& params)
+    : tiling_(tiling), params_(params) {}
+
+void TileMerger::begin(const std::vector<TileRef>& tiles) {
+    tiles_ = &tiles;
+    const size_t n = tiles.size();
+    if (tile_dets_.size() < n * Yolo::MAX_OUTPUT_BBOX_COUNT) tile_dets_.resize(n * Yolo::MAX_OUTPUT_BBOX_COUNT);
+    tile_counts_.assign(n, 0);
+    frame_first_.clear();
+    for (size_t t = 0; t < n; t++) {
+        while ((int)frame_first_.size() <= tiles[t].frame) frame_first_.push_back((int)t);
+    }
+    frame_first_.push_back((int)n);
+}
+
+void TileMerger::addTiles(const float* prob, int first, int n, int output_size, WorkerPool* pool) {
+    auto run = [&](int i) {
+        const int t = first + i;
+        const Tile& tile = (*tiles_)[t].tile;
+        ImageDetection* out = &tile_dets_[(size_t)t * Yolo::MAX_OUTPUT_BBOX_COUNT];
+        int count = postprocess_image(prob + (size_t)i * output_size, tile.w, tile.h, params_, out, Yolo::MAX_OUTPUT_BBOX_COUNT);
+        for (int k = 0; k < count; k++) tile_to_frame(tile, out[k]);
+        tile_counts_[t] = count;
+    };
+    if (pool) {
+        pool->parallelFor(n, run);
+    } else {
+        for (int i = 0; i < n; i++) run(i);
+    }
+}
+
+void TileMerger::merge(int frames, DetectionArena& arena, WorkerPool* pool) {
+    auto run = [&](int f) { arena.setCount(f, mergeFrame(f, arena.image(f), arena.maxPerImage())); };
+    if (pool) {
+        pool->parallelFor(frames, run);
+    } else {
+        for (int f = 0; f < frames; f++) run(f);
+    }
+}
+
+int TileMerger::tileDetections() const {
+    int n = 0;
+    for (int c : tile_counts_) n += c;
+    return n;
+}
+
+void TileMerger::gatherFrame(int frame, std::vector<ImageDetection>& boxes) {
+    static thread_local std::vector<char> cut, dropped;
+    static thread_local std::vector<int> by_class;
+    boxes.clear();
+    cut.clear();
+    if (frame + 1 >= (int)frame_first_.size()) return;
+    const int first = frame_first_[frame], last = frame_first_[frame + 1];
+    int frame_width = 0, frame_height = 0;
+    for (int t = first; t < last; t++) {
+        const Tile& tile = (*tiles_)[t].tile;
+        frame_width = std::max(frame_width, tile.x + tile.w);
+        frame_height = std::max(frame_height, tile.y + tile.h);
+    }
+    bool any_cut = false;
+    for (int t = first; t < last; t++) {
+        const Tile& tile = (*tiles_)[t].tile;
+        const ImageDetection* dets = &tile_dets_[(size_t)t * Yolo::MAX_OUTPUT_BBOX_COUNT];
+        for (int k = 0; k < tile_counts_[t]; k++) {
+            boxes.push_back(dets[k]);
+            cut.push_back(cut_by_tile(dets[k], tile, frame_width, frame_height));
+            any_cut = any_cut || cut.back();
+        }
+    }
+    if (!any_cut) return;
+
+    // Drop the cut boxes covered by a larger box of their class, keeping the
+    // order; by_class holds the box indices by class, so each cut box only
+    // scans its own class.
+    by_class.resize(boxes.size());
+    for (size_t i = 0; i < by_class.size(); i++) by_class[i] = (int)i;
+    std::sort(by_class.begin(), by_class.end(), [&](int a, int b) {
+        return boxes[a].class_id != boxes[b].class_id ? boxes[a].class_id < boxes[b].class_id : a < b;
+    });
+    dropped.assign(boxes.size(), 0);
+    for (size_t begin = 0, end = 0; begin < by_class.size(); begin = end) {
+        while (end < by_class.size() && boxes[by_class[end]].class_id == boxes[by_class[begin]].class_id) end++;
+        for (size_t a = begin; a < end; a++) {
+            const int i = by_class[a];
+            if (!cut[i]) continue;
+            const ImageDetection& d = boxes[i];
+            const float d_area = area(d);
+            for (size_t b = begin; b < end; b++) {
+                const ImageDetection& o = boxes[by_class[b]];
+                if (area(o) <= d_area) continue;
+                float w = std::min(d.x2, o.x2) - std::max(d.x1, o.x1);
+                float h = std::min(d.y2, o.y2) - std::max(d.y1, o.y1);
+                if (w > 0 && h > 0 && w * h >= tiling_.cut_cover * d_area) {
+                    dropped[i] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    int n = 0;
+    for (size_t i = 0; i < boxes.size(); i++) {
+        if (!dropped[i]) boxes[n++] = boxes[i];
+    }
+    boxes.resize(n);
+}
+
+int TileMerger::mergeFrame(int frame, ImageDetection* out, int capacity) {
+    static thread_local std::vector<ImageDetection> boxes;
+    static thread_local std::vector<int> order;
+    static thread_local std::vector<Cluster> clusters;
+    static thread_local boxnms::NmsEngine engine;
+    gatherFrame(frame, boxes);
+
+    int n = 0;
+    if (tiling_.merge == TILE_MERGE_NMS) {
+        engine.reset();
+        for (const ImageDetection& d : boxes) engine.addCorner(&d.x1, d.conf, (int)d.class_id);
+        boxnms::Config config;
+        config.iou_thresh = tiling_.merge_thresh;
+        for (int k : engine.run(config)) {
+            if (n == capacity) break;
+            out[n++] = boxes[k];
+        }
+        return n;
+    }
+
+    // Weighted box fusion: boxes by class and falling confidence join the
+    // cluster of their class whose fused box they overlap most, if above
+    // merge_thresh, and the cluster's box becomes the confidence-weighted mean.
+    order.resize(boxes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+    std::sort(order.begin(), order.end(), [](int a, int b) {
+        if (boxes[a].class_id != boxes[b].class_id) return boxes[a].class_id < boxes[b].class_id;
+        if (boxes[a].conf != boxes[b].conf) return boxes[a].conf > boxes[b].conf;
+        return a < b;
+    });
+    clusters.clear();
+    size_t class_begin = 0;
+    for (size_t k = 0; k < order.size(); k++) {
+        const ImageDetection& d = boxes[order[k]];
+        if (k > 0 && d.class_id != boxes[order[k - 1]].class_id) class_begin = clusters.size();
+        int best = -1;
+        float best_iou = tiling_.merge_thresh;
+        for (size_t c = class_begin; c < clusters.size(); c++) {
+            float o = iou(clusters[c].fused, d);
+            if (o > best_iou) {
+                best = (int)c;
+                best_iou = o;
+            }
+        }
+        if (best < 0) {
+            clusters.push_back(Cluster{d.x1 * d.conf, d.y1 * d.conf, d.x2 * d.conf, d.y2 * d.conf, d.conf, d});
+            continue;
+        }
+        Cluster& c = clusters[best];
+        c.sx1 += d.x1 * d.conf;
+        c.sy1 += d.y1 * d.conf;
+        c.sx2 += d.x2 * d.conf;
+        c.sy2 += d.y2 * d.conf;
+        c.weight += d.conf;
+        c.fused.x1 = c.sx1 / c.weight;
+        c.fused.y1 = c.sy1 / c.weight;
+        c.fused.x2 = c.sx2 / c.weight;
+        c.fused.y2 = c.sy2 / c.weight;
+    }
+    for (const Cluster& c : clusters) {
+        if (n == capacity) break;
+        out[n++] = c.fused;
+    }
+    return n;
+}
@@ -0,0 +1,114 @@
+#ifndef TRTX_YOLOV5_TILING_H_
+#define TRTX_YOLOV5_TILING_H_
+
+#include <vector>
+#include "postprocess_cpu.h"
+
+// Sliced inference for frames much larger than the network input, e.g. 4K at
+// 640x640, where small objects shrink below what the model can see once the
+// whole frame is letterboxed. Each frame is cut into overlapping tiles of
+// tile_w x tile_h (the network resolution by default, so tiles are not scaled),
+// optionally plus the whole frame letterboxed for objects larger than a tile.
+// The tiles of a batch of frames are inferred batch_size at a time, each tile
+// is post-processed as an image of its own and its boxes are moved into the
+// frame by the tile's offset, and the boxes of all tiles of a frame go through
+// one more NMS or weighted box fusion pass that merges the duplicates found by
+// neighbouring tiles at their seams. Before that pass, a box that ends at an
+// inner edge of its tile and lies mostly inside a larger box of the same class
+// is dropped: it is the cut-off view of an object another tile sees whole,
+// whose IoU with the whole box can be too low for the merge when less than
+// half of the object was inside the tile.
+//
+//   plan_tiles(frame_sizes, frames, tiling, tiles);
+//   merger.begin(tiles);
+//   for (int first = 0; first < (int)tiles.size(); first += BATCH_SIZE) {
+//       int n = std::min(BATCH_SIZE, (int)tiles.size() - first);
+//       ... letterbox tiles[first + i].tile of its frame into input slot i, infer ...
+//       merger.addTiles(prob, first, n, OUTPUT_SIZE, &pool);
+//   }
+//   merger.merge(frames, arena, &pool);  // frame detections in arena.image(frame)
+
+enum TileMerge { TILE_MERGE_NMS = 0, TILE_MERGE_WBF = 1 };
+
+struct TilingParams {
+    int tile_w = Yolo::INPUT_W;
+    int tile_h = Yolo::INPUT_H;
+    // least fraction of a tile shared with its neighbour
+    float overlap = 0.2f;
+    // also infer the whole frame, letterboxed, when it is larger than a tile
+    bool full_frame = true;
+    TileMerge merge = TILE_MERGE_NMS;
+    // IoU above which boxes of the same class from different tiles are one object
+    float merge_thresh = 0.5f;
+    // least part of a box cut by an inner tile edge that a larger box of the
+    // same class must cover for the cut box to be dropped
+    float cut_cover = 0.8f;
+};
+
+// Source rectangle of a tile in its frame.
+struct Tile {
+    int x, y, w, h;
+};
+
+struct TileRef {
+    int frame;
+    Tile tile;
+};
+
+// Tiles of a frame_width x frame_height frame, row-major, spaced evenly so that
+// neighbours share at least overlap of a tile, then the whole frame if
+// full_frame. A frame no larger than a tile is one tile, the frame itself; an
+// empty one (0 x 0, e.g. unreadable) has none.
+void tile_frame(int frame_width, int frame_height, const TilingParams& params, std::vector<Tile>& tiles);
+
+// Tiles of frames 0..frames-1 (width, height in frame_sizes[2 * f], [2 * f + 1]),
+// frame after frame, in the order they are packed into inference batches.
+void plan_tiles(const int* frame_sizes, int frames, const TilingParams& params, std::vector<TileRef>& tiles);
+
+// Moves an x1, y1, x2, y2 box of a tile's image into its frame.
+inline void tile_to_frame(const Tile& tile, ImageDetection& det) {
+    det.x1 += tile.x;
+    det.y1 += tile.y;
+    det.x2 += tile.x;
+    det.y2 += tile.y;
+}
+
+// Post-processing of the tiles of a batch of frames. Memory is sized by the
+// largest plan seen, so a steady stream does not allocate.
+class TileMerger {
+public:
+    TileMerger(const TilingParams& tiling, const PostprocessParams& params);
+
+    // Starts the frames whose tiles are tiles, as laid out by plan_tiles.
+    // tiles must stay alive until merge().
+    void begin(const std::vector<TileRef>& tiles);
+
+    // Post-processes the outputs of tiles [first, first + n), tile first + i at
+    // prob + i * output_size: top_k, NMS and mapping into the frame, as
+    // postprocess_image does for a whole image. Tiles are spread over pool.
+    void addTiles(const float* prob, int first, int n, int output_size, WorkerPool* pool = nullptr);
+
+    // Merges the boxes of each frame's tiles into arena.image(frame), at most
+    // arena.maxPerImage(), by ascending class and descending confidence.
+    // Frames are spread over pool.
+    void merge(int frames, DetectionArena& arena, WorkerPool* pool = nullptr);
+
+    // Boxes of all tiles before merging, for reporting.
+    int tileDetections() const;
+
+private:
+    int mergeFrame(int frame, ImageDetection* out, int capacity);
+    // Gathers the boxes of a frame's tiles, without the cut-off views.
+    void gatherFrame(int frame, std::vector<ImageDetection>& boxes);
+
+    TilingParams tiling_;
+    PostprocessParams params_;
+    const std::vector<TileRef>* tiles_ = nullptr;
+    // tile t's boxes at t * MAX_OUTPUT_BBOX_COUNT, in frame pixels
+    std::vector<ImageDetection> tile_dets_;
+    std::vector<int> tile_counts_;
+    // first tile of each frame, and one past the last frame's tiles
+    std::vector<int> frame_first_;
+};
+
+#endif  // TRTX_YOLOV5_TILING_H_
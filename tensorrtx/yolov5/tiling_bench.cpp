@@ -0,0 +1,274 @@
+// Checks the tile layout, batching and cross-tile merging of tiling.h on the
+// CPU and reports tiles/s for the host side (per-tile post-processing and the
+// merge). Without arguments, 4K frames of small synthetic objects are cut into
+// tiles, and each tile gets the prob a detector would give: a box, possibly
+// cut by the tile's edge, for every object it shows enough of, plus a jittered
+// duplicate. Some objects straddle a seam with less than half of them inside
+// one tile, which then reports the truncated box while its neighbour reports
+// the whole one. Every object must come out exactly once, with both NMS and
+// WBF merging, and the report compares with letterboxing the whole frame, where
+// objects under 8 network pixels are taken as lost. Given an image folder and
+// the prob dump of `yolov5 -d [.engine] [folder] [prob.bin]` built with
+// TILED_INFERENCE, it replays the dump through the same plan instead.
+//   ./tiling_bench [image folder prob.bin]
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tiling.h"
+#include "utils.h"
+
+static const int DET_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+static const int OUTPUT_SIZE = Yolo::MAX_OUTPUT_BBOX_COUNT * DET_SIZE + 1;
+static const int BATCH_SIZE = 8;
+static const int FRAMES = 4;
+static const int FRAME_W = 3840;
+static const int FRAME_H = 2160;
+static const float MIN_VISIBLE = 0.6f;  // least part of an object a tile must show to detect it
+static const float MIN_SEAM_VISIBLE = 0.2f;  // the same for the objects placed across a seam
+static const int SEAM_OBJECTS = 60;  // of the 400 objects of a frame
+static const float MIN_INPUT_SIZE = 8.f;  // smallest object side, in network pixels, that is detected
+
+static float iou(const ImageDetection& a, const ImageDetection& b) {
+    float w = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+    float h = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+    if (w <= 0 || h <= 0) return 0.f;
+    float inter = w * h;
+    return inter / ((a.x2 - a.x1) * (a.y2 - a.y1) + (b.x2 - b.x1) * (b.y2 - b.y1) - inter);
+}
+
+// The letterbox of a tile: network pixels per frame pixel and padding.
+static void tile_letterbox(const Tile& tile, float& scale, float& pad_x, float& pad_y) {
+    scale = std::min(Yolo::INPUT_W / (float)tile.w, Yolo::INPUT_H / (float)tile.h);
+    pad_x = (Yolo::INPUT_W - scale * tile.w) / 2;
+    pad_y = (Yolo::INPUT_H - scale * tile.h) / 2;
+}
+
+// prob of one tile for objects of one frame: each object the tile shows at
+// least MIN_VISIBLE of (MIN_SEAM_VISIBLE for the first SEAM_OBJECTS) and at
+// least MIN_INPUT_SIZE network pixels of is detected, clipped to the tile, with
+// a confidence falling with the part cut off.
+static void synthesize_tile(const std::vector<ImageDetection>& objects, const Tile& tile, std::mt19937& rng, float* prob) {
+    std::uniform_real_distribution<float> jitter(-1.5f, 1.5f);
+    float scale, pad_x, pad_y;
+    tile_letterbox(tile, scale, pad_x, pad_y);
+    int count = 0;
+    float* dets = prob + 1;
+    for (size_t i = 0; i < objects.size(); i++) {
+        const ImageDetection& o = objects[i];
+        float x1 = std::max(o.x1, (float)tile.x), y1 = std::max(o.y1, (float)tile.y);
+        float x2 = std::min(o.x2, (float)(tile.x + tile.w)), y2 = std::min(o.y2, (float)(tile.y + tile.h));
+        if (x2 <= x1 || y2 <= y1) continue;
+        float visible = (x2 - x1) * (y2 - y1) / ((o.x2 - o.x1) * (o.y2 - o.y1));
+        if (visible < (i < SEAM_OBJECTS ? MIN_SEAM_VISIBLE : MIN_VISIBLE)) continue;
+        if (std::min(x2 - x1, y2 - y1) * scale < MIN_INPUT_SIZE) continue;
+        for (int k = 0; k < 2 && count < Yolo::MAX_OUTPUT_BBOX_COUNT; k++, count++) {
+            float* d = dets + DET_SIZE * count;
+            float j = k ? jitter(rng) : 0.f;
+            d[0] = ((x1 + x2) / 2 - tile.x) * scale + pad_x + j;
+            d[1] = ((y1 + y2) / 2 - tile.y) * scale + pad_y + j;
+            d[2] = (x2 - x1) * scale;
+            d[3] = (y2 - y1) * scale;
+            d[4] = 0.6f + 0.35f * visible - 0.05f * k;
+            d[5] = o.class_id;
+        }
+    }
+    prob[0] = count;
+}
+
+// Small objects of random classes, not touching each other. The first
+// SEAM_OBJECTS lie across the left or top edge of a tile with 20 to 45% of
+// their width or height inside it, and whole in the tile before.
+static std::vector<ImageDetection> make_objects(std::mt19937& rng, int count) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<Tile> tiles;
+    tile_frame(FRAME_W, FRAME_H, TilingParams(), tiles);
+    std::vector<ImageDetection> objects;
+    while ((int)objects.size() < count) {
+        float w = 12 + 84 * u(rng), h = 12 + 84 * u(rng);
+        ImageDetection o;
+        o.x1 = (FRAME_W - w) * u(rng);
+        o.y1 = (FRAME_H - h) * u(rng);
+        if ((int)objects.size() < SEAM_OBJECTS) {
+            // at least 40 pixels across, so the part inside stays above MIN_INPUT_SIZE
+            w = 40 + 56 * u(rng);
+            h = 40 + 56 * u(rng);
+            const Tile& t = tiles[rng() % tiles.size()];
+            const float inside = 0.2f + 0.25f * u(rng);
+            if (rng() % 2) {
+                if (t.x == 0) continue;
+                o.x1 = t.x - (1 - inside) * w;
+                o.y1 = t.y + (t.h - h) * u(rng);
+            } else {
+                if (t.y == 0) continue;
+                o.x1 = t.x + (t.w - w) * u(rng);
+                o.y1 = t.y - (1 - inside) * h;
+            }
+        }
+        o.x2 = o.x1 + w;
+        o.y2 = o.y1 + h;
+        o.conf = 1.f;
+        o.class_id = (float)(rng() % Yolo::CLASS_NUM);
+        bool apart = true;
+        for (const ImageDetection& p : objects) apart = apart && iou(o, p) == 0.f;
+        if (apart) objects.push_back(o);
+    }
+    return objects;
+}
+
+// Merged detections of a frame against its objects: found once at IoU >= 0.5
+// and the same class, and detections matching no object (duplicates). Those of
+// the first SEAM_OBJECTS are also counted in seam_found, and the duplicates
+// that overlap a seam object most in seam_extra.
+static void score_frame(const std::vector<ImageDetection>& objects, const ImageDetection* dets, int n,
+                        int& found, int& extra, int& seam_found, int& seam_extra) {
+    std::vector<bool> taken(objects.size(), false);
+    for (int i = 0; i < n; i++) {
+        int best = -1;
+        float best_iou = 0.5f;
+        for (size_t k = 0; k < objects.size(); k++) {
+            float o = iou(objects[k], dets[i]);
+            if (!taken[k] && objects[k].class_id == dets[i].class_id && o >= best_iou) {
+                best = (int)k;
+                best_iou = o;
+            }
+        }
+        if (best < 0) {
+            extra++;
+            int nearest = -1;
+            float most = 0.f;
+            for (size_t k = 0; k < objects.size(); k++) {
+                float w = std::min(objects[k].x2, dets[i].x2) - std::max(objects[k].x1, dets[i].x1);
+                float h = std::min(objects[k].y2, dets[i].y2) - std::max(objects[k].y1, dets[i].y1);
+                if (w > 0 && h > 0 && w * h > most) {
+                    nearest = (int)k;
+                    most = w * h;
+                }
+            }
+            if (nearest >= 0 && nearest < SEAM_OBJECTS) seam_extra++;
+        } else {
+            taken[best] = true;
+            found++;
+            if (best < SEAM_OBJECTS) seam_found++;
+        }
+    }
+}
+
+static bool run_synthetic() {
+    std::mt19937 rng(0);
+    std::vector<std::vector<ImageDetection>> objects;
+    for (int f = 0; f < FRAMES; f++) objects.push_back(make_objects(rng, 400));
+    int frame_sizes[2 * FRAMES];
+    for (int f = 0; f < FRAMES; f++) {
+        frame_sizes[2 * f] = FRAME_W;
+        frame_sizes[2 * f + 1] = FRAME_H;
+    }
+
+    // objects the letterbox of the whole frame keeps above MIN_INPUT_SIZE
+    float scale, pad_x, pad_y;
+    tile_letterbox(Tile{0, 0, FRAME_W, FRAME_H}, scale, pad_x, pad_y);
+    int total = 0, whole_frame = 0;
+    for (const auto& frame : objects) {
+        for (const ImageDetection& o : frame) {
+            total++;
+            if (std::min(o.x2 - o.x1, o.y2 - o.y1) * scale >= MIN_INPUT_SIZE) whole_frame++;
+        }
+    }
+
+    PostprocessParams params;
+    WorkerPool pool;
+    DetectionArena arena(FRAMES, Yolo::MAX_OUTPUT_BBOX_COUNT);
+    std::vector<TileRef> tiles;
+    std::vector<float> prob;
+    bool ok = true;
+    for (TileMerge mode : {TILE_MERGE_NMS, TILE_MERGE_WBF}) {
+        TilingParams tiling;
+        tiling.merge = mode;
+        plan_tiles(frame_sizes, FRAMES, tiling, tiles);
+        prob.assign(tiles.size() * OUTPUT_SIZE, 0.f);
+        for (size_t t = 0; t < tiles.size(); t++) {
+            synthesize_tile(objects[tiles[t].frame], tiles[t].tile, rng, &prob[t * OUTPUT_SIZE]);
+        }
+        TileMerger merger(tiling, params);
+        const int iterations = 20;
+        int tile_dets = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            merger.begin(tiles);
+            for (int first = 0; first < (int)tiles.size(); first += BATCH_SIZE) {
+                const int n = std::min(BATCH_SIZE, (int)tiles.size() - first);
+                merger.addTiles(&prob[(size_t)first * OUTPUT_SIZE], first, n, OUTPUT_SIZE, &pool);
+            }
+            merger.merge(FRAMES, arena, &pool);
+            tile_dets = merger.tileDetections();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int found = 0, extra = 0, seam_found = 0, seam_extra = 0;
+        for (int f = 0; f < FRAMES; f++) {
+            score_frame(objects[f], arena.image(f), arena.count(f), found, extra, seam_found, seam_extra);
+        }
+        bool mode_ok = found == total && extra == 0;
+        ok = ok && mode_ok;
+        std::cout << (mode == TILE_MERGE_NMS ? "NMS" : "WBF") << " merge: " << tiles.size() / FRAMES << " tiles per "
+                  << FRAME_W << "x" << FRAME_H << " frame, " << tile_dets << " tile detections -> found " << found << " of "
+                  << total << " objects, " << extra << " extra" << (mode_ok ? "" : " FAIL") << " (across a seam: found "
+                  << seam_found << " of " << SEAM_OBJECTS * FRAMES << ", " << seam_extra << " extra), whole frame letterbox "
+                  << whole_frame << " of " << total << ", " << tiles.size() * iterations / seconds << " tiles/s host side"
+                  << std::endl;
+    }
+    return ok;
+}
+
+// Replays a prob dump of TILED_INFERENCE through the plan of the folder's images.
+static bool run_dump(const std::string& dir, const std::string& dump) {
+    std::vector<std::string> files;
+    if (read_files_in_dir(dir.c_str(), files) < 0) {
+        std::cerr << "read_files_in_dir " << dir << " failed" << std::endl;
+        return false;
+    }
+    std::ifstream in(dump, std::ios::binary);
+    if (!in) {
+        std::cerr << "could not open " << dump << std::endl;
+        return false;
+    }
+    PostprocessParams params;
+    TilingParams tiling;
+    TileMerger merger(tiling, params);
+    WorkerPool pool;
+    DetectionArena arena(1, Yolo::MAX_OUTPUT_BBOX_COUNT);
+    std::vector<TileRef> tiles;
+    std::vector<float> prob(OUTPUT_SIZE);
+    long long tile_count = 0;
+    double seconds = 0;
+    for (const std::string& file : files) {
+        cv::Mat img = cv::imread(dir + "/" + file);
+        int size[2] = {img.cols, img.rows};
+        plan_tiles(size, 1, tiling, tiles);
+        prob.resize(tiles.size() * OUTPUT_SIZE);
+        if (!tiles.empty() && !in.read(reinterpret_cast<char*>(prob.data()), prob.size() * sizeof(float))) {
+            std::cerr << "the dump holds fewer tiles than the images of " << dir << std::endl;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        merger.begin(tiles);
+        merger.addTiles(prob.data(), 0, (int)tiles.size(), OUTPUT_SIZE, &pool);
+        merger.merge(1, arena, &pool);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        tile_count += tiles.size();
+        std::cout << file << " " << img.cols << "x" << img.rows << ": " << tiles.size() << " tiles, "
+                  << merger.tileDetections() << " tile detections, " << arena.count(0) << " after merging" << std::endl;
+    }
+    std::cout << tile_count << " tiles, " << (seconds > 0 ? tile_count / seconds : 0.0) << " tiles/s host side" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2) return run_dump(argv[1], argv[2]) ? 0 : -1;
+    return run_synthetic() ? 0 : 1;
+}
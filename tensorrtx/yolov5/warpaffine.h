@@ -0,0 +1,217 @@
+#ifndef TRTX_YOLOV5_WARPAFFINE_H_
+#define TRTX_YOLOV5_WARPAFFINE_H_
+
+#include <cmath>
+#include <cstdint>
+
+// Per-pixel letterbox math shared by the CUDA kernel in preprocess.cu and the
+// CPU code in preprocess_cpu.cpp, so both sides sample the image identically.
+
+#ifdef __CUDACC__
+#define WARPAFFINE_HD __host__ __device__
+#else
+#define WARPAFFINE_HD
+#endif
+
+struct AffineMatrix{
+    float value[6];
+};
+
+// dst -> src matrix of the letterbox that scales src to fit dst and centers it.
+// Same arithmetic as building s2d and calling cv::invertAffineTransform on it.
+static inline AffineMatrix letterbox_d2s(int src_width, int src_height, int dst_width, int dst_height) {
+    float scale = dst_height / (float)src_height < dst_width / (float)src_width ? dst_height / (float)src_height : dst_width / (float)src_width;
+    float s2d[6];
+    s2d[0] = scale;
+    s2d[1] = 0;
+    s2d[2] = -scale * src_width  * 0.5  + dst_width * 0.5;
+    s2d[3] = 0;
+    s2d[4] = scale;
+    s2d[5] = -scale * src_height * 0.5 + dst_height * 0.5;
+
+    double D = (double)s2d[0] * s2d[4] - (double)s2d[1] * s2d[3];
+    D = D != 0 ? 1. / D : 0;
+    double A11 = s2d[4] * D, A22 = s2d[0] * D, A12 = -s2d[1] * D, A21 = -s2d[3] * D;
+    double b1 = -A11 * s2d[2] - A12 * s2d[5];
+    double b2 = -A21 * s2d[2] - A22 * s2d[5];
+
+    AffineMatrix d2s;
+    d2s.value[0] = (float)A11;
+    d2s.value[1] = (float)A12;
+    d2s.value[2] = (float)b1;
+    d2s.value[3] = (float)A21;
+    d2s.value[4] = (float)A22;
+    d2s.value[5] = (float)b2;
+    return d2s;
+}
+
+// Bilinear sample of one dst pixel with const_value_st outside the image,
+// BGR->RGB, /255 and HWC->CHW.
+WARPAFFINE_HD inline void warpaffine_pixel(
+    const uint8_t* src, int src_line_size, int src_width,
+    int src_height, float* dst, int dst_width,
+    int dst_height, uint8_t const_value_st,
+    const AffineMatrix& d2s, int dx, int dy) {
+    float m_x1 = d2s.value[0];
+    float m_y1 = d2s.value[1];
+    float m_z1 = d2s.value[2];
+    float m_x2 = d2s.value[3];
+    float m_y2 = d2s.value[4];
+    float m_z2 = d2s.value[5];
+
+    float src_x = m_x1 * dx + m_y1 * dy + m_z1 + 0.5f;
+    float src_y = m_x2 * dx + m_y2 * dy + m_z2 + 0.5f;
+    float c0, c1, c2;
+
+    if (src_x <= -1 || src_x >= src_width || src_y <= -1 || src_y >= src_height) {
+        // out of range
+        c0 = const_value_st;
+        c1 = const_value_st;
+        c2 = const_value_st;
+    } else {
+        int y_low = floorf(src_y);
+        int x_low = floorf(src_x);
+        int y_high = y_low + 1;
+        int x_high = x_low + 1;
+
+        uint8_t const_value[] = {const_value_st, const_value_st, const_value_st};
+        float ly = src_y - y_low;
+        float lx = src_x - x_low;
+        float hy = 1 - ly;
+        float hx = 1 - lx;
+        float w1 = hy * hx, w2 = hy * lx, w3 = ly * hx, w4 = ly * lx;
+        const uint8_t* v1 = const_value;
+        const uint8_t* v2 = const_value;
+        const uint8_t* v3 = const_value;
+        const uint8_t* v4 = const_value;
+
+        if (y_low >= 0) {
+            if (x_low >= 0)
+                v1 = src + y_low * src_line_size + x_low * 3;
+
+            if (x_high < src_width)
+                v2 = src + y_low * src_line_size + x_high * 3;
+        }
+
+        if (y_high < src_height) {
+            if (x_low >= 0)
+                v3 = src + y_high * src_line_size + x_low * 3;
+
+            if (x_high < src_width)
+                v4 = src + y_high * src_line_size + x_high * 3;
+        }
+
+        c0 = w1 * v1[0] + w2 * v2[0] + w3 * v3[0] + w4 * v4[0];
+        c1 = w1 * v1[1] + w2 * v2[1] + w3 * v3[1] + w4 * v4[1];
+        c2 = w1 * v1[2] + w2 * v2[2] + w3 * v3[2] + w4 * v4[2];
+    }
+
+    //bgr to rgb
+    float t = c2;
+    c2 = c0;
+    c0 = t;
+
+    //normalization
+    c0 = c0 / 255.0f;
+    c1 = c1 / 255.0f;
+    c2 = c2 / 255.0f;
+
+    //rgbrgbrgb to rrrgggbbb
+    int area = dst_width * dst_height;
+    float* pdst_c0 = dst + dy * dst_width + dx;
+    float* pdst_c1 = pdst_c0 + area;
+    float* pdst_c2 = pdst_c1 + area;
+    *pdst_c0 = c0;
+    *pdst_c1 = c1;
+    *pdst_c2 = c2;
+}
+
+// A YUV 4:2:0 frame as video decoders and cameras deliver it: a full
+// resolution Y plane and U / V planes at half resolution, either interleaved
+// (NV12, u = uv plane, v = u + 1, uv_step 2) or separate (I420, uv_step 1).
+struct YuvImage {
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    int y_line_size;
+    int uv_line_size;
+    int uv_step;
+};
+
+static inline YuvImage yuv_nv12(const uint8_t* y, int y_line_size, const uint8_t* uv, int uv_line_size) {
+    YuvImage img = {y, uv, uv + 1, y_line_size, uv_line_size, 2};
+    return img;
+}
+
+static inline YuvImage yuv_i420(const uint8_t* y, int y_line_size, const uint8_t* u, const uint8_t* v, int uv_line_size) {
+    YuvImage img = {y, u, v, y_line_size, uv_line_size, 1};
+    return img;
+}
+
+// Contiguous frames of width x height (even), planes back to back.
+static inline YuvImage yuv_nv12_frame(const uint8_t* data, int width, int height) {
+    return yuv_nv12(data, width, data + width * height, width);
+}
+
+static inline YuvImage yuv_i420_frame(const uint8_t* data, int width, int height) {
+    return yuv_i420(data, width, data + width * height, data + width * height + (width / 2) * (height / 2), width / 2);
+}
+
+// BT.601 limited range YUV -> BGR of one pixel in the fixed point arithmetic of
+// cv::cvtColor(COLOR_YUV2BGR_NV12 / COLOR_YUV2BGR_I420), so letterboxing the
+// planes samples the same BGR values as converting the frame first.
+WARPAFFINE_HD inline void yuv_to_bgr(const YuvImage& src, int x, int y, uint8_t* bgr) {
+    const int shift = 20;
+    const int uv_offset = (y >> 1) * src.uv_line_size + (x >> 1) * src.uv_step;
+    const int u = src.u[uv_offset] - 128;
+    const int v = src.v[uv_offset] - 128;
+    const int half = 1 << (shift - 1);
+    int yy = src.y[y * src.y_line_size + x] - 16;
+    yy = (yy > 0 ? yy : 0) * 1220542;
+    const int c[3] = {(yy + half + 2116026 * u) >> shift,
+                      (yy + half - 852492 * v - 409993 * u) >> shift,
+                      (yy + half + 1673527 * v) >> shift};
+    for (int i = 0; i < 3; i++) bgr[i] = (uint8_t)(c[i] < 0 ? 0 : c[i] > 255 ? 255 : c[i]);
+}
+
+// warpaffine_pixel of the BGR image the YUV frame converts to, converting only
+// the four taps of the sample.
+WARPAFFINE_HD inline void warpaffine_pixel_yuv(
+    const YuvImage& src, int src_width, int src_height,
+    float* dst, int dst_width, int dst_height, uint8_t const_value_st,
+    const AffineMatrix& d2s, int dx, int dy) {
+    float src_x = d2s.value[0] * dx + d2s.value[1] * dy + d2s.value[2] + 0.5f;
+    float src_y = d2s.value[3] * dx + d2s.value[4] * dy + d2s.value[5] + 0.5f;
+    float c0 = const_value_st, c1 = const_value_st, c2 = const_value_st;
+
+    if (!(src_x <= -1 || src_x >= src_width || src_y <= -1 || src_y >= src_height)) {
+        int y_low = floorf(src_y);
+        int x_low = floorf(src_x);
+        float ly = src_y - y_low;
+        float lx = src_x - x_low;
+        float hy = 1 - ly;
+        float hx = 1 - lx;
+        float w[4] = {hy * hx, hy * lx, ly * hx, ly * lx};
+        uint8_t v[4][3];
+        for (int i = 0; i < 4; i++) {
+            int x = x_low + (i & 1), y = y_low + (i >> 1);
+            if (x >= 0 && x < src_width && y >= 0 && y < src_height) {
+                yuv_to_bgr(src, x, y, v[i]);
+            } else {
+                v[i][0] = v[i][1] = v[i][2] = const_value_st;
+            }
+        }
+        c0 = w[0] * v[0][0] + w[1] * v[1][0] + w[2] * v[2][0] + w[3] * v[3][0];
+        c1 = w[0] * v[0][1] + w[1] * v[1][1] + w[2] * v[2][1] + w[3] * v[3][1];
+        c2 = w[0] * v[0][2] + w[1] * v[1][2] + w[2] * v[2][2] + w[3] * v[3][2];
+    }
+
+    // bgr to rgb, normalization, rrrgggbbb
+    int area = dst_width * dst_height;
+    float* pdst = dst + dy * dst_width + dx;
+    pdst[0] = c2 / 255.0f;
+    pdst[area] = c1 / 255.0f;
+    pdst[2 * area] = c0 / 255.0f;
+}
+
+#endif  // TRTX_YOLOV5_WARPAFFINE_H_
@@ -0,0 +1,119 @@
+// Checks YoloLayerCpu::forward against forwardRef, the per-cell loop of the
+// plugin's CalDetection kernel, and times both. The three detect heads of a
+// 640x640 yolov5 are filled with synthetic logits: mostly background, a few
+// hundred object cells, and some saturated class logits, so ties between
+// classes are exercised too. Needs no GPU.
+//   ./yololayer_bench [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "yololayer_cpu.h"
+
+using namespace Yolo;
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+static std::vector<YoloKernel> yolov5_kernels() {
+    const float anchors[3][6] = {{10, 13, 16, 30, 33, 23}, {30, 61, 62, 45, 59, 119}, {116, 90, 156, 198, 373, 326}};
+    std::vector<YoloKernel> kernels;
+    for (int i = 0, scale = 8; i < 3; i++, scale *= 2) {
+        YoloKernel kernel;
+        kernel.width = INPUT_W / scale;
+        kernel.height = INPUT_H / scale;
+        memcpy(kernel.anchors, anchors[i], sizeof(kernel.anchors));
+        kernels.push_back(kernel);
+    }
+    return kernels;
+}
+
+// One head for the whole batch, CHW per batch item. objects is the share of
+// cells whose objectness is above IGNORE_THRESH.
+static std::vector<float> make_head(const YoloKernel& yolo, int batch, float objects, std::mt19937& rng) {
+    std::normal_distribution<float> background(-7.f, 2.f), logit(-3.f, 3.f);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    const int grid = yolo.width * yolo.height;
+    const int info_len = 5 + CLASS_NUM;
+    std::vector<float> head((size_t)batch * CHECK_COUNT * info_len * grid);
+    for (int b = 0; b < batch; b++) {
+        for (int k = 0; k < CHECK_COUNT; k++) {
+            float* in = &head[((size_t)b * CHECK_COUNT + k) * info_len * grid];
+            for (int c = 0; c < info_len * grid; c++) in[c] = logit(rng);
+            for (int cell = 0; cell < grid; cell++) {
+                in[4 * grid + cell] = u(rng) < objects ? 2.f * u(rng) - 2.1f : background(rng);
+                if (u(rng) < 0.05f) {
+                    // saturated classes, their sigmoids are all 1.f
+                    for (int n = 0; n < 3; n++) in[(5 + rng() % CLASS_NUM) * grid + cell] = 17.f + 10.f * u(rng);
+                }
+            }
+        }
+    }
+    return head;
+}
+
+static bool less_det(const Detection& a, const Detection& b) {
+    return memcmp(&a, &b, sizeof(Detection)) < 0;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    std::vector<YoloKernel> kernels = yolov5_kernels();
+    std::mt19937 rng(0);
+    WorkerPool pool;
+    bool ok = true;
+    struct Case { int batch; float objects; int max_out; };
+    const Case cases[] = {{1, 0.01f, MAX_OUTPUT_BBOX_COUNT}, {1, 0.05f, MAX_OUTPUT_BBOX_COUNT}, {4, 0.01f, MAX_OUTPUT_BBOX_COUNT}, {1, 0.2f, 300}};
+    for (const Case& c : cases) {
+        YoloLayerCpu layer(CLASS_NUM, INPUT_W, INPUT_H, c.max_out, kernels);
+        std::vector<std::vector<float>> heads;
+        std::vector<const float*> inputs;
+        for (const YoloKernel& yolo : kernels) heads.push_back(make_head(yolo, c.batch, c.objects, rng));
+        for (auto& head : heads) inputs.push_back(head.data());
+        const size_t output_size = (size_t)c.batch * layer.outputSize();
+        std::vector<float> ref(output_size, 0.f), out(output_size, 0.f), any(output_size, 0.f);
+
+        layer.forwardRef(inputs.data(), ref.data(), c.batch);
+        layer.forward(inputs.data(), out.data(), c.batch, true, &pool);
+        bool same = memcmp(ref.data(), out.data(), output_size * sizeof(float)) == 0;
+        layer.forward(inputs.data(), out.data(), c.batch, true);
+        same = same && memcmp(ref.data(), out.data(), output_size * sizeof(float)) == 0;
+
+        // Without the deterministic order only the set of boxes matches, and
+        // only while no image overflows max_out.
+        layer.forward(inputs.data(), any.data(), c.batch, false, &pool);
+        bool same_set = true;
+        for (int b = 0; b < c.batch; b++) {
+            const float* r = &ref[(size_t)b * layer.outputSize()];
+            const float* a = &any[(size_t)b * layer.outputSize()];
+            int n = std::min((int)r[0], c.max_out);
+            if (n == c.max_out) continue;
+            same_set = same_set && r[0] == a[0];
+            std::vector<Detection> dr((const Detection*)(r + 1), (const Detection*)(r + 1) + n);
+            std::vector<Detection> da((const Detection*)(a + 1), (const Detection*)(a + 1) + n);
+            std::sort(dr.begin(), dr.end(), less_det);
+            std::sort(da.begin(), da.end(), less_det);
+            same_set = same_set && memcmp(dr.data(), da.data(), n * sizeof(Detection)) == 0;
+        }
+        ok = ok && same && same_set;
+
+        double t_ref = time_ms(iterations, [&]() { layer.forwardRef(inputs.data(), ref.data(), c.batch); });
+        double t_one = time_ms(iterations, [&]() { layer.forward(inputs.data(), out.data(), c.batch); });
+        double t_pool = time_ms(iterations, [&]() { layer.forward(inputs.data(), out.data(), c.batch, true, &pool); });
+        double t_any = time_ms(iterations, [&]() { layer.forward(inputs.data(), any.data(), c.batch, false, &pool); });
+        std::cout << "batch " << c.batch << ", " << c.objects * 100 << "% object cells: count " << ref[0]
+                  << (same ? " same as per-cell loop" : " MISMATCH") << (same_set ? "" : ", unordered MISMATCH")
+                  << "  per-cell " << t_ref << "ms  1 thread " << t_one << "ms  " << pool.size() << " threads " << t_pool
+                  << "ms  unordered " << t_any << "ms" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
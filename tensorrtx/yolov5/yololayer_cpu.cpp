@@ -0,0 +1,179 @@
+#include "yololayer_cpu.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "yolo_decode.h"
+
+using namespace Yolo;
+
+namespace {
+
+// Cells per band of rows, the unit of work of forward().
+const int BAND_CELLS = 512;
+
+inline float logist(float data) { return 1.0f / (1.0f + expf(-data)); }
+
+}  // namespace
+
+YoloLayerCpu::YoloLayerCpu(int classCount, int netWidth, int netHeight, int maxOut, const std::vector<YoloKernel>& kernels)
+    : mClassCount(classCount), mNetWidth(netWidth), mNetHeight(netHeight), mMaxOut(maxOut),
+      mOutputSize(1 + maxOut * sizeof(Detection) / sizeof(float)), mKernels(kernels) {}
+
+void YoloLayerCpu::decodeCell(const float* in, int head, int cell, int k, float max_logit, Detection& det) const {
+    const YoloKernel& yolo = mKernels[head];
+    const int total_grid = yolo.width * yolo.height;
+    const int info_len_i = 5 + mClassCount;
+    const float* box = in + k * info_len_i * total_grid + cell;
+
+    float max_cls_prob;
+    int class_id = yolodecode::bestClass<yolodecode::Yolov5Head, 0>(box + 5 * total_grid, total_grid, mClassCount, max_logit, max_cls_prob);
+    yolodecode::Cell c = {box, total_grid, cell % yolo.width, cell / yolo.width, yolo.width, yolo.height,
+                          mNetWidth, mNetHeight, yolo.anchors[2 * k], yolo.anchors[2 * k + 1]};
+    yolodecode::Yolov5Head::write(c, logist(box[4 * total_grid]), class_id, max_cls_prob, (float*)&det);
+}
+
+void YoloLayerCpu::decodeBand(const float* const* inputs, const Band& band, std::vector<Found>& found) const {
+    const YoloKernel& yolo = mKernels[band.head];
+    const int total_grid = yolo.width * yolo.height;
+    const int info_len_i = 5 + mClassCount;
+    const float* in = inputs[band.head] + (size_t)band.batch * info_len_i * total_grid * CHECK_COUNT;
+    const int cell1 = band.row1 * yolo.width;
+    found.clear();
+    for (int cell0 = band.row0 * yolo.width; cell0 < cell1; cell0 += 8) {
+        unsigned masks[CHECK_COUNT];
+        unsigned any = 0;
+        for (int k = 0; k < CHECK_COUNT; ++k) {
+            const float* obj = in + (k * info_len_i + 4) * total_grid + cell0;
+            if (cell0 + 8 <= cell1) {
+                masks[k] = yolodecode::screen8(obj, yolodecode::kObjLogitMin);
+            } else {
+                masks[k] = 0;
+                for (int j = 0; j < cell1 - cell0; j++) masks[k] |= (unsigned)(obj[j] >= yolodecode::kObjLogitMin) << j;
+            }
+            any |= masks[k];
+        }
+        // Class maxima of all 8 cells of an anchor, once one of them is decoded:
+        // 8 contiguous logits per class plane instead of one cache line per class
+        // and cell.
+        float max_logits[CHECK_COUNT][8];
+        unsigned have_max = 0;
+        while (any) {
+            int j = __builtin_ctz(any);
+            any &= any - 1;
+            int cell = cell0 + j;
+            for (int k = 0; k < CHECK_COUNT; ++k) {
+                if (!(masks[k] >> j & 1)) continue;
+                if (logist(in[(k * info_len_i + 4) * total_grid + cell]) < IGNORE_THRESH) continue;
+                const float* cls = in + (k * info_len_i + 5) * total_grid + cell0;
+                if (!(have_max >> k & 1)) {
+                    if (cell0 + 8 <= cell1) {
+                        yolodecode::classMax8<0>(cls, total_grid, mClassCount, max_logits[k]);
+                    } else {
+                        std::fill(max_logits[k], max_logits[k] + 8, -INFINITY);
+                    }
+                    have_max |= 1u << k;
+                }
+                found.emplace_back();
+                found.back().cell = cell;
+                decodeCell(in, band.head, cell, k, max_logits[k][j], found.back().det);
+            }
+        }
+    }
+}
+
+void YoloLayerCpu::forward(const float* const* inputs, float* output, int batchSize, bool deterministic, WorkerPool* pool) {
+    mBands.clear();
+    for (int b = 0; b < batchSize; ++b) {
+        for (int h = 0; h < (int)mKernels.size(); ++h) {
+            const YoloKernel& yolo = mKernels[h];
+            int rows = std::max(1, BAND_CELLS / yolo.width);
+            for (int r = 0; r < yolo.height; r += rows) mBands.push_back({b, h, r, std::min(r + rows, yolo.height)});
+        }
+    }
+    const int bands = (int)mBands.size();
+    const int bandsPerImage = bands / std::max(batchSize, 1);
+    if ((int)mFound.size() < bands) mFound.resize(bands);
+    if ((int)mCounts.size() < batchSize) {
+        std::vector<std::atomic<int>> counts(batchSize);
+        mCounts.swap(counts);
+    }
+    for (int b = 0; b < batchSize; ++b) mCounts[b] = 0;
+
+    // Appends the boxes of one band to its image as CalDetection does: count
+    // every box, write the first mMaxOut, and leave a cell once it overflows.
+    auto emit = [&](int band) {
+        const std::vector<Found>& found = mFound[band];
+        const int b = mBands[band].batch;
+        float* out = output + (size_t)b * mOutputSize;
+        int overflowed = -1;
+        for (const Found& f : found) {
+            if (f.cell == overflowed) continue;
+            int count = mCounts[b]++;
+            if (count >= mMaxOut) {
+                overflowed = f.cell;
+                continue;
+            }
+            memcpy(out + 1 + count * sizeof(Detection) / sizeof(float), &f.det, sizeof(Detection));
+        }
+    };
+    auto decode = [&](int band) {
+        decodeBand(inputs, mBands[band], mFound[band]);
+        if (!deterministic) emit(band);
+    };
+    auto merge = [&](int b) {
+        for (int band = b * bandsPerImage; band < (b + 1) * bandsPerImage; ++band) emit(band);
+    };
+    if (pool) {
+        pool->parallelFor(bands, decode);
+        if (deterministic) pool->parallelFor(batchSize, merge);
+    } else {
+        for (int band = 0; band < bands; ++band) decode(band);
+        if (deterministic) {
+            for (int b = 0; b < batchSize; ++b) merge(b);
+        }
+    }
+    for (int b = 0; b < batchSize; ++b) output[(size_t)b * mOutputSize] = (float)mCounts[b];
+}
+
+void YoloLayerCpu::forwardRef(const float* const* inputs, float* output, int batchSize) const {
+    for (int b = 0; b < batchSize; ++b) output[(size_t)b * mOutputSize] = 0;
+    for (size_t h = 0; h < mKernels.size(); ++h) {
+        const YoloKernel& yolo = mKernels[h];
+        const float* anchors = yolo.anchors;
+        const int total_grid = yolo.width * yolo.height;
+        const int info_len_i = 5 + mClassCount;
+        for (int bnIdx = 0; bnIdx < batchSize; ++bnIdx) {
+            const float* curInput = inputs[h] + (size_t)bnIdx * (info_len_i * total_grid * CHECK_COUNT);
+            for (int idx = 0; idx < total_grid; ++idx) {
+                for (int k = 0; k < CHECK_COUNT; ++k) {
+                    float box_prob = logist(curInput[idx + k * info_len_i * total_grid + 4 * total_grid]);
+                    if (box_prob < IGNORE_THRESH) continue;
+                    int class_id = 0;
+                    float max_cls_prob = 0.0;
+                    for (int i = 5; i < info_len_i; ++i) {
+                        float p = logist(curInput[idx + k * info_len_i * total_grid + i * total_grid]);
+                        if (p > max_cls_prob) {
+                            max_cls_prob = p;
+                            class_id = i - 5;
+                        }
+                    }
+                    float* res_count = output + (size_t)bnIdx * mOutputSize;
+                    int count = (int)(*res_count)++;
+                    if (count >= mMaxOut) break;
+                    Detection* det = (Detection*)(res_count + 1) + count;
+
+                    int row = idx / yolo.width;
+                    int col = idx % yolo.width;
+                    det->bbox[0] = (col - 0.5f + 2.0f * logist(curInput[idx + k * info_len_i * total_grid + 0 * total_grid])) * mNetWidth / yolo.width;
+                    det->bbox[1] = (row - 0.5f + 2.0f * logist(curInput[idx + k * info_len_i * total_grid + 1 * total_grid])) * mNetHeight / yolo.height;
+                    det->bbox[2] = 2.0f * logist(curInput[idx + k * info_len_i * total_grid + 2 * total_grid]);
+                    det->bbox[2] = det->bbox[2] * det->bbox[2] * anchors[2 * k];
+                    det->bbox[3] = 2.0f * logist(curInput[idx + k * info_len_i * total_grid + 3 * total_grid]);
+                    det->bbox[3] = det->bbox[3] * det->bbox[3] * anchors[2 * k + 1];
+                    det->conf = box_prob * max_cls_prob;
+                    det->class_id = class_id;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef TRTX_YOLOV5_YOLOLAYER_CPU_H_
+#define TRTX_YOLOV5_YOLOLAYER_CPU_H_
+
+#include <atomic>
+#include <vector>
+#include "yololayer.h"
+#include "worker_pool.h"
+
+// Host version of YoloLayerPlugin: decodes the detect conv outputs, one
+// CHW tensor of CHECK_COUNT * (5 + classes) channels per head and batch item,
+// into the plugin's output, per image [count, Detection * maxOut].
+//
+// forward() splits each head into bands of rows over a WorkerPool. The
+// objectness planes are screened on their raw logits, 8 cells at a time with
+// AVX2 (4 with NEON), so the sigmoid is only evaluated near or above
+// IGNORE_THRESH, and the class loop only evaluates the sigmoid of the classes
+// that can reach the maximum. The decisions and values are those of the
+// per-cell loop, forwardRef().
+//
+// Order of the detections of an image:
+//  deterministic  head, then cell in row-major order, then anchor; the same
+//                 blob as forwardRef(), bit for bit, for any thread count.
+//  otherwise      whatever order the bands finish in, like the GPU's atomic
+//                 counter; the same set of detections unless maxOut overflows.
+// count is that of the plugin: every box above IGNORE_THRESH counts, and only
+// the first maxOut are written.
+//
+// The CUDA kernel's expf and fused multiply-adds can differ in the last bits
+// from the host, so compare GPU output with a tolerance.
+class YoloLayerCpu {
+public:
+    YoloLayerCpu(int classCount, int netWidth, int netHeight, int maxOut, const std::vector<Yolo::YoloKernel>& kernels);
+
+    // Floats of one image's output, 1 + maxOut * 6.
+    int outputSize() const { return mOutputSize; }
+
+    // inputs[i] is head i for the whole batch, output holds batchSize * outputSize() floats.
+    // Scratch is kept across calls; one call at a time per object.
+    void forward(const float* const* inputs, float* output, int batchSize, bool deterministic = true, WorkerPool* pool = nullptr);
+
+    // CalDetection's loop on one thread, one cell after another. Slow; the reference for forward().
+    void forwardRef(const float* const* inputs, float* output, int batchSize) const;
+
+private:
+    struct Band {
+        int batch, head, row0, row1;
+    };
+    // A decoded box and the cell it came from.
+    struct Found {
+        int cell;
+        Yolo::Detection det;
+    };
+
+    void decodeBand(const float* const* inputs, const Band& band, std::vector<Found>& found) const;
+    void decodeCell(const float* in, int head, int cell, int k, float max_logit, Yolo::Detection& det) const;
+
+    int mClassCount;
+    int mNetWidth;
+    int mNetHeight;
+    int mMaxOut;
+    int mOutputSize;
+    std::vector<Yolo::YoloKernel> mKernels;
+    std::vector<Band> mBands;
+    std::vector<std::vector<Found>> mFound;
+    std::vector<std::atomic<int>> mCounts;
+};
+
+#endif  // TRTX_YOLOV5_YOLOLAYER_CPU_H_
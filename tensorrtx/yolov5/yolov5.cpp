@@ -6,14 +6,29 @@
 #include "common.hpp"
 #include "utils.h"
 #include "calibrator.h"
+#include "image_loader.h"
+#include "result_writer.h"
 #include "preprocess.h"
+#include "preprocess_cpu.h"
+#include "tiling.h"
 
 #define USE_FP16  // set USE_INT8 or USE_FP16 or USE_FP32
+#define INPUT_FORMAT INPUT_FORMAT_FP32  // wire format of the "data" binding, INPUT_FORMAT_UINT8 / INPUT_FORMAT_FP16 see input_format.h
 #define DEVICE 0  // GPU id
 #define NMS_THRESH 0.4
 #define CONF_THRESH 0.5
 #define BATCH_SIZE 1
-#define MAX_IMAGE_INPUT_SIZE_THRESH 3000 * 3000 // ensure it exceed the maximum size in the input images !
+#define TOP_K 300  // most confident boxes per image that go to NMS
+#define MAX_IMAGE_INPUT_SIZE_THRESH 3000 * 3000 // larger input images are letterboxed on the host
+#define LOADER_THREADS 2  // threads reading and decoding images, 0 for one per core
+#define LOADER_LOOKAHEAD 2  // batches decoded ahead of the one being inferred
+#define REDUCED_DECODE false  // decode JPEGs at 1/2, 1/4 or 1/8 size when that still covers the input, e.g. 4K stills
+#define TILED_INFERENCE false  // infer overlapping INPUT_W x INPUT_H tiles of each image plus the whole image, and merge them, see tiling.h
+#define TILE_OVERLAP 0.2  // least fraction of a tile shared with its neighbour
+#define WRITER_THREADS 2  // threads drawing, encoding and writing the output images, 0 for half the cores
+#define WRITER_QUEUE 8  // images waiting to be written before the loop waits for the writer
+#define DRAW_RESULTS true  // false: write no images, only RESULTS_FILE
+#define RESULTS_FILE ""  // JSON lines file of the boxes of every image, "" for none
 
 // stuff we know about the network and the input/output blobs
 static const int INPUT_H = Yolo::INPUT_H;
@@ -24,6 +39,11 @@ const char* INPUT_BLOB_NAME = "data";
 const char* OUTPUT_BLOB_NAME = "prob";
 static Logger gLogger;
 
+#if defined(USE_INT8)
+// The calibrator feeds FP32 CHW batches to INPUT_BLOB_NAME.
+static_assert(INPUT_FORMAT == INPUT_FORMAT_FP32, "INT8 calibration needs INPUT_FORMAT_FP32");
+#endif
+
 static int get_width(int x, float gw, int divisor = 8) {
     return int(ceil((x * gw) / divisor)) * divisor;
 }
@@ -40,8 +60,9 @@ static int get_depth(int x, float gd) {
 ICudaEngine* build_engine(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, float& gd, float& gw, std::string& wts_name) {
     INetworkDefinition* network = builder->createNetworkV2(0U);
 
-    // Create input tensor of shape {3, INPUT_H, INPUT_W} with name INPUT_BLOB_NAME
-    ITensor* data = network->addInput(INPUT_BLOB_NAME, dt, Dims3{ 3, INPUT_H, INPUT_W });
+    // Create input tensor of shape {3, INPUT_H, INPUT_W} with name INPUT_BLOB_NAME,
+    // behind the normalize layer when the binding is UINT8 / FP16
+    ITensor* data = addNetworkInput(network, INPUT_BLOB_NAME, INPUT_FORMAT, INPUT_W, INPUT_H);
     assert(data);
     std::map<std::string, Weights> weightMap = loadWeights(wts_name);
     /* ------ yolov5 backbone------ */
@@ -116,18 +137,16 @@ ICudaEngine* build_engine(unsigned int maxBatchSize, IBuilder* builder, IBuilder
     network->destroy();
 
     // Release host memory
-    for (auto& mem : weightMap)
-    {
-        free((void*)(mem.second.values));
-    }
+    freeWeights(weightMap);
 
     return engine;
 }
 
 ICudaEngine* build_engine_p6(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, float& gd, float& gw, std::string& wts_name) {
     INetworkDefinition* network = builder->createNetworkV2(0U);
-    // Create input tensor of shape {3, INPUT_H, INPUT_W} with name INPUT_BLOB_NAME
-    ITensor* data = network->addInput(INPUT_BLOB_NAME, dt, Dims3{ 3, INPUT_H, INPUT_W });
+    // Create input tensor of shape {3, INPUT_H, INPUT_W} with name INPUT_BLOB_NAME,
+    // behind the normalize layer when the binding is UINT8 / FP16
+    ITensor* data = addNetworkInput(network, INPUT_BLOB_NAME, INPUT_FORMAT, INPUT_W, INPUT_H);
     assert(data);
     
     std::map<std::string, Weights> weightMap = loadWeights(wts_name);
@@ -220,10 +239,7 @@ ICudaEngine* build_engine_p6(unsigned int maxBatchSize, IBuilder* builder, IBuil
     network->destroy();
 
     // Release host memory
-    for (auto& mem : weightMap)
-    {
-        free((void*)(mem.second.values));
-    }
+    freeWeights(weightMap);
 
     return engine;
 }
@@ -258,7 +274,7 @@ void doInference(IExecutionContext& context, cudaStream_t& stream, void **buffer
     cudaStreamSynchronize(stream);
 }
 
-bool parse_args(int argc, char** argv, std::string& wts, std::string& engine, bool& is_p6, float& gd, float& gw, std::string& img_dir) {
+bool parse_args(int argc, char** argv, std::string& wts, std::string& engine, bool& is_p6, float& gd, float& gw, std::string& img_dir, std::string& prob_dump) {
     if (argc < 4) return false;
     if (std::string(argv[1]) == "-s" && (argc == 5 || argc == 7)) {
         wts = std::string(argv[2]);
@@ -288,9 +304,10 @@ bool parse_args(int argc, char** argv, std::string& wts, std::string& engine, bo
         if (net.size() == 2 && net[1] == '6') {
             is_p6 = true;
         }
-    } else if (std::string(argv[1]) == "-d" && argc == 4) {
+    } else if (std::string(argv[1]) == "-d" && (argc == 4 || argc == 5)) {
         engine = std::string(argv[2]);
         img_dir = std::string(argv[3]);
+        if (argc == 5) prob_dump = std::string(argv[4]);
     } else {
         return false;
     }
@@ -305,10 +322,11 @@ int main(int argc, char** argv) {
     bool is_p6 = false;
     float gd = 0.0f, gw = 0.0f;
     std::string img_dir;
-    if (!parse_args(argc, argv, wts_name, engine_name, is_p6, gd, gw, img_dir)) {
+    std::string prob_dump;
+    if (!parse_args(argc, argv, wts_name, engine_name, is_p6, gd, gw, img_dir, prob_dump)) {
         std::cerr << "arguments not right!" << std::endl;
         std::cerr << "./yolov5 -s [.wts] [.engine] [n/s/m/l/x/n6/s6/m6/l6/x6 or c/c6 gd gw]  // serialize model to plan file" << std::endl;
-        std::cerr << "./yolov5 -d [.engine] ../samples  // deserialize plan file and run inference" << std::endl;
+        std::cerr << "./yolov5 -d [.engine] ../samples [prob.bin]  // deserialize plan file and run inference, optionally recording the raw outputs" << std::endl;
         return -1;
     }
 
@@ -366,7 +384,8 @@ int main(int argc, char** argv) {
     assert(inputIndex == 0);
     assert(outputIndex == 1);
     // Create GPU buffers on device
-    CUDA_CHECK(cudaMalloc((void**)&buffers[inputIndex], BATCH_SIZE * 3 * INPUT_H * INPUT_W * sizeof(float)));
+    const int input_bytes = input_format_bytes(INPUT_FORMAT, INPUT_W, INPUT_H);
+    CUDA_CHECK(cudaMalloc((void**)&buffers[inputIndex], BATCH_SIZE * input_bytes));
     CUDA_CHECK(cudaMalloc((void**)&buffers[outputIndex], BATCH_SIZE * OUTPUT_SIZE * sizeof(float)));
 
     // Create stream
@@ -376,49 +395,152 @@ int main(int argc, char** argv) {
     uint8_t* img_device = nullptr;
     // prepare input data cache in pinned memory 
     CUDA_CHECK(cudaMallocHost((void**)&img_host, MAX_IMAGE_INPUT_SIZE_THRESH * 3));
-    // prepare input data cache in device memory
-    CUDA_CHECK(cudaMalloc((void**)&img_device, MAX_IMAGE_INPUT_SIZE_THRESH * 3));
-    int fcount = 0;
-    std::vector<cv::Mat> imgs_buffer(BATCH_SIZE);
-    for (int f = 0; f < (int)file_names.size(); f++) {
-        fcount++;
-        if (fcount < BATCH_SIZE && f + 1 != (int)file_names.size()) continue;
+    // prepare input data cache in device memory, one image per batch slot when the tiles of a batch are packed together
+    CUDA_CHECK(cudaMalloc((void**)&img_device, (TILED_INFERENCE ? BATCH_SIZE : 1) * MAX_IMAGE_INPUT_SIZE_THRESH * 3));
+    // FP32 images are letterboxed on the GPU when they fit in img_device, on the host otherwise
+    auto on_device = [](const cv::Mat& img) {
+        return INPUT_FORMAT == INPUT_FORMAT_FP32 && img.rows * img.step <= (size_t)MAX_IMAGE_INPUT_SIZE_THRESH * 3;
+    };
+    // raw "prob" of every image, back to back, for postprocess_bench and the mock server's --replay
+    std::ofstream dump;
+    if (!prob_dump.empty()) dump.open(prob_dump, std::ios::binary);
+    WorkerPool pool;
+    DetectionArena arena(BATCH_SIZE, Yolo::MAX_OUTPUT_BBOX_COUNT);
+    PostprocessParams params;
+    params.conf_thresh = CONF_THRESH;
+    params.nms_thresh = NMS_THRESH;
+    params.top_k = TOP_K;
+    int img_sizes[2 * BATCH_SIZE];
+    int original_sizes[2 * BATCH_SIZE];
+    // the next batches are read and decoded while this one runs, straight into pinned memory
+    ImageLoader::Options loader_options;
+    loader_options.batch_size = BATCH_SIZE;
+    loader_options.lookahead = LOADER_LOOKAHEAD;
+    loader_options.threads = LOADER_THREADS;
+    loader_options.max_image_bytes = MAX_IMAGE_INPUT_SIZE_THRESH * 3;
+    if (REDUCED_DECODE && !TILED_INFERENCE) {
+        loader_options.target_w = INPUT_W;
+        loader_options.target_h = INPUT_H;
+    }
+    loader_options.alloc = [](size_t bytes) -> void* {
+        void* p = nullptr;
+        CUDA_CHECK(cudaMallocHost(&p, bytes));
+        return p;
+    };
+    loader_options.release = [](void* p) { CUDA_CHECK(cudaFreeHost(p)); };
+    TilingParams tiling;
+    tiling.overlap = TILE_OVERLAP;
+    TileMerger merger(tiling, params);
+    std::vector<TileRef> tiles;
+    long long tile_count = 0;
+    auto tiles_start = std::chrono::steady_clock::now();
+    ImageLoader loader(img_dir, file_names, loader_options);
+    ResultWriter::Options writer_options;
+    writer_options.threads = WRITER_THREADS;
+    writer_options.queue = WRITER_QUEUE;
+    writer_options.draw = DRAW_RESULTS;
+    writer_options.results = RESULTS_FILE;
+    ResultWriter writer(writer_options);
+    while (const ImageLoader::Batch* batch = loader.next()) {
+        const int fcount = batch->size;
         //auto start = std::chrono::system_clock::now();
-        float* buffer_idx = (float*)buffers[inputIndex];
-        for (int b = 0; b < fcount; b++) {
-            cv::Mat img = cv::imread(img_dir + "/" + file_names[f - fcount + 1 + b]);
-            if (img.empty()) continue;
-            imgs_buffer[b] = img;
+        uint8_t* buffer_idx = (uint8_t*)buffers[inputIndex];
+        for (int b = 0; TILED_INFERENCE && b < fcount; b++) {
+            const cv::Mat& img = batch->images[b];
+            if (img.empty()) std::cerr << "could not read " << batch->names[b] << std::endl;
+            img_sizes[2 * b] = original_sizes[2 * b] = img.cols;
+            img_sizes[2 * b + 1] = original_sizes[2 * b + 1] = img.rows;
+            if (!img.empty() && on_device(img)) {
+                CUDA_CHECK(cudaMemcpyAsync(img_device + (size_t)b * MAX_IMAGE_INPUT_SIZE_THRESH * 3, img.data, img.rows * img.step, cudaMemcpyHostToDevice, stream));
+            }
+        }
+        if (TILED_INFERENCE) {
+            // the tiles of all images of the batch, BATCH_SIZE at a time
+            plan_tiles(img_sizes, fcount, tiling, tiles);
+            merger.begin(tiles);
+            for (int first = 0; first < (int)tiles.size(); first += BATCH_SIZE) {
+                const int n = std::min(BATCH_SIZE, (int)tiles.size() - first);
+                for (int i = 0; i < n; i++) {
+                    const TileRef& ref = tiles[first + i];
+                    const cv::Mat& img = batch->images[ref.frame];
+                    const size_t offset = (size_t)ref.tile.y * img.step + ref.tile.x * 3;
+                    uint8_t* slot = (uint8_t*)buffers[inputIndex] + (size_t)i * input_bytes;
+                    if (on_device(img)) {
+                        uint8_t* frame = img_device + (size_t)ref.frame * MAX_IMAGE_INPUT_SIZE_THRESH * 3;
+                        preprocess_kernel_img(frame + offset, ref.tile.w, ref.tile.h, img.step, (float*)slot, INPUT_W, INPUT_H, stream);
+                    } else {
+                        CUDA_CHECK(cudaStreamSynchronize(stream));
+                        preprocess_img_cpu_packed(img.data + offset, ref.tile.w, ref.tile.h, img.step, INPUT_FORMAT, img_host, INPUT_W, INPUT_H);
+                        CUDA_CHECK(cudaMemcpyAsync(slot,img_host,input_bytes,cudaMemcpyHostToDevice,stream));
+                    }
+                }
+                doInference(*context, stream, (void**)buffers, prob, BATCH_SIZE);
+                if (dump.is_open()) dump.write(reinterpret_cast<const char*>(prob), n * OUTPUT_SIZE * sizeof(float));
+                merger.addTiles(prob, first, n, OUTPUT_SIZE, &pool);
+            }
+            merger.merge(fcount, arena, &pool);
+            tile_count += tiles.size();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tiles_start).count();
+            std::cout << tiles.size() << " tiles, " << merger.tileDetections() << " tile detections merged, "
+                      << tile_count / seconds << " tiles/s" << std::endl;
+        }
+        for (int b = 0; !TILED_INFERENCE && b < fcount; b++) {
+            const cv::Mat& img = batch->images[b];
+            img_sizes[2 * b] = original_sizes[2 * b] = INPUT_W;
+            img_sizes[2 * b + 1] = original_sizes[2 * b + 1] = INPUT_H;
+            if (img.empty()) {
+                std::cerr << "could not read " << batch->names[b] << std::endl;
+                buffer_idx += input_bytes;
+                continue;
+            }
+            img_sizes[2 * b] = img.cols;
+            img_sizes[2 * b + 1] = img.rows;
+            original_sizes[2 * b] = batch->original_sizes[b].width;
+            original_sizes[2 * b + 1] = batch->original_sizes[b].height;
             size_t  size_image = img.cols * img.rows * 3;
-            size_t  size_image_dst = INPUT_H * INPUT_W * 3;
-            //copy data to pinned memory
-            memcpy(img_host,img.data,size_image);
-            //copy data to device memory
-            CUDA_CHECK(cudaMemcpyAsync(img_device,img_host,size_image,cudaMemcpyHostToDevice,stream));
-            preprocess_kernel_img(img_device, img.cols, img.rows, buffer_idx, INPUT_W, INPUT_H, stream);       
-            buffer_idx += size_image_dst;
+            if (on_device(img)) {
+                //the loader's buffers are pinned, copy to device memory
+                CUDA_CHECK(cudaMemcpyAsync(img_device,img.data,size_image,cudaMemcpyHostToDevice,stream));
+                preprocess_kernel_img(img_device, img.cols, img.rows, (float*)buffer_idx, INPUT_W, INPUT_H, stream);
+            } else {
+                // letterbox into the packed wire format on the host, the engine normalizes it,
+                // or into FP32 for an image over MAX_IMAGE_INPUT_SIZE_THRESH
+                CUDA_CHECK(cudaStreamSynchronize(stream));
+                preprocess_img_cpu_packed(img.data, img.cols, img.rows, img.step, INPUT_FORMAT, img_host, INPUT_W, INPUT_H);
+                CUDA_CHECK(cudaMemcpyAsync(buffer_idx,img_host,input_bytes,cudaMemcpyHostToDevice,stream));
+            }
+            buffer_idx += input_bytes;
         }
-        // Run inference
-        auto start = std::chrono::system_clock::now();
-        doInference(*context, stream, (void**)buffers, prob, BATCH_SIZE);
-        auto end = std::chrono::system_clock::now();
-        std::cout << "inference time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
-        std::vector<std::vector<Yolo::Detection>> batch_res(fcount);
-        for (int b = 0; b < fcount; b++) {
-            auto& res = batch_res[b];
-            nms(res, &prob[b * OUTPUT_SIZE], CONF_THRESH, NMS_THRESH);
+        if (!TILED_INFERENCE) {
+            // Run inference
+            auto start = std::chrono::system_clock::now();
+            doInference(*context, stream, (void**)buffers, prob, BATCH_SIZE);
+            auto end = std::chrono::system_clock::now();
+            std::cout << "inference time: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms" << std::endl;
+            if (dump.is_open()) dump.write(reinterpret_cast<const char*>(prob), fcount * OUTPUT_SIZE * sizeof(float));
+            // boxes in pixels of the original images
+            postprocess_batch(prob, fcount, OUTPUT_SIZE, img_sizes, original_sizes, params, arena, &pool);
         }
+        // drawn, encoded and written on the writer's threads, the loader's image copied as it gets reused
         for (int b = 0; b < fcount; b++) {
-            auto& res = batch_res[b];
-            cv::Mat img = imgs_buffer[b];
-            for (size_t j = 0; j < res.size(); j++) {
-                cv::Rect r = get_rect(img, res[j].bbox);
-                cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
-                cv::putText(img, std::to_string((int)res[j].class_id), cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
+            const cv::Mat& img = batch->images[b];
+            if (img.empty()) continue;
+            ResultWriter::Job& job = writer.acquire();
+            job.name = "_" + batch->names[b];
+            if (writer.drawing()) img.copyTo(job.image);
+            // drawn on the decoded image, smaller than the original with REDUCED_DECODE
+            float sx = (float)img.cols / original_sizes[2 * b], sy = (float)img.rows / original_sizes[2 * b + 1];
+            const ImageDetection* res = arena.image(b);
+            for (int j = 0; j < arena.count(b); j++) {
+                job.detections.push_back(ResultWriter::Detection{res[j].x1 * sx, res[j].y1 * sy, res[j].x2 * sx, res[j].y2 * sy, res[j].conf, (int)res[j].class_id});
             }
-            cv::imwrite("_" + file_names[f - fcount + 1 + b], img);
+            writer.submit(job);
         }
-        fcount = 0;
+    }
+    writer.finish();
+    if (writer.blockedCount()) {
+        std::cout << "waited " << writer.blockedSeconds() * 1000 << "ms for the writer " << writer.blockedCount()
+                  << " times, raise WRITER_THREADS" << std::endl;
     }
 
     // Release stream and buffers
@@ -0,0 +1,426 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Pipeline.hpp"
+
+namespace Triton{
+
+    struct AggregatorConfig
+    {
+        // Frames per request, from any streams.
+        size_t max_batch_size = 4;
+        // A request is sent once it is full or its oldest frame has waited this long.
+        double deadline_ms = 20;
+        // Frames older than this when a request is formed are dropped.
+        double max_latency_ms = 250;
+        // Frames buffered per stream; a new frame to a full buffer drops the oldest.
+        size_t stream_queue = 2;
+        // Requests submitted to the server and not yet completed.
+        size_t inflight = 2;
+        // Read file sources at this rate, as a camera delivers them; 0 reads as fast as possible.
+        double source_fps = 0;
+    };
+
+    // Counters and latency (capture -> result delivered) of one stream.
+    struct StreamStats
+    {
+        size_t captured = 0;
+        size_t delivered = 0;
+        // dropped as the oldest of a full buffer, or too old to be worth sending
+        size_t dropped = 0;
+        size_t stale = 0;
+        StageStats latency;
+    };
+
+    // Serves several video streams with one model: a thread per source reads
+    // frames into a small buffer per stream, and requests are formed from the
+    // oldest buffered frames of all streams, taken in turn, up to
+    // max_batch_size frames. A request is sent once it is full or the oldest
+    // frame waiting has waited deadline_ms, so a stalled or slow stream
+    // delays nobody by more than that. At most `inflight` requests are
+    // outstanding; while the server is behind, the buffers fill and each new
+    // frame pushes out its stream's oldest, and frames older than
+    // max_latency_ms by the time they could be sent are dropped too, so the
+    // latency stays bounded and results stay recent. Results are handed back
+    // per stream, in capture order, on the calling thread. The batch
+    // dimension of each request is its number of frames, so the model must
+    // accept a dynamic batch up to max_batch_size.
+    class Aggregator
+    {
+    public:
+        using ResultFn = std::function<void(size_t stream, uint64_t frame_id, cv::Mat& frame, const float* prob)>;
+
+        Aggregator(TritonClient& client, ProtocolType protocol, const nic::InferOptions& options,
+            const std::vector<const nic::InferRequestedOutput*>& outputs,
+            const TritonModelInfo& modelInfo, const AggregatorConfig& config)
+            : client_(client), protocol_(protocol), options_(options), outputs_(outputs),
+              modelInfo_(modelInfo), config_(config), free_(SIZE_MAX), completed_(SIZE_MAX)
+        {
+            config_.max_batch_size = std::max<size_t>(config_.max_batch_size, 1);
+            config_.stream_queue = std::max<size_t>(config_.stream_queue, 1);
+            config_.inflight = std::max<size_t>(config_.inflight, 1);
+            for (size_t i = 0; i < config_.inflight; i++)
+            {
+                requests_.emplace_back(new Request(modelInfo, config_.max_batch_size));
+                free_.Push(requests_.back().get());
+            }
+        }
+
+        // Reads every source to its end and hands each result to `result`.
+        void Run(std::vector<cv::VideoCapture>& sources, const ResultFn& result)
+        {
+            streams_.clear();
+            for (size_t s = 0; s < sources.size(); s++)
+            {
+                streams_.emplace_back(new Stream());
+                streams_.back()->stats.latency.name = "stream " + std::to_string(s) + " latency";
+            }
+            running_sources_ = sources.size();
+            auto start = Clock::now();
+            std::vector<std::thread> readers;
+            for (size_t s = 0; s < sources.size(); s++)
+            {
+                readers.emplace_back([this, &sources, s] { ReadLoop(sources[s], s); });
+            }
+            std::thread batcher([this] { BatchLoop(); });
+            DeliverLoop(result);
+            for (auto& t : readers)
+            {
+                t.join();
+            }
+            batcher.join();
+            Report(std::chrono::duration<double>(Clock::now() - start).count());
+        }
+
+    private:
+        struct Frame
+        {
+            size_t stream;
+            uint64_t id;
+            cv::Mat image;
+            Clock::time_point captured;
+        };
+
+        struct Stream
+        {
+            std::deque<Frame> pending;
+            // Mats of delivered and dropped frames, read into again
+            std::vector<cv::Mat> spare;
+            StreamStats stats;
+        };
+
+        struct Request
+        {
+            Request(const TritonModelInfo& modelInfo, size_t max_batch_size)
+                : frames(max_batch_size), preprocessor(modelInfo, max_batch_size), shape(modelInfo.shape_)
+            {
+                nic::InferInput* raw;
+                nic::Error err = nic::InferInput::Create(
+                    &raw, modelInfo.input_name_, modelInfo.shape_, modelInfo.input_datatype_);
+                if (!err.IsOk())
+                {
+                    std::cerr << "unable to get input: " << err << std::endl;
+                    exit(1);
+                }
+                input.reset(raw);
+            }
+
+            uint64_t id = 0;
+            size_t count = 0;
+            std::vector<Frame> frames;
+            Preprocessor preprocessor;
+            std::vector<int64_t> shape;
+            std::unique_ptr<nic::InferInput> input;
+            std::unique_ptr<nic::InferResult> result;
+        };
+
+        static double Milliseconds(Clock::time_point from, Clock::time_point to)
+        {
+            return std::chrono::duration<double, std::milli>(to - from).count();
+        }
+
+        void ReadLoop(cv::VideoCapture& cap, size_t s)
+        {
+            Stream& stream = *streams_[s];
+            const auto period = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(config_.source_fps > 0 ? 1.0 / config_.source_fps : 0.0));
+            auto next = Clock::now();
+            cv::Mat image;
+            for (uint64_t id = 0;; id++)
+            {
+                if (period.count() > 0)
+                {
+                    std::this_thread::sleep_until(next);
+                    next += period;
+                }
+                if (!cap.read(image))
+                {
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                stream.stats.captured++;
+                if (stream.pending.size() >= config_.stream_queue)
+                {
+                    stream.spare.push_back(std::move(stream.pending.front().image));
+                    stream.pending.pop_front();
+                    stream.stats.dropped++;
+                }
+                stream.pending.push_back(Frame{s, id, std::move(image), Clock::now()});
+                if (!stream.spare.empty())
+                {
+                    image = std::move(stream.spare.back());
+                    stream.spare.pop_back();
+                }
+                pending_cv_.notify_one();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_sources_--;
+            pending_cv_.notify_one();
+        }
+
+        // Oldest buffered frame over all streams, or null.
+        Frame* Oldest()
+        {
+            Frame* oldest = nullptr;
+            for (auto& stream : streams_)
+            {
+                if (!stream->pending.empty() && (!oldest || stream->pending.front().captured < oldest->captured))
+                {
+                    oldest = &stream->pending.front();
+                }
+            }
+            return oldest;
+        }
+
+        // Takes up to max_batch_size frames into req, one stream after the
+        // other starting after the stream that led the last request, each
+        // stream's oldest first; drops the frames too old to send.
+        void Take(Request* req, Clock::time_point now)
+        {
+            req->count = 0;
+            const size_t n = streams_.size();
+            bool took = true;
+            while (req->count < config_.max_batch_size && took)
+            {
+                took = false;
+                for (size_t k = 0; k < n && req->count < config_.max_batch_size; k++)
+                {
+                    Stream& stream = *streams_[(next_stream_ + k) % n];
+                    while (!stream.pending.empty() && Milliseconds(stream.pending.front().captured, now) > config_.max_latency_ms)
+                    {
+                        stream.spare.push_back(std::move(stream.pending.front().image));
+                        stream.pending.pop_front();
+                        stream.stats.stale++;
+                    }
+                    if (stream.pending.empty())
+                    {
+                        continue;
+                    }
+                    req->frames[req->count++] = std::move(stream.pending.front());
+                    stream.pending.pop_front();
+                    took = true;
+                }
+            }
+            next_stream_ = (next_stream_ + 1) % std::max<size_t>(n, 1);
+        }
+
+        size_t Pending() const
+        {
+            size_t n = 0;
+            for (auto& stream : streams_)
+            {
+                n += stream->pending.size();
+            }
+            return n;
+        }
+
+        void BatchLoop()
+        {
+            Request* req;
+            while (free_.Pop(req))
+            {
+                bool full;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    // wait for a full request, the deadline of the oldest frame, or the end
+                    for (;;)
+                    {
+                        Frame* oldest = Oldest();
+                        if (Pending() >= config_.max_batch_size || (!oldest && running_sources_ == 0))
+                        {
+                            break;
+                        }
+                        if (!oldest)
+                        {
+                            pending_cv_.wait(lock);
+                            continue;
+                        }
+                        auto deadline = oldest->captured + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::milli>(config_.deadline_ms));
+                        if (Clock::now() >= deadline || running_sources_ == 0)
+                        {
+                            break;
+                        }
+                        pending_cv_.wait_until(lock, deadline);
+                    }
+                    full = Pending() >= config_.max_batch_size;
+                    Take(req, Clock::now());
+                    if (req->count == 0 && running_sources_ == 0 && Pending() == 0)
+                    {
+                        break;
+                    }
+                }
+                if (req->count == 0)
+                {
+                    // everything waiting was too old
+                    free_.Push(req);
+                    continue;
+                }
+                full_requests_ += full;
+                Send(req);
+            }
+            submit_done_ = true;
+            completed_.Push(nullptr);
+        }
+
+        void Send(Request* req)
+        {
+            req->id = submitted_;
+            req->shape[0] = (int64_t)req->count;
+            nic::Error err = req->input->Reset();
+            if (err.IsOk())
+            {
+                err = req->input->SetShape(req->shape);
+            }
+            for (size_t b = 0; err.IsOk() && b < req->count; b++)
+            {
+                err = req->preprocessor.Process(req->frames[b].image, b, req->input.get());
+            }
+            if (!err.IsOk())
+            {
+                std::cerr << "failed setting input: " << err << std::endl;
+                exit(1);
+            }
+            std::vector<nic::InferInput*> inputs = {req->input.get()};
+            auto callback = [this, req](nic::InferResult* result) {
+                req->result.reset(result);
+                completed_.Push(req);
+            };
+            if (protocol_ == ProtocolType::HTTP)
+            {
+                err = client_.httpClient->AsyncInfer(callback, options_, inputs, outputs_);
+            }
+            else
+            {
+                err = client_.grpcClient->AsyncInfer(callback, options_, inputs, outputs_);
+            }
+            if (!err.IsOk())
+            {
+                std::cerr << "failed sending asynchronous infer request: " << err << std::endl;
+                exit(1);
+            }
+            batched_frames_ += req->count;
+            submitted_++;
+        }
+
+        void DeliverLoop(const ResultFn& result)
+        {
+            const int DETECTION_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+            const int OUTPUT_SIZE = Yolo::MAX_OUTPUT_BBOX_COUNT * DETECTION_SIZE + 1;
+            // Completions arrive in any order; hold them until their turn, so
+            // each stream's results come in capture order.
+            std::map<uint64_t, Request*> pending;
+            uint64_t next = 0;
+            Request* req;
+            while (completed_.Pop(req))
+            {
+                if (req)
+                {
+                    pending[req->id] = req;
+                }
+                while (!pending.empty() && pending.begin()->first == next)
+                {
+                    req = pending.begin()->second;
+                    pending.erase(pending.begin());
+                    if (!req->result->RequestStatus().IsOk())
+                    {
+                        std::cerr << "inference failed with error: " << req->result->RequestStatus() << std::endl;
+                        exit(1);
+                    }
+                    const float* prob;
+                    size_t byteSize;
+                    req->result->RawData(modelInfo_.output_names_[0], (const uint8_t**)&prob, &byteSize);
+                    for (size_t b = 0; b < req->count; b++)
+                    {
+                        Frame& frame = req->frames[b];
+                        result(frame.stream, frame.id, frame.image, prob + b * OUTPUT_SIZE);
+                    }
+                    auto done = Clock::now();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        for (size_t b = 0; b < req->count; b++)
+                        {
+                            Frame& frame = req->frames[b];
+                            Stream& stream = *streams_[frame.stream];
+                            stream.stats.delivered++;
+                            stream.stats.latency.Add(frame.captured, done);
+                            stream.spare.push_back(std::move(frame.image));
+                        }
+                    }
+                    req->result.reset();
+                    next++;
+                    free_.Push(req);
+                }
+                if (submit_done_ && next == submitted_)
+                {
+                    break;
+                }
+            }
+            free_.Close();
+        }
+
+        void Report(double seconds)
+        {
+            std::cout << "Aggregated " << streams_.size() << " streams in " << seconds << "s: " << submitted_
+                      << " requests of " << (submitted_ ? (double)batched_frames_ / submitted_ : 0.0) << " frames on average, "
+                      << full_requests_ << " full, " << submitted_ - full_requests_ << " sent at the deadline" << std::endl;
+            for (size_t s = 0; s < streams_.size(); s++)
+            {
+                StreamStats& st = streams_[s]->stats;
+                std::cout << "  stream " << s << ": " << st.delivered / seconds << " FPS, " << st.delivered << " of "
+                          << st.captured << " frames delivered, " << st.dropped << " dropped from a full buffer, "
+                          << st.stale << " too old" << std::endl;
+                st.latency.Print(std::cout);
+            }
+        }
+
+        TritonClient& client_;
+        ProtocolType protocol_;
+        const nic::InferOptions& options_;
+        const std::vector<const nic::InferRequestedOutput*>& outputs_;
+        const TritonModelInfo& modelInfo_;
+        AggregatorConfig config_;
+
+        std::vector<std::unique_ptr<Request>> requests_;
+        BoundedQueue<Request*> free_;
+        BoundedQueue<Request*> completed_;
+
+        // guards the streams' buffers, spares and stats
+        std::mutex mutex_;
+        std::condition_variable pending_cv_;
+        std::vector<std::unique_ptr<Stream>> streams_;
+        size_t running_sources_ = 0;
+        size_t next_stream_ = 0;
+
+        std::atomic<uint64_t> submitted_{0};
+        std::atomic<bool> submit_done_{false};
+        size_t batched_frames_ = 0;
+        size_t full_requests_ = 0;
+    };
+}
@@ -0,0 +1,445 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui.hpp>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MOTION_GATE_AVX2
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define MOTION_GATE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace Triton{
+
+    // Skips frames of a fixed camera that show nothing new. Each frame is
+    // reduced to a small gray image, one pixel per `step` x `step` block, and
+    // compared with the one of the last frame whose detections are in use.
+    // The frame is split into grid_cols x grid_rows regions, and a region has
+    // changed when more than region_thresh of its pixels moved by more than
+    // pixel_thresh gray levels. With no changed region the frame reuses the
+    // last detections instead of being preprocessed and sent. With crops, a
+    // small change is sent as a crop around the changed regions, and only the
+    // detections inside it are replaced. Every max_skip frames one frame is
+    // inferred whole anyway, so the reuse cannot go stale forever.
+    struct MotionGateConfig
+    {
+        bool enabled = false;
+        int step = 8;
+        int grid_cols = 8;
+        int grid_rows = 6;
+        int pixel_thresh = 16;
+        float region_thresh = 0.02f;
+        int max_skip = 150;
+        bool crops = false;
+        // largest crop, as a fraction of the frame area
+        float crop_max_area = 0.25f;
+    };
+
+    struct MotionDecision
+    {
+        enum Action { INFER = 0, SKIP = 1, CROP = 2 };
+        Action action = INFER;
+        // frame pixels sent for CROP
+        cv::Rect crop;
+        int changed_regions = 0;
+        // largest fraction of changed pixels of a region
+        float score = 0.f;
+    };
+
+    struct MotionStats
+    {
+        size_t frames = 0;
+        // frames between the detections of a detect-every-N schedule
+        size_t between = 0;
+        // frames the gate found unchanged
+        size_t skipped = 0;
+        size_t cropped = 0;
+        size_t requests = 0;
+
+        void Print(std::ostream& os, size_t batch_size) const
+        {
+            size_t ungated = frames / std::max<size_t>(batch_size, 1);
+            os << "Reused the last detections for " << between + skipped << " of " << frames << " frames ("
+               << between << " between scheduled detections, " << skipped << " unchanged), "
+               << cropped << " sent as crops, " << requests << " requests instead of " << ungated
+               << " (" << (ungated > requests ? ungated - requests : 0) << " saved)" << std::endl;
+        }
+    };
+
+    // Pixels of a and b (n bytes) that differ by more than thresh.
+    inline int CountChangedScalar(const uint8_t* a, const uint8_t* b, int n, int thresh)
+    {
+        int count = 0;
+        for (int i = 0; i < n; i++)
+        {
+            count += std::abs(a[i] - b[i]) > thresh;
+        }
+        return count;
+    }
+
+#ifdef MOTION_GATE_AVX2
+    __attribute__((target("avx2"))) inline int CountChangedAvx2(const uint8_t* a, const uint8_t* b, int n, int thresh)
+    {
+        const __m256i t = _mm256_set1_epi8((char)thresh);
+        const __m256i zero = _mm256_setzero_si256();
+        int count = 0, i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i diff = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+            // diff <= thresh exactly where diff - thresh saturates to 0
+            __m256i same = _mm256_cmpeq_epi8(_mm256_subs_epu8(diff, t), zero);
+            count += 32 - __builtin_popcount((uint32_t)_mm256_movemask_epi8(same));
+        }
+        return count + CountChangedScalar(a + i, b + i, n - i, thresh);
+    }
+
+    inline bool HasAvx2()
+    {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+#ifdef MOTION_GATE_NEON
+    inline int CountChangedNeon(const uint8_t* a, const uint8_t* b, int n, int thresh)
+    {
+        const uint8x16_t t = vdupq_n_u8((uint8_t)thresh);
+        const uint8x16_t one = vdupq_n_u8(1);
+        int count = 0, i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t changed = vcgtq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)), t);
+            count += vaddvq_u8(vandq_u8(changed, one));
+        }
+        return count + CountChangedScalar(a + i, b + i, n - i, thresh);
+    }
+#endif
+
+    inline int CountChanged(const uint8_t* a, const uint8_t* b, int n, int thresh)
+    {
+#if defined(MOTION_GATE_AVX2)
+        if (HasAvx2())
+        {
+            return CountChangedAvx2(a, b, n, thresh);
+        }
+#elif defined(MOTION_GATE_NEON)
+        return CountChangedNeon(a, b, n, thresh);
+#endif
+        return CountChangedScalar(a, b, n, thresh);
+    }
+
+    class MotionGate
+    {
+    public:
+        explicit MotionGate(const MotionGateConfig& config) : config_(config)
+        {
+            config_.step = std::max(1, config_.step);
+            config_.grid_cols = std::max(1, config_.grid_cols);
+            config_.grid_rows = std::max(1, config_.grid_rows);
+        }
+
+        const MotionGateConfig& Config() const { return config_; }
+
+        // Gray image of a BGR frame, one pixel per step x step block: the mean
+        // of B, G and R over the block's middle row, so only 1 / step of the
+        // frame is read.
+        void Downsample(const cv::Mat& frame, std::vector<uint8_t>& small, int& width, int& height) const
+        {
+            const int step = config_.step;
+            width = frame.cols / step;
+            height = frame.rows / step;
+            small.resize((size_t)width * height);
+            const int div = 3 * step;
+            for (int r = 0; r < height; r++)
+            {
+                const uint8_t* row = frame.ptr<uint8_t>(r * step + step / 2);
+                uint8_t* out = &small[(size_t)r * width];
+                for (int c = 0; c < width; c++)
+                {
+                    const uint8_t* p = row + 3 * c * step;
+                    int sum = 0;
+                    for (int k = 0; k < div; k++)
+                    {
+                        sum += p[k];
+                    }
+                    out[c] = (uint8_t)(sum / div);
+                }
+            }
+        }
+
+        // Decides for the next frame. force (e.g. for a frame filling a batch
+        // that is sent anyway) infers it whole. The compared-to image becomes
+        // this frame's unless it is skipped; for a crop only inside the crop.
+        MotionDecision Update(const cv::Mat& frame, bool force = false)
+        {
+            Downsample(frame, current_, width_, height_);
+            return Decide(frame.cols, frame.rows, force);
+        }
+
+        // Update on the image of the last Downsample into Current().
+        MotionDecision Decide(int frame_width, int frame_height, bool force = false)
+        {
+            MotionDecision decision;
+            const bool fresh = reference_.size() != current_.size() || ref_width_ != width_;
+            if (force || fresh || since_full_ >= config_.max_skip || width_ < config_.grid_cols || height_ < config_.grid_rows)
+            {
+                Accept(0, 0, width_, height_);
+                since_full_ = 0;
+                return decision;
+            }
+
+            // changed regions and their bounding box, in regions
+            int gx0 = config_.grid_cols, gy0 = config_.grid_rows, gx1 = -1, gy1 = -1;
+            for (int gy = 0; gy < config_.grid_rows; gy++)
+            {
+                const int y0 = gy * height_ / config_.grid_rows, y1 = (gy + 1) * height_ / config_.grid_rows;
+                for (int gx = 0; gx < config_.grid_cols; gx++)
+                {
+                    const int x0 = gx * width_ / config_.grid_cols, x1 = (gx + 1) * width_ / config_.grid_cols;
+                    int changed = 0;
+                    for (int y = y0; y < y1; y++)
+                    {
+                        const size_t row = (size_t)y * width_;
+                        changed += CountChanged(&current_[row + x0], &reference_[row + x0], x1 - x0, config_.pixel_thresh);
+                    }
+                    const float score = changed / (float)std::max(1, (x1 - x0) * (y1 - y0));
+                    decision.score = std::max(decision.score, score);
+                    if (score <= config_.region_thresh)
+                    {
+                        continue;
+                    }
+                    decision.changed_regions++;
+                    gx0 = std::min(gx0, gx);
+                    gy0 = std::min(gy0, gy);
+                    gx1 = std::max(gx1, gx);
+                    gy1 = std::max(gy1, gy);
+                }
+            }
+
+            since_full_++;
+            if (decision.changed_regions == 0)
+            {
+                decision.action = MotionDecision::SKIP;
+                return decision;
+            }
+            if (config_.crops)
+            {
+                // one region of margin, so objects crossing into the change are whole
+                gx0 = std::max(0, gx0 - 1);
+                gy0 = std::max(0, gy0 - 1);
+                gx1 = std::min(config_.grid_cols - 1, gx1 + 1);
+                gy1 = std::min(config_.grid_rows - 1, gy1 + 1);
+                const int x0 = gx0 * width_ / config_.grid_cols, x1 = (gx1 + 1) * width_ / config_.grid_cols;
+                const int y0 = gy0 * height_ / config_.grid_rows, y1 = (gy1 + 1) * height_ / config_.grid_rows;
+                // the last region row / column also covers the frame left over by the downsampling
+                const int px1 = gx1 == config_.grid_cols - 1 ? frame_width : x1 * config_.step;
+                const int py1 = gy1 == config_.grid_rows - 1 ? frame_height : y1 * config_.step;
+                cv::Rect crop(x0 * config_.step, y0 * config_.step, px1 - x0 * config_.step, py1 - y0 * config_.step);
+                if (crop.area() <= config_.crop_max_area * frame_width * frame_height)
+                {
+                    decision.action = MotionDecision::CROP;
+                    decision.crop = crop;
+                    Accept(x0, y0, x1, y1);
+                    return decision;
+                }
+            }
+            Accept(0, 0, width_, height_);
+            since_full_ = 0;
+            return decision;
+        }
+
+    private:
+        // The area [x0, x1) x [y0, y1) of the current image becomes the reference.
+        void Accept(int x0, int y0, int x1, int y1)
+        {
+            if (reference_.size() != current_.size() || ref_width_ != width_)
+            {
+                reference_ = current_;
+                ref_width_ = width_;
+                return;
+            }
+            for (int y = y0; y < y1; y++)
+            {
+                const size_t row = (size_t)y * width_;
+                std::memcpy(&reference_[row + x0], &current_[row + x0], x1 - x0);
+            }
+        }
+
+        MotionGateConfig config_;
+        std::vector<uint8_t> current_;
+        std::vector<uint8_t> reference_;
+        int width_ = 0;
+        int height_ = 0;
+        int ref_width_ = 0;
+        int since_full_ = 0;
+    };
+
+    // Frames of one request in capture order. Frames with a slot are
+    // preprocessed into that batch slot (whole, or their crop); the others
+    // reuse the detections of the frame before them.
+    struct GatedBatch
+    {
+        explicit GatedBatch(size_t batch_size, size_t detect_every = 1)
+            : frames(2 * batch_size * detect_every), decisions(frames.size()), slots(frames.size()) {}
+
+        // capture index of frames[0]
+        uint64_t first_frame = 0;
+        size_t count = 0;
+        size_t inferred = 0;
+        std::vector<cv::Mat> frames;
+        std::vector<MotionDecision> decisions;
+        std::vector<int> slots;
+
+        // What frame i sends: the whole frame or its crop.
+        cv::Mat Input(size_t i) const
+        {
+            return decisions[i].action == MotionDecision::CROP ? frames[i](decisions[i].crop) : frames[i];
+        }
+    };
+
+    // Reads the next request's frames from cap: only every detect_every-th
+    // frame is a candidate for detection (the others reuse detections, e.g.
+    // through a Tracker), candidates are gated until one has to be inferred,
+    // and the candidates after it fill the rest of the batch whatever they
+    // show, since the request costs the same. Returns once batch_size frames
+    // are to be inferred, or batch_size * detect_every frames in a row reuse
+    // detections, which needs no request. At the end of the video returns
+    // false, the frames read so far left in batch; as without the gate, a last
+    // batch short of frames to infer is not sent. Without a gate every
+    // candidate is inferred. next_frame is the capture index of the next
+    // frame. cap is a cv::VideoCapture or anything else with read(cv::Mat&).
+    // batch must have been made for the same detect_every.
+    template <typename Capture>
+    bool ReadGated(Capture& cap, MotionGate* gate, size_t batch_size, uint64_t& next_frame,
+        GatedBatch& batch, MotionStats& stats, size_t detect_every = 1)
+    {
+        batch.first_frame = next_frame;
+        batch.count = 0;
+        batch.inferred = 0;
+        detect_every = std::max<size_t>(detect_every, 1);
+        while (batch.inferred < batch_size && (batch.inferred > 0 || batch.count < batch_size * detect_every))
+        {
+            const size_t i = batch.count;
+            if (!cap.read(batch.frames[i]))
+            {
+                return false;
+            }
+            MotionDecision& d = batch.decisions[i];
+            const bool candidate = next_frame % detect_every == 0;
+            d = MotionDecision();
+            if (!candidate)
+            {
+                d.action = MotionDecision::SKIP;
+            }
+            else if (gate)
+            {
+                d = gate->Update(batch.frames[i], batch.inferred > 0);
+            }
+            batch.slots[i] = d.action == MotionDecision::SKIP ? -1 : (int)batch.inferred++;
+            stats.frames++;
+            stats.between += !candidate;
+            stats.skipped += candidate && d.action == MotionDecision::SKIP;
+            stats.cropped += d.action == MotionDecision::CROP;
+            batch.count++;
+            next_frame++;
+        }
+        if (batch.inferred > 0)
+        {
+            stats.requests++;
+        }
+        return true;
+    }
+
+    // The detections in use, as a `prob` blob ([count, Detection...] with
+    // Detection = center x, y, w, h, conf, class_id in letterbox coordinates
+    // of the whole frame), kept across requests so that skipped frames can
+    // reuse them and crop results can be merged into them.
+    class DetectionCache
+    {
+    public:
+        static constexpr int DETECTION_SIZE = 6;
+
+        DetectionCache(int input_w, int input_h, int max_boxes)
+            : input_w_(input_w), input_h_(input_h), max_boxes_(max_boxes),
+              last_(1 + (size_t)max_boxes * DETECTION_SIZE, 0.f), merged_(last_.size(), 0.f) {}
+
+        // The blob to post-process for frame i of batch, given the request's
+        // output of its slot (null if it has none).
+        const float* Resolve(const GatedBatch& batch, size_t i, const float* slot_prob)
+        {
+            const MotionDecision& d = batch.decisions[i];
+            if (d.action == MotionDecision::SKIP)
+            {
+                return last_.data();
+            }
+            if (d.action == MotionDecision::INFER)
+            {
+                const int count = std::min(std::max((int)slot_prob[0], 0), max_boxes_);
+                std::memcpy(last_.data(), slot_prob, (1 + (size_t)count * DETECTION_SIZE) * sizeof(float));
+                return slot_prob;
+            }
+            MergeCrop(slot_prob, d.crop, batch.frames[i].cols, batch.frames[i].rows);
+            return last_.data();
+        }
+
+    private:
+        // Network pixels per frame pixel and padding of the letterbox of a w x h image.
+        void Letterbox(int w, int h, float& scale, float& pad_x, float& pad_y) const
+        {
+            float r_w = input_w_ / (w * 1.0f), r_h = input_h_ / (h * 1.0f);
+            scale = std::min(r_w, r_h);
+            pad_x = r_h > r_w ? 0.f : (input_w_ - r_h * w) / 2;
+            pad_y = r_h > r_w ? (input_h_ - r_w * h) / 2 : 0.f;
+        }
+
+        // Keeps the boxes of the last blob centered outside crop and adds those
+        // of the crop's blob, moved into the frame's letterbox.
+        void MergeCrop(const float* crop_prob, const cv::Rect& crop, int frame_w, int frame_h)
+        {
+            float fs, fx, fy, cs, cx, cy;
+            Letterbox(frame_w, frame_h, fs, fx, fy);
+            Letterbox(crop.width, crop.height, cs, cx, cy);
+            float* out = merged_.data() + 1;
+            int n = 0;
+            const int last_count = std::min((int)last_[0], max_boxes_);
+            for (int k = 0; k < last_count; k++)
+            {
+                const float* det = &last_[1 + (size_t)k * DETECTION_SIZE];
+                float x = (det[0] - fx) / fs, y = (det[1] - fy) / fs;
+                if (x >= crop.x && x < crop.x + crop.width && y >= crop.y && y < crop.y + crop.height)
+                {
+                    continue;
+                }
+                std::memcpy(out + (size_t)n++ * DETECTION_SIZE, det, DETECTION_SIZE * sizeof(float));
+            }
+            const int crop_count = std::min((int)crop_prob[0], max_boxes_);
+            for (int k = 0; k < crop_count && n < max_boxes_; k++)
+            {
+                const float* det = &crop_prob[1 + (size_t)k * DETECTION_SIZE];
+                float* o = out + (size_t)n++ * DETECTION_SIZE;
+                o[0] = ((det[0] - cx) / cs + crop.x) * fs + fx;
+                o[1] = ((det[1] - cy) / cs + crop.y) * fs + fy;
+                o[2] = det[2] / cs * fs;
+                o[3] = det[3] / cs * fs;
+                o[4] = det[4];
+                o[5] = det[5];
+            }
+            merged_[0] = (float)n;
+            last_.swap(merged_);
+        }
+
+        int input_w_;
+        int input_h_;
+        int max_boxes_;
+        std::vector<float> last_;
+        std::vector<float> merged_;
+    };
+}
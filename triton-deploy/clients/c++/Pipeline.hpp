@@ -0,0 +1,440 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Triton.hpp"
+#include "SharedMemory.hpp"
+#include "MotionGate.hpp"
+
+namespace Triton{
+
+    // Blocking FIFO with a fixed capacity. Push waits while the queue is full,
+    // which is what gives the pipeline its back-pressure; Close wakes everyone up
+    // and makes Pop return false once the queue has drained.
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+        bool Push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+            if (closed_)
+            {
+                return false;
+            }
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+            return true;
+        }
+
+        bool Pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+            if (items_.empty())
+            {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+            not_full_.notify_all();
+        }
+
+    private:
+        size_t capacity_;
+        std::deque<T> items_;
+        bool closed_ = false;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Latency samples of one pipeline stage, in milliseconds.
+    struct StageStats
+    {
+        std::string name;
+        std::vector<double> samples;
+
+        void Add(Clock::time_point from, Clock::time_point to)
+        {
+            samples.push_back(std::chrono::duration<double, std::milli>(to - from).count());
+        }
+
+        void Print(std::ostream& os)
+        {
+            if (samples.empty())
+            {
+                return;
+            }
+            std::sort(samples.begin(), samples.end());
+            double sum = 0;
+            for (double s : samples)
+            {
+                sum += s;
+            }
+            auto pct = [&](double p) { return samples[std::min(samples.size() - 1, size_t(p * samples.size()))]; };
+            os << "  " << name << ": mean " << sum / samples.size() << "ms, p50 " << pct(0.5)
+               << "ms, p99 " << pct(0.99) << "ms" << std::endl;
+        }
+    };
+
+    struct PipelineConfig
+    {
+        size_t batch_size = 1;
+        // Requests submitted to the server and not yet completed.
+        size_t inflight = 4;
+        // Capacity of the queues between stages.
+        size_t queue_depth = 4;
+        // Exchange tensors through one registered shared memory region per request.
+        bool shared_memory = false;
+        // Reuse the last detections for frames that did not change.
+        MotionGateConfig motion;
+        // Detect on every Nth frame only; the others reuse the last detections.
+        size_t detect_every = 1;
+    };
+
+    // A batch of frames travelling through the pipeline. Every request owns its
+    // frames, its input buffers and its InferInput, so several can be in flight.
+    // With shared memory the buffers are the request's region and the request
+    // also owns the output bound to it. With the motion gate or detect_every, a
+    // request carries up to batch_size frames to infer plus the frames reusing
+    // detections between them, and one of only reusing frames is never sent.
+    struct PipelineRequest
+    {
+        PipelineRequest(const TritonModelInfo& modelInfo, size_t batch_size,
+            std::unique_ptr<SharedMemoryRegion> shm = nullptr, size_t detect_every = 1)
+            : batch(batch_size, detect_every), region(std::move(shm)),
+              preprocessor(modelInfo, batch_size, region ? region->Input() : nullptr)
+        {
+            nic::InferInput* raw;
+            nic::Error err = nic::InferInput::Create(
+                &raw, modelInfo.input_name_, modelInfo.shape_, modelInfo.input_datatype_);
+            if (!err.IsOk())
+            {
+                std::cerr << "unable to get input: " << err << std::endl;
+                exit(1);
+            }
+            input.reset(raw);
+            if (region)
+            {
+                nic::InferRequestedOutput* rawOutput;
+                err = nic::InferRequestedOutput::Create(&rawOutput, modelInfo.output_names_[0]);
+                if (err.IsOk())
+                {
+                    output.reset(rawOutput);
+                    err = region->Bind(input.get(), output.get());
+                }
+                if (!err.IsOk())
+                {
+                    std::cerr << "unable to bind shared memory: " << err << std::endl;
+                    exit(1);
+                }
+            }
+        }
+
+        uint64_t id = 0;
+        GatedBatch batch;
+        std::unique_ptr<SharedMemoryRegion> region;
+        Preprocessor preprocessor;
+        std::unique_ptr<nic::InferInput> input;
+        std::unique_ptr<nic::InferRequestedOutput> output;
+        std::unique_ptr<nic::InferResult> result;
+        Clock::time_point decoded, preprocessed, sent, completed;
+    };
+
+    // Decode -> preprocess -> AsyncInfer -> postprocess, each stage on its own
+    // thread and connected by bounded queues. At most `inflight` requests are
+    // outstanding on the server; results are post-processed in frame order on
+    // the calling thread.
+    class Pipeline
+    {
+    public:
+        // detected is false when prob was carried over from an earlier frame.
+        using PostprocessFn = std::function<void(uint64_t frame_id, cv::Mat& frame, const float* prob, bool detected)>;
+
+        Pipeline(TritonClient& client, ProtocolType protocol, const nic::InferOptions& options,
+            const std::vector<const nic::InferRequestedOutput*>& outputs,
+            const TritonModelInfo& modelInfo, const PipelineConfig& config)
+            : client_(client), protocol_(protocol), options_(options), outputs_(outputs),
+              modelInfo_(modelInfo), config_(config), gate_(config.motion),
+              cache_(Yolo::INPUT_W, Yolo::INPUT_H, Yolo::MAX_OUTPUT_BBOX_COUNT),
+              free_(SIZE_MAX), decoded_(config.queue_depth), preprocessed_(config.queue_depth),
+              completed_(SIZE_MAX)
+        {
+            // Enough requests for every queue and the in-flight window to be full at once.
+            size_t pool = config.inflight + 2 * config.queue_depth + 2;
+            size_t inputByteSize = config.batch_size * modelInfo.input_byte_size_;
+            for (size_t i = 0; i < pool; i++)
+            {
+                std::unique_ptr<SharedMemoryRegion> region;
+                if (config.shared_memory)
+                {
+                    region.reset(new SharedMemoryRegion(client, protocol, SharedMemoryRegion::UniqueName(i),
+                        inputByteSize, config.batch_size * OutputSize() * sizeof(float)));
+                }
+                requests_.emplace_back(new PipelineRequest(modelInfo, config.batch_size, std::move(region), config.detect_every));
+                free_.Push(requests_.back().get());
+            }
+            stats_[0].name = "decode -> preprocessed";
+            stats_[1].name = "preprocessed -> sent";
+            stats_[2].name = "sent -> completed (server)";
+            stats_[3].name = "completed -> postprocessed";
+            stats_[4].name = "end to end";
+        }
+
+        void Run(cv::VideoCapture& cap, const PostprocessFn& postprocess)
+        {
+            auto start = Clock::now();
+            std::thread decode([&] { DecodeLoop(cap); });
+            std::thread preprocess([&] { PreprocessLoop(); });
+            std::thread infer([&] { InferLoop(); });
+            size_t frames = PostprocessLoop(postprocess);
+            decode.join();
+            preprocess.join();
+            infer.join();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            std::cout << "Pipelined " << frames << " frames in " << seconds << "s, "
+                      << frames / seconds << " FPS (inflight " << config_.inflight
+                      << ", batch " << config_.batch_size
+                      << (config_.shared_memory ? ", shared memory" : "") << ")" << std::endl;
+            for (auto& s : stats_)
+            {
+                s.Print(std::cout);
+            }
+            if (config_.motion.enabled || config_.detect_every > 1)
+            {
+                motion_.Print(std::cout, config_.batch_size);
+            }
+        }
+
+    private:
+        static int OutputSize()
+        {
+            const int DETECTION_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+            return Yolo::MAX_OUTPUT_BBOX_COUNT * DETECTION_SIZE + 1;
+        }
+
+        void DecodeLoop(cv::VideoCapture& cap)
+        {
+            uint64_t id = 0, frame = 0;
+            MotionGate* gate = config_.motion.enabled ? &gate_ : nullptr;
+            PipelineRequest* req;
+            bool eof = false;
+            while (!eof && free_.Pop(req))
+            {
+                // A partial last batch is dropped, as in the synchronous loop.
+                if (!ReadGated(cap, gate, config_.batch_size, frame, req->batch, motion_, config_.detect_every))
+                {
+                    eof = true;
+                    break;
+                }
+                req->id = id++;
+                req->decoded = Clock::now();
+                decoded_.Push(req);
+            }
+            decoded_.Close();
+        }
+
+        void PreprocessLoop()
+        {
+            PipelineRequest* req;
+            while (decoded_.Pop(req))
+            {
+                const GatedBatch& batch = req->batch;
+                nic::Error err;
+                if (batch.inferred > 0 && req->region)
+                {
+                    // The input stays bound to the region, the server reads what we write there.
+                    for (size_t i = 0; err.IsOk() && i < batch.count; i++)
+                    {
+                        if (batch.slots[i] >= 0)
+                        {
+                            err = req->preprocessor.Process(batch.Input(i), batch.slots[i]);
+                        }
+                    }
+                }
+                else if (batch.inferred > 0)
+                {
+                    err = req->input->Reset();
+                    for (size_t i = 0; err.IsOk() && i < batch.count; i++)
+                    {
+                        if (batch.slots[i] >= 0)
+                        {
+                            err = req->preprocessor.Process(batch.Input(i), batch.slots[i], req->input.get());
+                        }
+                    }
+                }
+                if (!err.IsOk())
+                {
+                    std::cerr << "failed setting input: " << err << std::endl;
+                    exit(1);
+                }
+                req->preprocessed = Clock::now();
+                preprocessed_.Push(req);
+            }
+            preprocessed_.Close();
+        }
+
+        void InferLoop()
+        {
+            PipelineRequest* req;
+            while (preprocessed_.Pop(req))
+            {
+                if (req->batch.inferred == 0)
+                {
+                    // Nothing to send, the frames reuse the last detections.
+                    req->sent = req->completed = req->preprocessed;
+                    submitted_++;
+                    completed_.Push(req);
+                    continue;
+                }
+                {
+                    std::unique_lock<std::mutex> lock(window_mutex_);
+                    window_cv_.wait(lock, [&] { return inflight_ < config_.inflight; });
+                    inflight_++;
+                }
+                std::vector<nic::InferInput*> inputs = {req->input.get()};
+                std::vector<const nic::InferRequestedOutput*> outputs = outputs_;
+                if (req->output)
+                {
+                    outputs = {req->output.get()};
+                }
+                auto callback = [this, req](nic::InferResult* result) {
+                    req->result.reset(result);
+                    req->completed = Clock::now();
+                    {
+                        std::lock_guard<std::mutex> lock(window_mutex_);
+                        inflight_--;
+                    }
+                    window_cv_.notify_one();
+                    completed_.Push(req);
+                };
+                req->sent = Clock::now();
+                nic::Error err;
+                if (protocol_ == ProtocolType::HTTP)
+                {
+                    err = client_.httpClient->AsyncInfer(callback, options_, inputs, outputs);
+                }
+                else
+                {
+                    err = client_.grpcClient->AsyncInfer(callback, options_, inputs, outputs);
+                }
+                if (!err.IsOk())
+                {
+                    std::cerr << "failed sending asynchronous infer request: " << err << std::endl;
+                    exit(1);
+                }
+                submitted_++;
+            }
+            submit_done_ = true;
+            // Wake the postprocess loop in case everything has already completed.
+            completed_.Push(nullptr);
+        }
+
+        size_t PostprocessLoop(const PostprocessFn& postprocess)
+        {
+            const int OUTPUT_SIZE = OutputSize();
+            // Completions arrive in any order; hold them until their turn.
+            std::map<uint64_t, PipelineRequest*> pending;
+            uint64_t next = 0;
+            size_t frames = 0;
+            PipelineRequest* req;
+            while (completed_.Pop(req))
+            {
+                if (req)
+                {
+                    pending[req->id] = req;
+                }
+                while (!pending.empty() && pending.begin()->first == next)
+                {
+                    req = pending.begin()->second;
+                    pending.erase(pending.begin());
+                    const float* prob = nullptr;
+                    if (req->result && !req->result->RequestStatus().IsOk())
+                    {
+                        std::cerr << "inference failed with error: " << req->result->RequestStatus() << std::endl;
+                        exit(1);
+                    }
+                    else if (req->result && req->region)
+                    {
+                        prob = req->region->Output();
+                    }
+                    else if (req->result)
+                    {
+                        size_t byteSize;
+                        req->result->RawData(modelInfo_.output_names_[0], (const uint8_t**)&prob, &byteSize);
+                    }
+                    GatedBatch& batch = req->batch;
+                    for (size_t i = 0; i < batch.count; i++)
+                    {
+                        const float* slot = batch.slots[i] >= 0 ? prob + batch.slots[i] * OUTPUT_SIZE : nullptr;
+                        postprocess(batch.first_frame + i, batch.frames[i], cache_.Resolve(batch, i, slot), slot != nullptr);
+                    }
+                    auto done = Clock::now();
+                    stats_[0].Add(req->decoded, req->preprocessed);
+                    stats_[1].Add(req->preprocessed, req->sent);
+                    stats_[2].Add(req->sent, req->completed);
+                    stats_[3].Add(req->completed, done);
+                    stats_[4].Add(req->decoded, done);
+                    frames += batch.count;
+                    req->result.reset();
+                    next++;
+                    free_.Push(req);
+                }
+                if (submit_done_ && next == submitted_)
+                {
+                    break;
+                }
+            }
+            free_.Close();
+            return frames;
+        }
+
+        TritonClient& client_;
+        ProtocolType protocol_;
+        const nic::InferOptions& options_;
+        const std::vector<const nic::InferRequestedOutput*>& outputs_;
+        const TritonModelInfo& modelInfo_;
+        PipelineConfig config_;
+        // used by the decode loop only
+        MotionGate gate_;
+        MotionStats motion_;
+        // used by the postprocess loop only
+        DetectionCache cache_;
+
+        std::vector<std::unique_ptr<PipelineRequest>> requests_;
+        BoundedQueue<PipelineRequest*> free_;
+        BoundedQueue<PipelineRequest*> decoded_;
+        BoundedQueue<PipelineRequest*> preprocessed_;
+        BoundedQueue<PipelineRequest*> completed_;
+
+        std::mutex window_mutex_;
+        std::condition_variable window_cv_;
+        size_t inflight_ = 0;
+        std::atomic<uint64_t> submitted_{0};
+        std::atomic<bool> submit_done_{false};
+
+        StageStats stats_[5];
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <unistd.h>
+#include "Triton.hpp"
+#include "shm_utils.h"
+
+namespace Triton{
+
+    // One POSIX shared memory region registered with the server, holding the
+    // `data` input of a request followed by its `prob` output. Preprocessing
+    // writes into Input() and post-processing reads Output() in place, so
+    // neither tensor goes through the HTTP/gRPC body.
+    class SharedMemoryRegion
+    {
+    public:
+        SharedMemoryRegion(TritonClient& client, ProtocolType protocol, const std::string& name,
+            size_t input_byte_size, size_t output_byte_size)
+            : client_(client), protocol_(protocol), name_(name), key_("/" + name),
+              input_byte_size_(input_byte_size), output_byte_size_(output_byte_size)
+        {
+            size_t byte_size = input_byte_size_ + output_byte_size_;
+            // A region left behind by a crashed run would make registration fail.
+            nic::UnlinkSharedMemoryRegion(key_);
+            Check(nic::CreateSharedMemoryRegion(key_, byte_size, &fd_), "unable to create shared memory region");
+            Check(nic::MapSharedMemory(fd_, 0, byte_size, &addr_), "unable to map shared memory region");
+            if (protocol_ == ProtocolType::HTTP)
+            {
+                Check(client_.httpClient->RegisterSystemSharedMemory(name_, key_, byte_size),
+                    "unable to register shared memory region");
+            }
+            else
+            {
+                Check(client_.grpcClient->RegisterSystemSharedMemory(name_, key_, byte_size),
+                    "unable to register shared memory region");
+            }
+        }
+
+        ~SharedMemoryRegion()
+        {
+            if (protocol_ == ProtocolType::HTTP)
+            {
+                client_.httpClient->UnregisterSystemSharedMemory(name_);
+            }
+            else
+            {
+                client_.grpcClient->UnregisterSystemSharedMemory(name_);
+            }
+            nic::UnmapSharedMemory(addr_, input_byte_size_ + output_byte_size_);
+            nic::CloseSharedMemory(fd_);
+            nic::UnlinkSharedMemoryRegion(key_);
+        }
+
+        SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+        SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+        void* Input() { return addr_; }
+
+        const float* Output() const
+        {
+            return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(addr_) + input_byte_size_);
+        }
+
+        // Point input and output at this region. Only needs to be done once,
+        // InferInput::Reset would undo it.
+        nic::Error Bind(nic::InferInput* input, nic::InferRequestedOutput* output)
+        {
+            nic::Error err = input->SetSharedMemory(name_, input_byte_size_, 0);
+            if (!err.IsOk())
+            {
+                return err;
+            }
+            return output->SetSharedMemory(name_, output_byte_size_, input_byte_size_);
+        }
+
+        // Region names must be unique on the server, which may be shared by several clients.
+        static std::string UniqueName(size_t index)
+        {
+            return "yolov5_client_" + std::to_string(getpid()) + "_" + std::to_string(index);
+        }
+
+    private:
+        void Check(const nic::Error& err, const std::string& what)
+        {
+            if (!err.IsOk())
+            {
+                std::cerr << what << " " << name_ << ": " << err << std::endl;
+                exit(1);
+            }
+        }
+
+        TritonClient& client_;
+        ProtocolType protocol_;
+        std::string name_;
+        std::string key_;
+        size_t input_byte_size_;
+        size_t output_byte_size_;
+        int fd_ = -1;
+        void* addr_ = nullptr;
+    };
+}
@@ -0,0 +1,487 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Yolo.hpp"
+
+namespace Triton{
+
+    // SORT / ByteTrack style multi-object tracking on the boxes of Yolo::nms(),
+    // so detection can run on every Nth frame only and the frames between get
+    // the tracks' predicted boxes. Each track is a constant velocity Kalman
+    // filter on center x, y, width and height; its noise scales with the box
+    // size, as in ByteTrack. On a frame with detections, tracks are matched to
+    // confident detections of their class by IoU, then the tracks left over to
+    // the less confident ones, each stage solved as an assignment problem
+    // (Hungarian, or greedy by IoU). Unmatched confident detections start new
+    // tracks, and a track not matched for max_age frames is dropped. IDs are
+    // never reused. All memory is sized by max_tracks and max_detections up
+    // front, so tracking a stream does not allocate.
+    struct TrackerConfig
+    {
+        int max_tracks = 256;
+        // detections per frame beyond this are ignored
+        int max_detections = 512;
+        // detections at or above high_thresh are matched first and start tracks
+        float high_thresh = 0.6f;
+        // detections in [low_thresh, high_thresh) only keep tracks alive
+        float low_thresh = 0.1f;
+        float match_iou = 0.2f;
+        float low_match_iou = 0.5f;
+        // frames a track survives without a match
+        int max_age = 30;
+        // matches before a track is reported, except on the first frame
+        int min_hits = 2;
+        bool greedy = false;
+    };
+
+    struct TrackedDetection
+    {
+        // predicted box, in the coordinates of the detections, and the
+        // confidence and class of the last detection matched
+        Yolo::Detection det;
+        uint32_t id;
+        // frames since the track was last matched
+        int age;
+    };
+
+    // Minimum cost assignment of a rows x cols cost matrix (row-major), with
+    // buffers sized once for the largest problem.
+    class Assignment
+    {
+    public:
+        Assignment(int max_rows, int max_cols)
+        {
+            const size_t n = (size_t)std::max(max_rows, max_cols) + 1;
+            u_.resize(n);
+            v_.resize(n);
+            p_.resize(n);
+            way_.resize(n);
+            minv_.resize(n);
+            used_.resize(n);
+            pairs_.reserve((size_t)max_rows * max_cols);
+        }
+
+        // row_to_col[r] is the column given to row r, or -1. Pairs costing more
+        // than max_cost are never given.
+        void Solve(const float* cost, int rows, int cols, float max_cost, bool greedy, int* row_to_col)
+        {
+            std::fill(row_to_col, row_to_col + rows, -1);
+            if (rows == 0 || cols == 0)
+            {
+                return;
+            }
+            if (greedy)
+            {
+                Greedy(cost, rows, cols, max_cost, row_to_col);
+            }
+            else
+            {
+                Hungarian(cost, rows, cols, max_cost, row_to_col);
+            }
+        }
+
+    private:
+        // Cheapest pairs first.
+        void Greedy(const float* cost, int rows, int cols, float max_cost, int* row_to_col)
+        {
+            pairs_.clear();
+            for (int r = 0; r < rows; r++)
+            {
+                for (int c = 0; c < cols; c++)
+                {
+                    if (cost[(size_t)r * cols + c] <= max_cost)
+                    {
+                        pairs_.push_back(r * cols + c);
+                    }
+                }
+            }
+            std::sort(pairs_.begin(), pairs_.end(), [cost](int a, int b) { return cost[a] < cost[b] || (cost[a] == cost[b] && a < b); });
+            std::fill(used_.begin(), used_.begin() + cols, 0);
+            for (int k : pairs_)
+            {
+                const int r = k / cols, c = k % cols;
+                if (row_to_col[r] < 0 && !used_[c])
+                {
+                    row_to_col[r] = c;
+                    used_[c] = 1;
+                }
+            }
+        }
+
+        // Shortest augmenting paths with potentials, O(n^2 m) for n <= m; the
+        // smaller side is taken as the rows. Pairs above max_cost cost a
+        // constant larger than any full assignment of allowed ones, so the
+        // solution is optimal among allowed pairs, and the forbidden pairs it
+        // still holds are dropped afterwards.
+        void Hungarian(const float* cost, int rows, int cols, float max_cost, int* row_to_col)
+        {
+            const bool transposed = rows > cols;
+            const int n = transposed ? cols : rows, m = transposed ? rows : cols;
+            const double forbidden = (double)(max_cost + 1) * (n + 1);
+            auto at = [&](int i, int j) -> double {
+                const float c = transposed ? cost[(size_t)j * cols + i] : cost[(size_t)i * cols + j];
+                return c <= max_cost ? c : forbidden;
+            };
+            std::fill(u_.begin(), u_.begin() + n + 1, 0.0);
+            std::fill(v_.begin(), v_.begin() + m + 1, 0.0);
+            std::fill(p_.begin(), p_.begin() + m + 1, 0);
+            std::fill(way_.begin(), way_.begin() + m + 1, 0);
+            for (int i = 1; i <= n; i++)
+            {
+                p_[0] = i;
+                int j0 = 0;
+                std::fill(minv_.begin(), minv_.begin() + m + 1, 1e300);
+                std::fill(used_.begin(), used_.begin() + m + 1, 0);
+                do
+                {
+                    used_[j0] = 1;
+                    const int i0 = p_[j0];
+                    double delta = 1e300;
+                    int j1 = 0;
+                    for (int j = 1; j <= m; j++)
+                    {
+                        if (used_[j])
+                        {
+                            continue;
+                        }
+                        const double cur = at(i0 - 1, j - 1) - u_[i0] - v_[j];
+                        if (cur < minv_[j])
+                        {
+                            minv_[j] = cur;
+                            way_[j] = j0;
+                        }
+                        if (minv_[j] < delta)
+                        {
+                            delta = minv_[j];
+                            j1 = j;
+                        }
+                    }
+                    for (int j = 0; j <= m; j++)
+                    {
+                        if (used_[j])
+                        {
+                            u_[p_[j]] += delta;
+                            v_[j] -= delta;
+                        }
+                        else
+                        {
+                            minv_[j] -= delta;
+                        }
+                    }
+                    j0 = j1;
+                } while (p_[j0] != 0);
+                do
+                {
+                    const int j1 = way_[j0];
+                    p_[j0] = p_[j1];
+                    j0 = j1;
+                } while (j0);
+            }
+            for (int j = 1; j <= m; j++)
+            {
+                if (p_[j] == 0 || at(p_[j] - 1, j - 1) > max_cost)
+                {
+                    continue;
+                }
+                if (transposed)
+                {
+                    row_to_col[j - 1] = p_[j] - 1;
+                }
+                else
+                {
+                    row_to_col[p_[j] - 1] = j - 1;
+                }
+            }
+        }
+
+        std::vector<double> u_, v_, minv_;
+        std::vector<int> p_, way_;
+        std::vector<char> used_;
+        std::vector<int> pairs_;
+    };
+
+    class Tracker
+    {
+    public:
+        explicit Tracker(const TrackerConfig& config = TrackerConfig())
+            : config_(config), assignment_(config.max_tracks, config.max_detections)
+        {
+            tracks_.reserve(config_.max_tracks);
+            output_.reserve(config_.max_tracks);
+            cost_.resize((size_t)config_.max_tracks * config_.max_detections);
+            high_.reserve(config_.max_detections);
+            low_.reserve(config_.max_detections);
+            track_rows_.reserve(config_.max_tracks);
+            matches_.resize(std::max(config_.max_tracks, config_.max_detections));
+            det_used_.resize(config_.max_detections);
+        }
+
+        // A frame with detections, e.g. the result of Yolo::nms().
+        const std::vector<TrackedDetection>& Update(const Yolo::Detection* dets, int count)
+        {
+            count = std::min(count, config_.max_detections);
+            Predict();
+            high_.clear();
+            low_.clear();
+            for (int d = 0; d < count; d++)
+            {
+                if (dets[d].conf >= config_.high_thresh)
+                {
+                    high_.push_back(d);
+                }
+                else if (dets[d].conf >= config_.low_thresh)
+                {
+                    low_.push_back(d);
+                }
+            }
+            std::fill(det_used_.begin(), det_used_.begin() + count, 0);
+
+            // confident detections against all tracks, then the rest against the tracks left
+            track_rows_.clear();
+            for (int t = 0; t < (int)tracks_.size(); t++)
+            {
+                track_rows_.push_back(t);
+            }
+            Match(dets, high_, config_.match_iou);
+            size_t kept = 0;
+            for (int t : track_rows_)
+            {
+                if (tracks_[t].age > 0)
+                {
+                    track_rows_[kept++] = t;
+                }
+            }
+            track_rows_.resize(kept);
+            Match(dets, low_, config_.low_match_iou);
+
+            for (int d : high_)
+            {
+                if (!det_used_[d] && (int)tracks_.size() < config_.max_tracks)
+                {
+                    tracks_.emplace_back();
+                    tracks_.back().Start(dets[d], next_id_++, first_);
+                }
+            }
+            frames_since_detection_ = 0;
+            first_ = false;
+            return Output();
+        }
+
+        const std::vector<TrackedDetection>& Update(const std::vector<Yolo::Detection>& dets)
+        {
+            return Update(dets.data(), (int)dets.size());
+        }
+
+        // A frame without detections: every track moves on by its velocity.
+        const std::vector<TrackedDetection>& Advance()
+        {
+            Predict();
+            frames_since_detection_++;
+            return Output();
+        }
+
+        // Tracks of the last Update or Advance.
+        const std::vector<TrackedDetection>& Tracks() const { return output_; }
+
+        void Reset()
+        {
+            tracks_.clear();
+            output_.clear();
+            first_ = true;
+            frames_since_detection_ = 0;
+        }
+
+    private:
+        static constexpr float STD_POSITION = 1.f / 20;
+        static constexpr float STD_VELOCITY = 1.f / 160;
+
+        // One coordinate's position and velocity, with their covariance. The
+        // four coordinates of a box move and are measured independently, so
+        // four of these make the usual 8-state filter with the same result.
+        struct Axis
+        {
+            float x, v, p00, p01, p11;
+
+            void Start(float z, float scale)
+            {
+                x = z;
+                v = 0;
+                p00 = sq(2 * STD_POSITION * scale);
+                p01 = 0;
+                p11 = sq(10 * STD_VELOCITY * scale);
+            }
+
+            void Predict(float scale)
+            {
+                x += v;
+                p00 += 2 * p01 + p11 + sq(STD_POSITION * scale);
+                p01 += p11;
+                p11 += sq(STD_VELOCITY * scale);
+            }
+
+            void Correct(float z, float scale)
+            {
+                const float s = p00 + sq(STD_POSITION * scale);
+                const float k0 = p00 / s, k1 = p01 / s;
+                const float y = z - x;
+                x += k0 * y;
+                v += k1 * y;
+                p11 -= k1 * p01;
+                p01 *= 1 - k0;
+                p00 *= 1 - k0;
+            }
+
+            static float sq(float a) { return a * a; }
+        };
+
+        struct Track
+        {
+            // center x, center y, width, height
+            Axis axis[4];
+            uint32_t id;
+            float conf, class_id;
+            int hits;
+            // frames since the last match
+            int age;
+            // reported; from min_hits matches on, or from the start on the first frame
+            bool confirmed;
+
+            // noise of x and width scales with the width, of y and height with the height
+            float Scale(int k) const { return std::max(k % 2 ? axis[3].x : axis[2].x, 1.f); }
+
+            void Start(const Yolo::Detection& det, uint32_t track_id, bool first_frame)
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    axis[k].Start(det.bbox[k], k % 2 ? det.bbox[3] : det.bbox[2]);
+                }
+                id = track_id;
+                conf = det.conf;
+                class_id = det.class_id;
+                hits = 1;
+                age = 0;
+                confirmed = first_frame;
+            }
+
+            void Predict()
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    axis[k].Predict(Scale(k));
+                }
+                age++;
+            }
+
+            void Correct(const Yolo::Detection& det, int min_hits)
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    axis[k].Correct(det.bbox[k], Scale(k));
+                }
+                conf = det.conf;
+                hits++;
+                age = 0;
+                confirmed = confirmed || hits >= min_hits;
+            }
+
+            void Box(float* bbox) const
+            {
+                bbox[0] = axis[0].x;
+                bbox[1] = axis[1].x;
+                bbox[2] = std::max(axis[2].x, 1.f);
+                bbox[3] = std::max(axis[3].x, 1.f);
+            }
+        };
+
+        static float Iou(const float* a, const float* b)
+        {
+            const float w = std::min(a[0] + a[2] / 2, b[0] + b[2] / 2) - std::max(a[0] - a[2] / 2, b[0] - b[2] / 2);
+            const float h = std::min(a[1] + a[3] / 2, b[1] + b[3] / 2) - std::max(a[1] - a[3] / 2, b[1] - b[3] / 2);
+            if (w <= 0 || h <= 0)
+            {
+                return 0.f;
+            }
+            const float inter = w * h;
+            return inter / (a[2] * a[3] + b[2] * b[3] - inter);
+        }
+
+        void Predict()
+        {
+            size_t kept = 0;
+            for (size_t t = 0; t < tracks_.size(); t++)
+            {
+                tracks_[t].Predict();
+                if (tracks_[t].age <= config_.max_age)
+                {
+                    tracks_[kept++] = tracks_[t];
+                }
+            }
+            tracks_.resize(kept);
+        }
+
+        // Assigns the detections cols to the tracks track_rows_ of the same
+        // class at IoU >= min_iou, and corrects the matched tracks.
+        void Match(const Yolo::Detection* dets, const std::vector<int>& cols, float min_iou)
+        {
+            const int rows = (int)track_rows_.size(), n = (int)cols.size();
+            if (rows == 0 || n == 0)
+            {
+                return;
+            }
+            for (int r = 0; r < rows; r++)
+            {
+                const Track& track = tracks_[track_rows_[r]];
+                float box[4];
+                track.Box(box);
+                for (int c = 0; c < n; c++)
+                {
+                    const Yolo::Detection& det = dets[cols[c]];
+                    const float iou = det.class_id == track.class_id ? Iou(box, det.bbox) : 0.f;
+                    cost_[(size_t)r * n + c] = 1.f - iou;
+                }
+            }
+            assignment_.Solve(cost_.data(), rows, n, 1.f - min_iou, config_.greedy, matches_.data());
+            for (int r = 0; r < rows; r++)
+            {
+                if (matches_[r] >= 0)
+                {
+                    tracks_[track_rows_[r]].Correct(dets[cols[matches_[r]]], config_.min_hits);
+                    det_used_[cols[matches_[r]]] = 1;
+                }
+            }
+        }
+
+        // Tracks matched at the last frame with detections, once confirmed.
+        const std::vector<TrackedDetection>& Output()
+        {
+            output_.clear();
+            for (const Track& t : tracks_)
+            {
+                if (t.age != frames_since_detection_ || !t.confirmed)
+                {
+                    continue;
+                }
+                TrackedDetection out;
+                t.Box(out.det.bbox);
+                out.det.conf = t.conf;
+                out.det.class_id = t.class_id;
+                out.id = t.id;
+                out.age = t.age;
+                output_.push_back(out);
+            }
+            return output_;
+        }
+
+        TrackerConfig config_;
+        Assignment assignment_;
+        std::vector<Track> tracks_;
+        std::vector<TrackedDetection> output_;
+        std::vector<float> cost_;
+        std::vector<int> high_, low_, track_rows_, matches_;
+        std::vector<char> det_used_;
+        uint32_t next_id_ = 1;
+        int frames_since_detection_ = 0;
+        bool first_ = true;
+    };
+}
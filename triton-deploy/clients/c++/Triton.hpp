@@ -1,6 +1,7 @@
 #pragma once
 #include "common.hpp"
 #include "Yolo.hpp"
+#include "preprocess_cpu.h"
 
 namespace Triton{
 
@@ -20,6 +21,9 @@ namespace Triton{
         int input_w_;
         // The format of the input
         std::string input_format_;
+        // Wire format of the input, see input_format.h, and its size per image
+        InputFormat wire_format_;
+        size_t input_byte_size_;
         int type1_;
         int type3_;
         int max_batch_size_;
@@ -29,24 +33,48 @@ namespace Triton{
     };
 
 
-    void setModel(TritonModelInfo& yoloModelInfo, const int batch_size){
+    void setModel(TritonModelInfo& yoloModelInfo, const int batch_size, InputFormat format = INPUT_FORMAT_FP32){
         yoloModelInfo.output_names_ = std::vector<std::string>{"prob"};
         yoloModelInfo.input_name_ = "data";
-        yoloModelInfo.input_datatype_ = std::string("FP32");
         // The shape of the input
         yoloModelInfo.input_c_ = Yolo::INPUT_C;
         yoloModelInfo.input_w_ = Yolo::INPUT_W;
         yoloModelInfo.input_h_ = Yolo::INPUT_H;
-        // The format of the input
-        yoloModelInfo.input_format_ = "FORMAT_NCHW";
-        yoloModelInfo.type1_ = CV_32FC1;
-        yoloModelInfo.type3_ = CV_32FC3;
-        yoloModelInfo.max_batch_size_ = 32;
+        yoloModelInfo.wire_format_ = format;
+        yoloModelInfo.input_byte_size_ = input_format_bytes(format, yoloModelInfo.input_w_, yoloModelInfo.input_h_);
+        yoloModelInfo.max_batch_size_ = 1;
         yoloModelInfo.shape_.push_back(batch_size);
-        yoloModelInfo.shape_.push_back(yoloModelInfo.input_c_);
-        yoloModelInfo.shape_.push_back(yoloModelInfo.input_h_);
-        yoloModelInfo.shape_.push_back(yoloModelInfo.input_w_);
-
+        if (format == INPUT_FORMAT_UINT8)
+        {
+            // letterboxed BGR HWC bytes, declared as INT32 [H, W*3/4] (config.uint8.pbtxt)
+            yoloModelInfo.input_datatype_ = std::string("INT32");
+            yoloModelInfo.input_format_ = "FORMAT_NHWC";
+            yoloModelInfo.type1_ = CV_8UC1;
+            yoloModelInfo.type3_ = CV_8UC3;
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_h_);
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_w_ * yoloModelInfo.input_c_ / 4);
+        }
+        else if (format == INPUT_FORMAT_FP16)
+        {
+            // letterboxed BGR HWC, not normalized (config.fp16.pbtxt)
+            yoloModelInfo.input_datatype_ = std::string("FP16");
+            yoloModelInfo.input_format_ = "FORMAT_NHWC";
+            yoloModelInfo.type1_ = CV_16FC1;
+            yoloModelInfo.type3_ = CV_16FC3;
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_h_);
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_w_);
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_c_);
+        }
+        else
+        {
+            yoloModelInfo.input_datatype_ = std::string("FP32");
+            yoloModelInfo.input_format_ = "FORMAT_NCHW";
+            yoloModelInfo.type1_ = CV_32FC1;
+            yoloModelInfo.type3_ = CV_32FC3;
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_c_);
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_h_);
+            yoloModelInfo.shape_.push_back(yoloModelInfo.input_w_);
+        }
     }
 
     union TritonClient
@@ -63,92 +91,89 @@ namespace Triton{
 
 
 
-    std::vector<uint8_t> Preprocess(
-        const cv::Mat& img, const std::string& format, int img_type1, int img_type3,
-        size_t img_channels, const cv::Size& img_size, const ScaleType scale)
+    // Owns one input slot per batch entry and fills it straight from the
+    // decoded BGR frame in a single pass, with the same sampling as the
+    // engine's GPU preprocessing: letterbox, BGR->RGB, /255 and planar for the
+    // FP32 input, or letterbox only into the packed UINT8 / FP16 wire formats
+    // that the engine normalizes itself. The slots are handed to
+    // InferInput::AppendRaw by pointer, so they must stay untouched until the
+    // request that references them has completed. The slots can also live in an
+    // external buffer, e.g. a shared memory region registered with the server,
+    // in which case nothing is appended to the request.
+    class Preprocessor
     {
-        // Image channels are in BGR order. Currently model configuration
-        // data doesn't provide any information as to the expected channel
-        // orderings (like RGB, BGR). We are going to assume that RGB is the
-        // most likely ordering and so change the channels to that ordering.
-        std::vector<uint8_t> input_data;
-        cv::Mat sample;
-        cv::cvtColor(img, sample,  cv::COLOR_BGR2RGB);
-        cv::Mat sample_resized;
-        if (sample.size() != img_size)
+    public:
+        Preprocessor(const TritonModelInfo& modelInfo, size_t batch_size, void* buffer = nullptr)
+            : input_c_(modelInfo.input_c_), input_h_(modelInfo.input_h_), input_w_(modelInfo.input_w_),
+              format_(modelInfo.wire_format_), slot_size_(modelInfo.input_byte_size_),
+              batch_size_(batch_size),
+              owned_(buffer ? 0 : slot_size_ * batch_size),
+              data_(buffer ? static_cast<uint8_t*>(buffer) : owned_.data())
         {
-            cv::resize(sample, sample_resized, img_size);
-        }
-        else
-        {
-            sample_resized = sample;
         }
 
-        cv::Mat sample_type;
-        sample_resized.convertTo(
-            sample_type, (img_channels == 3) ? img_type3 : img_type1);
-    
-        cv::Mat sample_final;
-        sample.convertTo(
-            sample_type, (img_channels == 3) ? img_type3 : img_type1);
-        const int INPUT_W = Yolo::INPUT_W;
-        const int INPUT_H = Yolo::INPUT_H;
-        int w, h, x, y;
-        float r_w = INPUT_W / (sample_type.cols * 1.0);
-        float r_h = INPUT_H / (sample_type.rows * 1.0);
-        if (r_h > r_w)
+        size_t BatchSize() const { return batch_size_; }
+
+        size_t SlotByteSize() const { return slot_size_; }
+
+        const uint8_t* Slot(size_t slot) const
         {
-            w = INPUT_W;
-            h = r_w * sample_type.rows;
-            x = 0;
-            y = (INPUT_H - h) / 2;
+            return data_ + slot * slot_size_;
         }
-        else
+
+        // Preprocess img into its batch slot.
+        nic::Error Process(const cv::Mat& img, size_t slot)
         {
-            w = r_h * sample_type.cols;
-            h = INPUT_H;
-            x = (INPUT_W - w) / 2;
-            y = 0;
+            if (img.type() != CV_8UC3 || input_c_ != 3)
+            {
+                return nic::Error("preprocessing expects a 3 channel 8-bit BGR image");
+            }
+            if (slot >= BatchSize())
+            {
+                return nic::Error("batch slot " + std::to_string(slot) + " out of range");
+            }
+            preprocess_img_cpu_packed(img.data, img.cols, img.rows, img.step, format_, data_ + slot * slot_size_, input_w_, input_h_);
+            return nic::Error::Success;
         }
-        cv::Mat re(h, w, CV_8UC3);
-        cv::resize(sample_type, re, re.size(), 0, 0, cv::INTER_CUBIC);
-        cv::Mat out(INPUT_H, INPUT_W, CV_8UC3, cv::Scalar(128, 128, 128));
-        re.copyTo(out(cv::Rect(x, y, re.cols, re.rows)));
-        out.convertTo(sample_final, CV_32FC3, 1.f / 255.f);
-
-
-        // Allocate a buffer to hold all image elements.
-        size_t img_byte_size = sample_final.total() * sample_final.elemSize();
-        size_t pos = 0;
-        input_data.resize(img_byte_size);
-
-        // (format.compare("FORMAT_NCHW") == 0)
-        //
-        // For CHW formats must split out each channel from the matrix and
-        // order them as BBBB...GGGG...RRRR. To do this split the channels
-        // of the image directly into 'input_data'. The BGR channels are
-        // backed by the 'input_data' vector so that ends up with CHW
-        // order of the data.
-        std::vector<cv::Mat> input_bgr_channels;
-        for (size_t i = 0; i < img_channels; ++i)
+
+        // Preprocess the planes of a width x height NV12 / I420 frame into its
+        // batch slot, without converting the frame to BGR first; same result
+        // as cv::cvtColor to BGR followed by Process.
+        nic::Error Process(const YuvImage& frame, int width, int height, size_t slot)
         {
-            input_bgr_channels.emplace_back(
-                img_size.height, img_size.width, img_type1, &(input_data[pos]));
-            pos += input_bgr_channels.back().total() *
-                input_bgr_channels.back().elemSize();
+            if (input_c_ != 3 || width % 2 || height % 2)
+            {
+                return nic::Error("YUV 4:2:0 preprocessing expects an even sized frame and a 3 channel input");
+            }
+            if (slot >= BatchSize())
+            {
+                return nic::Error("batch slot " + std::to_string(slot) + " out of range");
+            }
+            preprocess_yuv_cpu_packed(frame, width, height, format_, data_ + slot * slot_size_, input_w_, input_h_);
+            return nic::Error::Success;
         }
 
-        cv::split(sample_final, input_bgr_channels);
-
-        if (pos != img_byte_size)
+        // Preprocess img into its batch slot and append that slot to input without copying.
+        nic::Error Process(const cv::Mat& img, size_t slot, nic::InferInput* input)
         {
-            std::cerr << "unexpected total size of channels " << pos << ", expecting "
-                << img_byte_size << std::endl;
-            exit(1);
+            nic::Error err = Process(img, slot);
+            if (!err.IsOk())
+            {
+                return err;
+            }
+            return input->AppendRaw(Slot(slot), SlotByteSize());
         }
 
-        return input_data;
-    }
+    private:
+        int input_c_;
+        int input_h_;
+        int input_w_;
+        InputFormat format_;
+        size_t slot_size_;
+        size_t batch_size_;
+        std::vector<uint8_t> owned_;
+        uint8_t* data_;
+    };
 
 
     auto
@@ -232,6 +257,31 @@ namespace Triton{
         return ProtocolType::HTTP;
     }
 
+    InputFormat
+    ParseInputFormat(const std::string& str)
+    {
+        std::string format(str);
+        std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+        if (format == "fp32")
+        {
+            return INPUT_FORMAT_FP32;
+        }
+        else if (format == "uint8")
+        {
+            return INPUT_FORMAT_UINT8;
+        }
+        else if (format == "fp16")
+        {
+            return INPUT_FORMAT_FP16;
+        }
+
+        std::cerr << "unexpected input format \"" << str
+            << "\", expecting fp32, uint8 or fp16" << std::endl;
+        exit(1);
+
+        return INPUT_FORMAT_FP32;
+    }
+
     bool
     ParseType(const std::string& dtype, int* type1, int* type3)
     {
@@ -1,5 +1,6 @@
 #pragma once
 #include "common.hpp"
+#include "nms_engine.h"
 
 namespace Yolo
 {
@@ -8,17 +9,17 @@ namespace Yolo
     static constexpr int MAX_OUTPUT_BBOX_COUNT = 1000;
     static constexpr int CLASS_NUM = 80;
     static constexpr int INPUT_C = 3;
-    static constexpr int INPUT_H = 608;
-    static constexpr int INPUT_W = 608;
+    static constexpr int INPUT_H = 640;
+    static constexpr int INPUT_W = 640;
 
     static constexpr int LOCATIONS = 4;
 
+    // Layout of one box in the `prob` output of the tensorrtx yolov5 engine
     struct Detection{
-        //x y w h
+        //center_x center_y w h
         float bbox[LOCATIONS];
-        float det_confidence;
+        float conf;  // bbox_conf * cls_conf
         float class_id;
-        float class_confidence;
     };
 
     std::vector<std::string> coco_names;
@@ -62,57 +63,25 @@ namespace Yolo
     }
 
 
-    float iou(float lbox[4], float rbox[4]) 
-    {
-        float interBox[] = {
-            std::max(lbox[0] - lbox[2]/2.f , rbox[0] - rbox[2]/2.f), //left
-            std::min(lbox[0] + lbox[2]/2.f , rbox[0] + rbox[2]/2.f), //right
-            std::max(lbox[1] - lbox[3]/2.f , rbox[1] - rbox[3]/2.f), //top
-            std::min(lbox[1] + lbox[3]/2.f , rbox[1] + rbox[3]/2.f), //bottom
-        };
-
-        if(interBox[2] > interBox[3] || interBox[0] > interBox[1])
-            return 0.0f;
-
-        float interBoxS =(interBox[1]-interBox[0])*(interBox[3]-interBox[2]);
-        return interBoxS/(lbox[2]*lbox[3] + rbox[2]*rbox[3] -interBoxS);
-    }
-
-
-    bool cmp(const Detection& a, const Detection& b) 
-    {
-        return a.det_confidence > b.det_confidence;
-    }
-
-
-
     void nms(std::vector<Yolo::Detection>& res, const float* output, float nms_thresh = 0.4) {
         const float BBOX_CONF_THRESH = 0.5;
-        const int BATCH_SIZE = 1;
         const int DETECTION_SIZE = sizeof(Detection) / sizeof(float);
-        const int OUTPUT_SIZE = MAX_OUTPUT_BBOX_COUNT * DETECTION_SIZE + 1;  // we assume the yololayer outputs no more than MAX_OUTPUT_BBOX_COUNT boxes that conf >= 0.1
-        std::map<float, std::vector<Detection>> m;
+        static thread_local boxnms::NmsEngine engine;
+        static thread_local std::vector<int> rows;
+        engine.reset();
+        rows.clear();
         for (int i = 0; i < output[0] && i < Yolo::MAX_OUTPUT_BBOX_COUNT; i++) {
-            if (output[1 + DETECTION_SIZE * i + 4] <= BBOX_CONF_THRESH) continue;
-            Detection det;
-            memcpy(&det, &output[1 + DETECTION_SIZE * i], DETECTION_SIZE * sizeof(float));
-            if (m.count(det.class_id) == 0) m.emplace(det.class_id, std::vector<Detection>());
-            m[det.class_id].push_back(det);
+            const float* det = &output[1 + DETECTION_SIZE * i];
+            if (det[4] <= BBOX_CONF_THRESH) continue;
+            engine.addCenter(det, det[4], (int)det[5]);
+            rows.push_back(i);
         }
-        for (auto it = m.begin(); it != m.end(); it++) {
-            //std::cout << it->second[0].class_id << " --- " << std::endl;
-            auto& dets = it->second;
-            std::sort(dets.begin(), dets.end(), cmp);
-            for (size_t m = 0; m < dets.size(); ++m) {
-                auto& item = dets[m];
-                res.push_back(item);
-                for (size_t n = m + 1; n < dets.size(); ++n) {
-                    if (iou(item.bbox, dets[n].bbox) > nms_thresh) {
-                        dets.erase(dets.begin()+n);
-                        --n;
-                    }
-                }
-            }
+        boxnms::Config config;
+        config.iou_thresh = nms_thresh;
+        for (int k : engine.run(config)) {
+            Detection det;
+            memcpy(&det, &output[1 + DETECTION_SIZE * rows[k]], DETECTION_SIZE * sizeof(float));
+            res.push_back(det);
         }
     }
 
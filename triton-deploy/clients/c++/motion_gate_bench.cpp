@@ -0,0 +1,349 @@
+// Replays a video through the motion gate of MotionGate.hpp for a few
+// threshold settings and reports, at batch 1 and 4, the frames that would
+// reuse the last detections, those sent as crops and the inference requests
+// saved, plus the time the gate takes per frame. Without a video it plays a
+// synthetic fixed camera: a noisy 1080p scene, still except for two objects
+// moving for a while, and it also reports how far the detections in use lag
+// behind the objects (the position at the last frame that saw them). It first
+// checks the SIMD difference count against the scalar one.
+//   ./motion_gate_bench [video]
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "MotionGate.hpp"
+
+using Triton::GatedBatch;
+using Triton::MotionDecision;
+using Triton::MotionGate;
+using Triton::MotionGateConfig;
+using Triton::MotionStats;
+
+static const int SCENE_W = 1920;
+static const int SCENE_H = 1080;
+static const int SCENE_FRAMES = 360;
+
+// A textured square moving by (dx, dy) per frame during [first, last).
+struct MovingObject
+{
+    int x, y, size, dx, dy, first, last;
+
+    void Position(int frame, int& px, int& py) const
+    {
+        int steps = std::min(std::max(frame - first, 0), last - first);
+        px = x + dx * steps;
+        py = y + dy * steps;
+    }
+};
+
+// The synthetic fixed camera, read like a cv::VideoCapture.
+class SyntheticScene
+{
+public:
+    SyntheticScene() : background_(SCENE_H, SCENE_W, CV_8UC3)
+    {
+        std::mt19937 rng(0);
+        // blocks of flat color, so the scene has edges for the noise to hide among
+        for (int r = 0; r < SCENE_H; r++)
+        {
+            uint8_t* row = background_.ptr<uint8_t>(r);
+            for (int c = 0; c < SCENE_W * 3; c++)
+            {
+                row[c] = (uint8_t)(60 + 3 * ((r / 90 * 7 + c / 3 / 160 * 13 + c % 3 * 5) % 40));
+            }
+        }
+        std::uniform_int_distribution<int> noise(-3, 3);
+        for (auto& plane : noise_)
+        {
+            plane.resize((size_t)SCENE_W * SCENE_H * 3);
+            for (auto& v : plane)
+            {
+                v = (int8_t)noise(rng);
+            }
+        }
+        objects_.push_back(MovingObject{200, 300, 160, 6, 1, 60, 150});
+        objects_.push_back(MovingObject{1500, 800, 48, -3, -2, 240, 300});
+    }
+
+    const std::vector<MovingObject>& Objects() const { return objects_; }
+
+    void Reset() { frame_ = 0; }
+
+    bool read(cv::Mat& out)
+    {
+        if (frame_ >= SCENE_FRAMES)
+        {
+            return false;
+        }
+        out.create(SCENE_H, SCENE_W, CV_8UC3);
+        const std::vector<int8_t>& noise = noise_[frame_ % 4];
+        for (int r = 0; r < SCENE_H; r++)
+        {
+            const uint8_t* src = background_.ptr<uint8_t>(r);
+            const int8_t* n = &noise[(size_t)r * SCENE_W * 3];
+            uint8_t* dst = out.ptr<uint8_t>(r);
+            for (int c = 0; c < SCENE_W * 3; c++)
+            {
+                dst[c] = (uint8_t)(src[c] + n[c]);
+            }
+        }
+        for (const MovingObject& o : objects_)
+        {
+            int px, py;
+            o.Position(frame_, px, py);
+            // 16 px checkerboard, dark and bright
+            for (int r = std::max(py, 0); r < std::min(py + o.size, SCENE_H); r++)
+            {
+                uint8_t* dst = out.ptr<uint8_t>(r);
+                for (int c = std::max(px, 0); c < std::min(px + o.size, SCENE_W); c++)
+                {
+                    const uint8_t v = (((r - py) / 16 + (c - px) / 16) % 2) ? 240 : 15;
+                    dst[3 * c] = dst[3 * c + 1] = dst[3 * c + 2] = v;
+                }
+            }
+        }
+        frame_++;
+        return true;
+    }
+
+private:
+    cv::Mat background_;
+    std::vector<int8_t> noise_[4];
+    std::vector<MovingObject> objects_;
+    int frame_ = 0;
+};
+
+class VideoScene
+{
+public:
+    explicit VideoScene(const std::string& path) : path_(path) { Reset(); }
+
+    void Reset() { cap_ = cv::VideoCapture(path_); }
+
+    bool Opened() const { return cap_.isOpened(); }
+
+    bool read(cv::Mat& out) { return cap_.read(out); }
+
+private:
+    std::string path_;
+    cv::VideoCapture cap_;
+};
+
+static bool check_count()
+{
+    std::mt19937 rng(1);
+    std::vector<uint8_t> a(4096), b(4096);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a[i] = (uint8_t)rng();
+        // mostly small differences, some large, in both directions
+        b[i] = (uint8_t)(a[i] + (rng() % 4 == 0 ? (int)(rng() % 256) : (int)(rng() % 9) - 4));
+    }
+    for (int n : {0, 1, 15, 16, 31, 32, 33, 63, 64, 100, 1000, 4095})
+    {
+        for (int thresh : {0, 1, 4, 16, 127, 128, 200, 255})
+        {
+            for (int offset : {0, 1})
+            {
+                const int simd = Triton::CountChanged(&a[offset], &b[offset], n, thresh);
+                const int scalar = Triton::CountChangedScalar(&a[offset], &b[offset], n, thresh);
+                if (simd != scalar)
+                {
+                    std::cout << "CountChanged n " << n << " thresh " << thresh << ": " << simd << " != " << scalar
+                              << " FAIL" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    // throughput over a full 1080p gray frame
+    std::vector<uint8_t> x((size_t)SCENE_W * SCENE_H), y(x.size());
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] = (uint8_t)rng();
+        y[i] = (uint8_t)(x[i] + rng() % 32);
+    }
+    const int iterations = 200;
+    int sink = 0;
+    auto time = [&](int (*fn)(const uint8_t*, const uint8_t*, int, int)) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink += fn(x.data(), y.data(), (int)x.size(), 16);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+    double scalar = time(Triton::CountChangedScalar);
+    double simd = time(Triton::CountChanged);
+    std::cout << "CountChanged matches the scalar count; " << SCENE_W << "x" << SCENE_H << " bytes: scalar " << scalar
+              << "ms, dispatched " << simd << "ms" << (sink == 0 ? " " : "") << std::endl;
+    return true;
+}
+
+// Time of the gate on the first two frames of scene, alternately.
+template <typename Scene>
+static void time_gate(Scene& scene)
+{
+    scene.Reset();
+    cv::Mat frames[2];
+    if (!scene.read(frames[0]) || !scene.read(frames[1]))
+    {
+        return;
+    }
+    MotionGateConfig config;
+    MotionGate gate(config);
+    std::vector<uint8_t> small;
+    int w, h;
+    const int iterations = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        gate.Downsample(frames[i % 2], small, w, h);
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        gate.Update(frames[i % 2]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << frames[0].cols << "x" << frames[0].rows << " -> " << w << "x" << h << " gate image: downsample "
+              << std::chrono::duration<double, std::milli>(mid - start).count() / iterations << "ms, downsample + decide "
+              << std::chrono::duration<double, std::milli>(end - mid).count() / iterations << "ms per frame" << std::endl;
+}
+
+template <typename Scene>
+static void run(Scene& scene, const std::vector<MovingObject>* objects, const MotionGateConfig& config, size_t batch_size)
+{
+    scene.Reset();
+    MotionGate gate(config);
+    MotionStats stats;
+    GatedBatch batch(batch_size);
+    uint64_t next = 0;
+    double crop_area = 0;
+    // where the detections in use put each object, and the lag behind it
+    std::vector<int> seen_x, seen_y;
+    double lag_sum = 0, lag_max = 0;
+    size_t moving_frames = 0;
+    bool more = true;
+    while (more)
+    {
+        more = Triton::ReadGated(scene, config.enabled ? &gate : nullptr, batch_size, next, batch, stats);
+        for (size_t i = 0; more && i < batch.count; i++)
+        {
+            const MotionDecision& d = batch.decisions[i];
+            if (d.action == MotionDecision::CROP)
+            {
+                crop_area += d.crop.area() / (double)(batch.frames[i].cols * batch.frames[i].rows);
+            }
+            if (!objects)
+            {
+                continue;
+            }
+            const int frame = (int)(batch.first_frame + i);
+            seen_x.resize(objects->size());
+            seen_y.resize(objects->size());
+            for (size_t k = 0; k < objects->size(); k++)
+            {
+                const MovingObject& o = (*objects)[k];
+                int px, py;
+                o.Position(frame, px, py);
+                const int cx = px + o.size / 2, cy = py + o.size / 2;
+                const cv::Rect& c = d.crop;
+                const int sx = seen_x[k] + o.size / 2, sy = seen_y[k] + o.size / 2;
+                const bool in_crop = d.action == MotionDecision::CROP &&
+                    ((cx >= c.x && cx < c.x + c.width && cy >= c.y && cy < c.y + c.height) ||
+                     (sx >= c.x && sx < c.x + c.width && sy >= c.y && sy < c.y + c.height));
+                if (d.action == MotionDecision::INFER || in_crop)
+                {
+                    seen_x[k] = px;
+                    seen_y[k] = py;
+                }
+                const double lag = std::hypot(px - seen_x[k], py - seen_y[k]);
+                lag_max = std::max(lag_max, lag);
+                if (frame >= o.first && frame < o.last)
+                {
+                    lag_sum += lag;
+                    moving_frames++;
+                }
+            }
+        }
+    }
+
+    const size_t ungated = stats.frames / batch_size;
+    std::cout << "  batch " << batch_size << ": " << 100.0 * stats.skipped / std::max<size_t>(stats.frames, 1)
+              << "% frames reused, " << stats.cropped << " crops";
+    if (stats.cropped)
+    {
+        std::cout << " (mean " << 100 * crop_area / stats.cropped << "% of the frame)";
+    }
+    std::cout << ", " << stats.requests << " requests instead of " << ungated << " ("
+              << 100.0 * (ungated - std::min(ungated, stats.requests)) / std::max<size_t>(ungated, 1) << "% saved)";
+    if (objects)
+    {
+        std::cout << ", detections lag objects by mean " << lag_sum / std::max<size_t>(moving_frames, 1)
+                  << "px while moving, max " << lag_max << "px";
+    }
+    std::cout << std::endl;
+}
+
+template <typename Scene>
+static void sweep(Scene& scene, const std::vector<MovingObject>* objects)
+{
+    time_gate(scene);
+    struct Setting
+    {
+        const char* name;
+        bool enabled;
+        int pixel_thresh;
+        float region_thresh;
+        bool crops;
+    };
+    const Setting settings[] = {
+        {"no gate", false, 16, 0.02f, false},
+        {"pixel 8, region 0.5%", true, 8, 0.005f, false},
+        {"pixel 16, region 2% (default)", true, 16, 0.02f, false},
+        {"pixel 32, region 5%", true, 32, 0.05f, false},
+        {"pixel 16, region 2%, crops", true, 16, 0.02f, true},
+    };
+    for (const Setting& s : settings)
+    {
+        MotionGateConfig config;
+        config.enabled = s.enabled;
+        config.pixel_thresh = s.pixel_thresh;
+        config.region_thresh = s.region_thresh;
+        config.crops = s.crops;
+        std::cout << s.name << std::endl;
+        for (size_t batch_size : {1, 4})
+        {
+            run(scene, objects, config, batch_size);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (!check_count())
+    {
+        return 1;
+    }
+    if (argc > 1)
+    {
+        VideoScene scene(argv[1]);
+        if (!scene.Opened())
+        {
+            std::cerr << "could not open " << argv[1] << std::endl;
+            return -1;
+        }
+        sweep(scene, nullptr);
+        return 0;
+    }
+    SyntheticScene scene;
+    std::cout << "synthetic " << SCENE_W << "x" << SCENE_H << ", " << SCENE_FRAMES << " frames, objects moving in "
+              << scene.Objects().size() << " frame ranges" << std::endl;
+    sweep(scene, &scene.Objects());
+    return 0;
+}
@@ -0,0 +1,339 @@
+// Replays a sequence through Tracker.hpp with detection on every Nth frame
+// only and scores the boxes of every frame against the ground truth: MOTA
+// (1 - (misses + false positives + ID switches) / objects), ID switches and
+// the mean IoU of the matched boxes, each against simply holding the last
+// detections until the next detection frame. The sequence is a MOTChallenge
+// gt.txt, with its detections from a det.txt if given and otherwise made from
+// the ground truth with noise and misses, or without arguments a synthetic
+// 1280x720 scene of objects crossing each other. It also checks that tracking
+// does not allocate once warmed up, and reports the time per frame.
+//   ./tracker_bench [gt.txt [det.txt]]
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "Tracker.hpp"
+
+// allocations, counted by replacing operator new
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// GCC 12 takes the free() of the replaced operator delete, once inlined, for a
+// mismatch with the operator new it pairs with
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+#pragma GCC diagnostic pop
+
+struct Box
+{
+    int id;
+    // center x, center y, w, h
+    float bbox[4];
+    float conf;
+};
+
+// Boxes of every frame of a sequence.
+using Sequence = std::vector<std::vector<Box>>;
+
+static float iou(const float* a, const float* b)
+{
+    const float w = std::min(a[0] + a[2] / 2, b[0] + b[2] / 2) - std::max(a[0] - a[2] / 2, b[0] - b[2] / 2);
+    const float h = std::min(a[1] + a[3] / 2, b[1] + b[3] / 2) - std::max(a[1] - a[3] / 2, b[1] - b[3] / 2);
+    if (w <= 0 || h <= 0)
+    {
+        return 0.f;
+    }
+    return w * h / (a[2] * a[3] + b[2] * b[3] - w * h);
+}
+
+// MOTChallenge text: frame, id, left, top, width, height, conf[, class, visibility].
+// Ground truth keeps the boxes marked to be evaluated (conf 1) of class 1,
+// pedestrians, when classes are given.
+static bool read_mot(const std::string& path, bool ground_truth, Sequence& seq)
+{
+    FILE* f = std::fopen(path.c_str(), "r");
+    if (!f)
+    {
+        return false;
+    }
+    char line[512];
+    while (std::fgets(line, sizeof(line), f))
+    {
+        int frame, id, cls = 1;
+        float left, top, w, h, conf, visibility;
+        const int fields = std::sscanf(line, "%d,%d,%f,%f,%f,%f,%f,%d,%f", &frame, &id, &left, &top, &w, &h, &conf, &cls, &visibility);
+        if (fields < 7 || frame < 1 || (ground_truth && (conf == 0 || cls != 1)))
+        {
+            continue;
+        }
+        if ((int)seq.size() < frame)
+        {
+            seq.resize(frame);
+        }
+        seq[frame - 1].push_back(Box{id, {left + w / 2, top + h / 2, w, h}, ground_truth ? 1.f : conf});
+    }
+    std::fclose(f);
+    return !seq.empty();
+}
+
+// Detections made from the ground truth: jittered, 5% missed, a few false ones.
+static Sequence detect_from(const Sequence& truth, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> jitter(0.f, 1.f);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    Sequence dets(truth.size());
+    for (size_t f = 0; f < truth.size(); f++)
+    {
+        for (const Box& t : truth[f])
+        {
+            if (u(rng) < 0.05f)
+            {
+                continue;
+            }
+            Box d = t;
+            for (int k = 0; k < 4; k++)
+            {
+                d.bbox[k] += jitter(rng) * 0.03f * t.bbox[k % 2 ? 3 : 2];
+            }
+            d.conf = 0.5f + 0.5f * u(rng);
+            dets[f].push_back(d);
+        }
+        if (!truth[f].empty() && u(rng) < 0.1f)
+        {
+            const Box& t = truth[f][rng() % truth[f].size()];
+            dets[f].push_back(Box{-1, {t.bbox[0] + 3 * t.bbox[2], t.bbox[1], t.bbox[2], t.bbox[3]}, 0.5f + 0.2f * u(rng)});
+        }
+    }
+    return dets;
+}
+
+// Objects crossing a 1280x720 frame at constant speed, turning now and then
+// and bouncing off the edges.
+static Sequence synthetic_truth()
+{
+    const int frames = 900, objects = 40;
+    const float W = 1280, H = 720;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<Box> state(objects);
+    std::vector<float> vx(objects), vy(objects);
+    for (int i = 0; i < objects; i++)
+    {
+        const float w = 30 + 60 * u(rng);
+        state[i] = Box{i + 1, {w + (W - 2 * w) * u(rng), w + (H - 2 * w) * u(rng), w, w * (1.5f + u(rng))}, 1.f};
+        vx[i] = 8 * (u(rng) - 0.5f);
+        vy[i] = 4 * (u(rng) - 0.5f);
+    }
+    Sequence seq(frames);
+    for (int f = 0; f < frames; f++)
+    {
+        for (int i = 0; i < objects; i++)
+        {
+            Box& b = state[i];
+            if (u(rng) < 0.01f)
+            {
+                vx[i] = 8 * (u(rng) - 0.5f);
+                vy[i] = 4 * (u(rng) - 0.5f);
+            }
+            b.bbox[0] += vx[i];
+            b.bbox[1] += vy[i];
+            if (b.bbox[0] < b.bbox[2] / 2 || b.bbox[0] > W - b.bbox[2] / 2)
+            {
+                vx[i] = -vx[i];
+            }
+            if (b.bbox[1] < b.bbox[3] / 2 || b.bbox[1] > H - b.bbox[3] / 2)
+            {
+                vy[i] = -vy[i];
+            }
+            seq[f].push_back(b);
+        }
+    }
+    return seq;
+}
+
+struct Score
+{
+    long objects = 0, misses = 0, false_positives = 0, switches = 0, matches = 0;
+    double iou_sum = 0;
+    std::map<int, int> last_id;
+
+    // Matches the boxes of a frame (with their track IDs) to its ground truth
+    // at IoU >= 0.5, and counts an ID switch when an object's track changes
+    // (boxes without an ID, below 0, have none to switch).
+    void Frame(const std::vector<Box>& truth, const std::vector<Box>& out, Triton::Assignment& assignment)
+    {
+        static std::vector<float> cost;
+        static std::vector<int> match;
+        cost.resize(truth.size() * out.size());
+        match.resize(truth.size());
+        for (size_t t = 0; t < truth.size(); t++)
+        {
+            for (size_t o = 0; o < out.size(); o++)
+            {
+                cost[t * out.size() + o] = 1.f - iou(truth[t].bbox, out[o].bbox);
+            }
+        }
+        assignment.Solve(cost.data(), (int)truth.size(), (int)out.size(), 0.5f, false, match.data());
+        objects += truth.size();
+        int matched = 0;
+        for (size_t t = 0; t < truth.size(); t++)
+        {
+            if (match[t] < 0)
+            {
+                misses++;
+                continue;
+            }
+            matched++;
+            iou_sum += 1.f - cost[t * out.size() + match[t]];
+            const int id = out[match[t]].id;
+            auto it = last_id.find(truth[t].id);
+            if (id >= 0 && it != last_id.end() && it->second != id)
+            {
+                switches++;
+            }
+            last_id[truth[t].id] = id;
+        }
+        matches += matched;
+        false_positives += (long)out.size() - matched;
+    }
+
+    double Mota() const { return 1.0 - (double)(misses + false_positives + switches) / std::max(objects, 1L); }
+};
+
+static void run(const Sequence& truth, const Sequence& dets, int every, bool greedy, bool hold)
+{
+    Triton::TrackerConfig config;
+    config.greedy = greedy;
+    // a track has to outlive a few detection gaps
+    config.max_age = std::max(config.max_age, 3 * every);
+    Triton::Tracker tracker(config);
+    Triton::Assignment assignment(1024, 1024);
+    Score score;
+    std::vector<Yolo::Detection> frame_dets;
+    frame_dets.reserve(config.max_detections);
+    std::vector<Box> out, held;
+    double seconds = 0;
+    size_t warm_allocations = 0;
+    const size_t warmup = std::min<size_t>(truth.size() / 4, 50);
+    for (size_t f = 0; f < truth.size(); f++)
+    {
+        const bool detect = f % every == 0;
+        frame_dets.clear();
+        for (const Box& d : f < dets.size() ? dets[f] : std::vector<Box>())
+        {
+            if ((int)frame_dets.size() < config.max_detections)
+            {
+                frame_dets.push_back(Yolo::Detection{{d.bbox[0], d.bbox[1], d.bbox[2], d.bbox[3]}, d.conf, 0.f});
+            }
+        }
+        out.clear();
+        if (hold)
+        {
+            // no tracker: the detections of the last detection frame, without identities
+            if (detect)
+            {
+                held.clear();
+                for (const Yolo::Detection& d : frame_dets)
+                {
+                    held.push_back(Box{-1, {d.bbox[0], d.bbox[1], d.bbox[2], d.bbox[3]}, d.conf});
+                }
+            }
+            out = held;
+        }
+        else
+        {
+            const size_t before = allocations;
+            auto start = std::chrono::steady_clock::now();
+            const auto& tracks = detect ? tracker.Update(frame_dets) : tracker.Advance();
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (f >= warmup)
+            {
+                warm_allocations += allocations - before;
+            }
+            for (const Triton::TrackedDetection& t : tracks)
+            {
+                out.push_back(Box{(int)t.id, {t.det.bbox[0], t.det.bbox[1], t.det.bbox[2], t.det.bbox[3]}, t.det.conf});
+            }
+        }
+        score.Frame(truth[f], out, assignment);
+    }
+    std::printf("  every %2d frame%s: %5.1f%% inferred  %-8s MOTA %6.3f  misses %6ld  false %6ld  ID switches %5ld  mean IoU %.3f",
+                every, every > 1 ? "s" : " ", 100.0 / every, hold ? "hold" : greedy ? "greedy" : "hungarian", score.Mota(),
+                score.misses, score.false_positives, score.switches, score.matches ? score.iou_sum / score.matches : 0.0);
+    if (!hold)
+    {
+        std::printf("  %.1fus/frame  %zu allocations after warm-up", 1e6 * seconds / truth.size(), warm_allocations);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    Sequence truth, dets;
+    if (argc > 1)
+    {
+        if (!read_mot(argv[1], true, truth))
+        {
+            std::cerr << "could not read " << argv[1] << std::endl;
+            return -1;
+        }
+        if (argc > 2 && !read_mot(argv[2], false, dets))
+        {
+            std::cerr << "could not read " << argv[2] << std::endl;
+            return -1;
+        }
+    }
+    else
+    {
+        truth = synthetic_truth();
+    }
+    if (dets.empty())
+    {
+        dets = detect_from(truth, 1);
+    }
+    long objects = 0;
+    for (const auto& f : truth)
+    {
+        objects += f.size();
+    }
+    std::cout << truth.size() << " frames, " << objects << " ground truth boxes"
+              << (argc > 2 ? ", recorded detections" : ", detections from the ground truth") << std::endl;
+    for (int every : {1, 2, 3, 5, 8, 12})
+    {
+        run(truth, dets, every, false, false);
+        if (every == 5)
+        {
+            run(truth, dets, every, true, false);
+        }
+        run(truth, dets, every, false, true);
+    }
+    return 0;
+}
@@ -1,5 +1,10 @@
+#include <sstream>
 #include "Yolo.hpp"
 #include "Triton.hpp"
+#include "Pipeline.hpp"
+#include "SharedMemory.hpp"
+#include "Tracker.hpp"
+#include "Aggregator.hpp"
 
 
 
@@ -10,7 +15,52 @@ static const std::string keys =
     "{ verbose vb | false | Verbose mode, true or false}"
     "{ protocol p | grpc | Protocol type, grpc or http}"
     "{ labelsFile l | ../coco.names | path to  coco labels names}"
-    "{ batch b | 1 | Batch size}";
+    "{ batch b | 1 | Batch size}"
+    "{ inflight i | 0 | Asynchronous requests kept in flight, 0 runs the synchronous loop}"
+    "{ queue q | 4 | Capacity of the queues between pipeline stages}"
+    "{ shm | false | Exchange tensors through system shared memory instead of the request body}"
+    "{ inputFormat f | fp32 | Wire format of the input: fp32, or uint8 / fp16 for an engine that normalizes itself}"
+    "{ motion m | false | Reuse the last detections for frames that did not change}"
+    "{ motionPixel | 16 | Gray level difference at which a pixel has changed}"
+    "{ motionRegion | 0.02 | Fraction of changed pixels at which a grid region has changed}"
+    "{ motionMaxSkip | 150 | Frames at most between two whole frame inferences}"
+    "{ motionCrops | false | Send small changes as a crop around the changed regions}"
+    "{ detectEvery n | 1 | Run detection on every Nth frame only}"
+    "{ track t | false | Track objects across frames, predicting their boxes between detections}"
+    "{ streams | | Comma separated videos / camera URLs served together, requests mix their frames}"
+    "{ deadline | 20 | With --streams, ms the oldest frame waits before a partial batch is sent}"
+    "{ maxLatency | 250 | With --streams, frames older than this many ms are dropped instead of sent}"
+    "{ sourceFps | 0 | With --streams, read file sources at this frame rate, 0 as fast as possible}";
+
+
+// Draws the detections of a frame, or with a tracker, the tracks they update;
+// frames without fresh detections only advance the tracks.
+static void annotate(cv::Mat& img, const float* prob, bool detected, Triton::Tracker* tracker)
+{
+    std::vector<Yolo::Detection> res;
+    if (detected || !tracker)
+    {
+        Yolo::nms(res, prob);
+    }
+    auto draw = [&img](const Yolo::Detection& det, const std::string& label) {
+        float bbox[4] = {det.bbox[0], det.bbox[1], det.bbox[2], det.bbox[3]};
+        cv::Rect r = Yolo::get_rect(img, bbox);
+        cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
+        cv::putText(img, label, cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
+    };
+    if (!tracker)
+    {
+        for (const Yolo::Detection& det : res)
+        {
+            draw(det, Yolo::coco_names[(int)det.class_id]);
+        }
+        return;
+    }
+    for (const Triton::TrackedDetection& t : detected ? tracker->Update(res) : tracker->Advance())
+    {
+        draw(t.det, Yolo::coco_names[(int)t.det.class_id] + " #" + std::to_string(t.id));
+    }
+}
 
 
 int main(int argc, const char* argv[])
@@ -31,9 +81,8 @@ int main(int argc, const char* argv[])
     else protocol = Triton::ProtocolType::HTTP;      
     const size_t batch_size = parser.get<size_t>("batch");
 
-    Triton::ScaleType scale = Triton::ScaleType::YOLOV4;
     std::string preprocess_output_filename;
-    std::string modelName = "yolov4";
+    std::string modelName = "yolov5";
     std::string modelVersion = "";
     std::string url(serverAddress);
     
@@ -66,7 +115,7 @@ int main(int argc, const char* argv[])
     }
 
     Triton::TritonModelInfo yoloModelInfo;
-    Triton::setModel(yoloModelInfo, batch_size);
+    Triton::setModel(yoloModelInfo, batch_size, Triton::ParseInputFormat(parser.get<std::string>("inputFormat")));
 
     nic::InferInput *input;
     err = nic::InferInput::Create(
@@ -100,11 +149,6 @@ int main(int argc, const char* argv[])
     nic::InferOptions options(modelName);
     options.model_version_ = modelVersion;
 
-    cv::Mat frame;
-    std::vector<uint8_t> input_data;
-    std::vector<cv::Mat> frameBatch;
-    std::vector<std::vector<uint8_t>> input_data_raw;
-
     cv::VideoCapture cap(videoName);
 
     Yolo::coco_names = Yolo::readLabelNames(fileName);
@@ -114,79 +158,195 @@ int main(int argc, const char* argv[])
         exit(1);
     }
 
-    while (cap.read(frame))
+    const bool sharedMemory = parser.get<bool>("shm");
+    Triton::MotionGateConfig motion;
+    motion.enabled = parser.get<bool>("motion");
+    motion.pixel_thresh = parser.get<int>("motionPixel");
+    motion.region_thresh = parser.get<float>("motionRegion");
+    motion.max_skip = parser.get<int>("motionMaxSkip");
+    motion.crops = parser.get<bool>("motionCrops");
+    const size_t detectEvery = std::max<size_t>(parser.get<size_t>("detectEvery"), 1);
+    std::unique_ptr<Triton::Tracker> tracker;
+    if (parser.get<bool>("track"))
     {
-        frameBatch.push_back(frame.clone());
-        if (frameBatch.size() < batch_size)
-        {
-            continue;
-        }
-
-        // Reset the input for new request.
-        err = input_ptr->Reset();
-        if (!err.IsOk())
-        {
-            std::cerr << "failed resetting input: " << err << std::endl;
-            exit(1);
-        }
-
-        for (size_t batchId = 0; batchId < batch_size; batchId++)
+        tracker.reset(new Triton::Tracker());
+    }
+    const size_t inflight = parser.get<size_t>("inflight");
+    const std::string streams = parser.get<std::string>("streams");
+    if (!streams.empty())
+    {
+        std::vector<cv::VideoCapture> sources;
+        std::stringstream list(streams);
+        std::string source;
+        while (std::getline(list, source, ','))
         {
-            input_data_raw.push_back(Triton::Preprocess(
-                frameBatch[batchId], yoloModelInfo.input_format_, yoloModelInfo.type1_, yoloModelInfo.type3_,
-                yoloModelInfo.input_c_ , cv::Size(yoloModelInfo.input_w_, yoloModelInfo.input_h_), scale));
-            err = input_ptr->AppendRaw(input_data_raw[batchId]);
-            if (!err.IsOk())
+            sources.emplace_back(source);
+            if (!sources.back().isOpened())
             {
-                std::cerr << "failed setting input: " << err << std::endl;
+                std::cerr << "unable to open " << source << std::endl;
                 exit(1);
             }
         }
-
-        nic::InferResult *result;
-        std::unique_ptr<nic::InferResult> result_ptr;
-        if (protocol == Triton::ProtocolType::HTTP)
+        Triton::AggregatorConfig config;
+        config.max_batch_size = batch_size;
+        config.inflight = std::max<size_t>(inflight, 1);
+        config.deadline_ms = parser.get<double>("deadline");
+        config.max_latency_ms = parser.get<double>("maxLatency");
+        config.source_fps = parser.get<double>("sourceFps");
+        // one tracker per stream
+        std::vector<std::unique_ptr<Triton::Tracker>> trackers(sources.size());
+        for (auto& t : trackers)
         {
-            err = tritonClient.httpClient->Infer(
-                &result, options, inputs, outputs);
+            if (tracker)
+            {
+                t.reset(new Triton::Tracker());
+            }
         }
-        else
+        Triton::Aggregator aggregator(tritonClient, protocol, options, outputs, yoloModelInfo, config);
+        aggregator.Run(sources, [&trackers](size_t stream, uint64_t, cv::Mat& img, const float* prob) {
+            annotate(img, prob, true, trackers[stream].get());
+            cv::imshow("stream " + std::to_string(stream), img);
+            cv::waitKey(1);
+        });
+        return 0;
+    }
+    if (inflight > 0)
+    {
+        Triton::PipelineConfig config;
+        config.batch_size = batch_size;
+        config.inflight = inflight;
+        config.queue_depth = parser.get<size_t>("queue");
+        config.shared_memory = sharedMemory;
+        config.motion = motion;
+        config.detect_every = detectEvery;
+        Triton::Pipeline pipeline(tritonClient, protocol, options, outputs, yoloModelInfo, config);
+        pipeline.Run(cap, [batch_size, &tracker](uint64_t frameId, cv::Mat& img, const float* prob, bool detected) {
+            annotate(img, prob, detected, tracker.get());
+            cv::imshow("video feed " + std::to_string(frameId % batch_size), img);
+            cv::waitKey(1);
+        });
+        return 0;
+    }
+
+    const int DETECTION_SIZE = sizeof(Yolo::Detection) / sizeof(float);
+    const int OUTPUT_SIZE = Yolo::MAX_OUTPUT_BBOX_COUNT * DETECTION_SIZE + 1;
+
+    // With --shm the input is preprocessed straight into a region registered with the
+    // server and prob is read back from it; the requests only carry the region names.
+    std::unique_ptr<Triton::SharedMemoryRegion> region;
+    std::unique_ptr<nic::InferRequestedOutput> shmOutput;
+    if (sharedMemory)
+    {
+        size_t inputByteSize = batch_size * yoloModelInfo.input_byte_size_;
+        region.reset(new Triton::SharedMemoryRegion(tritonClient, protocol, Triton::SharedMemoryRegion::UniqueName(0),
+            inputByteSize, batch_size * OUTPUT_SIZE * sizeof(float)));
+        nic::InferRequestedOutput* output;
+        err = nic::InferRequestedOutput::Create(&output, yoloModelInfo.output_names_[0]);
+        if (err.IsOk())
         {
-            err = tritonClient.grpcClient->Infer(
-                &result, options, inputs, outputs);
+            shmOutput.reset(output);
+            err = region->Bind(input_ptr.get(), shmOutput.get());
         }
         if (!err.IsOk())
         {
-            std::cerr << "failed sending synchronous infer request: " << err
-                      << std::endl;
+            std::cerr << "unable to bind shared memory: " << err << std::endl;
             exit(1);
         }
-        
-        const int DETECTION_SIZE = sizeof(Yolo::Detection) / sizeof(float);
-        const int OUTPUT_SIZE = Yolo::MAX_OUTPUT_BBOX_COUNT * DETECTION_SIZE + 1;
-        auto [detections, shape] = Triton::PostprocessYoloV4(result, batch_size, yoloModelInfo.output_names_, yoloModelInfo.max_batch_size_ != 0);
-        std::vector<std::vector<Yolo::Detection>> batch_res(batch_size);    
-        const float *prob = detections.data();        
-        for (size_t batchId = 0; batchId < batch_size; batchId++) 
+        outputs = {shmOutput.get()};
+    }
+
+    // Frames are decoded straight into the batch, reusing the same Mats every
+    // iteration. With --motion, frames that did not change reuse the last
+    // detections, as do the frames between detections with --detectEvery, and
+    // a batch of only such frames sends no request.
+    Triton::GatedBatch batch(batch_size, detectEvery);
+    Triton::MotionGate gate(motion);
+    Triton::MotionStats motionStats;
+    Triton::DetectionCache cache(Yolo::INPUT_W, Yolo::INPUT_H, Yolo::MAX_OUTPUT_BBOX_COUNT);
+    uint64_t nextFrame = 0;
+    Triton::Preprocessor preprocessor(yoloModelInfo, batch_size, region ? region->Input() : nullptr);
+
+    while (Triton::ReadGated(cap, motion.enabled ? &gate : nullptr, batch_size, nextFrame, batch, motionStats, detectEvery))
+    {
+        std::vector<float> detections;
+        const float *prob = nullptr;
+        std::unique_ptr<nic::InferResult> result_ptr;
+        if (batch.inferred > 0)
         {
-            auto& res = batch_res[batchId];
-            Yolo::nms(res, &prob[batchId * OUTPUT_SIZE]);
+            // Reset the input for new request, a shared memory input stays bound to its region.
+            if (!region)
+            {
+                err = input_ptr->Reset();
+                if (!err.IsOk())
+                {
+                    std::cerr << "failed resetting input: " << err << std::endl;
+                    exit(1);
+                }
+            }
+
+            for (size_t i = 0; i < batch.count; i++)
+            {
+                if (batch.slots[i] < 0)
+                {
+                    continue;
+                }
+                err = region ? preprocessor.Process(batch.Input(i), batch.slots[i])
+                             : preprocessor.Process(batch.Input(i), batch.slots[i], input_ptr.get());
+                if (!err.IsOk())
+                {
+                    std::cerr << "failed setting input: " << err << std::endl;
+                    exit(1);
+                }
+            }
+
+            nic::InferResult *result;
+            if (protocol == Triton::ProtocolType::HTTP)
+            {
+                err = tritonClient.httpClient->Infer(
+                    &result, options, inputs, outputs);
+            }
+            else
+            {
+                err = tritonClient.grpcClient->Infer(
+                    &result, options, inputs, outputs);
+            }
+            if (!err.IsOk())
+            {
+                std::cerr << "failed sending synchronous infer request: " << err
+                          << std::endl;
+                exit(1);
+            }
+            result_ptr.reset(result);
+
+            if (region)
+            {
+                if (!result->RequestStatus().IsOk())
+                {
+                    std::cerr << "inference  failed with error: " << result->RequestStatus() << std::endl;
+                    exit(1);
+                }
+                prob = region->Output();
+            }
+            else
+            {
+                auto [output, shape] = Triton::PostprocessYoloV4(result, batch_size, yoloModelInfo.output_names_, yoloModelInfo.max_batch_size_ != 0);
+                detections = std::move(output);
+                prob = detections.data();
+            }
         }
-        for (size_t batchId = 0; batchId < batch_size; batchId++) 
+        for (size_t i = 0; i < batch.count; i++)
         {
-            auto& res = batch_res[batchId];
-            cv::Mat img = frameBatch.at(batchId);
-            for (size_t j = 0; j < res.size(); j++) {
-                cv::Rect r = Yolo::get_rect(img, res[j].bbox);
-                cv::rectangle(img, r, cv::Scalar(0x27, 0xC1, 0x36), 2);
-                cv::putText(img, Yolo::coco_names[(int)res[j].class_id], cv::Point(r.x, r.y - 1), cv::FONT_HERSHEY_PLAIN, 1.2, cv::Scalar(0xFF, 0xFF, 0xFF), 2);
-            }
-            cv::imshow("video feed " + std::to_string(batchId), img);
+            const float* slot = batch.slots[i] >= 0 ? &prob[batch.slots[i] * OUTPUT_SIZE] : nullptr;
+            cv::Mat img = batch.frames.at(i);
+            annotate(img, cache.Resolve(batch, i, slot), slot != nullptr, tracker.get());
+            cv::imshow("video feed " + std::to_string((batch.first_frame + i) % batch_size), img);
             cv::waitKey(1);
         }
-        frameBatch.clear();
-        input_data_raw.clear();
+    }
+    if (motion.enabled || detectEvery > 1)
+    {
+        motionStats.Print(std::cout, batch_size);
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -9,6 +9,7 @@ import tritonclient.grpc as grpcclient
 from tritonclient.utils import InferenceServerException
 
 from processing import preprocess, postprocess
+from transport import TensorTransport
 from render import render_box, render_filled_box, get_text_size, render_text, RAND_COLORS, plot_one_box
 from labels import COCOLabels
 
@@ -86,6 +87,16 @@ if __name__ == '__main__':
                         required=False,
                         default=None,
                         help='Client timeout in seconds, default no timeout')
+    parser.add_argument('--shm',
+                        action="store_true",
+                        required=False,
+                        default=False,
+                        help='Exchange input and output through system shared memory instead of the gRPC message')
+    parser.add_argument('--input-format',
+                        choices=['fp32', 'uint8', 'fp16'],
+                        default='fp32',
+                        help='Wire format of the input, uint8 / fp16 need a model that normalizes it itself '
+                        '(models/yolov5/config.uint8.pbtxt, config.fp16.pbtxt), default fp32')
     parser.add_argument('-s',
                         '--ssl',
                         action="store_true",
@@ -165,15 +176,18 @@ if __name__ == '__main__':
             print("Got: {}".format(ex.message()))
             sys.exit(1)
 
+    transport = TensorTransport(triton_client, FLAGS.width, FLAGS.height, FLAGS.shm,
+                                input_format=FLAGS.input_format)
+    inputs = transport.inputs
+    outputs = transport.outputs
+
     # DUMMY MODE
     if FLAGS.mode == 'dummy':
         print("Running in 'dummy' mode")
         print("Creating emtpy buffer filled with ones...")
-        inputs = []
-        outputs = []
-        inputs.append(grpcclient.InferInput('data', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
-        inputs[0].set_data_from_numpy(np.ones(shape=(1, 3, FLAGS.width, FLAGS.height), dtype=np.float32))
-        outputs.append(grpcclient.InferRequestedOutput('prob'))
+        input_buffer = transport.input_buffer()
+        input_buffer.fill(1)
+        transport.set_input(input_buffer)
 
         print("Invoking inference...")
         results = triton_client.infer(model_name=FLAGS.model,
@@ -188,7 +202,7 @@ if __name__ == '__main__':
             print(statistics)
         print("Done")
 
-        result = results.as_numpy('prob')
+        result = transport.prob(results)
         print(f"Received result buffer of size {result.shape}")
         print(f"Naive buffer sum: {np.sum(result)}")
 
@@ -198,20 +212,15 @@ if __name__ == '__main__':
         if not FLAGS.input:
             print("FAILED: no input image")
             sys.exit(1)
-        
-        inputs = []
-        outputs = []
-        inputs.append(grpcclient.InferInput('data', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
-        outputs.append(grpcclient.InferRequestedOutput('prob'))
 
         print("Creating buffer from image file...")
         input_image = cv2.imread(str(FLAGS.input))
         if input_image is None:
             print(f"FAILED: could not load input image {str(FLAGS.input)}")
             sys.exit(1)
-        input_image_buffer = preprocess(input_image, [FLAGS.width, FLAGS.height])
-        input_image_buffer = np.expand_dims(input_image_buffer, axis=0)
-        inputs[0].set_data_from_numpy(input_image_buffer)
+        input_image_buffer = transport.input_buffer()
+        preprocess(input_image, [FLAGS.width, FLAGS.height], out=input_image_buffer[0], input_format=FLAGS.input_format)
+        transport.set_input(input_image_buffer)
 
         print("Invoking inference...")
         results = triton_client.infer(model_name=FLAGS.model,
@@ -226,7 +235,7 @@ if __name__ == '__main__':
             print(statistics)
         print("Done")
 
-        result = results.as_numpy('prob')
+        result = transport.prob(results)
         print(f"Received result buffer of size {result.shape}")
         print(f"Naive buffer sum: {np.sum(result)}")
 
@@ -252,11 +261,6 @@ if __name__ == '__main__':
             print("FAILED: no input video")
             sys.exit(1)
 
-        inputs = []
-        outputs = []
-        inputs.append(grpcclient.InferInput('data', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
-        outputs.append(grpcclient.InferRequestedOutput('prob'))
-
         print("Opening input video stream...")
         cap = cv2.VideoCapture(FLAGS.input)
         if not cap.isOpened():
@@ -277,16 +281,16 @@ if __name__ == '__main__':
                 fourcc = cv2.VideoWriter_fourcc('M', 'P', '4', 'V')
                 out = cv2.VideoWriter(FLAGS.out, fourcc, FLAGS.fps, (frame.shape[1], frame.shape[0]))
 
-            input_image_buffer = preprocess(frame, [FLAGS.width, FLAGS.height])
-            input_image_buffer = np.expand_dims(input_image_buffer, axis=0)
-            inputs[0].set_data_from_numpy(input_image_buffer)
+            input_image_buffer = transport.input_buffer()
+            preprocess(frame, [FLAGS.width, FLAGS.height], out=input_image_buffer[0], input_format=FLAGS.input_format)
+            transport.set_input(input_image_buffer)
 
             results = triton_client.infer(model_name=FLAGS.model,
                                     inputs=inputs,
                                     outputs=outputs,
                                     client_timeout=FLAGS.client_timeout)
 
-            result = results.as_numpy('prob')
+            result = transport.prob(results)
 
             detected_objects = postprocess(result, frame.shape[1], frame.shape[0], [FLAGS.width, FLAGS.height], FLAGS.confidence, FLAGS.nms)
             print(f"Frame {counter}: {len(detected_objects)} objects")
@@ -317,3 +321,5 @@ if __name__ == '__main__':
         else:
             cv2.destroyAllWindows()
         print("Done")
+
+    transport.close()
@@ -3,22 +3,18 @@ from boundingbox import BoundingBox
 import cv2
 import numpy as np
 
-def preprocess(raw_bgr_image, input_shape):
+def letterbox(raw_bgr_image, input_shape):
     """
-    description: Preprocess an image before TRT YOLO inferencing.
-                 Convert BGR image to RGB,
-                 resize and pad it to target size, normalize to [0,1],
-                 transform to NCHW format.          
+    description: Resize an image with its aspect ratio kept and pad it with
+                 (128,128,128) to the target size, still BGR uint8 HWC.
     param:
         raw_bgr_image: int8 numpy array of shape (img_h, img_w, 3)
         input_shape: a tuple of (H, W)
     return:
-        image:  the processed image float32 numpy array of shape (3, H, W)
+        image:  uint8 numpy array of shape (H, W, 3)
     """
     input_w, input_h = input_shape
-    image_raw = raw_bgr_image
-    h, w, c = image_raw.shape
-    image = cv2.cvtColor(image_raw, cv2.COLOR_BGR2RGB)
+    h, w, c = raw_bgr_image.shape
     # Calculate widht and height and paddings
     r_w = input_w / w
     r_h = input_h / h
@@ -35,11 +31,41 @@ def preprocess(raw_bgr_image, input_shape):
         tx2 = input_w - tw - tx1
         ty1 = ty2 = 0
     # Resize the image with long side while maintaining ratio
-    image = cv2.resize(image, (tw, th))
+    image = cv2.resize(raw_bgr_image, (tw, th))
     # Pad the short side with (128,128,128)
-    image = cv2.copyMakeBorder(
+    return cv2.copyMakeBorder(
         image, ty1, ty2, tx1, tx2, cv2.BORDER_CONSTANT, (128, 128, 128)
     )
+
+
+def preprocess(raw_bgr_image, input_shape, out=None, input_format='fp32'):
+    """
+    description: Preprocess an image before TRT YOLO inferencing.
+                 Letterbox it to the target size, then for the 'fp32' input
+                 convert BGR image to RGB, normalize to [0,1] and transform to
+                 NCHW format. The 'uint8' and 'fp16' inputs stay BGR HWC and
+                 unnormalized, the engine's first layer does the rest.
+    param:
+        raw_bgr_image: int8 numpy array of shape (img_h, img_w, 3)
+        input_shape: a tuple of (H, W)
+        out: optional array to write the result into, e.g. a view of a shared
+             memory region: float32 (3, H, W) for 'fp32', uint8 / float16
+             (H, W, 3) for 'uint8' / 'fp16'
+        input_format: 'fp32', 'uint8' or 'fp16'
+    return:
+        image:  the processed image, float32 (3, H, W) or uint8 / float16 (H, W, 3)
+    """
+    image = letterbox(raw_bgr_image, input_shape)
+    if input_format != 'fp32':
+        if out is None:
+            return image if input_format == 'uint8' else image.astype(np.float16)
+        np.copyto(out, image, casting='unsafe')
+        return out
+    image = cv2.cvtColor(image, cv2.COLOR_BGR2RGB)
+    if out is not None:
+        # Normalize to [0,1] and HWC to CHW in one pass into the caller's buffer
+        np.multiply(np.transpose(image, [2, 0, 1]), np.float32(1 / 255.0), out=out, casting='unsafe')
+        return out
     image = image.astype(np.float32)
     # Normalize to [0,1]
     image /= 255.0
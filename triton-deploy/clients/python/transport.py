@@ -0,0 +1,93 @@
+import atexit
+import mmap
+import os
+
+import numpy as np
+import tritonclient.grpc as grpcclient
+
+OUTPUT_ELEMENTS = 6001
+
+
+# Per input format: dtype and shape of the image the client preprocesses into,
+# then datatype, dtype and shape of the `data` tensor on the wire. UINT8 images
+# travel as INT32 [H, W*3/4] since TensorRT has no uint8 bindings.
+INPUT_FORMATS = {
+    'fp32': (np.float32, lambda w, h: [3, h, w], 'FP32', np.float32, lambda w, h: [3, h, w]),
+    'uint8': (np.uint8, lambda w, h: [h, w, 3], 'INT32', np.int32, lambda w, h: [h, w * 3 // 4]),
+    'fp16': (np.float16, lambda w, h: [h, w, 3], 'FP16', np.float16, lambda w, h: [h, w, 3]),
+}
+
+
+class TensorTransport:
+    """
+    description: Inputs/outputs of one yolov5 request, either carried in the gRPC
+                 message or placed in a POSIX shared memory region registered
+                 with the server. With shared memory, preprocessing writes into
+                 input_buffer() and prob() is a view of the region, so neither
+                 tensor is serialized. input_format selects the model's input
+                 contract, see INPUT_FORMATS.
+    """
+
+    def __init__(self, triton_client, width, height, use_shm=False, name='yolov5_client', input_format='fp32'):
+        self.triton_client = triton_client
+        self.dtype, image_shape, datatype, self.wire_dtype, wire_shape = INPUT_FORMATS[input_format]
+        self.shape = [1] + image_shape(width, height)
+        self.wire_shape = [1] + wire_shape(width, height)
+        self.inputs = [grpcclient.InferInput('data', self.wire_shape, datatype)]
+        self.outputs = [grpcclient.InferRequestedOutput('prob')]
+        self.region = None
+        if not use_shm:
+            return
+
+        self.name = f'{name}_{os.getpid()}'
+        self.key = '/' + self.name
+        input_byte_size = int(np.prod(self.shape)) * np.dtype(self.dtype).itemsize
+        output_byte_size = OUTPUT_ELEMENTS * 4
+        fd = os.open('/dev/shm' + self.key, os.O_RDWR | os.O_CREAT, 0o600)
+        try:
+            os.ftruncate(fd, input_byte_size + output_byte_size)
+            self.region = mmap.mmap(fd, input_byte_size + output_byte_size)
+        finally:
+            os.close(fd)
+        self.input_view = np.ndarray(self.shape, self.dtype, buffer=self.region)
+        self.output_view = np.ndarray([1, OUTPUT_ELEMENTS, 1, 1], np.float32, buffer=self.region, offset=input_byte_size)
+        triton_client.register_system_shared_memory(self.name, self.key, input_byte_size + output_byte_size)
+        # Don't leave the region behind in /dev/shm when the client exits early.
+        atexit.register(self.close)
+        self.inputs[0].set_shared_memory(self.name, input_byte_size)
+        self.outputs[0].set_shared_memory(self.name, output_byte_size, offset=input_byte_size)
+
+    def input_buffer(self):
+        """
+        description: Array to preprocess into, (1, 3, H, W) float32 or (1, H, W, 3)
+                     uint8 / float16, the shared region itself when shared memory
+                     is enabled.
+        """
+        if self.region is None:
+            return np.empty(self.shape, dtype=self.dtype)
+        return self.input_view
+
+    def set_input(self, buffer):
+        if self.region is None:
+            # Same bytes, viewed with the tensor's wire datatype and shape.
+            self.inputs[0].set_data_from_numpy(buffer.view(self.wire_dtype).reshape(self.wire_shape))
+        elif buffer is not self.input_view:
+            np.copyto(self.input_view, buffer)
+
+    def prob(self, results):
+        if self.region is None:
+            return results.as_numpy('prob')
+        # Valid until the next request overwrites the region.
+        return self.output_view
+
+    def close(self):
+        if self.region is None:
+            return
+        self.triton_client.unregister_system_shared_memory(self.name)
+        del self.input_view, self.output_view
+        try:
+            self.region.close()
+        except BufferError:
+            pass  # an array from prob() is still alive, the mapping goes away with the process
+        os.unlink('/dev/shm' + self.key)
+        self.region = None
@@ -0,0 +1,682 @@
+#!/usr/bin/env python
+"""
+Stand-in for tritonserver that speaks the KServe v2 inference protocol over
+HTTP/REST and gRPC for the yolov5 model in ../models, without a GPU. It checks
+the request against config.pbtxt and answers with a synthetic or replayed
+`prob` tensor after a configurable delay, so the clients can be benchmarked
+and regression tested on a CPU-only machine.
+
+HTTP only needs the standard library; gRPC additionally needs grpcio and
+tritonclient[grpc], which provide the generated service stubs.
+"""
+
+import argparse
+import json
+import mmap
+import os
+import random
+import re
+import signal
+import struct
+import sys
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DTYPE_SIZE = {'BOOL': 1, 'UINT8': 1, 'INT8': 1, 'UINT16': 2, 'INT16': 2, 'FP16': 2,
+              'UINT32': 4, 'INT32': 4, 'FP32': 4, 'UINT64': 8, 'INT64': 8, 'FP64': 8}
+
+
+class InferError(Exception):
+    pass
+
+
+def parse_pbtxt(text):
+    """
+    description: Minimal protobuf text format parser, enough for config.pbtxt.
+                 Repeated fields come back as lists.
+    """
+    tokens = re.findall(r'"[^"]*"|[{}\[\]:,]|[^\s{}\[\]:,"]+', re.sub(r'#.*', '', text))
+    pos = 0
+
+    def value():
+        nonlocal pos
+        tok = tokens[pos]
+        pos += 1
+        if tok == '{':
+            return message('}')
+        if tok == '[':
+            items = []
+            while tokens[pos] != ']':
+                items.append(value())
+                if tokens[pos] == ',':
+                    pos += 1
+            pos += 1
+            return items
+        if tok.startswith('"'):
+            return tok[1:-1]
+        try:
+            return int(tok)
+        except ValueError:
+            return tok
+
+    def message(end):
+        nonlocal pos
+        fields = {}
+        while pos < len(tokens) and tokens[pos] != end:
+            name = tokens[pos]
+            pos += 1
+            if tokens[pos] == ':':
+                pos += 1
+            v = value()
+            if isinstance(v, list) or name in fields:
+                fields.setdefault(name, [])
+                fields[name] += v if isinstance(v, list) else [v]
+            else:
+                fields[name] = v
+            if pos < len(tokens) and tokens[pos] in (',', ';'):
+                pos += 1
+        pos += 1
+        return fields
+
+    return message(None)
+
+
+class MockModel:
+    """
+    description: Model contract from config.pbtxt plus the output to serve.
+    """
+
+    def __init__(self, config_path, max_batch_size, replay, boxes, latency_ms, per_image_ms, jitter_ms, instances):
+        with open(config_path) as f:
+            self.config_text = f.read()
+        self.config = parse_pbtxt(self.config_text)
+        self.name = self.config['name']
+        self.max_batch_size = max_batch_size if max_batch_size is not None else self.config.get('max_batch_size', 0)
+        self.inputs = [self._tensor(t) for t in self.config['input']]
+        self.outputs = [self._tensor(t) for t in self.config['output']]
+        if len(self.outputs) != 1 or self.outputs[0]['datatype'] != 'FP32':
+            raise ValueError('mock server serves exactly one FP32 output')
+        self.output_elements = 1
+        for d in self.outputs[0]['dims']:
+            self.output_elements *= d
+        self.frames = self._load_replay(replay) if replay else [self._synthetic(boxes)]
+        self.latency_ms = latency_ms
+        self.per_image_ms = per_image_ms
+        self.jitter_ms = jitter_ms
+        count = instances
+        if count is None:
+            count = sum(g.get('count', 1) for g in self.config.get('instance_group', [{}]))
+        # Concurrent executions, like the instance_group count of a GPU model.
+        self.slots = threading.Semaphore(max(1, count))
+        self.instances = max(1, count)
+        self.lock = threading.Lock()
+        self.frame_index = 0
+        self.stats = {'requests': 0, 'images': 0, 'failures': 0, 'bytes_in': 0, 'bytes_out': 0,
+                      'queue_ns': 0, 'compute_ns': 0}
+
+    @staticmethod
+    def _tensor(t):
+        return {'name': t['name'], 'datatype': t['data_type'].replace('TYPE_', '').replace('STRING', 'BYTES'),
+                'dims': [int(d) for d in t['dims']]}
+
+    def _input_size(self):
+        """
+        description: Width and height of the network input for the layouts in
+                     models/yolov5: FP32 CHW, FP16 HWC, or UINT8 HWC bytes packed
+                     as INT32 [H, W*3/4].
+        """
+        dims = self.inputs[0]['dims']
+        if len(dims) == 3 and dims[0] == 3:
+            return dims[2], dims[1]
+        if len(dims) == 3:
+            return dims[1], dims[0]
+        return dims[1] * 4 // 3, dims[0]
+
+    def _synthetic(self, boxes):
+        # yolov5 layout: [count, {cx, cy, w, h, conf, class_id} * MAX_OUTPUT_BBOX_COUNT]
+        rng = random.Random(0)
+        max_boxes = (self.output_elements - 1) // 6
+        boxes = min(boxes, max_boxes)
+        w, h = self._input_size()
+        values = [float(boxes)]
+        for i in range(boxes):
+            bw, bh = rng.uniform(16, w / 3), rng.uniform(16, h / 3)
+            values += [rng.uniform(bw / 2, w - bw / 2), rng.uniform(bh / 2, h - bh / 2), bw, bh,
+                       rng.uniform(0.1, 1.0), float(i % 80)]
+        values += [0.0] * (self.output_elements - len(values))
+        return struct.pack('<%df' % self.output_elements, *values)
+
+    def _load_replay(self, path):
+        frame_bytes = self.output_elements * 4
+        with open(path, 'rb') as f:
+            data = f.read()
+        if not data or len(data) % frame_bytes:
+            raise ValueError(f'{path}: size {len(data)} is not a multiple of one prob tensor ({frame_bytes} bytes)')
+        return [data[i:i + frame_bytes] for i in range(0, len(data), frame_bytes)]
+
+    def metadata(self):
+        batch = [-1] if self.max_batch_size > 0 else []
+        return {'name': self.name, 'versions': ['1'], 'platform': self.config.get('platform', ''),
+                'inputs': [{'name': t['name'], 'datatype': t['datatype'], 'shape': batch + t['dims']} for t in self.inputs],
+                'outputs': [{'name': t['name'], 'datatype': t['datatype'], 'shape': batch + t['dims']} for t in self.outputs]}
+
+    def check_input(self, name, datatype, shape, byte_size):
+        """
+        description: Validates one input against the config and returns its batch size.
+        """
+        spec = next((t for t in self.inputs if t['name'] == name), None)
+        if spec is None:
+            raise InferError(f"unexpected inference input '{name}' for model '{self.name}'")
+        if datatype != spec['datatype']:
+            raise InferError(f"inference input '{name}' data-type is '{datatype}', model expects '{spec['datatype']}'")
+        shape = [int(d) for d in shape]
+        if self.max_batch_size > 0:
+            if len(shape) != len(spec['dims']) + 1 or shape[1:] != spec['dims']:
+                raise InferError(f"unexpected shape for input '{name}', model expects [-1,{','.join(map(str, spec['dims']))}], got {shape}")
+            batch = shape[0]
+            if batch < 1 or batch > self.max_batch_size:
+                raise InferError(f"inference request batch-size must be <= {self.max_batch_size} for '{self.name}', got {batch}")
+        else:
+            if shape != spec['dims']:
+                raise InferError(f"unexpected shape for input '{name}', model expects {spec['dims']}, got {shape}")
+            batch = 1
+        expected = DTYPE_SIZE[datatype]
+        for d in shape:
+            expected *= d
+        if byte_size != expected:
+            raise InferError(f"input '{name}' got {byte_size} bytes, expected {expected}")
+        return batch
+
+    def execute(self, batch, bytes_in):
+        """
+        description: Waits for an instance, sleeps for the configured latency and
+                     returns the output shape and raw bytes for the batch.
+        """
+        queued = time.perf_counter_ns()
+        with self.slots:
+            started = time.perf_counter_ns()
+            delay = self.latency_ms + self.per_image_ms * batch + random.uniform(0, self.jitter_ms)
+            if delay > 0:
+                time.sleep(delay / 1000.0)
+            with self.lock:
+                out = b''.join(self.frames[(self.frame_index + i) % len(self.frames)] for i in range(batch))
+                self.frame_index = (self.frame_index + batch) % len(self.frames)
+                done = time.perf_counter_ns()
+                self.stats['requests'] += 1
+                self.stats['images'] += batch
+                self.stats['bytes_in'] += bytes_in
+                self.stats['bytes_out'] += len(out)
+                self.stats['queue_ns'] += started - queued
+                self.stats['compute_ns'] += done - started
+        shape = ([batch] if self.max_batch_size > 0 else []) + self.outputs[0]['dims']
+        return shape, out
+
+    def failed(self):
+        with self.lock:
+            self.stats['failures'] += 1
+
+    def statistics(self):
+        with self.lock:
+            s = dict(self.stats)
+        return {'model_stats': [{
+            'name': self.name, 'version': '1', 'inference_count': s['images'], 'execution_count': s['requests'],
+            'inference_stats': {'success': {'count': s['requests'], 'ns': s['queue_ns'] + s['compute_ns']},
+                                'fail': {'count': s['failures'], 'ns': 0},
+                                'queue': {'count': s['requests'], 'ns': s['queue_ns']},
+                                'compute_infer': {'count': s['requests'], 'ns': s['compute_ns']}}}]}
+
+
+class SharedMemoryRegistry:
+    """
+    description: System shared memory regions registered by clients, mapped
+                 the way tritonserver maps them (POSIX shm_open key under /dev/shm).
+    """
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.regions = {}
+
+    def register(self, name, key, offset, byte_size):
+        with self.lock:
+            if name in self.regions:
+                raise InferError(f"shared memory region '{name}' already in manager")
+            try:
+                fd = os.open('/dev/shm/' + key.lstrip('/'), os.O_RDWR)
+            except OSError as e:
+                raise InferError(f"Unable to open shared memory region: '{key}': {e.strerror}")
+            try:
+                mapped = mmap.mmap(fd, offset + byte_size)
+            except (OSError, ValueError) as e:
+                raise InferError(f"unable to map shared memory region '{name}': {e}")
+            finally:
+                os.close(fd)
+            self.regions[name] = {'key': key, 'offset': offset, 'byte_size': byte_size, 'map': mapped}
+
+    def unregister(self, name=None):
+        with self.lock:
+            for n in ([name] if name else list(self.regions)):
+                region = self.regions.pop(n, None)
+                if region:
+                    region['map'].close()
+
+    def status(self, name=None):
+        with self.lock:
+            return [{'name': n, 'key': r['key'], 'offset': r['offset'], 'byte_size': r['byte_size']}
+                    for n, r in self.regions.items() if name is None or n == name]
+
+    def _view(self, name, byte_size, offset):
+        region = self.regions.get(name)
+        if region is None:
+            raise InferError(f"Unable to find shared memory region: '{name}'")
+        if offset + byte_size > region['byte_size']:
+            raise InferError(f"shared memory region '{name}' too small for {byte_size} bytes at offset {offset}")
+        start = region['offset'] + offset
+        return region['map'], start, start + byte_size
+
+    def check(self, name, byte_size, offset=0):
+        # An engine would read the input from here; the mock only validates the range.
+        with self.lock:
+            self._view(name, byte_size, offset)
+
+    def write(self, name, data, byte_size, offset=0):
+        with self.lock:
+            if len(data) > byte_size:
+                raise InferError(f"shared memory region '{name}' byte size {byte_size} is less than output size {len(data)}")
+            m, start, _ = self._view(name, len(data), offset)
+            m[start:start + len(data)] = data
+
+
+def make_http_handler(model, shm):
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.1'
+        # Headers and body go out in separate writes; don't let Nagle hold the body back.
+        disable_nagle_algorithm = True
+
+        def log_message(self, fmt, *args):
+            pass
+
+        def _send(self, code, body=b'', headers=None):
+            self.send_response(code)
+            for k, v in (headers or {'Content-Type': 'application/json'}).items():
+                self.send_header(k, v)
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def _json(self, code, obj):
+            self._send(code, json.dumps(obj).encode())
+
+        def _model_path(self, path):
+            m = re.match(r'^/v2/models/([^/]+)(?:/versions/[^/]+)?(/.*)?$', path)
+            if not m:
+                return None, None
+            return m.group(1), m.group(2) or ''
+
+        def _shm_request(self, path):
+            m = re.match(r'^/v2/systemsharedmemory(?:/region/([^/]+))?/(register|unregister|status)$', path)
+            if not m:
+                return False
+            name, action = m.group(1), m.group(2)
+            try:
+                if action == 'status':
+                    self._json(200, shm.status(name))
+                elif action == 'unregister':
+                    shm.unregister(name)
+                    self._send(200)
+                else:
+                    body = json.loads(self.rfile.read(int(self.headers.get('Content-Length', 0))))
+                    shm.register(name, body['key'], body.get('offset', 0), body['byte_size'])
+                    self._send(200)
+            except (InferError, KeyError, ValueError) as e:
+                self._json(400, {'error': str(e)})
+            return True
+
+        def do_GET(self):
+            path = self.path.split('?')[0]
+            if self._shm_request(path):
+                return
+            if path == '/v2/health/live' or path == '/v2/health/ready':
+                return self._send(200)
+            if path == '/v2':
+                return self._json(200, {'name': 'mock_server', 'version': '0', 'extensions': ['binary_tensor_data', 'statistics', 'model_configuration', 'system_shared_memory']})
+            name, rest = self._model_path(path)
+            if name is None:
+                return self._json(404, {'error': 'not found'})
+            if name != model.name:
+                return self._json(400, {'error': f"Request for unknown model: '{name}' is not found"})
+            if rest == '/ready':
+                return self._send(200)
+            if rest == '':
+                return self._json(200, model.metadata())
+            if rest == '/config':
+                return self._json(200, {'name': model.name, 'max_batch_size': model.max_batch_size,
+                                        'input': model.config['input'], 'output': model.config['output']})
+            if rest == '/stats':
+                return self._json(200, model.statistics())
+            return self._json(404, {'error': 'not found'})
+
+        def do_POST(self):
+            path = self.path.split('?')[0]
+            if self._shm_request(path):
+                return
+            name, rest = self._model_path(path)
+            if name is None or rest != '/infer':
+                return self._json(404, {'error': 'not found'})
+            if name != model.name:
+                return self._json(400, {'error': f"Request for unknown model: '{name}' is not found"})
+            body = self.rfile.read(int(self.headers.get('Content-Length', 0)))
+            encoding = self.headers.get('Content-Encoding', '')
+            if encoding == 'gzip':
+                body = zlib.decompress(body, 16 + zlib.MAX_WBITS)
+            elif encoding == 'deflate':
+                body = zlib.decompress(body)
+            try:
+                self._infer(body)
+            except (InferError, ValueError, KeyError) as e:
+                model.failed()
+                self._json(400, {'error': str(e)})
+
+        def _infer(self, body):
+            header_len = self.headers.get('Inference-Header-Content-Length')
+            header_len = int(header_len) if header_len is not None else len(body)
+            request = json.loads(body[:header_len])
+            offset = header_len
+            batch = None
+            for t in request['inputs']:
+                params = t.get('parameters', {})
+                if 'shared_memory_region' in params:
+                    size = params['shared_memory_byte_size']
+                    shm.check(params['shared_memory_region'], size, params.get('shared_memory_offset', 0))
+                elif 'binary_data_size' in params:
+                    size = params['binary_data_size']
+                    if offset + size > len(body):
+                        raise InferError(f"unexpected end of binary data for input '{t['name']}'")
+                    offset += size
+                elif 'data' in t:
+                    size = len(flatten(t['data'])) * DTYPE_SIZE.get(t['datatype'], 4)
+                else:
+                    raise InferError(f"input '{t['name']}' has neither data nor binary_data_size")
+                b = model.check_input(t['name'], t['datatype'], t['shape'], size)
+                if batch is not None and b != batch:
+                    raise InferError('inputs disagree on batch size')
+                batch = b
+            if batch is None:
+                raise InferError('request has no inputs')
+
+            shape, out = model.execute(batch, len(body))
+
+            requested = request.get('outputs') or [{'name': o['name']} for o in model.outputs]
+            binary_default = request.get('parameters', {}).get('binary_data_output', False)
+            response = {'model_name': model.name, 'model_version': '1', 'outputs': []}
+            if 'id' in request:
+                response['id'] = request['id']
+            binary = b''
+            for o in requested:
+                if o['name'] != model.outputs[0]['name']:
+                    raise InferError(f"unexpected inference output '{o['name']}' for model '{model.name}'")
+                entry = {'name': o['name'], 'datatype': 'FP32', 'shape': shape}
+                params = o.get('parameters', {})
+                if 'shared_memory_region' in params:
+                    shm.write(params['shared_memory_region'], out, params['shared_memory_byte_size'],
+                              params.get('shared_memory_offset', 0))
+                    entry['parameters'] = {'shared_memory_region': params['shared_memory_region'],
+                                           'shared_memory_byte_size': len(out)}
+                elif params.get('binary_data', binary_default):
+                    entry['parameters'] = {'binary_data_size': len(out)}
+                    binary += out
+                else:
+                    entry['data'] = list(struct.unpack('<%df' % (len(out) // 4), out))
+                response['outputs'].append(entry)
+            header = json.dumps(response).encode()
+            if binary:
+                self._send(200, header + binary, {'Content-Type': 'application/octet-stream',
+                                                   'Inference-Header-Content-Length': str(len(header))})
+            else:
+                self._send(200, header)
+
+    return Handler
+
+
+def flatten(data):
+    out = []
+    for d in data:
+        out += flatten(d) if isinstance(d, list) else [d]
+    return out
+
+
+def import_grpc_stubs():
+    import grpc
+    try:
+        from tritonclient.grpc import service_pb2 as pb, service_pb2_grpc as pb_grpc
+    except ImportError:
+        from tritonclient.grpc import grpc_service_pb2 as pb, grpc_service_pb2_grpc as pb_grpc
+    from tritonclient.grpc import model_config_pb2
+    return grpc, pb, pb_grpc, model_config_pb2
+
+
+def make_grpc_server(model, shm, port, workers):
+    grpc, pb, pb_grpc, model_config_pb2 = import_grpc_stubs()
+    from concurrent import futures
+    from google.protobuf import text_format
+
+    config_proto = text_format.Parse(model.config_text, model_config_pb2.ModelConfig())
+    config_proto.max_batch_size = model.max_batch_size
+
+    def check_model(name, context):
+        if name != model.name:
+            context.abort(grpc.StatusCode.NOT_FOUND, f"Request for unknown model: '{name}' is not found")
+
+    class Servicer(pb_grpc.GRPCInferenceServiceServicer):
+
+        def ServerLive(self, request, context):
+            return pb.ServerLiveResponse(live=True)
+
+        def ServerReady(self, request, context):
+            return pb.ServerReadyResponse(ready=True)
+
+        def ModelReady(self, request, context):
+            return pb.ModelReadyResponse(ready=request.name == model.name)
+
+        def ServerMetadata(self, request, context):
+            return pb.ServerMetadataResponse(name='mock_server', version='0', extensions=['binary_tensor_data', 'statistics', 'system_shared_memory'])
+
+        def ModelMetadata(self, request, context):
+            check_model(request.name, context)
+            meta = model.metadata()
+            tensor = pb.ModelMetadataResponse.TensorMetadata
+            return pb.ModelMetadataResponse(
+                name=meta['name'], versions=meta['versions'], platform=meta['platform'],
+                inputs=[tensor(name=t['name'], datatype=t['datatype'], shape=t['shape']) for t in meta['inputs']],
+                outputs=[tensor(name=t['name'], datatype=t['datatype'], shape=t['shape']) for t in meta['outputs']])
+
+        def ModelConfig(self, request, context):
+            check_model(request.name, context)
+            return pb.ModelConfigResponse(config=config_proto)
+
+        def ModelStatistics(self, request, context):
+            s = model.statistics()['model_stats'][0]
+            stats = pb.ModelStatistics(name=s['name'], version=s['version'],
+                                       inference_count=s['inference_count'], execution_count=s['execution_count'])
+            for key, v in s['inference_stats'].items():
+                getattr(stats.inference_stats, key).count = v['count']
+                getattr(stats.inference_stats, key).ns = v['ns']
+            return pb.ModelStatisticsResponse(model_stats=[stats])
+
+        def SystemSharedMemoryRegister(self, request, context):
+            try:
+                shm.register(request.name, request.key, request.offset, request.byte_size)
+            except InferError as e:
+                context.abort(grpc.StatusCode.INVALID_ARGUMENT, str(e))
+            return pb.SystemSharedMemoryRegisterResponse()
+
+        def SystemSharedMemoryUnregister(self, request, context):
+            shm.unregister(request.name or None)
+            return pb.SystemSharedMemoryUnregisterResponse()
+
+        def SystemSharedMemoryStatus(self, request, context):
+            response = pb.SystemSharedMemoryStatusResponse()
+            for r in shm.status(request.name or None):
+                response.regions[r['name']].name = r['name']
+                response.regions[r['name']].key = r['key']
+                response.regions[r['name']].offset = r['offset']
+                response.regions[r['name']].byte_size = r['byte_size']
+            return response
+
+        def ModelInfer(self, request, context):
+            check_model(request.model_name, context)
+            try:
+                batch = None
+                bytes_in = 0
+                for i, t in enumerate(request.inputs):
+                    if 'shared_memory_region' in t.parameters:
+                        size = t.parameters['shared_memory_byte_size'].int64_param
+                        offset = t.parameters['shared_memory_offset'].int64_param if 'shared_memory_offset' in t.parameters else 0
+                        shm.check(t.parameters['shared_memory_region'].string_param, size, offset)
+                    elif i < len(request.raw_input_contents):
+                        size = len(request.raw_input_contents[i])
+                        bytes_in += size
+                    else:
+                        size = len(t.contents.fp32_contents) * 4
+                        bytes_in += size
+                    b = model.check_input(t.name, t.datatype, list(t.shape), size)
+                    if batch is not None and b != batch:
+                        raise InferError('inputs disagree on batch size')
+                    batch = b
+                if batch is None:
+                    raise InferError('request has no inputs')
+                shape, out = model.execute(batch, bytes_in)
+            except InferError as e:
+                model.failed()
+                context.abort(grpc.StatusCode.INVALID_ARGUMENT, str(e))
+            response = pb.ModelInferResponse(model_name=model.name, model_version='1', id=request.id)
+            for o in (request.outputs or [pb.ModelInferRequest.InferRequestedOutputTensor(name=model.outputs[0]['name'])]):
+                if o.name != model.outputs[0]['name']:
+                    context.abort(grpc.StatusCode.INVALID_ARGUMENT, f"unexpected inference output '{o.name}'")
+                tensor = response.outputs.add(name=o.name, datatype='FP32', shape=shape)
+                if 'shared_memory_region' in o.parameters:
+                    region = o.parameters['shared_memory_region'].string_param
+                    offset = o.parameters['shared_memory_offset'].int64_param if 'shared_memory_offset' in o.parameters else 0
+                    try:
+                        shm.write(region, out, o.parameters['shared_memory_byte_size'].int64_param, offset)
+                    except InferError as e:
+                        context.abort(grpc.StatusCode.INVALID_ARGUMENT, str(e))
+                    tensor.parameters['shared_memory_region'].string_param = region
+                    tensor.parameters['shared_memory_byte_size'].int64_param = len(out)
+                    # Keeps raw_output_contents aligned with outputs.
+                    response.raw_output_contents.append(b'')
+                else:
+                    response.raw_output_contents.append(out)
+            return response
+
+    # Triton accepts full-size image tensors, the gRPC default is a 4 MB cap.
+    server = grpc.server(futures.ThreadPoolExecutor(max_workers=workers),
+                         options=[('grpc.max_receive_message_length', -1),
+                                  ('grpc.max_send_message_length', -1)])
+    pb_grpc.add_GRPCInferenceServiceServicer_to_server(Servicer(), server)
+    server.add_insecure_port(f'[::]:{port}')
+    return server
+
+
+if __name__ == '__main__':
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--model-config',
+                        type=str,
+                        required=False,
+                        default=os.path.join(here, '..', 'models', 'yolov5', 'config.pbtxt'),
+                        help='Model configuration to serve, default ../models/yolov5/config.pbtxt')
+    parser.add_argument('--http-port',
+                        type=int,
+                        required=False,
+                        default=8220,
+                        help='HTTP/REST port, 0 disables it, default 8220 as in run_triton.sh')
+    parser.add_argument('--grpc-port',
+                        type=int,
+                        required=False,
+                        default=8221,
+                        help='gRPC port, 0 disables it, default 8221 as in run_triton.sh')
+    parser.add_argument('--max-batch-size',
+                        type=int,
+                        required=False,
+                        default=None,
+                        help='Override max_batch_size from the model config, e.g. to test client batching')
+    parser.add_argument('--replay',
+                        type=str,
+                        required=False,
+                        default=None,
+                        help='Raw little-endian FP32 file of one or more prob tensors to return in turn')
+    parser.add_argument('--boxes',
+                        type=int,
+                        required=False,
+                        default=20,
+                        help='Number of synthetic detections per image when not replaying, default 20')
+    parser.add_argument('--latency-ms',
+                        type=float,
+                        required=False,
+                        default=5.0,
+                        help='Fixed execution time per request in milliseconds, default 5')
+    parser.add_argument('--per-image-ms',
+                        type=float,
+                        required=False,
+                        default=0.0,
+                        help='Additional execution time per image in the batch, default 0')
+    parser.add_argument('--jitter-ms',
+                        type=float,
+                        required=False,
+                        default=0.0,
+                        help='Uniform random extra execution time, default 0')
+    parser.add_argument('--instances',
+                        type=int,
+                        required=False,
+                        default=None,
+                        help='Concurrent executions, default the instance_group count of the config')
+    parser.add_argument('--workers',
+                        type=int,
+                        required=False,
+                        default=16,
+                        help='gRPC worker threads, default 16')
+
+    FLAGS = parser.parse_args()
+    model = MockModel(FLAGS.model_config, FLAGS.max_batch_size, FLAGS.replay, FLAGS.boxes,
+                      FLAGS.latency_ms, FLAGS.per_image_ms, FLAGS.jitter_ms, FLAGS.instances)
+    shm = SharedMemoryRegistry()
+    print(f"Serving model '{model.name}' (max_batch_size {model.max_batch_size}, {model.instances} instances, "
+          f"{len(model.frames)} output frame(s), latency {FLAGS.latency_ms}ms + {FLAGS.per_image_ms}ms/image)")
+
+    http_server = None
+    grpc_server = None
+    if FLAGS.http_port:
+        http_server = ThreadingHTTPServer(('0.0.0.0', FLAGS.http_port), make_http_handler(model, shm))
+        http_server.daemon_threads = True
+        threading.Thread(target=http_server.serve_forever, daemon=True).start()
+        print(f'HTTP  listening on 0.0.0.0:{FLAGS.http_port}')
+    if FLAGS.grpc_port:
+        try:
+            grpc_server = make_grpc_server(model, shm, FLAGS.grpc_port, FLAGS.workers)
+        except ImportError as e:
+            print(f'gRPC disabled, {e}; install grpcio and tritonclient[grpc]')
+        else:
+            grpc_server.start()
+            print(f'gRPC  listening on 0.0.0.0:{FLAGS.grpc_port}')
+    sys.stdout.flush()
+
+    started = time.time()
+    stop = threading.Event()
+    signal.signal(signal.SIGINT, lambda *_: stop.set())
+    signal.signal(signal.SIGTERM, lambda *_: stop.set())
+    stop.wait()
+
+    if http_server:
+        http_server.shutdown()
+    if grpc_server:
+        grpc_server.stop(0)
+    shm.unregister()
+    s = model.stats
+    elapsed = time.time() - started
+    print(f"\n{s['requests']} requests, {s['images']} images, {s['failures']} failures in {elapsed:.1f}s; "
+          f"received {s['bytes_in'] / 1e6:.1f} MB, sent {s['bytes_out'] / 1e6:.1f} MB")
+    if s['requests']:
+        print(f"mean queue {s['queue_ns'] / s['requests'] / 1e6:.2f}ms, mean execution {s['compute_ns'] / s['requests'] / 1e6:.2f}ms")
@@ -0,0 +1,204 @@
+#!/usr/bin/env python
+"""
+Throughput of the yolov5 `data`/`prob` exchange over the KServe v2 HTTP protocol,
+tensors in the request/response body ("socket") versus in registered system
+shared memory ("shm"). Runs against mock_server.py or a real tritonserver on
+the same host, needs only the standard library.
+
+    python transport_bench.py -u localhost:8220 -c 4 -n 200
+"""
+
+import argparse
+import http.client
+import json
+import mmap
+import os
+import struct
+import threading
+import time
+
+OUTPUT_ELEMENTS = 6001
+# Per --input-format: datatype, shape and element size of `data`, matching
+# models/yolov5/config.pbtxt, config.uint8.pbtxt and config.fp16.pbtxt.
+INPUT_FORMATS = {
+    'fp32': ('FP32', [3, 640, 640], 4),
+    'uint8': ('INT32', [640, 480], 4),
+    'fp16': ('FP16', [640, 640, 3], 2),
+}
+
+
+class Worker(threading.Thread):
+
+    def __init__(self, index, flags, mode, barrier):
+        threading.Thread.__init__(self)
+        self.index = index
+        self.flags = flags
+        self.mode = mode
+        self.barrier = barrier
+        self.latencies = []
+        self.wire_bytes = 0
+        self.error = None
+        self.datatype, self.input_shape, element_size = INPUT_FORMATS[flags.input_format]
+        elements = flags.batch
+        for d in self.input_shape:
+            elements *= d
+        self.input_bytes = elements * element_size
+        self.output_bytes = flags.batch * OUTPUT_ELEMENTS * 4
+        # Stands in for the decoded frame the preprocessing reads from.
+        self.source = os.urandom(self.input_bytes)
+
+    def _post(self, conn, path, header, data=b''):
+        conn.putrequest('POST', path)
+        conn.putheader('Content-Length', str(len(header) + len(data)))
+        if data:
+            conn.putheader('Inference-Header-Content-Length', str(len(header)))
+        # One write for headers and JSON, so Nagle doesn't delay the small request.
+        conn.endheaders(message_body=header)
+        if data:
+            conn.send(data)
+        response = conn.getresponse()
+        body = response.read()
+        if response.status != 200:
+            raise RuntimeError(f'{path}: HTTP {response.status} {body[:200]}')
+        self.wire_bytes += len(header) + len(data) + len(body)
+        return response, body
+
+    def run(self):
+        try:
+            self._run()
+        except Exception as e:
+            self.error = e
+            self.barrier.abort()
+
+    def _run(self):
+        f = self.flags
+        host, port = f.url.split(':')
+        conn = http.client.HTTPConnection(host, int(port))
+        infer_path = f'/v2/models/{f.model}/infer'
+        shape = [f.batch] + self.input_shape
+        region = None
+        if self.mode == 'shm':
+            name = f'transport_bench_{os.getpid()}_{self.index}'
+            key = '/' + name
+            fd = os.open('/dev/shm' + key, os.O_RDWR | os.O_CREAT, 0o600)
+            os.ftruncate(fd, self.input_bytes + self.output_bytes)
+            region = mmap.mmap(fd, self.input_bytes + self.output_bytes)
+            os.close(fd)
+            self._post(conn, f'/v2/systemsharedmemory/region/{name}/register',
+                       json.dumps({'key': key, 'offset': 0, 'byte_size': self.input_bytes + self.output_bytes}).encode())
+            header = json.dumps({
+                'inputs': [{'name': 'data', 'datatype': self.datatype, 'shape': shape,
+                            'parameters': {'shared_memory_region': name, 'shared_memory_byte_size': self.input_bytes}}],
+                'outputs': [{'name': 'prob',
+                             'parameters': {'shared_memory_region': name, 'shared_memory_byte_size': self.output_bytes,
+                                            'shared_memory_offset': self.input_bytes}}]}).encode()
+        else:
+            buffer = bytearray(self.input_bytes)
+            header = json.dumps({
+                'inputs': [{'name': 'data', 'datatype': self.datatype, 'shape': shape,
+                            'parameters': {'binary_data_size': self.input_bytes}}],
+                'outputs': [{'name': 'prob', 'parameters': {'binary_data': True}}]}).encode()
+        self.wire_bytes = 0
+
+        self.barrier.wait()
+        try:
+            for _ in range(f.requests):
+                start = time.perf_counter()
+                if region is not None:
+                    # Preprocessing writes into the region, prob is read back in place.
+                    region[:self.input_bytes] = self.source
+                    self._post(conn, infer_path, header)
+                    count = struct.unpack_from('<f', region, self.input_bytes)[0]
+                else:
+                    buffer[:] = self.source
+                    response, body = self._post(conn, infer_path, header, buffer)
+                    offset = int(response.getheader('Inference-Header-Content-Length'))
+                    if len(body) - offset != self.output_bytes:
+                        raise RuntimeError(f'expected {self.output_bytes} output bytes, got {len(body) - offset}')
+                    count = struct.unpack_from('<f', body, offset)[0]
+                if count < 0:
+                    raise RuntimeError('corrupt prob tensor')
+                self.latencies.append(time.perf_counter() - start)
+        finally:
+            if region is not None:
+                conn.request('POST', f'/v2/systemsharedmemory/region/{name}/unregister')
+                conn.getresponse().read()
+                region.close()
+                os.unlink('/dev/shm' + key)
+            conn.close()
+
+
+def run(flags, mode):
+    barrier = threading.Barrier(flags.concurrency + 1)
+    workers = [Worker(i, flags, mode, barrier) for i in range(flags.concurrency)]
+    for w in workers:
+        w.start()
+    try:
+        barrier.wait()
+    except threading.BrokenBarrierError:
+        pass
+    start = time.perf_counter()
+    for w in workers:
+        w.join()
+    elapsed = time.perf_counter() - start
+    for w in workers:
+        if w.error:
+            raise w.error
+    latencies = sorted(l for w in workers for l in w.latencies)
+    requests = len(latencies)
+    return {'mode': mode, 'fps': requests * flags.batch / elapsed,
+            'mean': 1000 * sum(latencies) / requests, 'p50': 1000 * latencies[requests // 2],
+            'p99': 1000 * latencies[min(requests - 1, int(requests * 0.99))],
+            'wire': sum(w.wire_bytes for w in workers) / requests}
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-u',
+                        '--url',
+                        type=str,
+                        required=False,
+                        default='localhost:8220',
+                        help='HTTP endpoint of the server, default localhost:8220')
+    parser.add_argument('-m',
+                        '--model',
+                        type=str,
+                        required=False,
+                        default='yolov5',
+                        help='Inference model name, default yolov5')
+    parser.add_argument('-b',
+                        '--batch',
+                        type=int,
+                        required=False,
+                        default=1,
+                        help='Images per request, default 1')
+    parser.add_argument('-c',
+                        '--concurrency',
+                        type=int,
+                        required=False,
+                        default=4,
+                        help='Concurrent clients, each with its own connection and region, default 4')
+    parser.add_argument('-n',
+                        '--requests',
+                        type=int,
+                        required=False,
+                        default=100,
+                        help='Requests per client, default 100')
+    parser.add_argument('--input-format',
+                        choices=list(INPUT_FORMATS),
+                        default='fp32',
+                        help='Input contract, the server must run the matching model config, default fp32')
+    parser.add_argument('--mode',
+                        choices=['socket', 'shm', 'both'],
+                        default='both',
+                        help='Transport to measure, default both')
+
+    FLAGS = parser.parse_args()
+    modes = ['socket', 'shm'] if FLAGS.mode == 'both' else [FLAGS.mode]
+    results = [run(FLAGS, mode) for mode in modes]
+    print(f'{FLAGS.input_format} input, batch {FLAGS.batch}, concurrency {FLAGS.concurrency}, {FLAGS.requests} requests per client')
+    for r in results:
+        print(f"{r['mode']:>6}: {r['fps']:8.1f} FPS  latency mean {r['mean']:.2f}ms p50 {r['p50']:.2f}ms "
+              f"p99 {r['p99']:.2f}ms  {r['wire'] / 1e6:.3f} MB on the wire per request")
+    if len(results) == 2:
+        print(f"shm / socket throughput: {results[1]['fps'] / results[0]['fps']:.2f}x")